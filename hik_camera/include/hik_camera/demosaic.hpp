@@ -0,0 +1,80 @@
+#ifndef HIK_CAMERA__DEMOSAIC_HPP_
+#define HIK_CAMERA__DEMOSAIC_HPP_
+
+// STD
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hik_camera
+{
+// Colors of the top-left 2x2 block, in row order
+enum class BayerPattern { RGGB, GRBG, GBRG, BGGR };
+
+enum class DemosaicMode {
+  // Green and chroma from the average of the nearest samples
+  BILINEAR,
+  // Green interpolated along the direction with the smaller gradient, avoiding zippering on the
+  // edges of the lights
+  EDGE_AWARE,
+};
+
+// Returns false for unknown names, "bilinear" and "edge_aware" are known
+bool demosaicModeFromName(const std::string & name, DemosaicMode & mode);
+
+// Converts 8-bit Bayer frames to RGB or gray. The frame is split into bands of rows converted in
+// parallel by a fixed pool of threads, the calling thread converts the first band.
+class Demosaicer
+{
+public:
+  // threads <= 1 converts on the calling thread only. worker_setup runs first on every pool
+  // thread, e.g. to give it the real-time profile of the calling thread. The constructor waits
+  // for all of them and rethrows the first exception one of them threw.
+  explicit Demosaicer(int threads, const std::function<void()> & worker_setup = nullptr);
+  ~Demosaicer();
+
+  // dst is width * height * 3 bytes, rows not padded
+  void toRgb(
+    const uint8_t * src, int width, int height, BayerPattern pattern, DemosaicMode mode,
+    uint8_t * dst);
+
+  // Luma of the bilinear RGB, with the OpenCV RGB2GRAY weights. dst is width * height bytes.
+  void toGray(const uint8_t * src, int width, int height, BayerPattern pattern, uint8_t * dst);
+
+  int threads() const { return static_cast<int>(workers_.size()) + 1; }
+
+private:
+  // rgb_dst or gray_dst is nullptr
+  void convert(
+    const uint8_t * src, int width, int height, BayerPattern pattern, DemosaicMode mode,
+    uint8_t * rgb_dst, uint8_t * gray_dst);
+
+  // Runs band(i) for every band i, in parallel
+  void runBands(const std::function<void(int)> & band);
+  void workerLoop(int band);
+  void stopWorkers();
+
+  // Row range of a band
+  void bandRows(int band, int height, int & first, int & last) const;
+
+  // Per band scratch rows, 3 padded Bayer rows and one RGB row
+  void reserveScratch(int width);
+  std::vector<std::vector<uint8_t>> scratch_;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(int)> * job_;
+  unsigned generation_;
+  int pending_;
+  bool stop_;
+};
+
+}  // namespace hik_camera
+
+#endif  // HIK_CAMERA__DEMOSAIC_HPP_
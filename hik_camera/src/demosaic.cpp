@@ -0,0 +1,293 @@
+#include "hik_camera/demosaic.hpp"
+
+// STD
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <future>
+
+// The row loops are vectorized by the compiler, on x86 an AVX2 clone is picked at load time
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+#define DEMOSAIC_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define DEMOSAIC_TARGET_CLONES
+#endif
+
+namespace hik_camera
+{
+namespace
+{
+// OpenCV's fixed point RGB2GRAY weights
+constexpr int kGrayShift = 14;
+constexpr int kGrayR = 4899;
+constexpr int kGrayG = 9617;
+constexpr int kGrayB = 1868;
+
+// Copy a Bayer row with one pixel of mirrored padding on both sides, which keeps the pattern
+void padRow(const uint8_t * row, int width, uint8_t * padded)
+{
+  std::memcpy(padded + 1, row, width);
+  padded[0] = row[width > 1 ? 1 : 0];
+  padded[width + 1] = row[width > 1 ? width - 2 : 0];
+}
+
+// Demosaic one row into planes of the color sampled in this row (red in a red row, blue in a
+// blue row), green and the color sampled in the rows around. up/mid/down are padded rows.
+// The color and green sites are filled by separate stride-2 loops the compiler can vectorize.
+DEMOSAIC_TARGET_CLONES void demosaicRow(
+  const uint8_t * up, const uint8_t * mid, const uint8_t * down, int width, bool first_green,
+  bool edge_aware, uint8_t * __restrict own_plane, uint8_t * __restrict green_plane,
+  uint8_t * __restrict other_plane)
+{
+  // Skip the padding, index -1 and width are valid
+  const uint8_t * __restrict u = up + 1;
+  const uint8_t * __restrict m = mid + 1;
+  const uint8_t * __restrict d = down + 1;
+
+  const int color_first = first_green ? 1 : 0;
+  const int green_first = 1 - color_first;
+  // Includes the last pixel of an odd row
+  const int color_num = (width - color_first + 1) / 2;
+  const int green_num = (width - green_first + 1) / 2;
+
+  for (int k = 0; k < color_num; k++) {
+    int x = 2 * k + color_first;
+    uint16_t n = u[x], s = d[x], w = m[x - 1], e = m[x + 1];
+    uint16_t g;
+    if (edge_aware) {
+      uint16_t dh = w > e ? w - e : e - w, dv = n > s ? n - s : s - n;
+      g = dh < dv ? (w + e + 1) >> 1 : dv < dh ? (n + s + 1) >> 1 : (n + s + w + e + 2) >> 2;
+    } else {
+      g = (n + s + w + e + 2) >> 2;
+    }
+    own_plane[x] = m[x];
+    green_plane[x] = g;
+    other_plane[x] = (u[x - 1] + u[x + 1] + d[x - 1] + d[x + 1] + 2) >> 2;
+  }
+  for (int k = 0; k < green_num; k++) {
+    int x = 2 * k + green_first;
+    own_plane[x] = (m[x - 1] + m[x + 1] + 1) >> 1;
+    green_plane[x] = m[x];
+    other_plane[x] = (u[x] + d[x] + 1) >> 1;
+  }
+}
+
+DEMOSAIC_TARGET_CLONES void interleaveRow(
+  const uint8_t * __restrict r, const uint8_t * __restrict g, const uint8_t * __restrict b,
+  int width, uint8_t * __restrict dst)
+{
+  for (int x = 0; x < width; x++) {
+    dst[3 * x] = r[x];
+    dst[3 * x + 1] = g[x];
+    dst[3 * x + 2] = b[x];
+  }
+}
+
+DEMOSAIC_TARGET_CLONES void grayRow(
+  const uint8_t * __restrict r, const uint8_t * __restrict g, const uint8_t * __restrict b,
+  int width, uint8_t * __restrict dst)
+{
+  for (int x = 0; x < width; x++) {
+    dst[x] = (r[x] * kGrayR + g[x] * kGrayG + b[x] * kGrayB + (1 << (kGrayShift - 1))) >>
+             kGrayShift;
+  }
+}
+}  // namespace
+
+bool demosaicModeFromName(const std::string & name, DemosaicMode & mode)
+{
+  if (name == "bilinear") {
+    mode = DemosaicMode::BILINEAR;
+  } else if (name == "edge_aware") {
+    mode = DemosaicMode::EDGE_AWARE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+Demosaicer::Demosaicer(int threads, const std::function<void()> & worker_setup)
+: job_(nullptr), generation_(0), pending_(0), stop_(false)
+{
+  scratch_.resize(std::max(threads, 1));
+  std::vector<std::promise<void>> setups(scratch_.size() - 1);
+  std::vector<std::future<void>> setup_results;
+  for (auto & setup : setups) {
+    setup_results.push_back(setup.get_future());
+  }
+
+  for (int band = 1; band < threads; band++) {
+    workers_.emplace_back([this, band, &worker_setup, &setup = setups[band - 1]]() {
+      try {
+        if (worker_setup) {
+          worker_setup();
+        }
+        setup.set_value();
+      } catch (...) {
+        setup.set_exception(std::current_exception());
+        return;
+      }
+      workerLoop(band);
+    });
+  }
+
+  std::exception_ptr error;
+  for (auto & result : setup_results) {
+    try {
+      result.get();
+    } catch (...) {
+      error = error ? error : std::current_exception();
+    }
+  }
+  if (error) {
+    // The destructor does not run for a throwing constructor
+    stopWorkers();
+    std::rethrow_exception(error);
+  }
+}
+
+Demosaicer::~Demosaicer() { stopWorkers(); }
+
+void Demosaicer::stopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto & worker : workers_) {
+    worker.join();
+  }
+}
+
+void Demosaicer::toRgb(
+  const uint8_t * src, int width, int height, BayerPattern pattern, DemosaicMode mode,
+  uint8_t * dst)
+{
+  convert(src, width, height, pattern, mode, dst, nullptr);
+}
+
+void Demosaicer::toGray(
+  const uint8_t * src, int width, int height, BayerPattern pattern, uint8_t * dst)
+{
+  convert(src, width, height, pattern, DemosaicMode::BILINEAR, nullptr, dst);
+}
+
+void Demosaicer::convert(
+  const uint8_t * src, int width, int height, BayerPattern pattern, DemosaicMode mode,
+  uint8_t * rgb_dst, uint8_t * gray_dst)
+{
+  // Position of red in the top-left 2x2 block
+  const int pattern_index = static_cast<int>(pattern);
+  const int red_y = pattern_index == 0 || pattern_index == 1 ? 0 : 1;
+  const int red_x = pattern_index == 0 || pattern_index == 2 ? 0 : 1;
+  // Rows above and below the image are mirrored, which keeps the pattern
+  auto mirrored = [height](int y) {
+    return height == 1 ? 0 : y < 0 ? -y : y >= height ? 2 * height - 2 - y : y;
+  };
+
+  reserveScratch(width);
+  std::function<void(int)> band = [&](int band_index) {
+    int first, last;
+    bandRows(band_index, height, first, last);
+    if (first >= last) {
+      return;
+    }
+
+    const int padded = width + 2;
+    uint8_t * scratch = scratch_[band_index].data();
+    uint8_t * rows[3] = {scratch, scratch + padded, scratch + 2 * padded};
+    uint8_t * own = scratch + 3 * padded;
+    uint8_t * green = own + width;
+    uint8_t * other = green + width;
+    padRow(src + mirrored(first - 1) * width, width, rows[0]);
+    padRow(src + first * width, width, rows[1]);
+
+    for (int y = first; y < last; y++) {
+      padRow(src + mirrored(y + 1) * width, width, rows[2]);
+
+      bool red_row = (y & 1) == red_y;
+      // Green comes first in a red row if red is in the second column, and the other way round
+      bool first_green = red_row == (red_x == 1);
+      demosaicRow(
+        rows[0], rows[1], rows[2], width, first_green, mode == DemosaicMode::EDGE_AWARE, own, green,
+        other);
+      const uint8_t * r = red_row ? own : other;
+      const uint8_t * b = red_row ? other : own;
+      if (gray_dst != nullptr) {
+        grayRow(r, green, b, width, gray_dst + y * width);
+      } else {
+        interleaveRow(r, green, b, width, rgb_dst + y * width * 3);
+      }
+      std::rotate(rows, rows + 1, rows + 3);
+    }
+  };
+  runBands(band);
+}
+
+void Demosaicer::reserveScratch(int width)
+{
+  size_t size = 3 * (width + 2) + 3 * width;
+  for (auto & scratch : scratch_) {
+    if (scratch.size() < size) {
+      scratch.resize(size);
+    }
+  }
+}
+
+void Demosaicer::bandRows(int band, int height, int & first, int & last) const
+{
+  int bands = static_cast<int>(scratch_.size());
+  int rows = (height + bands - 1) / bands;
+  first = std::min(band * rows, height);
+  last = std::min(first + rows, height);
+}
+
+void Demosaicer::runBands(const std::function<void(int)> & band)
+{
+  if (workers_.empty()) {
+    band(0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &band;
+    pending_ = static_cast<int>(workers_.size());
+    generation_++;
+  }
+  start_cv_.notify_all();
+
+  band(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]() { return pending_ == 0; });
+  job_ = nullptr;
+}
+
+void Demosaicer::workerLoop(int band)
+{
+  unsigned seen = 0;
+  while (true) {
+    const std::function<void(int)> * job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [this, seen]() { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+      job = job_;
+    }
+
+    (*job)(band);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+}  // namespace hik_camera
@@ -1,4 +1,10 @@
 #include "MvCameraControl.h"
+#include "auto_aim_interfaces/msg/detector_feedback.hpp"
+#include "auto_aim_interfaces/msg/frame_trace.hpp"
+#include "auto_aim_utils/live_metrics.hpp"
+#include "auto_aim_utils/realtime_parameters.hpp"
+#include "auto_aim_utils/tracing.hpp"
+#include "hik_camera/demosaic.hpp"
 // ROS
 #include <camera_info_manager/camera_info_manager.hpp>
 #include <image_transport/image_transport.hpp>
@@ -8,47 +14,86 @@
 #include <sensor_msgs/msg/camera_info.hpp>
 #include <sensor_msgs/msg/image.hpp>
 
+// STD
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace hik_camera
 {
+// Interval between two device enumerations while no camera is connected
+constexpr auto kDiscoverInterval = std::chrono::milliseconds(500);
+// Longest wait after a failed recovery, the wait doubles from kDiscoverInterval on every failure
+constexpr auto kMaxRecoverInterval = std::chrono::milliseconds(8000);
+// Timeout of MV_CC_GetImageBuffer
+constexpr unsigned int kGrabTimeoutMs = 1000;
+// Consecutive grab failures after which the device is reopened even though it is connected
+constexpr int kMaxGrabFailures = 3;
+// Weight of the newest sample in the smoothed capture time
+constexpr double kPacingSmoothing = 0.2;
+// Frames per frame age report
+constexpr size_t kFrameAgeReportFrames = 500;
+// Frames per pixel conversion time report
+constexpr size_t kConvertReportFrames = 500;
+// Live metrics
+enum MetricsCounter { FRAMES_COUNTER = 0, GRAB_FAILURES_COUNTER, RECOVERIES_COUNTER };
+enum MetricsGauge { STATE_GAUGE = 0 };
+enum MetricsHistogram {
+  GRAB_HISTOGRAM = 0,
+  CONVERT_HISTOGRAM,
+  PUBLISH_HISTOGRAM,
+  FRAME_AGE_HISTOGRAM,
+};
+
+// Pattern of the 8-bit Bayer pixel types, false for everything else
+bool bayerPattern(MvGvspPixelType pixel_type, BayerPattern & pattern)
+{
+  switch (pixel_type) {
+    case PixelType_Gvsp_BayerRG8:
+      pattern = BayerPattern::RGGB;
+      return true;
+    case PixelType_Gvsp_BayerGR8:
+      pattern = BayerPattern::GRBG;
+      return true;
+    case PixelType_Gvsp_BayerGB8:
+      pattern = BayerPattern::GBRG;
+      return true;
+    case PixelType_Gvsp_BayerBG8:
+      pattern = BayerPattern::BGGR;
+      return true;
+    default:
+      return false;
+  }
+}
+
 class HikCameraNode : public rclcpp::Node
 {
 public:
+  // The capture thread brings the camera up and brings it back after a disconnection:
+  // DISCOVER -> OPEN -> CONFIGURE -> STREAM, any failure goes to RECOVER, which closes the
+  // device and starts over from DISCOVER after a wait that grows with every failed attempt
+  enum class State { DISCOVER, OPEN, CONFIGURE, STREAM, RECOVER };
+
   explicit HikCameraNode(const rclcpp::NodeOptions & options) : Node("hik_camera", options)
   {
     RCLCPP_INFO(this->get_logger(), "Starting HikCameraNode!");
 
-    MV_CC_DEVICE_INFO_LIST DeviceList;
-    // enum device
-    nRet = MV_CC_EnumDevices(MV_USB_DEVICE, &DeviceList);
-    RCLCPP_INFO(this->get_logger(), "Found camera count = %d", DeviceList.nDeviceNum);
-
-    while (DeviceList.nDeviceNum == 0 && rclcpp::ok()) {
-      RCLCPP_ERROR(this->get_logger(), "No camera found!");
-      RCLCPP_INFO(this->get_logger(), "Enum state: [%x]", nRet);
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      nRet = MV_CC_EnumDevices(MV_USB_DEVICE, &DeviceList);
-    }
-
-    MV_CC_CreateHandle(&camera_handle_, DeviceList.pDeviceInfo[0]);
-
-    MV_CC_OpenDevice(camera_handle_);
-
-    // Get camera infomation
-    MV_CC_GetImageInfo(camera_handle_, &img_info_);
-    image_msg_.data.reserve(img_info_.nHeightMax * img_info_.nWidthMax * 3);
-
-    // Init convert param
-    ConvertParam_.nWidth = img_info_.nWidthMax;
-    ConvertParam_.nHeight = img_info_.nHeightMax;
-    ConvertParam_.enDstPixelType = PixelType_Gvsp_RGB8_Packed;
-
     bool use_sensor_data_qos = this->declare_parameter("use_sensor_data_qos", false);
     auto qos = use_sensor_data_qos ? rmw_qos_profile_sensor_data : rmw_qos_profile_default;
     camera_pub_ = image_transport::create_camera_publisher(this, "image_raw", qos);
 
-    declareParameters();
-
-    MV_CC_StartGrabbing(camera_handle_);
+    // Start of the per-frame latency trace, continued by the detector and the processor
+    trace_pub_ = this->create_publisher<auto_aim_interfaces::msg::FrameTrace>(
+      "/camera/trace", rclcpp::SensorDataQoS());
 
     // Load camera info
     camera_name_ = this->declare_parameter("camera_name", "Vanguard");
@@ -63,97 +108,456 @@ public:
       RCLCPP_WARN(this->get_logger(), "Invalid camera info URL: %s", camera_info_url.c_str());
     }
 
+    image_msg_.header.frame_id = "camera_optical_frame";
+    image_msg_.encoding = "rgb8";
+
+    // Software trigger pacing
+    // Instead of free-running, each exposure is triggered so that the frame arrives when the
+    // detector is expected to be done with the previous one, as reported on /detector/feedback
+    software_trigger_ = this->declare_parameter("trigger.software", false);
+    trigger_lead_ms_ = this->declare_parameter("trigger.lead_ms", 1.0);
+    min_trigger_interval_ms_ = this->declare_parameter("trigger.min_interval_ms", 4.0);
+    max_trigger_interval_ms_ = this->declare_parameter("trigger.max_interval_ms", 20.0);
+    feedback_sub_ = this->create_subscription<auto_aim_interfaces::msg::DetectorFeedback>(
+      "/detector/feedback", rclcpp::SensorDataQoS(),
+      std::bind(&HikCameraNode::feedbackCallback, this, std::placeholders::_1));
+    frame_ages_.reserve(kFrameAgeReportFrames);
+
+    // Real-time profile of the capture thread, failures are reported back to the constructor
+    auto realtime_config = auto_aim_utils::declareRealtimeParameters(this, "realtime");
+
+    // Bayer to RGB conversion, "sdk" uses MV_CC_ConvertPixelType, "bilinear" and "edge_aware"
+    // our own converter split across demosaic.threads threads. The converter threads work for
+    // the capture thread and get its real-time profile.
+    demosaic_name_ = this->declare_parameter("demosaic.mode", "sdk");
+    int demosaic_threads = this->declare_parameter("demosaic.threads", 2);
+    if (demosaic_name_ != "sdk") {
+      if (demosaicModeFromName(demosaic_name_, demosaic_mode_)) {
+        demosaicer_ = std::make_unique<Demosaicer>(demosaic_threads, [this, realtime_config]() {
+          auto_aim_utils::setupRealtimeThread(this, realtime_config, "demosaic");
+        });
+      } else {
+        RCLCPP_WARN(
+          this->get_logger(), "Unknown demosaic mode %s, using sdk", demosaic_name_.c_str());
+        demosaic_name_ = "sdk";
+      }
+    }
+
+    // Frame, grab failure and recovery counters, the capture state and latency histograms in
+    // shared memory, watched with aimtop
+    if (this->declare_parameter("live_metrics.enable", true)) {
+      try {
+        live_metrics_ = std::make_unique<auto_aim_utils::LiveMetrics>(
+          this->get_fully_qualified_name(),
+          std::vector<std::string>{"frames", "grab_failures", "recoveries"},
+          std::vector<std::string>{"state"},
+          std::vector<std::string>{"grab", "convert", "publish", "frame_age"});
+        live_metrics_->setLabels(
+          STATE_GAUGE, {"DISCOVER", "OPEN", "CONFIGURE", "STREAM", "RECOVER"});
+      } catch (const std::runtime_error & e) {
+        RCLCPP_WARN(this->get_logger(), "Live metrics unavailable: %s", e.what());
+      }
+    }
+
+    // Declared before the camera is up, their values are applied whenever it is configured
+    declareParameters();
+
+    // Registered after all parameters have been declared
     params_callback_handle_ = this->add_on_set_parameters_callback(
       std::bind(&HikCameraNode::parametersCallback, this, std::placeholders::_1));
-
-    capture_thread_ = std::thread{[this]() -> void {
-      MV_FRAME_OUT OutFrame;
-
-      RCLCPP_INFO(this->get_logger(), "Publishing image!");
-
-      image_msg_.header.frame_id = "camera_optical_frame";
-      image_msg_.encoding = "rgb8";
-
-      while (rclcpp::ok()) {
-        nRet = MV_CC_GetImageBuffer(camera_handle_, &OutFrame, 1000);
-        if (MV_OK == nRet) {
-          ConvertParam_.pDstBuffer = image_msg_.data.data();
-          ConvertParam_.nDstBufferSize = image_msg_.data.size();
-          ConvertParam_.pSrcData = OutFrame.pBufAddr;
-          ConvertParam_.nSrcDataLen = OutFrame.stFrameInfo.nFrameLen;
-          ConvertParam_.enSrcPixelType = OutFrame.stFrameInfo.enPixelType;
-
-          MV_CC_ConvertPixelType(camera_handle_, &ConvertParam_);
-
-          camera_info_msg_.header.stamp = image_msg_.header.stamp = this->now();
-          image_msg_.height = OutFrame.stFrameInfo.nHeight;
-          image_msg_.width = OutFrame.stFrameInfo.nWidth;
-          image_msg_.step = OutFrame.stFrameInfo.nWidth * 3;
-          image_msg_.data.resize(image_msg_.width * image_msg_.height * 3);
-          camera_pub_.publish(image_msg_, camera_info_msg_);
-
-          MV_CC_FreeImageBuffer(camera_handle_, &OutFrame);
-        } else {
-          RCLCPP_INFO(this->get_logger(), "Get buffer failed! nRet: [%x]", nRet);
-          MV_CC_StopGrabbing(camera_handle_);
-          MV_CC_StartGrabbing(camera_handle_);
-        }
+    std::promise<void> realtime_setup;
+    auto realtime_setup_result = realtime_setup.get_future();
+
+    // The camera is brought up by the capture thread, so the node starts without waiting for it
+    running_ = true;
+    capture_thread_ = std::thread{[this, realtime_config, &realtime_setup]() -> void {
+      try {
+        auto_aim_utils::setupRealtimeThread(this, realtime_config, "capture");
+        realtime_setup.set_value();
+      } catch (...) {
+        realtime_setup.set_exception(std::current_exception());
+        return;
       }
+      captureLoop();
     }};
+
+    try {
+      realtime_setup_result.get();
+    } catch (...) {
+      // The destructor does not run for a throwing constructor, release what it would have
+      running_ = false;
+      capture_thread_.join();
+      closeDevice();
+      throw;
+    }
   }
 
   ~HikCameraNode()
   {
+    {
+      // Under the lock, so that a wait of the capture thread can't miss it
+      std::lock_guard<std::mutex> lock(pacing_mutex_);
+      running_ = false;
+    }
+    pacing_cv_.notify_all();
     if (capture_thread_.joinable()) {
       capture_thread_.join();
     }
+    closeDevice();
+    RCLCPP_INFO(this->get_logger(), "HikCameraNode destroyed!");
+  }
+
+private:
+  void captureLoop()
+  {
+    State state = State::DISCOVER;
+    while (running_ && rclcpp::ok()) {
+      if (live_metrics_ != nullptr) {
+        live_metrics_->set(STATE_GAUGE, static_cast<int>(state));
+      }
+      switch (state) {
+        case State::DISCOVER:
+          if (discoverDevice()) {
+            state = State::OPEN;
+          } else {
+            std::this_thread::sleep_for(kDiscoverInterval);
+          }
+          break;
+        case State::OPEN:
+          state = openDevice() ? State::CONFIGURE : State::RECOVER;
+          break;
+        case State::CONFIGURE:
+          state = configureDevice() ? State::STREAM : State::RECOVER;
+          break;
+        case State::STREAM:
+          if (!grabFrame()) {
+            RCLCPP_WARN(this->get_logger(), "Camera lost, reconnecting");
+            lost_time_ = std::chrono::steady_clock::now();
+            recovering_ = true;
+            state = State::RECOVER;
+          }
+          break;
+        case State::RECOVER:
+          closeDevice();
+          waitToRecover();
+          state = State::DISCOVER;
+          break;
+      }
+    }
+  }
+
+  // Wait recover_interval_ or until the node stops, a camera that can be found but not opened
+  // or configured would otherwise be retried in a busy loop
+  void waitToRecover()
+  {
+    {
+      std::unique_lock<std::mutex> lock(pacing_mutex_);
+      pacing_cv_.wait_for(lock, recover_interval_, [this]() { return !running_; });
+    }
+    recover_interval_ = std::min(2 * recover_interval_, kMaxRecoverInterval);
+  }
+
+  bool discoverDevice()
+  {
+    nRet = MV_CC_EnumDevices(MV_USB_DEVICE, &device_list_);
+    if (nRet != MV_OK || device_list_.nDeviceNum == 0) {
+      RCLCPP_ERROR_THROTTLE(
+        this->get_logger(), *this->get_clock(), 5000, "No camera found! Enum state: [%x]", nRet);
+      return false;
+    }
+    RCLCPP_INFO(this->get_logger(), "Found camera count = %d", device_list_.nDeviceNum);
+    return true;
+  }
+
+  bool openDevice()
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    nRet = MV_CC_CreateHandle(&camera_handle_, device_list_.pDeviceInfo[0]);
+    if (nRet != MV_OK) {
+      RCLCPP_ERROR(this->get_logger(), "Failed to create camera handle! nRet: [%x]", nRet);
+      camera_handle_ = nullptr;
+      return false;
+    }
+    nRet = MV_CC_OpenDevice(camera_handle_);
+    if (nRet != MV_OK) {
+      RCLCPP_ERROR(this->get_logger(), "Failed to open camera! nRet: [%x]", nRet);
+      return false;
+    }
+
+    device_lost_ = false;
+    MV_CC_RegisterExceptionCallBack(camera_handle_, &HikCameraNode::onException, this);
+    return true;
+  }
+
+  bool configureDevice()
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    // Reapply the parameters, including those set while the camera was away
+    applyFloatValue("ExposureTime", this->get_parameter("exposure_time").as_int());
+    applyFloatValue("Gain", this->get_parameter("gain").as_double());
+    MV_CC_SetEnumValue(
+      camera_handle_, "TriggerMode", software_trigger_ ? MV_TRIGGER_MODE_ON : MV_TRIGGER_MODE_OFF);
+    if (software_trigger_) {
+      MV_CC_SetEnumValue(camera_handle_, "TriggerSource", MV_TRIGGER_SOURCE_SOFTWARE);
+    }
+
+    // Get camera infomation
+    MV_CC_GetImageInfo(camera_handle_, &img_info_);
+    image_msg_.data.reserve(img_info_.nHeightMax * img_info_.nWidthMax * 3);
+
+    nRet = MV_CC_StartGrabbing(camera_handle_);
+    if (nRet != MV_OK) {
+      RCLCPP_ERROR(this->get_logger(), "Failed to start grabbing! nRet: [%x]", nRet);
+      return false;
+    }
+    RCLCPP_INFO(this->get_logger(), "Publishing image!");
+    grab_failures_ = 0;
+    return true;
+  }
+
+  // Returns false once the camera has to be reopened
+  bool grabFrame()
+  {
+    if (device_lost_) {
+      return false;
+    }
+
+    if (software_trigger_) {
+      waitForTrigger();
+      trigger_time_ = std::chrono::steady_clock::now();
+      MV_CC_SetCommandValue(camera_handle_, "TriggerSoftware");
+    }
+
+    MV_FRAME_OUT OutFrame;
+    AUTO_AIM_TRACE_BEGIN(builtin_interfaces::msg::Time(), "camera_grab");
+    auto grab_start = std::chrono::steady_clock::now();
+    nRet = MV_CC_GetImageBuffer(camera_handle_, &OutFrame, kGrabTimeoutMs);
+    std::chrono::duration<double, std::milli> grab_time =
+      std::chrono::steady_clock::now() - grab_start;
+    AUTO_AIM_TRACE_END(builtin_interfaces::msg::Time(), "camera_grab");
+    if (MV_OK != nRet) {
+      RCLCPP_INFO(this->get_logger(), "Get buffer failed! nRet: [%x]", nRet);
+      if (live_metrics_ != nullptr) {
+        live_metrics_->add(GRAB_FAILURES_COUNTER);
+      }
+      if (!MV_CC_IsDeviceConnected(camera_handle_) || ++grab_failures_ >= kMaxGrabFailures) {
+        return false;
+      }
+      std::lock_guard<std::mutex> lock(camera_mutex_);
+      MV_CC_StopGrabbing(camera_handle_);
+      MV_CC_StartGrabbing(camera_handle_);
+      return true;
+    }
+    grab_failures_ = 0;
+    auto grabbed_time = this->now();
+
+    image_msg_.height = OutFrame.stFrameInfo.nHeight;
+    image_msg_.width = OutFrame.stFrameInfo.nWidth;
+    image_msg_.step = OutFrame.stFrameInfo.nWidth * 3;
+    image_msg_.data.resize(image_msg_.width * image_msg_.height * 3);
+
+    AUTO_AIM_TRACE_BEGIN(builtin_interfaces::msg::Time(), "camera_convert");
+    auto convert_start = std::chrono::steady_clock::now();
+    BayerPattern pattern;
+    if (demosaicer_ != nullptr && bayerPattern(OutFrame.stFrameInfo.enPixelType, pattern)) {
+      demosaicer_->toRgb(
+        OutFrame.pBufAddr, image_msg_.width, image_msg_.height, pattern, demosaic_mode_,
+        image_msg_.data.data());
+    } else {
+      ConvertParam_.nWidth = OutFrame.stFrameInfo.nWidth;
+      ConvertParam_.nHeight = OutFrame.stFrameInfo.nHeight;
+      ConvertParam_.enDstPixelType = PixelType_Gvsp_RGB8_Packed;
+      ConvertParam_.pDstBuffer = image_msg_.data.data();
+      ConvertParam_.nDstBufferSize = image_msg_.data.size();
+      ConvertParam_.pSrcData = OutFrame.pBufAddr;
+      ConvertParam_.nSrcDataLen = OutFrame.stFrameInfo.nFrameLen;
+      ConvertParam_.enSrcPixelType = OutFrame.stFrameInfo.enPixelType;
+
+      MV_CC_ConvertPixelType(camera_handle_, &ConvertParam_);
+    }
+    std::chrono::duration<double, std::milli> convert_time =
+      std::chrono::steady_clock::now() - convert_start;
+    AUTO_AIM_TRACE_END(builtin_interfaces::msg::Time(), "camera_convert");
+    convert_ms_sum_ += convert_time.count();
+    if (++convert_count_ == kConvertReportFrames) {
+      RCLCPP_INFO(
+        this->get_logger(), "Pixel conversion (%s): %.2fms per frame on average",
+        demosaic_name_.c_str(), convert_ms_sum_ / convert_count_);
+      convert_ms_sum_ = 0.0;
+      convert_count_ = 0;
+    }
+
+    camera_info_msg_.header.stamp = image_msg_.header.stamp = this->now();
+    AUTO_AIM_TRACE_PUBLISHED("image_raw", image_msg_.header.stamp, OutFrame.stFrameInfo.nFrameNum);
+    AUTO_AIM_TRACE_BEGIN(image_msg_.header.stamp, "camera_publish");
+    auto publish_start = std::chrono::steady_clock::now();
+
+    // The trace goes out first so that the detector has it when the image arrives
+    using auto_aim_interfaces::msg::FrameTrace;
+    trace_msg_.frame_number = OutFrame.stFrameInfo.nFrameNum;
+    trace_msg_.capture_stamp = image_msg_.header.stamp;
+    trace_msg_.enter_ns[FrameTrace::CAPTURE] = grabbed_time.nanoseconds();
+    trace_msg_.exit_ns[FrameTrace::CAPTURE] = rclcpp::Time(image_msg_.header.stamp).nanoseconds();
+    trace_pub_->publish(trace_msg_);
+    camera_pub_.publish(image_msg_, camera_info_msg_);
+    AUTO_AIM_TRACE_END(image_msg_.header.stamp, "camera_publish");
+    if (live_metrics_ != nullptr) {
+      std::chrono::duration<double, std::milli> publish_time =
+        std::chrono::steady_clock::now() - publish_start;
+      live_metrics_->add(FRAMES_COUNTER);
+      live_metrics_->record(GRAB_HISTOGRAM, grab_time.count());
+      live_metrics_->record(CONVERT_HISTOGRAM, convert_time.count());
+      live_metrics_->record(PUBLISH_HISTOGRAM, publish_time.count());
+    }
+
+    MV_CC_FreeImageBuffer(camera_handle_, &OutFrame);
+
+    {
+      std::lock_guard<std::mutex> lock(pacing_mutex_);
+      last_publish_time_ = std::chrono::steady_clock::now();
+      last_published_ns_ = rclcpp::Time(image_msg_.header.stamp).nanoseconds();
+    }
+    if (software_trigger_) {
+      std::chrono::duration<double, std::milli> capture_time = last_publish_time_ - trigger_time_;
+      capture_ms_ = capture_ms_ == 0.0 ? capture_time.count()
+                                       : kPacingSmoothing * capture_time.count() +
+                                           (1 - kPacingSmoothing) * capture_ms_;
+    }
+
+    // A frame got through, the next failure starts the backoff over
+    recover_interval_ = kDiscoverInterval;
+    if (recovering_) {
+      recovering_ = false;
+      recoveries_++;
+      if (live_metrics_ != nullptr) {
+        live_metrics_->add(RECOVERIES_COUNTER);
+      }
+      std::chrono::duration<double, std::milli> recover_time =
+        std::chrono::steady_clock::now() - lost_time_;
+      RCLCPP_INFO(
+        this->get_logger(), "Camera recovered after %.0fms (%d recoveries)", recover_time.count(),
+        recoveries_);
+    }
+    return true;
+  }
+
+  // Wait until the detector is expected to be done with the last frame, minus the time from
+  // the trigger to the frame being published, or until it reports being done
+  void waitForTrigger()
+  {
+    std::unique_lock<std::mutex> lock(pacing_mutex_);
+    auto earliest =
+      last_publish_time_ + std::chrono::duration<double, std::milli>(min_trigger_interval_ms_);
+    double delay_ms = std::min(
+      std::max(detector_processing_ms_ - capture_ms_ - trigger_lead_ms_, min_trigger_interval_ms_),
+      max_trigger_interval_ms_);
+    auto latest = last_publish_time_ + std::chrono::duration<double, std::milli>(delay_ms);
+
+    pacing_cv_.wait_until(lock, earliest, [this]() { return !running_; });
+    pacing_cv_.wait_until(
+      lock, latest, [this]() { return !running_ || last_done_ns_ >= last_published_ns_; });
+  }
+
+  void feedbackCallback(auto_aim_interfaces::msg::DetectorFeedback::ConstSharedPtr msg)
+  {
+    {
+      std::lock_guard<std::mutex> lock(pacing_mutex_);
+      detector_processing_ms_ = msg->processing_ms;
+      last_done_ns_ = std::max(last_done_ns_, rclcpp::Time(msg->header.stamp).nanoseconds());
+    }
+    pacing_cv_.notify_one();
+
+    // Frame age distribution, in either trigger mode for comparison
+    if (live_metrics_ != nullptr) {
+      live_metrics_->record(FRAME_AGE_HISTOGRAM, msg->frame_age_ms);
+    }
+    frame_ages_.push_back(msg->frame_age_ms);
+    if (frame_ages_.size() >= kFrameAgeReportFrames) {
+      std::sort(frame_ages_.begin(), frame_ages_.end());
+      auto percentile = [this](double p) {
+        return frame_ages_[static_cast<size_t>(p * (frame_ages_.size() - 1))];
+      };
+      RCLCPP_INFO(
+        this->get_logger(),
+        "Frame age over %zu frames (%s): p50 %.1fms, p90 %.1fms, p99 %.1fms, max %.1fms",
+        frame_ages_.size(), software_trigger_ ? "software trigger" : "free run", percentile(0.5),
+        percentile(0.9), percentile(0.99), frame_ages_.back());
+      frame_ages_.clear();
+    }
+  }
+
+  void closeDevice()
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
     if (camera_handle_) {
       MV_CC_StopGrabbing(camera_handle_);
       MV_CC_CloseDevice(camera_handle_);
-      MV_CC_DestroyHandle(&camera_handle_);
+      MV_CC_DestroyHandle(camera_handle_);
+      camera_handle_ = nullptr;
     }
-    RCLCPP_INFO(this->get_logger(), "HikCameraNode destroyed!");
   }
 
-private:
+  // Called by the SDK from its own thread
+  static void __stdcall onException(unsigned int msg_type, void * user)
+  {
+    auto node = static_cast<HikCameraNode *>(user);
+    if (msg_type == MV_EXCEPTION_DEV_DISCONNECT) {
+      RCLCPP_WARN(node->get_logger(), "Camera disconnected!");
+      node->device_lost_ = true;
+    }
+  }
+
+  // The valid ranges depend on the camera, which may not be connected yet. Out of range values
+  // are refused by the parameter callback or reported when the camera is configured.
   void declareParameters()
   {
     rcl_interfaces::msg::ParameterDescriptor param_desc;
-    MVCC_FLOATVALUE fValue;
-    param_desc.integer_range.resize(1);
-    param_desc.integer_range[0].step = 1;
     // Exposure time
     param_desc.description = "Exposure time in microseconds";
-    MV_CC_GetFloatValue(camera_handle_, "ExposureTime", &fValue);
-    param_desc.integer_range[0].from_value = fValue.fMin;
-    param_desc.integer_range[0].to_value = fValue.fMax;
-    double exposure_time = this->declare_parameter("exposure_time", 5000, param_desc);
-    MV_CC_SetFloatValue(camera_handle_, "ExposureTime", exposure_time);
-    RCLCPP_INFO(this->get_logger(), "Exposure time: %f", exposure_time);
+    int exposure_time = this->declare_parameter("exposure_time", 5000, param_desc);
+    RCLCPP_INFO(this->get_logger(), "Exposure time: %d", exposure_time);
 
     // Gain
     param_desc.description = "Gain";
-    MV_CC_GetFloatValue(camera_handle_, "Gain", &fValue);
-    param_desc.integer_range[0].from_value = fValue.fMin;
-    param_desc.integer_range[0].to_value = fValue.fMax;
-    double gain = this->declare_parameter("gain", fValue.fCurValue, param_desc);
-    MV_CC_SetFloatValue(camera_handle_, "Gain", gain);
+    double gain = this->declare_parameter("gain", 32.0, param_desc);
     RCLCPP_INFO(this->get_logger(), "Gain: %f", gain);
   }
 
+  // Set a float feature of the open camera, warning with its valid range if it is refused.
+  // Called with camera_mutex_ held.
+  void applyFloatValue(const char * name, double value)
+  {
+    int status = MV_CC_SetFloatValue(camera_handle_, name, value);
+    if (status != MV_OK) {
+      MVCC_FLOATVALUE range{};
+      MV_CC_GetFloatValue(camera_handle_, name, &range);
+      RCLCPP_WARN(
+        this->get_logger(), "Failed to set %s to %f (range %f to %f), status = %x", name, value,
+        range.fMin, range.fMax, status);
+    }
+  }
+
   rcl_interfaces::msg::SetParametersResult parametersCallback(
     const std::vector<rclcpp::Parameter> & parameters)
   {
     rcl_interfaces::msg::SetParametersResult result;
     result.successful = true;
+    // Without a camera the values are only stored, they are applied once it is back
+    std::lock_guard<std::mutex> lock(camera_mutex_);
     for (const auto & param : parameters) {
       if (param.get_name() == "exposure_time") {
+        if (camera_handle_ == nullptr) {
+          continue;
+        }
         int status = MV_CC_SetFloatValue(camera_handle_, "ExposureTime", param.as_int());
         if (MV_OK != status) {
           result.successful = false;
           result.reason = "Failed to set exposure time, status = " + std::to_string(status);
         }
       } else if (param.get_name() == "gain") {
+        if (camera_handle_ == nullptr) {
+          continue;
+        }
         int status = MV_CC_SetFloatValue(camera_handle_, "Gain", param.as_double());
         if (MV_OK != status) {
           result.successful = false;
@@ -170,20 +574,62 @@ private:
   sensor_msgs::msg::Image image_msg_;
 
   image_transport::CameraPublisher camera_pub_;
+  auto_aim_interfaces::msg::FrameTrace trace_msg_;
+  rclcpp::Publisher<auto_aim_interfaces::msg::FrameTrace>::SharedPtr trace_pub_;
 
   int nRet = MV_OK;
-  void * camera_handle_;
+  // Guards camera_handle_ between the capture thread and the parameter callback
+  std::mutex camera_mutex_;
+  void * camera_handle_ = nullptr;
+  MV_CC_DEVICE_INFO_LIST device_list_;
   MV_IMAGE_BASIC_INFO img_info_;
 
   MV_CC_PIXEL_CONVERT_PARAM ConvertParam_;
 
+  // In-house Bayer conversion, nullptr for the SDK one
+  std::string demosaic_name_;
+  DemosaicMode demosaic_mode_;
+  std::unique_ptr<Demosaicer> demosaicer_;
+  double convert_ms_sum_ = 0.0;
+  size_t convert_count_ = 0;
+
   std::string camera_name_;
   std::unique_ptr<camera_info_manager::CameraInfoManager> camera_info_manager_;
   sensor_msgs::msg::CameraInfo camera_info_msg_;
 
   std::thread capture_thread_;
+  std::atomic<bool> running_;
+
+  // Software trigger pacing
+  bool software_trigger_;
+  double trigger_lead_ms_;
+  double min_trigger_interval_ms_;
+  double max_trigger_interval_ms_;
+  // Guards the feedback shared with the capture thread, which waits on pacing_cv_
+  std::mutex pacing_mutex_;
+  std::condition_variable pacing_cv_;
+  double detector_processing_ms_ = 0.0;
+  int64_t last_done_ns_ = 0;
+  int64_t last_published_ns_ = 0;
+  std::chrono::steady_clock::time_point last_publish_time_;
+  std::chrono::steady_clock::time_point trigger_time_;
+  // Smoothed time from the trigger to the frame being published
+  double capture_ms_ = 0.0;
+  rclcpp::Subscription<auto_aim_interfaces::msg::DetectorFeedback>::SharedPtr feedback_sub_;
+  std::vector<float> frame_ages_;
+
+  // Reconnection
+  std::atomic<bool> device_lost_{false};
+  int grab_failures_ = 0;
+  bool recovering_ = false;
+  std::chrono::milliseconds recover_interval_ = kDiscoverInterval;
+  int recoveries_ = 0;
+  std::chrono::steady_clock::time_point lost_time_;
 
   OnSetParametersCallbackHandle::SharedPtr params_callback_handle_;
+
+  // Counters, capture state and latency histograms in shared memory for aimtop, null if disabled
+  std::unique_ptr<auto_aim_utils::LiveMetrics> live_metrics_;
 };
 }  // namespace hik_camera
 
@@ -0,0 +1,253 @@
+#include <gtest/gtest.h>
+
+// STD
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "hik_camera/demosaic.hpp"
+
+using hik_camera::BayerPattern;
+using hik_camera::Demosaicer;
+using hik_camera::DemosaicMode;
+
+namespace
+{
+const BayerPattern kPatterns[] = {
+  BayerPattern::RGGB, BayerPattern::GRBG, BayerPattern::GBRG, BayerPattern::BGGR};
+
+// Channel sampled at (x, y)
+int bayerChannel(BayerPattern pattern, int x, int y)
+{
+  int index = static_cast<int>(pattern);
+  int red_y = index == 0 || index == 1 ? 0 : 1;
+  int red_x = index == 0 || index == 2 ? 0 : 1;
+  bool red_row = (y & 1) == red_y;
+  bool red_col = (x & 1) == red_x;
+  if (red_row == red_col) {
+    return red_row ? 0 : 2;
+  }
+  return 1;
+}
+
+std::vector<uint8_t> mosaic(const std::vector<uint8_t> & rgb, int width, int height, BayerPattern p)
+{
+  std::vector<uint8_t> bayer(width * height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      bayer[y * width + x] = rgb[(y * width + x) * 3 + bayerChannel(p, x, y)];
+    }
+  }
+  return bayer;
+}
+
+// Smooth gradients, different in every channel
+std::vector<uint8_t> smoothImage(int width, int height)
+{
+  std::vector<uint8_t> rgb(width * height * 3);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint8_t * p = &rgb[(y * width + x) * 3];
+      p[0] = 40 + 150 * x / width;
+      p[1] = 60 + 120 * y / height;
+      p[2] = 200 - 100 * (x + y) / (width + height);
+    }
+  }
+  return rgb;
+}
+
+double meanAbsError(
+  const std::vector<uint8_t> & a, const std::vector<uint8_t> & b, int width, int height)
+{
+  // Interior only, the mirrored borders are approximations
+  double sum = 0;
+  int count = 0;
+  for (int y = 2; y < height - 2; y++) {
+    for (int x = 2; x < width - 2; x++) {
+      for (int c = 0; c < 3; c++) {
+        int i = (y * width + x) * 3 + c;
+        sum += std::abs(a[i] - b[i]);
+        count++;
+      }
+    }
+  }
+  return sum / count;
+}
+}  // namespace
+
+TEST(DemosaicTest, flat_color)
+{
+  const int width = 13, height = 9;
+  std::vector<uint8_t> rgb(width * height * 3);
+  for (int i = 0; i < width * height; i++) {
+    rgb[i * 3] = 200, rgb[i * 3 + 1] = 100, rgb[i * 3 + 2] = 30;
+  }
+
+  Demosaicer demosaicer(1);
+  for (auto pattern : kPatterns) {
+    auto bayer = mosaic(rgb, width, height, pattern);
+    for (auto mode : {DemosaicMode::BILINEAR, DemosaicMode::EDGE_AWARE}) {
+      std::vector<uint8_t> out(width * height * 3);
+      demosaicer.toRgb(bayer.data(), width, height, pattern, mode, out.data());
+      EXPECT_EQ(out, rgb) << "pattern " << static_cast<int>(pattern);
+    }
+  }
+}
+
+TEST(DemosaicTest, smooth_image)
+{
+  const int width = 64, height = 48;
+  auto rgb = smoothImage(width, height);
+
+  Demosaicer demosaicer(1);
+  for (auto pattern : kPatterns) {
+    auto bayer = mosaic(rgb, width, height, pattern);
+    for (auto mode : {DemosaicMode::BILINEAR, DemosaicMode::EDGE_AWARE}) {
+      std::vector<uint8_t> out(width * height * 3);
+      demosaicer.toRgb(bayer.data(), width, height, pattern, mode, out.data());
+      EXPECT_LT(meanAbsError(out, rgb, width, height), 1.0);
+      // Sampled channels are kept as they are
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          int c = bayerChannel(pattern, x, y);
+          ASSERT_EQ(out[(y * width + x) * 3 + c], bayer[y * width + x]);
+        }
+      }
+    }
+  }
+}
+
+TEST(DemosaicTest, edge_aware_sharpens_edges)
+{
+  // Vertical edge, bilinear green mixes both sides on the color sites next to it
+  const int width = 32, height = 16;
+  std::vector<uint8_t> rgb(width * height * 3);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint8_t v = x < width / 2 ? 20 : 220;
+      rgb[(y * width + x) * 3] = rgb[(y * width + x) * 3 + 1] = rgb[(y * width + x) * 3 + 2] = v;
+    }
+  }
+  auto bayer = mosaic(rgb, width, height, BayerPattern::RGGB);
+
+  Demosaicer demosaicer(1);
+  std::vector<uint8_t> bilinear(width * height * 3), edge_aware(width * height * 3);
+  demosaicer.toRgb(
+    bayer.data(), width, height, BayerPattern::RGGB, DemosaicMode::BILINEAR, bilinear.data());
+  demosaicer.toRgb(
+    bayer.data(), width, height, BayerPattern::RGGB, DemosaicMode::EDGE_AWARE, edge_aware.data());
+
+  auto greenError = [&](const std::vector<uint8_t> & out) {
+    double sum = 0;
+    for (int i = 0; i < width * height; i++) {
+      sum += std::abs(out[i * 3 + 1] - rgb[i * 3 + 1]);
+    }
+    return sum;
+  };
+  EXPECT_LT(greenError(edge_aware), greenError(bilinear));
+}
+
+TEST(DemosaicTest, threads_match_single_thread)
+{
+  const int width = 127, height = 101;
+  auto rgb = smoothImage(width, height);
+  auto bayer = mosaic(rgb, width, height, BayerPattern::GBRG);
+  // Add some texture
+  for (size_t i = 0; i < bayer.size(); i++) {
+    bayer[i] ^= (i * 37) & 0x1f;
+  }
+
+  Demosaicer single(1), parallel(4);
+  EXPECT_EQ(parallel.threads(), 4);
+  std::vector<uint8_t> expected(width * height * 3), out(width * height * 3);
+  for (auto mode : {DemosaicMode::BILINEAR, DemosaicMode::EDGE_AWARE}) {
+    single.toRgb(bayer.data(), width, height, BayerPattern::GBRG, mode, expected.data());
+    // Repeated to catch races between frames
+    for (int i = 0; i < 20; i++) {
+      parallel.toRgb(bayer.data(), width, height, BayerPattern::GBRG, mode, out.data());
+      ASSERT_EQ(out, expected);
+    }
+  }
+
+  std::vector<uint8_t> gray_expected(width * height), gray(width * height);
+  single.toGray(bayer.data(), width, height, BayerPattern::GBRG, gray_expected.data());
+  parallel.toGray(bayer.data(), width, height, BayerPattern::GBRG, gray.data());
+  EXPECT_EQ(gray, gray_expected);
+}
+
+TEST(DemosaicTest, gray_is_luma_of_rgb)
+{
+  const int width = 20, height = 10;
+  auto rgb = smoothImage(width, height);
+  auto bayer = mosaic(rgb, width, height, BayerPattern::BGGR);
+
+  Demosaicer demosaicer(2);
+  std::vector<uint8_t> out(width * height * 3), gray(width * height);
+  demosaicer.toRgb(
+    bayer.data(), width, height, BayerPattern::BGGR, DemosaicMode::BILINEAR, out.data());
+  demosaicer.toGray(bayer.data(), width, height, BayerPattern::BGGR, gray.data());
+  for (int i = 0; i < width * height; i++) {
+    int luma = (out[i * 3] * 4899 + out[i * 3 + 1] * 9617 + out[i * 3 + 2] * 1868 + 8192) >> 14;
+    ASSERT_EQ(gray[i], luma);
+  }
+}
+
+TEST(DemosaicTest, worker_setup)
+{
+  std::atomic<int> calls{0};
+  std::mutex mutex;
+  std::set<std::thread::id> ids;
+  {
+    Demosaicer demosaicer(4, [&]() {
+      calls++;
+      std::lock_guard<std::mutex> lock(mutex);
+      ids.insert(std::this_thread::get_id());
+    });
+    // Done before the constructor returns, once on every pool thread
+    EXPECT_EQ(calls, 3);
+    EXPECT_EQ(ids.size(), 3u);
+    EXPECT_EQ(ids.count(std::this_thread::get_id()), 0u);
+  }
+
+  EXPECT_THROW(
+    Demosaicer(4, []() { throw std::runtime_error("setup failed"); }), std::runtime_error);
+}
+
+TEST(DemosaicTest, benchmark)
+{
+  if (std::getenv("AUTO_AIM_BENCHMARKS") == nullptr) {
+    GTEST_SKIP() << "Set AUTO_AIM_BENCHMARKS=1 to time the converter";
+  }
+
+  // Full frame of the MV-CA016-10UC
+  const int width = 1440, height = 1080;
+  const int loop_num = 50;
+  auto rgb = smoothImage(width, height);
+  std::vector<uint8_t> out(width * height * 3);
+
+  for (auto pattern : kPatterns) {
+    auto bayer = mosaic(rgb, width, height, pattern);
+    for (int threads : {1, 2, 4}) {
+      Demosaicer demosaicer(threads);
+      for (auto mode : {DemosaicMode::BILINEAR, DemosaicMode::EDGE_AWARE}) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < loop_num; i++) {
+          demosaicer.toRgb(bayer.data(), width, height, pattern, mode, out.data());
+        }
+        std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+        std::cout << "pattern " << static_cast<int>(pattern) << ", "
+                  << (mode == DemosaicMode::BILINEAR ? "bilinear" : "edge_aware") << ", "
+                  << threads << " threads: " << elapsed.count() / loop_num << "ms" << std::endl;
+      }
+    }
+  }
+}
@@ -10,6 +10,8 @@
 #include <algorithm>
 #include <string>
 
+#include "armor_detector/packed_number.hpp"
+
 namespace rm_auto_aim
 {
 const int RED = 0;
@@ -36,6 +38,8 @@ struct Light : public cv::RotatedRect
   }
 
   int color;
+  // |sum_r - sum_b| / (sum_r + sum_b) inside the contour
+  float color_strength;
   cv::Point2f top, bottom;
   double length;
   double width;
@@ -58,7 +62,12 @@ struct Armor
   Light left_light, right_light;
   cv::Point2f center;
 
+  // Geometric score in [0, 1], candidates are classified in descending order of it
+  float score;
+
   cv::Mat number_img;
+  // Network input (number_img resized to 28x20), one bit per pixel
+  PackedNumber number_bits{};
 
   char number;
   // std::string number;
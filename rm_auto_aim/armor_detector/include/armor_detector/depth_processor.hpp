@@ -4,7 +4,6 @@
 #ifndef ARMOR_DETECTOR__DEPTH_PROCESSOR_HPP_
 #define ARMOR_DETECTOR__DEPTH_PROCESSOR_HPP_
 
-#include <geometry_msgs/msg/point.hpp>
 #include <opencv2/core.hpp>
 
 // STD
@@ -17,8 +16,8 @@ class DepthProcessor
 public:
   explicit DepthProcessor(const std::array<double, 9> & camera_matrix);
 
-  // Get 3d position
-  geometry_msgs::msg::Point getPosition(
+  // Get 3d position in meters
+  cv::Point3d getPosition(
     const cv::Mat & depth_image, const cv::Point2f & image_point);
 
   // Calculate the distance between armor center and image center
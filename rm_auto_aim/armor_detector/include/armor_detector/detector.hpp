@@ -14,11 +14,31 @@
 #include <vector>
 
 #include "armor_detector/armor.hpp"
-#include "auto_aim_interfaces/msg/debug_armors.hpp"
-#include "auto_aim_interfaces/msg/debug_lights.hpp"
+#include "armor_detector/light_table.hpp"
 
 namespace rm_auto_aim
 {
+// Debug information of every contour checked by isLight, published as DebugLight.msg
+struct DebugLight
+{
+  int center_x;
+  bool is_light;
+  float ratio;
+  float angle;
+};
+
+// Debug information of every light pair checked by isArmor, published as DebugArmor.msg
+struct DebugArmor
+{
+  int center_x;
+  bool is_armor;
+  float light_ratio;
+  float center_distance;
+  float angle;
+  float score;
+  ArmorType armor_type;
+};
+
 class Detector
 {
 public:
@@ -40,33 +60,56 @@ public:
     // horizontal angle
     double max_angle;
   };
+  // Weights of the features in the armor score
+  struct ScoreParams
+  {
+    double light_ratio;
+    double center_distance;
+    double angle;
+    double color;
+    double area;
+    // Light area (pixels) at which the area feature saturates
+    double reference_area;
+  };
 
   Detector(
     const int & init_min_l, const int & init_color, const LightParams & init_l,
-    const ArmorParams & init_a);
+    const ArmorParams & init_a, const ScoreParams & init_s);
 
   int min_lightness;
   int detect_color;
   LightParams l;
   ArmorParams a;
+  ScoreParams s;
 
-  // Debug msgs
-  auto_aim_interfaces::msg::DebugLights debug_lights;
-  auto_aim_interfaces::msg::DebugArmors debug_armors;
+  // Debug information
+  std::vector<DebugLight> debug_lights;
+  std::vector<DebugArmor> debug_armors;
 
   cv::Mat preprocessImage(const cv::Mat & rbg_img);
 
-  std::vector<Light> findLights(const cv::Mat & rbg_img, const cv::Mat & binary_img);
+  // Refills lights, reusing its storage
+  void findLights(const cv::Mat & rbg_img, const cv::Mat & binary_img, LightTable & lights);
 
+  // Refills candidates with the pairs of lights that pass isArmor, reusing its storage
+  void matchLights(const LightTable & lights, std::vector<ArmorCandidate> & candidates);
+
+  // Standalone Lights and Armors, converted from the table based versions above
+  std::vector<Light> findLights(const cv::Mat & rbg_img, const cv::Mat & binary_img);
   std::vector<Armor> matchLights(const std::vector<Light> & lights);
 
+  // Weighted mean of the armor features, each normalized to [0, 1] within the range accepted
+  // by isArmor
+  float scoreArmor(
+    const LightTable & lights, const ArmorCandidate & candidate, float light_length_ratio,
+    float center_distance, float angle) const;
+
 private:
   bool isLight(const Light & light);
 
-  bool containLight(
-    const Light & light_1, const Light & light_2, const std::vector<Light> & lights);
+  bool containLight(const LightTable & lights, int i, int j) const;
 
-  bool isArmor(Armor & armor);
+  bool isArmor(const LightTable & lights, ArmorCandidate & candidate);
 };
 
 }  // namespace rm_auto_aim
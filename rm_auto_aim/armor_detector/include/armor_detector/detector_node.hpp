@@ -15,18 +15,35 @@
 #include <rclcpp/rclcpp.hpp>
 #include <sensor_msgs/msg/camera_info.hpp>
 #include <sensor_msgs/msg/image.hpp>
+#include <std_msgs/msg/header.hpp>
 #include <visualization_msgs/msg/marker_array.hpp>
 
 // STD
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "armor_detector/depth_processor.hpp"
 #include "armor_detector/detector.hpp"
+#include "armor_detector/frame_deadline.hpp"
+#include "armor_detector/light_table.hpp"
+#include "armor_detector/load_shedder.hpp"
 #include "armor_detector/number_classifier.hpp"
 #include "armor_detector/pnp_solver.hpp"
 #include "auto_aim_interfaces/msg/armors.hpp"
+#include "auto_aim_interfaces/msg/debug_armors.hpp"
+#include "auto_aim_interfaces/msg/debug_lights.hpp"
+#include "auto_aim_interfaces/msg/detector_feedback.hpp"
+#include "auto_aim_interfaces/msg/frame_trace.hpp"
+#include "auto_aim_interfaces/msg/perf_counters.hpp"
+#include "auto_aim_utils/callback_group_thread.hpp"
+#include "auto_aim_utils/live_metrics.hpp"
+#include "auto_aim_utils/perf_counters.hpp"
+#include "auto_aim_utils/realtime.hpp"
 
 namespace rm_auto_aim
 {
@@ -38,20 +55,36 @@ class BaseDetectorNode : public rclcpp::Node
 {
 public:
   BaseDetectorNode(const std::string & node_name, const rclcpp::NodeOptions & options);
+  ~BaseDetectorNode() override;
 
 protected:
+  // Subscription options putting the image callbacks into hot_path_group_
+  rclcpp::SubscriptionOptions hotPathOptions() const;
+
+  // Start spinning hot_path_group_, called at the end of the derived constructors.
+  // Derived destructors must reset hot_path_thread_ before their members go away.
+  void startHotPathThread();
+
+  // Whether the next frame should be processed, false for the frames dropped by load shedding
+  // and until the classifier has been loaded
+  bool acceptFrame();
+
   std::vector<Armor> detectArmors(const sensor_msgs::msg::Image::ConstSharedPtr & img_msg);
 
+  // Stamp the end of detection into the frame's trace and publish armors_msg_
+  void publishArmors();
+
+  // Hand the armors in marker_back_ over to the visualization timer
+  void commitMarkers();
+
   void publishMarkers();
 
   // Camera info subscription
   rclcpp::Subscription<sensor_msgs::msg::CameraInfo>::SharedPtr cam_info_sub_;
 
-  // Camera info
-  std::shared_ptr<sensor_msgs::msg::CameraInfo> cam_info_;
-
-  // Camera center
-  cv::Point2f cam_center_;
+  // Camera info, written by the camera_info callback on the node's executor and read by the hot
+  // path thread, only accessed with std::atomic_load/std::atomic_store
+  std::shared_ptr<const sensor_msgs::msg::CameraInfo> cam_info_;
 
   // Image subscriptions transport type
   std::string transport_;
@@ -60,37 +93,127 @@ protected:
   auto_aim_interfaces::msg::Armors armors_msg_;
   rclcpp::Publisher<auto_aim_interfaces::msg::Armors>::SharedPtr armors_pub_;
 
+  // Frame age and smoothed processing time of every processed frame, used by the camera to
+  // trigger the next exposure just in time
+  double processing_ms_;
+  auto_aim_interfaces::msg::DetectorFeedback feedback_msg_;
+  rclcpp::Publisher<auto_aim_interfaces::msg::DetectorFeedback>::SharedPtr feedback_pub_;
+
   // Visualization marker publisher
-  visualization_msgs::msg::Marker position_marker_;
-  visualization_msgs::msg::Marker text_marker_;
-  visualization_msgs::msg::MarkerArray marker_array_;
+  // The image callbacks only fill marker_back_, markers are built and published by a timer
+  struct ArmorMarker
+  {
+    geometry_msgs::msg::Point position;
+    char number;
+    float confidence;
+  };
+  struct MarkerFrame
+  {
+    std_msgs::msg::Header header;
+    std::vector<ArmorMarker> armors;
+  };
+  MarkerFrame marker_back_;
+  std::atomic<bool> marker_subscribed_;
   rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr marker_pub_;
 
   bool active_;
   std::shared_ptr<rclcpp::ParameterEventHandler> active_param_sub_;
   std::shared_ptr<rclcpp::ParameterCallbackHandle> active_cb_handle_;
 
+  // Image callbacks run in their own callback group, spun by a dedicated real-time thread
+  // unless realtime.dedicated_thread is false
+  rclcpp::CallbackGroup::SharedPtr hot_path_group_;
+  std::unique_ptr<auto_aim_utils::CallbackGroupThread> hot_path_thread_;
+
 private:
   std::unique_ptr<Detector> initDetector();
 
+  // Continue the camera's trace of the frame in armors_msg_, or start a new one without the
+  // capture stage if it was not received
+  void startTrace(const builtin_interfaces::msg::Time & stamp, const rclcpp::Time & start_time);
+
   void createDebugPublishers();
   void destroyDebugPublishers();
 
+  // Update the load shedding level with the frame's age on arrival and its processing time
+  void updateLoadShedding(double frame_age_ms, double processing_ms);
+
+  // Number of candidates to classify, the highest scoring ones are kept
+  size_t classifyLimit(LoadShedder::Level level);
+
+  // Finish a detection stage for the frame deadline and the hardware counters
+  void finishStage(FrameDeadline::Stage stage);
+
+  void publishPerfCounters();
+
+  // Misses of each stage, logged when a frame misses its deadline
+  std::string deadlineMisses() const;
+
+  // Region around the armors of the last frame searched in ROI_ONLY mode, empty if none
+  cv::Rect nextRoi(const std::vector<Armor> & armors, const cv::Size & img_size) const;
+
   void drawResults(
-    cv::Mat & img, const std::vector<Light> & lights, const std::vector<Armor> & armors);
+    cv::Mat & img, const LightTable & lights, const std::vector<Armor> & armors);
+
+  // Visualization marker double buffer and preallocated markers
+  MarkerFrame marker_front_;
+  bool marker_fresh_;
+  std::mutex marker_mutex_;
+  visualization_msgs::msg::Marker text_marker_;
+  visualization_msgs::msg::MarkerArray marker_array_;
+  rclcpp::TimerBase::SharedPtr marker_timer_;
+
+  // Camera traces of the latest frames, a ring written by the hot path thread only
+  std::vector<auto_aim_interfaces::msg::FrameTrace> camera_traces_;
+  size_t camera_trace_next_;
+  rclcpp::Subscription<auto_aim_interfaces::msg::FrameTrace>::SharedPtr camera_trace_sub_;
 
   // Armor Detector
   std::unique_ptr<Detector> detector_;
+  // Lights and armor candidates of the current frame, only the ranked survivors become Armors
+  LightTable lights_;
+  std::vector<ArmorCandidate> candidates_;
 
   // Number Classifier
+  // Loaded and warmed up in the background, moved to classifier_ by the first accepted frame
   std::unique_ptr<NumberClassifier> classifier_;
+  std::future<std::unique_ptr<NumberClassifier>> classifier_future_;
+  std::string template_path_;
+
+  // Processing deadline of the current frame
+  FrameDeadline deadline_;
+  double deadline_budget_ms_;
+
+  // Hardware counters per stage, nullptr if disabled
+  std::unique_ptr<auto_aim_utils::StageCounters> stage_counters_;
+  auto_aim_interfaces::msg::PerfCounters perf_counters_msg_;
+  rclcpp::Publisher<auto_aim_interfaces::msg::PerfCounters>::SharedPtr perf_counters_pub_;
+  rclcpp::TimerBase::SharedPtr perf_counters_timer_;
+
+  // Counters and latency histograms in shared memory for aimtop, null if disabled
+  std::unique_ptr<auto_aim_utils::LiveMetrics> live_metrics_;
+  std::chrono::steady_clock::time_point stage_start_;
+
+  // Load shedding, nullptr if disabled
+  std::unique_ptr<LoadShedder> load_shedder_;
+  size_t top_k_;
+  double roi_scale_;
+  cv::Rect roi_;
+
+  // Real-time profile of the thread running the image callbacks
+  auto_aim_utils::RealtimeConfig realtime_config_;
+  bool dedicated_hot_path_;
 
   // Debug information publishers
-  bool debug_;
+  // Set from the parameter callback, the publishers are (re)created by the image callback
+  std::atomic<bool> debug_;
+  bool debug_publishers_created_;
   std::shared_ptr<rclcpp::ParameterEventHandler> debug_param_sub_;
   std::shared_ptr<rclcpp::ParameterCallbackHandle> debug_cb_handle_;
   rclcpp::Publisher<auto_aim_interfaces::msg::DebugLights>::SharedPtr lights_data_pub_;
   rclcpp::Publisher<auto_aim_interfaces::msg::DebugArmors>::SharedPtr armors_data_pub_;
+  auto_aim_interfaces::msg::DebugLights debug_lights_msg_;
+  auto_aim_interfaces::msg::DebugArmors debug_armors_msg_;
   rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr number_pub_;
   image_transport::Publisher binary_img_pub_;
   image_transport::Publisher final_img_pub_;
@@ -100,20 +223,25 @@ class RgbDetectorNode : public BaseDetectorNode
 {
 public:
   explicit RgbDetectorNode(const rclcpp::NodeOptions & options);
+  ~RgbDetectorNode() override;
 
 private:
   void imageCallback(const sensor_msgs::msg::Image::ConstSharedPtr & img_msg);
 
   std::shared_ptr<image_transport::Subscriber> img_sub_;
-  std::unique_ptr<PnPSolver> pnp_solver_;
+  // Created by the camera_info callback, accessed with std::atomic_load/store
+  std::shared_ptr<PnPSolver> pnp_solver_;
 };
 
 class RgbDepthDetectorNode : public BaseDetectorNode
 {
 public:
   explicit RgbDepthDetectorNode(const rclcpp::NodeOptions & options);
+  ~RgbDepthDetectorNode() override;
 
 private:
+  void subscribeImages();
+
   void colorDepthCallback(
     const sensor_msgs::msg::Image::ConstSharedPtr & color_msg,
     const sensor_msgs::msg::Image::ConstSharedPtr & depth_msg);
@@ -121,7 +249,8 @@ private:
   image_transport::SubscriberFilter color_img_sub_filter_;
   image_transport::SubscriberFilter depth_img_sub_filter_;
   std::unique_ptr<ColorDepthSync> sync_;
-  std::unique_ptr<DepthProcessor> depth_processor_;
+  // Created by the camera_info callback, accessed with std::atomic_load/store
+  std::shared_ptr<DepthProcessor> depth_processor_;
 };
 
 }  // namespace rm_auto_aim
@@ -0,0 +1,58 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__FRAME_DEADLINE_HPP_
+#define ARMOR_DETECTOR__FRAME_DEADLINE_HPP_
+
+// STD
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace rm_auto_aim
+{
+// Processing deadline of a single frame. Checking it only reads the steady clock, so the
+// detection stages can poll it between candidates.
+class FrameDeadline
+{
+public:
+  enum Stage {
+    PREPROCESS = 0,
+    FIND_LIGHTS,
+    MATCH_LIGHTS,
+    EXTRACT_NUMBERS,
+    CLASSIFY,
+    STAGE_NUM,
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  FrameDeadline();
+
+  // Start a frame that has to be done within budget_ms, a non-positive budget never expires
+  void start(double budget_ms);
+
+  bool expired() const { return enabled_ && Clock::now() >= deadline_; }
+
+  double remainingMs() const;
+
+  // Count a miss for the stage if it is the one during which the deadline passed
+  void finishStage(Stage stage);
+
+  // Whether the current frame has missed its deadline
+  bool missed() const { return missed_; }
+
+  uint64_t misses(Stage stage) const { return misses_[stage]; }
+
+  static const char * stageName(Stage stage);
+
+private:
+  bool enabled_;
+  bool missed_;
+  Clock::time_point deadline_;
+  std::array<uint64_t, STAGE_NUM> misses_;
+};
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__FRAME_DEADLINE_HPP_
@@ -0,0 +1,68 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__KERNELS_HPP_
+#define ARMOR_DETECTOR__KERNELS_HPP_
+
+// STD
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rm_auto_aim
+{
+enum class Isa { SCALAR = 0, SSE4_2, AVX2, AVX512, NEON };
+
+// Hot vision kernels. The same implementation is compiled once per instruction set (see
+// kernels_impl.hpp) and the best one the CPU supports is picked at runtime.
+struct Kernels
+{
+  Isa isa;
+
+  // dst = gray(rgb) > thresh ? 255 : 0, gray with the fixed-point weights of cv::COLOR_RGB2GRAY
+  void (*rgbThreshold)(const uint8_t * rgb, uint8_t * dst, int n, int thresh);
+
+  // dst = src > thresh ? 255 : 0, src may be dst
+  void (*threshold)(const uint8_t * src, uint8_t * dst, int n, int thresh);
+
+  // Sums of the R and B channels of the pixels where mask is non-zero
+  void (*colorVote)(
+    const uint8_t * rgb, const uint8_t * mask, int n, int64_t * sum_r, int64_t * sum_b);
+
+  // Threshold of a gray image by Otsu's method, as cv::THRESH_OTSU computes it
+  int (*otsu)(const uint8_t * gray, int width, int height, size_t step);
+
+  // Gray dst sampled bilinearly from the RGB src at h * (x, y, 1), 0 outside of src.
+  // h is the row-major 3x3 homography from dst to src pixels.
+  void (*warpPerspectiveGray)(
+    const uint8_t * src, int src_width, int src_height, size_t src_step, const double * h,
+    uint8_t * dst, int dst_width, int dst_height, size_t dst_step);
+
+  // y += x, y -= x
+  void (*add)(float * y, const float * x, int n);
+  void (*sub)(float * y, const float * x, int n);
+
+  // y = w * x + b, w is out x in row-major
+  void (*gemv)(const float * w, const float * b, const float * x, int in, int out, float * y);
+};
+
+const char * isaName(Isa isa);
+
+// Instruction sets compiled in and supported by this CPU, best last
+std::vector<Isa> supportedIsas();
+
+// The selected kernels, by default those of the best supported instruction set
+const Kernels & kernels();
+
+// Kernels of one instruction set, nullptr if not compiled in or not supported by this CPU
+const Kernels * kernelsFor(Isa isa);
+
+// Select the kernels by instruction set name ("scalar", "sse4.2", "avx2", "avx512", "neon"),
+// or "auto" for the best supported one. Returns false and keeps the current kernels if the
+// instruction set is unknown or not supported.
+bool selectKernels(const std::string & isa_name);
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__KERNELS_HPP_
@@ -0,0 +1,63 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__LIGHT_TABLE_HPP_
+#define ARMOR_DETECTOR__LIGHT_TABLE_HPP_
+
+#include <opencv2/core/types.hpp>
+
+// STL
+#include <cstddef>
+#include <vector>
+
+#include "armor_detector/armor.hpp"
+
+namespace rm_auto_aim
+{
+// Lights of a frame as a structure of arrays, so that pairing and filtering only stream through
+// the fields they compare. Cleared and refilled every frame, keeping its storage.
+struct LightTable
+{
+  size_t size() const { return centers.size(); }
+  bool empty() const { return centers.empty(); }
+
+  void clear();
+  void push_back(const Light & light);
+
+  // The light as a standalone Light, for the public Armor and debugging
+  Light light(size_t i) const;
+  cv::RotatedRect box(size_t i) const { return cv::RotatedRect(centers[i], sizes[i], angles[i]); }
+
+  // Move all lights by offset, e.g. from a ROI to the full image
+  void shift(const cv::Point2f & offset);
+
+  std::vector<cv::Point2f> centers;
+  std::vector<cv::Point2f> tops;
+  std::vector<cv::Point2f> bottoms;
+  std::vector<float> lengths;
+  std::vector<float> widths;
+  std::vector<float> tilt_angles;
+  std::vector<int> colors;
+  std::vector<float> color_strengths;
+
+  // Rest of the rotated rect, only needed to rebuild a Light
+  std::vector<cv::Size2f> sizes;
+  std::vector<float> angles;
+};
+
+// A pair of lights of a LightTable that may be an armor, left and right by the x of their center
+struct ArmorCandidate
+{
+  int left;
+  int right;
+  ArmorType armor_type;
+  // Geometric score in [0, 1], see Armor::score
+  float score;
+};
+
+// The public Armor of a candidate, copying its lights out of the table
+Armor makeArmor(const LightTable & lights, const ArmorCandidate & candidate);
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__LIGHT_TABLE_HPP_
@@ -0,0 +1,69 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__LOAD_SHEDDER_HPP_
+#define ARMOR_DETECTOR__LOAD_SHEDDER_HPP_
+
+namespace rm_auto_aim
+{
+// Steps the detector down through cheaper modes while the input-to-output latency is over
+// budget, and back up once it has stayed well below the budget for a while
+class LoadShedder
+{
+public:
+  enum Level {
+    NORMAL = 0,
+    // Skip debug images and messages
+    SKIP_DEBUG,
+    // Classify only the top-K armor candidates
+    TOP_K,
+    // Search only around the armors found in the last frame
+    ROI_ONLY,
+    // Drop frames, processing one out of every `decimation`
+    DECIMATE,
+  };
+
+  struct Params
+  {
+    double latency_budget_ms;
+    // Recover once the latency is below latency_budget_ms * recover_ratio
+    double recover_ratio;
+    // Consecutive frames over budget / under the recover threshold before changing level
+    int escalate_frames;
+    int recover_frames;
+    // Weight of the newest sample in the moving averages
+    double smoothing;
+    int decimation;
+  };
+
+  explicit LoadShedder(const Params & params);
+
+  // Whether the frame should be processed at all, counts frames when decimating
+  bool acceptFrame();
+
+  // Feed the age of a processed frame on arrival and its processing time.
+  // Returns true if the level changed.
+  bool update(double frame_age_ms, double processing_ms);
+
+  Level level() const { return level_; }
+  // Smoothed input-to-output latency
+  double latency() const { return latency_ms_; }
+  // Frames per second the detector could sustain at the current processing time
+  double processingRate() const { return processing_ms_ > 0 ? 1000.0 / processing_ms_ : 0.0; }
+
+  static const char * levelName(Level level);
+
+  Params params;
+
+private:
+  Level level_;
+  double latency_ms_;
+  double processing_ms_;
+  int over_budget_count_;
+  int under_budget_count_;
+  int frame_count_;
+};
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__LOAD_SHEDDER_HPP_
@@ -0,0 +1,54 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__MSG_CONVERSIONS_HPP_
+#define ARMOR_DETECTOR__MSG_CONVERSIONS_HPP_
+
+// ROS
+#include <geometry_msgs/msg/point.hpp>
+
+#include <opencv2/core.hpp>
+
+#include "armor_detector/detector.hpp"
+#include "auto_aim_interfaces/msg/debug_armor.hpp"
+#include "auto_aim_interfaces/msg/debug_light.hpp"
+
+// Conversions from the ROS-free armor_detector_core types to messages, only used by the nodes
+namespace rm_auto_aim
+{
+inline geometry_msgs::msg::Point toMsg(const cv::Point3d & position)
+{
+  geometry_msgs::msg::Point point;
+  point.x = position.x;
+  point.y = position.y;
+  point.z = position.z;
+  return point;
+}
+
+inline auto_aim_interfaces::msg::DebugLight toMsg(const DebugLight & light)
+{
+  auto_aim_interfaces::msg::DebugLight msg;
+  msg.center_x = light.center_x;
+  msg.is_light = light.is_light;
+  msg.ratio = light.ratio;
+  msg.angle = light.angle;
+  return msg;
+}
+
+inline auto_aim_interfaces::msg::DebugArmor toMsg(const DebugArmor & armor)
+{
+  auto_aim_interfaces::msg::DebugArmor msg;
+  msg.center_x = armor.center_x;
+  msg.is_armor = armor.is_armor;
+  msg.light_ratio = armor.light_ratio;
+  msg.center_distance = armor.center_distance;
+  msg.angle = armor.angle;
+  msg.score = armor.score;
+  // True means small armor
+  msg.armor_type = armor.armor_type == SMALL;
+  return msg;
+}
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__MSG_CONVERSIONS_HPP_
@@ -10,10 +10,14 @@
 #include <cstddef>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "armor_detector/detector.hpp"
+#include "armor_detector/frame_deadline.hpp"
+#include "armor_detector/number_mlp.hpp"
+#include "armor_detector/number_templates.hpp"
 
 namespace rm_auto_aim
 {
@@ -23,15 +27,82 @@ public:
   NumberClassifier(
     const std::string & model_path, const std::string & label_path, const double threshold);
 
-  void extractNumbers(const cv::Mat & src, std::vector<Armor> & armors);
+  // The number_img of the armors are views of one buffer of the frame.
+  // With a deadline, armors left once it has expired get an empty number_img
+  void extractNumbers(
+    const cv::Mat & src, std::vector<Armor> & armors, const FrameDeadline * deadline = nullptr);
 
-  void doClassify(std::vector<Armor> & armors);
+  // With a deadline, armors that can not be classified before it expires reuse the result of
+  // the nearest armor of the previous frame, or are dropped if there is none
+  void doClassify(std::vector<Armor> & armors, const FrameDeadline * deadline = nullptr);
+
+  // Run extractNumbers and the network once on a blank frame, so that the first real frame
+  // doesn't pay for the lazy initialization of cv::dnn and for faulting in the weights
+  void warmUp();
+
+  // Templates learned by the template pre-classifier
+  bool loadTemplates(const std::string & path);
+  bool saveTemplates(const std::string & path) const;
 
   double threshold;
 
+  // The template pre-classifier accepts a match at least this similar, and rejects numbers
+  // less similar than reject_similarity to every template, without running the network
+  double similarity_threshold;
+  double reject_similarity;
+
+  // Armors accepted / rejected by the template pre-classifier in the last doClassify
+  int template_accepted_count;
+  int template_rejected_count;
+
+  // Armors whose number image matched the previous frame's at the same place and reused its
+  // result in the last doClassify
+  int reused_count;
+
+  // Armors that reused a cached result / were dropped in the last doClassify
+  int cached_count;
+  int dropped_count;
+
 private:
+  struct CachedResult
+  {
+    cv::Point2f center;
+    ArmorType armor_type;
+    char number;
+    float confidence;
+    // Number of frames the result has been reused without comparing the number images
+    int age;
+    PackedNumber number_bits;
+  };
+
+  // Returns false if no armor of the previous frame is close enough, or, with same_number, if
+  // none of those has nearly the same number image
+  bool classifyFromCache(Armor & armor, bool same_number);
+
+  void updateCache(const std::vector<Armor> & armors);
+
+  // Returns true if the templates alone decided the armor's number
+  bool classifyByTemplates(Armor & armor);
+
+  // Fills logits_ with the network output for the armor's number
+  void runNetwork(const Armor & armor);
+
+  // Native MLP on the packed numbers, or cv::dnn if the model is not the expected MLP
+  bool use_mlp_;
+  NumberMlp mlp_;
   cv::dnn::Net net_;
+  std::vector<float> logits_;
   std::vector<char> class_names_;
+
+  // Number templates, learned from confident results of the network
+  std::unique_ptr<NumberTemplates> templates_;
+
+  // Results of the previous frame
+  std::vector<CachedResult> cache_;
+  std::vector<CachedResult> next_cache_;
+
+  // Average time to classify one armor
+  double classify_cost_ms_;
 };
 }  // namespace rm_auto_aim
 
@@ -0,0 +1,50 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__NUMBER_MLP_HPP_
+#define ARMOR_DETECTOR__NUMBER_MLP_HPP_
+
+// STD
+#include <string>
+#include <vector>
+
+#include "armor_detector/packed_number.hpp"
+
+namespace rm_auto_aim
+{
+// Native forward pass of the number classifier MLP (fc.onnx: 560 -> Relu -> Relu -> classes)
+// on bit-packed binary inputs. The input is binary, so the first layer is a sum of the weight
+// columns of the set bits, or of the cleared bits subtracted from the sum of all columns when
+// most bits are set.
+class NumberMlp
+{
+public:
+  // Returns false if the model can not be read or is not a three layer MLP on kNumberBits inputs
+  bool load(const std::string & model_path);
+
+  bool loaded() const { return classes_ > 0; }
+  int classes() const { return classes_; }
+
+  // Writes classes() logits
+  void forward(const PackedNumber & input, float * logits);
+
+private:
+  int hidden1_ = 0;
+  int hidden2_ = 0;
+  int classes_ = 0;
+
+  // First layer weights by input, row i holds the weights of input bit i
+  std::vector<float> w1_by_input_;
+  std::vector<float> b1_;
+  // b1_ plus the weights of all inputs
+  std::vector<float> b1_all_set_;
+  std::vector<float> w2_, b2_;
+  std::vector<float> w3_, b3_;
+
+  // Activations
+  std::vector<float> h1_, h2_;
+};
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__NUMBER_MLP_HPP_
@@ -0,0 +1,56 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__NUMBER_TEMPLATES_HPP_
+#define ARMOR_DETECTOR__NUMBER_TEMPLATES_HPP_
+
+// STD
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "armor_detector/packed_number.hpp"
+
+namespace rm_auto_aim
+{
+// Per-class binary templates of the number images, learned from confident classifications.
+// The template of a class is the per-pixel majority of its samples.
+class NumberTemplates
+{
+public:
+  // Templates are used once they have min_samples samples
+  NumberTemplates(const std::vector<char> & labels, int min_samples);
+
+  void learn(char label, const PackedNumber & number);
+
+  // Whether every label has a usable template
+  bool complete() const;
+
+  // Label of the most similar usable template, its similarity and the similarity of the
+  // runner-up. Returns false if there is no usable template.
+  bool match(const PackedNumber & number, char & label, float & best, float & second) const;
+
+  // A header line with the number image rows and cols, then one line per usable template:
+  // label, sample count and the packed words in hex. load fails on a size mismatch.
+  bool load(const std::string & path);
+  bool save(const std::string & path) const;
+
+private:
+  struct Template
+  {
+    char label;
+    int samples;
+    std::array<uint32_t, kNumberBits> counts;
+    PackedNumber bits;
+  };
+
+  Template * find(char label);
+
+  int min_samples_;
+  std::vector<Template> templates_;
+};
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__NUMBER_TEMPLATES_HPP_
@@ -0,0 +1,27 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__ONNX_READER_HPP_
+#define ARMOR_DETECTOR__ONNX_READER_HPP_
+
+// STD
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rm_auto_aim
+{
+struct OnnxTensor
+{
+  std::vector<int64_t> dims;
+  std::vector<float> data;
+};
+
+// Float initializers (weights) of an ONNX model by name, read straight from the protobuf wire
+// format. Throws std::runtime_error if the file can not be read or is malformed.
+std::map<std::string, OnnxTensor> readOnnxInitializers(const std::string & path);
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__ONNX_READER_HPP_
@@ -0,0 +1,62 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef ARMOR_DETECTOR__PACKED_NUMBER_HPP_
+#define ARMOR_DETECTOR__PACKED_NUMBER_HPP_
+
+// STD
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace rm_auto_aim
+{
+// Binarized number image as fed to the classifier (20 rows x 28 cols), bit-packed row by row.
+// 560 bits in 9 words, a little over one cache line.
+constexpr int kNumberRows = 20;
+constexpr int kNumberCols = 28;
+constexpr int kNumberBits = kNumberRows * kNumberCols;
+using PackedNumber = std::array<uint64_t, (kNumberBits + 63) / 64>;
+
+// Pack a kNumberRows x kNumberCols 8-bit image, non-zero pixels become set bits
+PackedNumber packNumber(const uint8_t * data, size_t step);
+
+inline bool testBit(const PackedNumber & number, int bit)
+{
+  return (number[bit / 64] >> (bit % 64)) & 1;
+}
+
+inline int countBits(const PackedNumber & number)
+{
+  int count = 0;
+  for (auto word : number) {
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
+
+inline int hammingDistance(const PackedNumber & a, const PackedNumber & b)
+{
+  int distance = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    distance += __builtin_popcountll(a[i] ^ b[i]);
+  }
+  return distance;
+}
+
+// Intersection over union of the set bits. Most of a number image is background, so equal
+// background bits don't count: a blank image is not similar to anything.
+inline float overlapSimilarity(const PackedNumber & a, const PackedNumber & b)
+{
+  int intersection = 0;
+  int union_ = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    intersection += __builtin_popcountll(a[i] & b[i]);
+    union_ += __builtin_popcountll(a[i] | b[i]);
+  }
+  return union_ == 0 ? 0.0f : static_cast<float>(intersection) / union_;
+}
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__PACKED_NUMBER_HPP_
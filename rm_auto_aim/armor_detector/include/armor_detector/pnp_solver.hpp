@@ -4,7 +4,6 @@
 #ifndef ARMOR_DETECTOR__PNP_SOLVER_HPP_
 #define ARMOR_DETECTOR__PNP_SOLVER_HPP_
 
-#include <geometry_msgs/msg/point.hpp>
 #include <opencv2/core.hpp>
 
 // STD
@@ -22,8 +21,8 @@ public:
     const std::array<double, 9> & camera_matrix,
     const std::vector<double> & distortion_coefficients);
 
-  // Get 3d position
-  bool solvePnP(const Armor & armor, geometry_msgs::msg::Point & point);
+  // Get 3d position in meters
+  bool solvePnP(const Armor & armor, cv::Point3d & position);
 
   // Calculate the distance between armor center and image center
   float calculateDistanceToCenter(const cv::Point2f & image_point);
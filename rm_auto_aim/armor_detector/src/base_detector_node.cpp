@@ -13,22 +13,72 @@
 
 // STD
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <limits>
 #include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "armor_detector/armor.hpp"
 #include "armor_detector/detector_node.hpp"
+#include "armor_detector/kernels.hpp"
+#include "armor_detector/msg_conversions.hpp"
+#include "auto_aim_utils/async_logger.hpp"
+#include "auto_aim_utils/perf_counters_msg.hpp"
+#include "auto_aim_utils/realtime_parameters.hpp"
+#include "auto_aim_utils/tracing.hpp"
 
 namespace rm_auto_aim
 {
+// Number of text markers allocated up front, more are appended if ever needed
+constexpr int kPreallocatedArmorMarkers = 8;
+// Weight of the newest sample in the processing time sent to the camera
+constexpr double kProcessingSmoothing = 0.2;
+// Number of camera traces kept to be matched with the images
+constexpr size_t kCameraTraceHistory = 8;
+// Size of the blank frame the detector is warmed up with
+const cv::Size kWarmUpImageSize(64, 64);
+// Live metrics. The histograms of the FrameDeadline stages come first, indexed by the stage.
+enum MetricsCounter {
+  FRAMES_COUNTER = 0,
+  DROPPED_FRAMES_COUNTER,
+  DEADLINE_MISSES_COUNTER,
+  ARMORS_COUNTER,
+};
+enum MetricsGauge { LOAD_LEVEL_GAUGE = 0 };
+enum MetricsHistogram { DETECT_HISTOGRAM = FrameDeadline::STAGE_NUM, FRAME_AGE_HISTOGRAM };
+
 BaseDetectorNode::BaseDetectorNode(
   const std::string & node_name, const rclcpp::NodeOptions & options)
 : Node(node_name, options)
 {
   RCLCPP_INFO(this->get_logger(), "Starting DetectorNode!");
 
+  // Image callbacks run in hot_path_group_. By default it is spun by a dedicated real-time
+  // thread, leaving parameter events, camera_info and timers to the node's own executor.
+  realtime_config_ = auto_aim_utils::declareRealtimeParameters(this, "realtime");
+  dedicated_hot_path_ = this->declare_parameter("realtime.dedicated_thread", true);
+  hot_path_group_ = this->create_callback_group(
+    rclcpp::CallbackGroupType::MutuallyExclusive, !dedicated_hot_path_);
+  // The profile is only applied to a thread the node owns, never to the executor or component
+  // container thread that runs the callbacks of other nodes as well
+  if (!dedicated_hot_path_ && auto_aim_utils::isRealtimeConfigured(realtime_config_)) {
+    RCLCPP_WARN(
+      this->get_logger(), "realtime.* is only applied to the dedicated hot path thread, ignored");
+  }
+
+  // SIMD kernels, "auto" picks the widest instruction set the CPU supports
+  auto isa = this->declare_parameter("kernels.isa", std::string("auto"));
+  if (!selectKernels(isa)) {
+    RCLCPP_WARN(this->get_logger(), "Kernels %s not supported on this CPU", isa.c_str());
+    selectKernels("auto");
+  }
+  RCLCPP_INFO(this->get_logger(), "Using %s kernels", isaName(kernels().isa));
+
   // Detector
   detector_ = initDetector();
 
@@ -37,48 +87,264 @@ BaseDetectorNode::BaseDetectorNode(
   auto model_path = pkg_path + "/model/fc.onnx";
   auto label_path = pkg_path + "/model/label.txt";
   double threshold = this->declare_parameter("classifier.threshold", 0.7);
-  classifier_ = std::make_unique<NumberClassifier>(model_path, label_path, threshold);
+  this->declare_parameter("classifier.similarity_threshold", 0.9);
+  this->declare_parameter("classifier.reject_similarity", 0.3);
+  // Templates are learned online, starting from this file if it exists and saved back on exit
+  template_path_ = this->declare_parameter("classifier.template_path", std::string());
+
+  // The model is loaded and both the classifier and the detector are run once on a blank frame
+  // in the background, so that neither the constructor nor the first real frame pay for it.
+  // Frames are dropped by acceptFrame() until this has finished, and for good if it failed.
+  classifier_future_ = std::async(
+    std::launch::async, [logger = this->get_logger(), detector = detector_.get(), model_path,
+                         label_path, threshold, template_path = template_path_]() {
+      try {
+        auto start = std::chrono::steady_clock::now();
+        auto classifier = std::make_unique<NumberClassifier>(model_path, label_path, threshold);
+        if (!template_path.empty() && classifier->loadTemplates(template_path)) {
+          RCLCPP_INFO(logger, "Loaded number templates from %s", template_path.c_str());
+        }
+        classifier->warmUp();
+        detector->preprocessImage(cv::Mat(kWarmUpImageSize, CV_8UC3, cv::Scalar::all(0)));
+
+        std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+        RCLCPP_INFO(logger, "Number classifier ready after %.1fms", elapsed.count());
+        return classifier;
+      } catch (const std::exception & e) {
+        RCLCPP_ERROR(
+          logger, "Failed to load the number classifier, dropping all frames: %s", e.what());
+        return std::unique_ptr<NumberClassifier>();
+      }
+    });
 
-  // Subscriptions transport type
+  // Per-frame processing budget (<= 0 disables it)
+  // Once it is used up the remaining candidates reuse the classification of the nearest armor
+  // of the previous frame or are dropped, instead of stalling the frame
+  deadline_budget_ms_ = this->declare_parameter("deadline.budget_ms", 10.0);
+
+  // Load shedding
+  // When the input-to-output latency exceeds the budget, the detector steps down through
+  // skipping debug output, classifying only the top-K candidates, searching only around the
+  // last armors and dropping frames, then steps back up once the latency has recovered
+  if (this->declare_parameter("load_shedding.enable", true)) {
+    LoadShedder::Params ls_params;
+    ls_params.latency_budget_ms = declare_parameter("load_shedding.latency_budget_ms", 15.0);
+    ls_params.recover_ratio = declare_parameter("load_shedding.recover_ratio", 0.7);
+    ls_params.escalate_frames = declare_parameter("load_shedding.escalate_frames", 5);
+    ls_params.recover_frames = declare_parameter("load_shedding.recover_frames", 30);
+    ls_params.smoothing = declare_parameter("load_shedding.smoothing", 0.2);
+    ls_params.decimation = declare_parameter("load_shedding.decimation", 2);
+    load_shedder_ = std::make_unique<LoadShedder>(ls_params);
+  }
+  top_k_ = std::max(declare_parameter("load_shedding.top_k", 3), 1);
+  // Candidates passed to the classifier, 0 leaves it to the frame deadline
+  this->declare_parameter("classifier.top_k", 0);
+  this->declare_parameter("score.min_score", 0.0);
+  roi_scale_ = declare_parameter("load_shedding.roi_scale", 3.0);
+
+  // Hardware counters (cycles, instructions, cache and branch misses) of each detection stage,
+  // recorded by the image callbacks and published as a summary at report_period
+  if (this->declare_parameter("perf_counters.enable", false)) {
+    std::vector<std::string> stages;
+    for (int s = 0; s < FrameDeadline::STAGE_NUM; s++) {
+      stages.emplace_back(FrameDeadline::stageName(static_cast<FrameDeadline::Stage>(s)));
+    }
+    stage_counters_ = std::make_unique<auto_aim_utils::StageCounters>(
+      stages, this->declare_parameter("perf_counters.history", 300));
+    perf_counters_pub_ = this->create_publisher<auto_aim_interfaces::msg::PerfCounters>(
+      "/detector/perf_counters", 10);
+    double report_period = this->declare_parameter("perf_counters.report_period", 1.0);
+    perf_counters_timer_ = this->create_wall_timer(
+      std::chrono::duration<double>(report_period), [this]() { publishPerfCounters(); });
+  }
+
+  // Frame, drop and deadline miss counters, the load shedding level and latency histograms of
+  // each stage in shared memory, watched with aimtop
+  if (this->declare_parameter("live_metrics.enable", true)) {
+    std::vector<std::string> histograms;
+    for (int s = 0; s < FrameDeadline::STAGE_NUM; s++) {
+      histograms.emplace_back(FrameDeadline::stageName(static_cast<FrameDeadline::Stage>(s)));
+    }
+    histograms.insert(histograms.end(), {"detect", "frame_age"});
+    std::vector<std::string> levels;
+    for (int l = LoadShedder::NORMAL; l <= LoadShedder::DECIMATE; l++) {
+      levels.emplace_back(LoadShedder::levelName(static_cast<LoadShedder::Level>(l)));
+    }
+    try {
+      live_metrics_ = std::make_unique<auto_aim_utils::LiveMetrics>(
+        this->get_fully_qualified_name(),
+        std::vector<std::string>{"frames", "dropped_frames", "deadline_misses", "armors"},
+        std::vector<std::string>{"load_level"}, histograms);
+      live_metrics_->setLabels(LOAD_LEVEL_GAUGE, levels);
+    } catch (const std::runtime_error & e) {
+      RCLCPP_WARN(this->get_logger(), "Live metrics unavailable: %s", e.what());
+    }
+  }
+
+  // Subscriptions transport type, a non-empty image_transport (e.g. "shm") takes precedence
   transport_ = this->declare_parameter("subscribe_compressed", false) ? "compressed" : "raw";
+  auto image_transport = this->declare_parameter("image_transport", std::string());
+  if (!image_transport.empty()) {
+    transport_ = image_transport;
+  }
+  RCLCPP_INFO(this->get_logger(), "Subscribing images with %s transport", transport_.c_str());
 
   // Armors Publisher
   armors_pub_ = this->create_publisher<auto_aim_interfaces::msg::Armors>(
     "/detector/armors", rclcpp::SensorDataQoS());
 
+  // Camera traces of the latest frames, continued for every processed image. Subscribed in the
+  // hot path group ahead of the images, so a frame's trace is usually taken before its image.
+  camera_traces_.resize(kCameraTraceHistory);
+  camera_trace_next_ = 0;
+  camera_trace_sub_ = this->create_subscription<auto_aim_interfaces::msg::FrameTrace>(
+    "/camera/trace", rclcpp::SensorDataQoS(),
+    [this](auto_aim_interfaces::msg::FrameTrace::ConstSharedPtr trace) {
+      camera_traces_[camera_trace_next_] = *trace;
+      camera_trace_next_ = (camera_trace_next_ + 1) % camera_traces_.size();
+    },
+    hotPathOptions());
+
+  // Per-frame feedback for the camera's software trigger pacing
+  processing_ms_ = 0.0;
+  feedback_pub_ = this->create_publisher<auto_aim_interfaces::msg::DetectorFeedback>(
+    "/detector/feedback", rclcpp::SensorDataQoS());
+
   // Visualization Marker Publisher
-  position_marker_.ns = "armors";
-  position_marker_.type = visualization_msgs::msg::Marker::SPHERE_LIST;
-  position_marker_.scale.x = position_marker_.scale.y = position_marker_.scale.z = 0.1;
-  position_marker_.color.a = 1.0;
-  position_marker_.color.r = 1.0;
+  // Markers are published by a timer at marker_rate (<= 0 disables them), reusing the
+  // preallocated marker_array_
+  double marker_rate = this->declare_parameter("marker_rate", 20.0);
+  marker_subscribed_ = false;
+  marker_fresh_ = false;
+  marker_back_.armors.reserve(kPreallocatedArmorMarkers);
+  marker_front_.armors.reserve(kPreallocatedArmorMarkers);
+
+  visualization_msgs::msg::Marker position_marker;
+  position_marker.ns = "armors";
+  position_marker.type = visualization_msgs::msg::Marker::SPHERE_LIST;
+  position_marker.scale.x = position_marker.scale.y = position_marker.scale.z = 0.1;
+  position_marker.color.a = 1.0;
+  position_marker.color.r = 1.0;
+  position_marker.points.reserve(kPreallocatedArmorMarkers);
 
   text_marker_.ns = "classification";
-  text_marker_.action = visualization_msgs::msg::Marker::ADD;
+  text_marker_.action = visualization_msgs::msg::Marker::DELETE;
   text_marker_.type = visualization_msgs::msg::Marker::TEXT_VIEW_FACING;
   text_marker_.scale.z = 0.1;
   text_marker_.color.a = 1.0;
   text_marker_.color.r = 1.0;
   text_marker_.color.g = 1.0;
   text_marker_.color.b = 1.0;
-  text_marker_.lifetime = rclcpp::Duration::from_seconds(0.1);
+  text_marker_.lifetime = rclcpp::Duration::from_seconds(marker_rate > 0 ? 2.0 / marker_rate : 0.1);
+  text_marker_.text.reserve(16);
+
+  marker_array_.markers.reserve(kPreallocatedArmorMarkers + 1);
+  marker_array_.markers.emplace_back(position_marker);
+  for (int i = 0; i < kPreallocatedArmorMarkers; i++) {
+    text_marker_.id = i + 1;
+    marker_array_.markers.emplace_back(text_marker_);
+  }
 
   marker_pub_ =
     this->create_publisher<visualization_msgs::msg::MarkerArray>("/detector/marker", 10);
+  if (marker_rate > 0) {
+    marker_timer_ = this->create_wall_timer(
+      std::chrono::duration<double>(1.0 / marker_rate), [this]() { publishMarkers(); });
+  }
 
   // Debug Publishers
   debug_ = this->declare_parameter("debug", false);
-  if (debug_) {
+  debug_publishers_created_ = debug_;
+  if (debug_publishers_created_) {
     createDebugPublishers();
   }
 
   // Debug param change moniter
   debug_param_sub_ = std::make_shared<rclcpp::ParameterEventHandler>(this);
-  debug_cb_handle_ =
-    debug_param_sub_->add_parameter_callback("debug", [this](const rclcpp::Parameter & p) {
-      debug_ = p.as_bool();
-      debug_ ? createDebugPublishers() : destroyDebugPublishers();
+  debug_cb_handle_ = debug_param_sub_->add_parameter_callback(
+    "debug", [this](const rclcpp::Parameter & p) { debug_ = p.as_bool(); });
+}
+
+BaseDetectorNode::~BaseDetectorNode()
+{
+  if (classifier_ == nullptr && classifier_future_.valid()) {
+    classifier_ = classifier_future_.get();
+  }
+  if (
+    classifier_ != nullptr && !template_path_.empty() &&
+    !classifier_->saveTemplates(template_path_)) {
+    RCLCPP_WARN(
+      this->get_logger(), "Failed to save number templates to %s", template_path_.c_str());
+  }
+}
+
+void BaseDetectorNode::startTrace(
+  const builtin_interfaces::msg::Time & stamp, const rclcpp::Time & start_time)
+{
+  using auto_aim_interfaces::msg::FrameTrace;
+  auto & trace = armors_msg_.trace;
+  auto camera_trace = std::find_if(
+    camera_traces_.begin(), camera_traces_.end(), [&stamp](const FrameTrace & camera_trace) {
+      return camera_trace.capture_stamp == stamp;
     });
+  if (camera_trace != camera_traces_.end()) {
+    trace = *camera_trace;
+  } else {
+    trace = FrameTrace();
+    trace.capture_stamp = stamp;
+  }
+  trace.enter_ns[FrameTrace::DETECT] = start_time.nanoseconds();
+}
+
+void BaseDetectorNode::publishArmors()
+{
+  armors_msg_.trace.exit_ns[auto_aim_interfaces::msg::FrameTrace::DETECT] =
+    this->now().nanoseconds();
+  AUTO_AIM_TRACE_PUBLISHED("/detector/armors", armors_msg_.trace.capture_stamp, 0);
+  armors_pub_->publish(armors_msg_);
+}
+
+void BaseDetectorNode::finishStage(FrameDeadline::Stage stage)
+{
+  deadline_.finishStage(stage);
+  if (stage_counters_ != nullptr) {
+    stage_counters_->finishStage(stage);
+  }
+  if (live_metrics_ != nullptr) {
+    auto now = std::chrono::steady_clock::now();
+    live_metrics_->record(
+      stage, std::chrono::duration<double, std::milli>(now - stage_start_).count());
+    stage_start_ = now;
+  }
+}
+
+void BaseDetectorNode::publishPerfCounters()
+{
+  if (stage_counters_->failed()) {
+    RCLCPP_WARN_ONCE(
+      this->get_logger(), "Hardware counters unavailable: %s", stage_counters_->error().c_str());
+    return;
+  }
+
+  perf_counters_msg_.header.stamp = this->now();
+  auto_aim_utils::toMsg(stage_counters_->summary(), perf_counters_msg_);
+  perf_counters_pub_->publish(perf_counters_msg_);
+}
+
+rclcpp::SubscriptionOptions BaseDetectorNode::hotPathOptions() const
+{
+  rclcpp::SubscriptionOptions options;
+  options.callback_group = hot_path_group_;
+  return options;
+}
+
+void BaseDetectorNode::startHotPathThread()
+{
+  if (dedicated_hot_path_) {
+    hot_path_thread_ = std::make_unique<auto_aim_utils::CallbackGroupThread>(
+      this, hot_path_group_, realtime_config_, "detector");
+  }
 }
 
 std::unique_ptr<Detector> BaseDetectorNode::initDetector()
@@ -95,26 +361,81 @@ std::unique_ptr<Detector> BaseDetectorNode::initDetector()
   param_desc.integer_range[0].to_value = 1;
   auto detect_color = declare_parameter("detect_color", RED, param_desc);
 
-  Detector::LightParams l_params = {
-    .min_ratio = declare_parameter("light.min_ratio", 0.1),
-    .max_ratio = declare_parameter("light.max_ratio", 0.55),
-    .max_angle = declare_parameter("light.max_angle", 40.0)};
-
-  Detector::ArmorParams a_params = {
-    .min_light_ratio = declare_parameter("armor.min_light_ratio", 0.6),
-    .min_small_center_distance = declare_parameter("armor.min_small_center_distance", 0.8),
-    .max_small_center_distance = declare_parameter("armor.max_small_center_distance", 2.8),
-    .min_large_center_distance = declare_parameter("armor.min_large_center_distance", 3.2),
-    .max_large_center_distance = declare_parameter("armor.max_large_center_distance", 4.3),
-    .max_angle = declare_parameter("armor.max_angle", 35.0)};
+  Detector::LightParams l_params;
+  l_params.min_ratio = declare_parameter("light.min_ratio", 0.1);
+  l_params.max_ratio = declare_parameter("light.max_ratio", 0.55);
+  l_params.max_angle = declare_parameter("light.max_angle", 40.0);
+
+  Detector::ArmorParams a_params;
+  a_params.min_light_ratio = declare_parameter("armor.min_light_ratio", 0.6);
+  a_params.min_small_center_distance = declare_parameter("armor.min_small_center_distance", 0.8);
+  a_params.max_small_center_distance = declare_parameter("armor.max_small_center_distance", 2.8);
+  a_params.min_large_center_distance = declare_parameter("armor.min_large_center_distance", 3.2);
+  a_params.max_large_center_distance = declare_parameter("armor.max_large_center_distance", 4.3);
+  a_params.max_angle = declare_parameter("armor.max_angle", 35.0);
+
+  Detector::ScoreParams s_params;
+  s_params.light_ratio = declare_parameter("score.light_ratio", 1.0);
+  s_params.center_distance = declare_parameter("score.center_distance", 1.0);
+  s_params.angle = declare_parameter("score.angle", 1.0);
+  s_params.color = declare_parameter("score.color", 1.0);
+  s_params.area = declare_parameter("score.area", 1.0);
+  s_params.reference_area = declare_parameter("score.reference_area", 150.0);
+
+  return std::make_unique<Detector>(min_lightness, detect_color, l_params, a_params, s_params);
+}
 
-  return std::make_unique<Detector>(min_lightness, detect_color, l_params, a_params);
+bool BaseDetectorNode::acceptFrame()
+{
+  if (classifier_ == nullptr) {
+    // The future is consumed once ready, if it left no classifier the load failed and was logged
+    bool loading = classifier_future_.valid();
+    if (
+      loading &&
+      classifier_future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      classifier_ = classifier_future_.get();
+      loading = false;
+    }
+    if (classifier_ == nullptr) {
+      if (loading) {
+        AUTO_AIM_LOG_WARN(this->get_logger(), "Number classifier not ready, frame dropped");
+      }
+      if (live_metrics_ != nullptr) {
+        live_metrics_->add(DROPPED_FRAMES_COUNTER);
+      }
+      return false;
+    }
+  }
+  bool accepted = load_shedder_ == nullptr || load_shedder_->acceptFrame();
+  if (!accepted && live_metrics_ != nullptr) {
+    live_metrics_->add(DROPPED_FRAMES_COUNTER);
+  }
+  return accepted;
 }
 
 std::vector<Armor> BaseDetectorNode::detectArmors(
   const sensor_msgs::msg::Image::ConstSharedPtr & img_msg)
 {
   auto start_time = this->now();
+  auto start_steady = std::chrono::steady_clock::now();
+  startTrace(img_msg->header.stamp, start_time);
+  AUTO_AIM_TRACE_BEGIN(img_msg->header.stamp, "detect_armors");
+  deadline_.start(deadline_budget_ms_);
+  stage_start_ = start_steady;
+  if (stage_counters_ != nullptr) {
+    stage_counters_->startFrame();
+  }
+  double frame_age_ms =
+    std::max((start_time - rclcpp::Time(img_msg->header.stamp)).seconds() * 1000, 0.0);
+  auto level = load_shedder_ != nullptr ? load_shedder_->level() : LoadShedder::NORMAL;
+
+  // Debug publishers are switched here instead of in the parameter callback,
+  // which runs on another thread
+  bool debug = debug_ && level < LoadShedder::SKIP_DEBUG;
+  if (debug != debug_publishers_created_) {
+    debug ? createDebugPublishers() : destroyDebugPublishers();
+    debug_publishers_created_ = debug;
+  }
   // Convert ROS img to cv::Mat
   auto img = cv_bridge::toCvShare(img_msg, "rgb8")->image;
 
@@ -122,22 +443,118 @@ std::vector<Armor> BaseDetectorNode::detectArmors(
   detector_->min_lightness = get_parameter("min_lightness").as_int();
   detector_->detect_color = get_parameter("detect_color").as_int();
 
-  auto binary_img = detector_->preprocessImage(img);
-  auto lights = detector_->findLights(img, binary_img);
-  auto armors = detector_->matchLights(lights);
+  cv::Mat binary_img;
+  bool roi_only = level >= LoadShedder::ROI_ONLY && roi_.area() > 0;
+  auto search_img = roi_only ? img(roi_) : img;
+  AUTO_AIM_TRACE_BEGIN(img_msg->header.stamp, "detect_preprocess");
+  binary_img = detector_->preprocessImage(search_img);
+  AUTO_AIM_TRACE_END(img_msg->header.stamp, "detect_preprocess");
+  finishStage(FrameDeadline::PREPROCESS);
+  AUTO_AIM_TRACE_BEGIN(img_msg->header.stamp, "detect_find_lights");
+  detector_->findLights(search_img, binary_img, lights_);
+  if (roi_only) {
+    lights_.shift(roi_.tl());
+  }
+  AUTO_AIM_TRACE_END(img_msg->header.stamp, "detect_find_lights");
+  finishStage(FrameDeadline::FIND_LIGHTS);
+  AUTO_AIM_TRACE_BEGIN(img_msg->header.stamp, "detect_match_lights");
+  detector_->matchLights(lights_, candidates_);
+  AUTO_AIM_TRACE_END(img_msg->header.stamp, "detect_match_lights");
+  finishStage(FrameDeadline::MATCH_LIGHTS);
+
+  // Rank the candidates by their geometric score so that the likely armors are classified first,
+  // and only let the top-K reach the classifier
+  size_t candidate_num = candidates_.size();
+  double min_score = get_parameter("score.min_score").as_double();
+  candidates_.erase(
+    std::remove_if(
+      candidates_.begin(), candidates_.end(),
+      [min_score](const ArmorCandidate & candidate) { return candidate.score < min_score; }),
+    candidates_.end());
+  size_t top_k = classifyLimit(level);
+  auto higher = [](const ArmorCandidate & c1, const ArmorCandidate & c2) {
+    return c1.score > c2.score;
+  };
+  if (candidates_.size() > top_k) {
+    std::partial_sort(candidates_.begin(), candidates_.begin() + top_k, candidates_.end(), higher);
+    candidates_.erase(candidates_.begin() + top_k, candidates_.end());
+  } else {
+    std::sort(candidates_.begin(), candidates_.end(), higher);
+  }
+  size_t gated_num = candidates_.size();
+
+  std::vector<Armor> armors;
+  armors.reserve(gated_num);
+  for (const auto & candidate : candidates_) {
+    armors.push_back(makeArmor(lights_, candidate));
+  }
 
   // Extract numbers
+  int cached_count = 0, dropped_count = 0;
   if (!armors.empty()) {
-    classifier_->extractNumbers(img, armors);
+    AUTO_AIM_TRACE_BEGIN(img_msg->header.stamp, "detect_extract_numbers");
+    classifier_->extractNumbers(img, armors, &deadline_);
+    AUTO_AIM_TRACE_END(img_msg->header.stamp, "detect_extract_numbers");
+    finishStage(FrameDeadline::EXTRACT_NUMBERS);
     classifier_->threshold = get_parameter("classifier.threshold").as_double();
-    classifier_->doClassify(armors);
+    classifier_->similarity_threshold =
+      get_parameter("classifier.similarity_threshold").as_double();
+    classifier_->reject_similarity = get_parameter("classifier.reject_similarity").as_double();
+    AUTO_AIM_TRACE_BEGIN(img_msg->header.stamp, "detect_classify");
+    classifier_->doClassify(armors, &deadline_);
+    AUTO_AIM_TRACE_END(img_msg->header.stamp, "detect_classify");
+    finishStage(FrameDeadline::CLASSIFY);
+    cached_count = classifier_->cached_count;
+    dropped_count = classifier_->dropped_count;
+  }
+
+  if (deadline_.missed()) {
+    AUTO_AIM_LOG_WARN(
+      this->get_logger(),
+      "Frame deadline %gms missed, %d armors reused cached results, %d dropped. Misses: %s",
+      deadline_budget_ms_, cached_count, dropped_count, deadlineMisses().c_str());
   }
 
+  std::chrono::duration<double, std::milli> processing_time =
+    std::chrono::steady_clock::now() - start_steady;
+  if (load_shedder_ != nullptr) {
+    roi_ = nextRoi(armors, img.size());
+    updateLoadShedding(frame_age_ms, processing_time.count());
+  }
+  if (live_metrics_ != nullptr) {
+    live_metrics_->add(FRAMES_COUNTER);
+    live_metrics_->add(ARMORS_COUNTER, armors.size());
+    if (deadline_.missed()) {
+      live_metrics_->add(DEADLINE_MISSES_COUNTER);
+    }
+    live_metrics_->set(
+      LOAD_LEVEL_GAUGE, load_shedder_ != nullptr ? load_shedder_->level() : LoadShedder::NORMAL);
+    live_metrics_->record(DETECT_HISTOGRAM, processing_time.count());
+    live_metrics_->record(FRAME_AGE_HISTOGRAM, frame_age_ms);
+  }
+
+  // Tell the camera when the next frame is needed
+  processing_ms_ = processing_ms_ == 0.0 ? processing_time.count()
+                                         : kProcessingSmoothing * processing_time.count() +
+                                             (1 - kProcessingSmoothing) * processing_ms_;
+  feedback_msg_.header = img_msg->header;
+  feedback_msg_.frame_age_ms = frame_age_ms;
+  feedback_msg_.processing_ms = processing_ms_;
+  feedback_pub_->publish(feedback_msg_);
+
+  AUTO_AIM_TRACE_END(img_msg->header.stamp, "detect_armors");
+
   // Publish debug info
-  if (debug_) {
+  if (debug) {
     auto final_time = this->now();
     auto latency = (final_time - start_time).seconds() * 1000;
-    RCLCPP_INFO_STREAM(this->get_logger(), "detectArmors used: " << latency << "ms");
+    AUTO_AIM_LOG(INFO, this->get_logger(), 0, "detectArmors used: %gms", latency);
+    AUTO_AIM_LOG(
+      INFO, this->get_logger(), 0,
+      "Classified %zu of %zu armor candidates, %d by templates, %d reused from the last frame",
+      gated_num, candidate_num,
+      classifier_->template_accepted_count + classifier_->template_rejected_count,
+      classifier_->reused_count);
     cv::putText(
       img, "Latency: " + std::to_string(latency) + "ms", cv::Point(10, 30),
       cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
@@ -145,43 +562,124 @@ std::vector<Armor> BaseDetectorNode::detectArmors(
     binary_img_pub_.publish(cv_bridge::CvImage(img_msg->header, "mono8", binary_img).toImageMsg());
 
     std::sort(
-      detector_->debug_lights.data.begin(), detector_->debug_lights.data.end(),
+      detector_->debug_lights.begin(), detector_->debug_lights.end(),
       [](const auto & l1, const auto & l2) { return l1.center_x < l2.center_x; });
     std::sort(
-      detector_->debug_armors.data.begin(), detector_->debug_armors.data.end(),
+      detector_->debug_armors.begin(), detector_->debug_armors.end(),
       [](const auto & a1, const auto & a2) { return a1.center_x < a2.center_x; });
 
-    lights_data_pub_->publish(detector_->debug_lights);
-    armors_data_pub_->publish(detector_->debug_armors);
+    debug_lights_msg_.data.clear();
+    for (const auto & light : detector_->debug_lights) {
+      debug_lights_msg_.data.push_back(toMsg(light));
+    }
+    debug_armors_msg_.data.clear();
+    for (const auto & armor : detector_->debug_armors) {
+      debug_armors_msg_.data.push_back(toMsg(armor));
+    }
+    lights_data_pub_->publish(debug_lights_msg_);
+    armors_data_pub_->publish(debug_armors_msg_);
 
     if (!armors.empty()) {
       // Combine all number images to one
       std::vector<cv::Mat> number_imgs;
       number_imgs.reserve(armors.size());
       for (auto & armor : armors) {
-        cv::resize(armor.number_img, armor.number_img, cv::Size(20, 28));
-        number_imgs.emplace_back(armor.number_img);
+        // Armors left after the deadline have no number image
+        if (!armor.number_img.empty()) {
+          number_imgs.emplace_back(armor.number_img);
+        }
       }
-      cv::Mat all_num_img;
-      cv::vconcat(number_imgs, all_num_img);
+      if (!number_imgs.empty()) {
+        cv::Mat all_num_img;
+        cv::vconcat(number_imgs, all_num_img);
 
-      number_pub_->publish(*cv_bridge::CvImage(img_msg->header, "mono8", all_num_img).toImageMsg());
+        number_pub_->publish(
+          *cv_bridge::CvImage(img_msg->header, "mono8", all_num_img).toImageMsg());
+      }
     }
 
-    drawResults(img, lights, armors);
+    drawResults(img, lights_, armors);
     final_img_pub_.publish(cv_bridge::CvImage(img_msg->header, "rgb8", img).toImageMsg());
   }
 
   return armors;
 }
 
+void BaseDetectorNode::updateLoadShedding(double frame_age_ms, double processing_ms)
+{
+  auto last_level = load_shedder_->level();
+  if (!load_shedder_->update(frame_age_ms, processing_ms)) {
+    return;
+  }
+
+  auto level = load_shedder_->level();
+  if (level > last_level) {
+    RCLCPP_WARN(
+      this->get_logger(),
+      "Load shedding degraded %s -> %s: latency %.1fms over budget %.1fms, processing %.1ffps",
+      LoadShedder::levelName(last_level), LoadShedder::levelName(level), load_shedder_->latency(),
+      load_shedder_->params.latency_budget_ms, load_shedder_->processingRate());
+  } else {
+    RCLCPP_INFO(
+      this->get_logger(),
+      "Load shedding recovered %s -> %s: latency %.1fms, budget %.1fms, processing %.1ffps",
+      LoadShedder::levelName(last_level), LoadShedder::levelName(level), load_shedder_->latency(),
+      load_shedder_->params.latency_budget_ms, load_shedder_->processingRate());
+  }
+}
+
+size_t BaseDetectorNode::classifyLimit(LoadShedder::Level level)
+{
+  int top_k = get_parameter("classifier.top_k").as_int();
+  size_t limit = top_k > 0 ? top_k : std::numeric_limits<size_t>::max();
+  if (level >= LoadShedder::TOP_K) {
+    limit = std::min(limit, top_k_);
+  }
+  return limit;
+}
+
+std::string BaseDetectorNode::deadlineMisses() const
+{
+  std::string misses;
+  for (int i = 0; i < FrameDeadline::STAGE_NUM; i++) {
+    auto stage = static_cast<FrameDeadline::Stage>(i);
+    misses += std::string(i == 0 ? "" : ", ") + FrameDeadline::stageName(stage) + " " +
+              std::to_string(deadline_.misses(stage));
+  }
+  return misses;
+}
+
+cv::Rect BaseDetectorNode::nextRoi(
+  const std::vector<Armor> & armors, const cv::Size & img_size) const
+{
+  if (armors.empty()) {
+    return cv::Rect();
+  }
+
+  std::vector<cv::Point2f> points;
+  points.reserve(armors.size() * 4);
+  for (const auto & armor : armors) {
+    points.emplace_back(armor.left_light.top);
+    points.emplace_back(armor.left_light.bottom);
+    points.emplace_back(armor.right_light.top);
+    points.emplace_back(armor.right_light.bottom);
+  }
+  cv::Rect2f box = cv::boundingRect(points);
+
+  // Scale around the center so that the armors can move between frames
+  cv::Point2f center(box.x + box.width / 2, box.y + box.height / 2);
+  cv::Size2f size(box.width * roi_scale_, box.height * roi_scale_);
+  cv::Rect2f roi(center - cv::Point2f(size.width / 2, size.height / 2), size);
+  return cv::Rect(roi) & cv::Rect(cv::Point(0, 0), img_size);
+}
+
 void BaseDetectorNode::drawResults(
-  cv::Mat & img, const std::vector<Light> & lights, const std::vector<Armor> & armors)
+  cv::Mat & img, const LightTable & lights, const std::vector<Armor> & armors)
 {
   // Draw Lights
-  for (const auto & light : lights) {
-    auto color = light.color == RED ? cv::Scalar(255, 255, 0) : cv::Scalar(255, 0, 255);
-    cv::ellipse(img, light, color, 2);
+  for (size_t i = 0; i < lights.size(); i++) {
+    auto color = lights.colors[i] == RED ? cv::Scalar(255, 255, 0) : cv::Scalar(255, 0, 255);
+    cv::ellipse(img, lights.box(i), color, 2);
   }
 
   // Draw armors
@@ -198,7 +696,10 @@ void BaseDetectorNode::drawResults(
   }
 
   // Draw camera center
-  cv::circle(img, cam_center_, 5, cv::Scalar(255, 0, 0), 2);
+  auto cam_info = std::atomic_load(&cam_info_);
+  if (cam_info != nullptr) {
+    cv::circle(img, cv::Point2f(cam_info->k[2], cam_info->k[5]), 5, cv::Scalar(255, 0, 0), 2);
+  }
 }
 
 void BaseDetectorNode::createDebugPublishers()
@@ -223,11 +724,65 @@ void BaseDetectorNode::destroyDebugPublishers()
   final_img_pub_.shutdown();
 }
 
+void BaseDetectorNode::commitMarkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(marker_mutex_);
+    std::swap(marker_back_, marker_front_);
+    marker_fresh_ = true;
+  }
+  marker_back_.armors.clear();
+}
+
 void BaseDetectorNode::publishMarkers()
 {
   using Marker = visualization_msgs::msg::Marker;
-  position_marker_.action = armors_msg_.armors.empty() ? Marker::DELETE : Marker::ADD;
-  marker_array_.markers.emplace_back(position_marker_);
+
+  // Let the image callbacks skip filling the buffer when nobody is listening
+  marker_subscribed_ = marker_pub_->get_subscription_count() > 0;
+  if (!marker_subscribed_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(marker_mutex_);
+    if (!marker_fresh_) {
+      return;
+    }
+    marker_fresh_ = false;
+
+    const auto & armors = marker_front_.armors;
+    auto & markers = marker_array_.markers;
+    while (markers.size() < armors.size() + 1) {
+      text_marker_.id = static_cast<int>(markers.size());
+      markers.emplace_back(text_marker_);
+    }
+
+    auto & position_marker = markers[0];
+    position_marker.header = marker_front_.header;
+    position_marker.action = armors.empty() ? Marker::DELETE : Marker::ADD;
+    position_marker.points.clear();
+
+    char text[16];
+    for (size_t i = 1; i < markers.size(); i++) {
+      auto & text_marker = markers[i];
+      text_marker.header = marker_front_.header;
+      if (i > armors.size()) {
+        text_marker.action = Marker::DELETE;
+        continue;
+      }
+
+      const auto & armor = armors[i - 1];
+      position_marker.points.emplace_back(armor.position);
+
+      text_marker.action = Marker::ADD;
+      text_marker.pose.position = armor.position;
+      text_marker.pose.position.y -= 0.1;
+      std::snprintf(text, sizeof(text), "%c:_%.1f%%", armor.number, armor.confidence * 100.0);
+      text_marker.text = text;
+    }
+  }
+
   marker_pub_->publish(marker_array_);
 }
 
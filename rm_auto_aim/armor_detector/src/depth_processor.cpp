@@ -12,12 +12,12 @@ DepthProcessor::DepthProcessor(const std::array<double, 9> & camera_matrix)
 {
 }
 
-geometry_msgs::msg::Point DepthProcessor::getPosition(
+cv::Point3d DepthProcessor::getPosition(
   const cv::Mat & depth_image, const cv::Point2f & image_point)
 {
   auto depth = depth_image.at<cv::uint16_t>(image_point.y, image_point.x);
 
-  geometry_msgs::msg::Point p;
+  cv::Point3d p;
   p.z = depth * 0.001;
   p.x = (image_point.x - cx_) * p.z / fx_;
   p.y = (image_point.y - cy_) * p.z / fy_;
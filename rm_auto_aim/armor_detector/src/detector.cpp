@@ -11,41 +11,46 @@
 // STD
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <vector>
 
 #include "armor_detector/detector.hpp"
-#include "auto_aim_interfaces/msg/debug_armor.hpp"
-#include "auto_aim_interfaces/msg/debug_light.hpp"
+#include "armor_detector/kernels.hpp"
 
 namespace rm_auto_aim
 {
 Detector::Detector(
   const int & init_min_l, const int & init_color, const LightParams & init_l,
-  const ArmorParams & init_a)
-: min_lightness(init_min_l), detect_color(init_color), l(init_l), a(init_a)
+  const ArmorParams & init_a, const ScoreParams & init_s)
+: min_lightness(init_min_l), detect_color(init_color), l(init_l), a(init_a), s(init_s)
 {
 }
 
 cv::Mat Detector::preprocessImage(const cv::Mat & rgb_img)
 {
-  cv::Mat gray_img;
-  cv::cvtColor(rgb_img, gray_img, cv::COLOR_RGB2GRAY);
-
-  cv::Mat binary_img;
-  cv::threshold(gray_img, binary_img, min_lightness, 255, cv::THRESH_BINARY);
+  // Gray conversion and threshold in one pass
+  const auto & k = kernels();
+  cv::Mat binary_img(rgb_img.size(), CV_8UC1);
+  for (int i = 0; i < rgb_img.rows; i++) {
+    k.rgbThreshold(
+      rgb_img.ptr<uint8_t>(i), binary_img.ptr<uint8_t>(i), rgb_img.cols, min_lightness);
+  }
 
   return binary_img;
 }
 
-std::vector<Light> Detector::findLights(const cv::Mat & rbg_img, const cv::Mat & binary_img)
+void Detector::findLights(
+  const cv::Mat & rbg_img, const cv::Mat & binary_img, LightTable & lights)
 {
   using std::vector;
   vector<vector<cv::Point>> contours;
   vector<cv::Vec4i> hierarchy;
   cv::findContours(binary_img, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
 
-  vector<Light> lights;
-  this->debug_lights.data.clear();
+  lights.clear();
+  this->debug_lights.clear();
 
   for (const auto & contour : contours) {
     if (contour.size() < 5) continue;
@@ -58,25 +63,37 @@ std::vector<Light> Detector::findLights(const cv::Mat & rbg_img, const cv::Mat &
       if (  // Avoid assertion failed
         0 <= rect.x && 0 <= rect.width && rect.x + rect.width <= rbg_img.cols && 0 <= rect.y &&
         0 <= rect.height && rect.y + rect.height <= rbg_img.rows) {
-        int sum_r = 0, sum_b = 0;
+        int64_t sum_r = 0, sum_b = 0;
         auto roi = rbg_img(rect);
-        // Iterate through the ROI
+        // Sum the pixels inside the contour
+        cv::Mat mask = cv::Mat::zeros(rect.size(), CV_8UC1);
+        const cv::Point * points = contour.data();
+        int point_num = static_cast<int>(contour.size());
+        cv::fillPoly(mask, &points, &point_num, 1, 255, cv::LINE_8, 0, -rect.tl());
+        const auto & k = kernels();
         for (int i = 0; i < roi.rows; i++) {
-          for (int j = 0; j < roi.cols; j++) {
-            if (cv::pointPolygonTest(contour, cv::Point2f(j + rect.x, i + rect.y), false) >= 0) {
-              // if point is inside contour
-              sum_r += roi.at<cv::Vec3b>(i, j)[0];
-              sum_b += roi.at<cv::Vec3b>(i, j)[2];
-            }
-          }
+          k.colorVote(roi.ptr<uint8_t>(i), mask.ptr<uint8_t>(i), roi.cols, &sum_r, &sum_b);
         }
         // Sum of red pixels > sum of blue pixels ?
         light.color = sum_r > sum_b ? RED : BLUE;
-        lights.emplace_back(light);
+        light.color_strength =
+          sum_r + sum_b > 0 ? static_cast<float>(std::abs(sum_r - sum_b)) / (sum_r + sum_b) : 0;
+        lights.push_back(light);
       }
     }
   }
+}
 
+std::vector<Light> Detector::findLights(const cv::Mat & rbg_img, const cv::Mat & binary_img)
+{
+  LightTable table;
+  findLights(rbg_img, binary_img, table);
+
+  std::vector<Light> lights;
+  lights.reserve(table.size());
+  for (size_t i = 0; i < table.size(); i++) {
+    lights.push_back(table.light(i));
+  }
   return lights;
 }
 
@@ -91,52 +108,74 @@ bool Detector::isLight(const Light & light)
   bool is_light = ratio_ok && angle_ok;
 
   // Fill in debug information
-  auto_aim_interfaces::msg::DebugLight light_data;
+  DebugLight light_data;
   light_data.center_x = light.center.x;
   light_data.ratio = ratio;
   light_data.angle = light.tilt_angle;
   light_data.is_light = is_light;
-  this->debug_lights.data.emplace_back(light_data);
+  this->debug_lights.emplace_back(light_data);
 
   return is_light;
 }
 
-std::vector<Armor> Detector::matchLights(const std::vector<Light> & lights)
+void Detector::matchLights(
+  const LightTable & lights, std::vector<ArmorCandidate> & candidates)
 {
-  std::vector<Armor> armors;
-  this->debug_armors.data.clear();
+  candidates.clear();
+  this->debug_armors.clear();
 
   // Loop all the pairing of lights
-  for (auto light_1 = lights.begin(); light_1 != lights.end(); light_1++) {
-    for (auto light_2 = light_1 + 1; light_2 != lights.end(); light_2++) {
-      if (light_1->color != detect_color || light_2->color != detect_color) continue;
+  int light_num = static_cast<int>(lights.size());
+  for (int i = 0; i < light_num; i++) {
+    if (lights.colors[i] != detect_color) continue;
+    for (int j = i + 1; j < light_num; j++) {
+      if (lights.colors[j] != detect_color) continue;
 
-      if (containLight(*light_1, *light_2, lights)) {
+      if (containLight(lights, i, j)) {
         continue;
       }
-      auto armor = Armor(*light_1, *light_2);
-      if (isArmor(armor)) {
-        armors.emplace_back(armor);
+      ArmorCandidate candidate;
+      if (lights.centers[i].x < lights.centers[j].x) {
+        candidate.left = i, candidate.right = j;
+      } else {
+        candidate.left = j, candidate.right = i;
+      }
+      if (isArmor(lights, candidate)) {
+        candidates.push_back(candidate);
       }
     }
   }
+}
+
+std::vector<Armor> Detector::matchLights(const std::vector<Light> & lights)
+{
+  LightTable table;
+  for (const auto & light : lights) {
+    table.push_back(light);
+  }
+  std::vector<ArmorCandidate> candidates;
+  matchLights(table, candidates);
 
+  std::vector<Armor> armors;
+  armors.reserve(candidates.size());
+  for (const auto & candidate : candidates) {
+    armors.push_back(makeArmor(table, candidate));
+  }
   return armors;
 }
 
 // Check if there is another light in the boundingRect formed by the 2 lights
-bool Detector::containLight(
-  const Light & light_1, const Light & light_2, const std::vector<Light> & lights)
+bool Detector::containLight(const LightTable & lights, int i, int j) const
 {
-  auto points = std::vector<cv::Point2f>{light_1.top, light_1.bottom, light_2.top, light_2.bottom};
-  auto bounding_rect = cv::boundingRect(points);
+  cv::Point2f points[4] = {lights.tops[i], lights.bottoms[i], lights.tops[j], lights.bottoms[j]};
+  auto bounding_rect = cv::boundingRect(cv::Mat(4, 1, CV_32FC2, points));
 
-  for (const auto & test_light : lights) {
-    if (test_light.center == light_1.center || test_light.center == light_2.center) continue;
+  for (size_t k = 0; k < lights.size(); k++) {
+    if (lights.centers[k] == lights.centers[i] || lights.centers[k] == lights.centers[j]) continue;
 
     if (
-      bounding_rect.contains(test_light.top) || bounding_rect.contains(test_light.bottom) ||
-      bounding_rect.contains(test_light.center)) {
+      bounding_rect.contains(lights.tops[k]) || bounding_rect.contains(lights.bottoms[k]) ||
+      bounding_rect.contains(lights.centers[k])) {
       return true;
     }
   }
@@ -144,41 +183,83 @@ bool Detector::containLight(
   return false;
 }
 
-bool Detector::isArmor(Armor & armor)
+bool Detector::isArmor(const LightTable & lights, ArmorCandidate & candidate)
 {
-  Light light_1 = armor.left_light;
-  Light light_2 = armor.right_light;
+  const float length_1 = lights.lengths[candidate.left];
+  const float length_2 = lights.lengths[candidate.right];
+  const cv::Point2f & center_1 = lights.centers[candidate.left];
+  const cv::Point2f & center_2 = lights.centers[candidate.right];
   // Ratio of the length of 2 lights (short side / long side)
-  float light_length_ratio = light_1.length < light_2.length ? light_1.length / light_2.length
-                                                             : light_2.length / light_1.length;
+  float light_length_ratio = length_1 < length_2 ? length_1 / length_2 : length_2 / length_1;
   bool light_ratio_ok = light_length_ratio > a.min_light_ratio;
 
   // Distance between the center of 2 lights (unit : light length)
-  float avg_light_length = (light_1.length + light_2.length) / 2;
-  float center_distance = cv::norm(light_1.center - light_2.center) / avg_light_length;
+  float avg_light_length = (length_1 + length_2) / 2;
+  float center_distance = cv::norm(center_1 - center_2) / avg_light_length;
   bool center_distance_ok = (a.min_small_center_distance < center_distance &&
                              center_distance < a.max_small_center_distance) ||
                             (a.min_large_center_distance < center_distance &&
                              center_distance < a.max_large_center_distance);
 
   // Angle of light center connection
-  cv::Point2f diff = light_1.center - light_2.center;
+  cv::Point2f diff = center_1 - center_2;
   float angle = std::abs(std::atan(diff.y / diff.x)) / CV_PI * 180;
   bool angle_ok = angle < a.max_angle;
 
   bool is_armor = light_ratio_ok && center_distance_ok && angle_ok;
-  armor.armor_type = center_distance > a.min_large_center_distance ? LARGE : SMALL;
+  candidate.armor_type = center_distance > a.min_large_center_distance ? LARGE : SMALL;
+  candidate.score =
+    is_armor ? scoreArmor(lights, candidate, light_length_ratio, center_distance, angle) : 0.0f;
   // Fill in debug information
-  auto_aim_interfaces::msg::DebugArmor armor_data;
-  armor_data.center_x = (light_1.center.x + light_2.center.x) / 2;
+  DebugArmor armor_data;
+  armor_data.center_x = (center_1.x + center_2.x) / 2;
   armor_data.light_ratio = light_length_ratio;
   armor_data.center_distance = center_distance;
   armor_data.angle = angle;
   armor_data.is_armor = is_armor;
-  armor_data.armor_type = (armor.armor_type == SMALL);
-  this->debug_armors.data.emplace_back(armor_data);
+  armor_data.armor_type = candidate.armor_type;
+  armor_data.score = candidate.score;
+  this->debug_armors.emplace_back(armor_data);
 
   return is_armor;
 }
 
+float Detector::scoreArmor(
+  const LightTable & lights, const ArmorCandidate & candidate, float light_length_ratio,
+  float center_distance, float angle) const
+{
+  auto clamp01 = [](double x) { return std::min(std::max(x, 0.0), 1.0); };
+
+  // Equal lights score 1, the least equal accepted lights score 0
+  double ratio_score = clamp01((light_length_ratio - a.min_light_ratio) / (1 - a.min_light_ratio));
+
+  // Distance in the middle of the accepted range of its type scores 1
+  double min_distance = candidate.armor_type == LARGE ? a.min_large_center_distance
+                                                      : a.min_small_center_distance;
+  double max_distance = candidate.armor_type == LARGE ? a.max_large_center_distance
+                                                      : a.max_small_center_distance;
+  double half_range = (max_distance - min_distance) / 2;
+  double center_score =
+    clamp01(1 - std::abs(center_distance - (min_distance + half_range)) / half_range);
+
+  double angle_score = clamp01(1 - angle / a.max_angle);
+
+  const int l = candidate.left, r = candidate.right;
+  double color_score = clamp01((lights.color_strengths[l] + lights.color_strengths[r]) / 2);
+
+  // Bigger, i.e. closer, lights are more likely to be a real armor than small spots
+  double area = (static_cast<double>(lights.lengths[l]) * lights.widths[l] +
+                 static_cast<double>(lights.lengths[r]) * lights.widths[r]) /
+                2;
+  double area_score = clamp01(area / s.reference_area);
+
+  double weight_sum = s.light_ratio + s.center_distance + s.angle + s.color + s.area;
+  if (weight_sum <= 0) {
+    return 0;
+  }
+  return (s.light_ratio * ratio_score + s.center_distance * center_score + s.angle * angle_score +
+          s.color * color_score + s.area * area_score) /
+         weight_sum;
+}
+
 }  // namespace rm_auto_aim
@@ -0,0 +1,57 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/frame_deadline.hpp"
+
+// STD
+#include <limits>
+
+namespace rm_auto_aim
+{
+FrameDeadline::FrameDeadline() : enabled_(false), missed_(false), misses_{} {}
+
+void FrameDeadline::start(double budget_ms)
+{
+  enabled_ = budget_ms > 0;
+  missed_ = false;
+  if (enabled_) {
+    deadline_ = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                 std::chrono::duration<double, std::milli>(budget_ms));
+  }
+}
+
+double FrameDeadline::remainingMs() const
+{
+  if (!enabled_) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::chrono::duration<double, std::milli>(deadline_ - Clock::now()).count();
+}
+
+void FrameDeadline::finishStage(Stage stage)
+{
+  if (!missed_ && expired()) {
+    missed_ = true;
+    misses_[stage]++;
+  }
+}
+
+const char * FrameDeadline::stageName(Stage stage)
+{
+  switch (stage) {
+    case PREPROCESS:
+      return "preprocess";
+    case FIND_LIGHTS:
+      return "find_lights";
+    case MATCH_LIGHTS:
+      return "match_lights";
+    case EXTRACT_NUMBERS:
+      return "extract_numbers";
+    case CLASSIFY:
+      return "classify";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace rm_auto_aim
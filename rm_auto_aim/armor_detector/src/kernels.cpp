@@ -0,0 +1,152 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/kernels.hpp"
+
+#if defined(__arm__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+// STD
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace rm_auto_aim
+{
+namespace scalar
+{
+extern const Kernels kernels;
+}
+#if defined(__x86_64__) || defined(__i386__)
+namespace sse4_2
+{
+extern const Kernels kernels;
+}
+namespace avx2
+{
+extern const Kernels kernels;
+}
+namespace avx512
+{
+extern const Kernels kernels;
+}
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+namespace neon
+{
+extern const Kernels kernels;
+}
+#endif
+
+namespace
+{
+bool cpuSupports(Isa isa)
+{
+  switch (isa) {
+    case Isa::SCALAR:
+      return true;
+#if defined(__x86_64__) || defined(__i386__)
+    case Isa::SSE4_2:
+      return __builtin_cpu_supports("sse4.2");
+    case Isa::AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case Isa::AVX512:
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+#if defined(__aarch64__)
+    case Isa::NEON:
+      return true;
+#elif defined(__arm__) && defined(__linux__) && defined(__ARM_NEON)
+    case Isa::NEON:
+      return getauxval(AT_HWCAP) & HWCAP_NEON;
+#endif
+    default:
+      return false;
+  }
+}
+
+const Kernels * compiledKernels(Isa isa)
+{
+  switch (isa) {
+    case Isa::SCALAR:
+      return &scalar::kernels;
+#if defined(__x86_64__) || defined(__i386__)
+    case Isa::SSE4_2:
+      return &sse4_2::kernels;
+    case Isa::AVX2:
+      return &avx2::kernels;
+    case Isa::AVX512:
+      return &avx512::kernels;
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+    case Isa::NEON:
+      return &neon::kernels;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+const Kernels * bestKernels() { return kernelsFor(supportedIsas().back()); }
+
+std::atomic<const Kernels *> & selectedKernels()
+{
+  static std::atomic<const Kernels *> selected(bestKernels());
+  return selected;
+}
+}  // namespace
+
+const char * isaName(Isa isa)
+{
+  switch (isa) {
+    case Isa::SCALAR:
+      return "scalar";
+    case Isa::SSE4_2:
+      return "sse4.2";
+    case Isa::AVX2:
+      return "avx2";
+    case Isa::AVX512:
+      return "avx512";
+    case Isa::NEON:
+      return "neon";
+  }
+  return "unknown";
+}
+
+std::vector<Isa> supportedIsas()
+{
+  std::vector<Isa> isas;
+  for (auto isa : {Isa::SCALAR, Isa::SSE4_2, Isa::AVX2, Isa::AVX512, Isa::NEON}) {
+    if (compiledKernels(isa) != nullptr && cpuSupports(isa)) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+const Kernels * kernelsFor(Isa isa) { return cpuSupports(isa) ? compiledKernels(isa) : nullptr; }
+
+const Kernels & kernels() { return *selectedKernels().load(std::memory_order_relaxed); }
+
+bool selectKernels(const std::string & isa_name)
+{
+  const Kernels * selected = nullptr;
+  if (isa_name == "auto") {
+    selected = bestKernels();
+  } else {
+    for (auto isa : supportedIsas()) {
+      if (isa_name == isaName(isa)) {
+        selected = kernelsFor(isa);
+      }
+    }
+  }
+  if (selected == nullptr) {
+    return false;
+  }
+  selectedKernels().store(selected);
+  return true;
+}
+
+}  // namespace rm_auto_aim
@@ -0,0 +1,9 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// AVX2 kernels, compiled with -mavx2 on x86 (see CMakeLists.txt)
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_NAMESPACE avx2
+#define KERNELS_ISA AVX2
+#include "kernels_impl.hpp"
+#endif
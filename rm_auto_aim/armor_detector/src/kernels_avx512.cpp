@@ -0,0 +1,9 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// AVX-512 kernels, compiled with -mavx512f on x86 (see CMakeLists.txt)
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_NAMESPACE avx512
+#define KERNELS_ISA AVX512
+#include "kernels_impl.hpp"
+#endif
@@ -0,0 +1,189 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// Kernel implementations, included by one translation unit per instruction set with
+// KERNELS_NAMESPACE and KERNELS_ISA defined. The units are compiled with different -m flags,
+// so everything here has internal linkage and no inline functions or templates from other
+// headers are used: the linker could otherwise keep a copy built for a newer instruction set.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "armor_detector/kernels.hpp"
+
+namespace rm_auto_aim
+{
+namespace KERNELS_NAMESPACE
+{
+namespace
+{
+// Fixed-point weights of cv::COLOR_RGB2GRAY
+constexpr int kGrayShift = 14;
+constexpr int kRedWeight = 4899;
+constexpr int kGreenWeight = 9617;
+constexpr int kBlueWeight = 1868;
+
+void rgbThreshold(const uint8_t * __restrict rgb, uint8_t * __restrict dst, int n, int thresh)
+{
+  for (int i = 0; i < n; i++) {
+    int gray = (rgb[3 * i] * kRedWeight + rgb[3 * i + 1] * kGreenWeight +
+                rgb[3 * i + 2] * kBlueWeight + (1 << (kGrayShift - 1))) >>
+               kGrayShift;
+    dst[i] = gray > thresh ? 255 : 0;
+  }
+}
+
+// May run in place
+void threshold(const uint8_t * src, uint8_t * dst, int n, int thresh)
+{
+  for (int i = 0; i < n; i++) {
+    dst[i] = src[i] > thresh ? 255 : 0;
+  }
+}
+
+void colorVote(
+  const uint8_t * __restrict rgb, const uint8_t * __restrict mask, int n, int64_t * sum_r,
+  int64_t * sum_b)
+{
+  // 32-bit partial sums vectorize better, a row of a light never overflows them
+  uint32_t r = 0, b = 0;
+  for (int i = 0; i < n; i++) {
+    uint32_t m = mask[i] ? 0xff : 0;
+    r += rgb[3 * i] & m;
+    b += rgb[3 * i + 2] & m;
+  }
+  *sum_r += r;
+  *sum_b += b;
+}
+
+int otsu(const uint8_t * gray, int width, int height, size_t step)
+{
+  constexpr int kBins = 256;
+  constexpr double kEpsilon = 1.192092896e-07;  // FLT_EPSILON
+
+  int hist[kBins] = {0};
+  for (int y = 0; y < height; y++) {
+    const uint8_t * row = gray + y * step;
+    for (int x = 0; x < width; x++) {
+      hist[row[x]]++;
+    }
+  }
+
+  // Same steps as OpenCV's getThreshVal_Otsu_8u so that the thresholds agree
+  double scale = 1.0 / (width * height);
+  double mu = 0;
+  for (int i = 0; i < kBins; i++) {
+    mu += i * static_cast<double>(hist[i]);
+  }
+  mu *= scale;
+
+  double mu1 = 0, q1 = 0, max_sigma = 0;
+  int max_val = 0;
+  for (int i = 0; i < kBins; i++) {
+    double p_i = hist[i] * scale;
+    mu1 *= q1;
+    q1 += p_i;
+    double q2 = 1.0 - q1;
+    double q_min = q1 < q2 ? q1 : q2;
+    double q_max = q1 < q2 ? q2 : q1;
+    if (q_min < kEpsilon || q_max > 1.0 - kEpsilon) {
+      continue;
+    }
+    mu1 = (mu1 + i * p_i) / q1;
+    double mu2 = (mu - q1 * mu1) / q2;
+    double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+    if (sigma > max_sigma) {
+      max_sigma = sigma;
+      max_val = i;
+    }
+  }
+  return max_val;
+}
+
+int floorToInt(float x)
+{
+  int i = static_cast<int>(x);
+  return i - (x < i);
+}
+
+void warpPerspectiveGray(
+  const uint8_t * src, int src_width, int src_height, size_t src_step, const double * h,
+  uint8_t * dst, int dst_width, int dst_height, size_t dst_step)
+{
+  auto pixel = [&](int x, int y, int c) -> float {
+    if (x < 0 || y < 0 || x >= src_width || y >= src_height) {
+      return 0;
+    }
+    return src[y * src_step + 3 * x + c];
+  };
+
+  for (int y = 0; y < dst_height; y++) {
+    uint8_t * row = dst + y * dst_step;
+    for (int x = 0; x < dst_width; x++) {
+      double w = h[6] * x + h[7] * y + h[8];
+      w = w != 0 ? 1.0 / w : 0;
+      float fx = static_cast<float>((h[0] * x + h[1] * y + h[2]) * w);
+      float fy = static_cast<float>((h[3] * x + h[4] * y + h[5]) * w);
+      int x0 = floorToInt(fx);
+      int y0 = floorToInt(fy);
+      float ax = fx - x0, ay = fy - y0;
+
+      float value[3];
+      for (int c = 0; c < 3; c++) {
+        float top = pixel(x0, y0, c) * (1 - ax) + pixel(x0 + 1, y0, c) * ax;
+        float bottom = pixel(x0, y0 + 1, c) * (1 - ax) + pixel(x0 + 1, y0 + 1, c) * ax;
+        value[c] = top * (1 - ay) + bottom * ay;
+      }
+      float gray = (value[0] * kRedWeight + value[1] * kGreenWeight + value[2] * kBlueWeight) /
+                   (1 << kGrayShift);
+      row[x] = static_cast<uint8_t>(gray + 0.5f);
+    }
+  }
+}
+
+void add(float * __restrict y, const float * __restrict x, int n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] += x[i];
+  }
+}
+
+void sub(float * __restrict y, const float * __restrict x, int n)
+{
+  for (int i = 0; i < n; i++) {
+    y[i] -= x[i];
+  }
+}
+
+void gemv(
+  const float * __restrict w, const float * __restrict b, const float * __restrict x, int in,
+  int out, float * __restrict y)
+{
+  // Eight independent partial sums let the dot products vectorize without -ffast-math
+  for (int i = 0; i < out; i++) {
+    const float * row = w + i * in;
+    float partial[8] = {0};
+    int j = 0;
+    for (; j + 8 <= in; j += 8) {
+      for (int k = 0; k < 8; k++) {
+        partial[k] += row[j + k] * x[j + k];
+      }
+    }
+    float sum = b[i];
+    for (; j < in; j++) {
+      sum += row[j] * x[j];
+    }
+    for (int k = 0; k < 8; k++) {
+      sum += partial[k];
+    }
+    y[i] = sum;
+  }
+}
+}  // namespace
+
+extern const Kernels kernels;
+const Kernels kernels = {
+  Isa::KERNELS_ISA, rgbThreshold, threshold, colorVote, otsu, warpPerspectiveGray, add, sub, gemv};
+
+}  // namespace KERNELS_NAMESPACE
+}  // namespace rm_auto_aim
@@ -0,0 +1,9 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// NEON kernels, NEON is part of the baseline on aarch64 and enabled with -mfpu=neon on arm
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define KERNELS_NAMESPACE neon
+#define KERNELS_ISA NEON
+#include "kernels_impl.hpp"
+#endif
@@ -0,0 +1,7 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// Baseline kernels, compiled without vectorization
+#define KERNELS_NAMESPACE scalar
+#define KERNELS_ISA SCALAR
+#include "kernels_impl.hpp"
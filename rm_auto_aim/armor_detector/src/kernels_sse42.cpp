@@ -0,0 +1,9 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// SSE4.2 kernels, compiled with -msse4.2 on x86 (see CMakeLists.txt)
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_NAMESPACE sse4_2
+#define KERNELS_ISA SSE4_2
+#include "kernels_impl.hpp"
+#endif
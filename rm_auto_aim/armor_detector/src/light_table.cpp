@@ -0,0 +1,74 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/light_table.hpp"
+
+#include <opencv2/core/types.hpp>
+
+// STL
+#include <cstddef>
+
+namespace rm_auto_aim
+{
+void LightTable::clear()
+{
+  centers.clear();
+  tops.clear();
+  bottoms.clear();
+  lengths.clear();
+  widths.clear();
+  tilt_angles.clear();
+  colors.clear();
+  color_strengths.clear();
+  sizes.clear();
+  angles.clear();
+}
+
+void LightTable::push_back(const Light & light)
+{
+  centers.push_back(light.center);
+  tops.push_back(light.top);
+  bottoms.push_back(light.bottom);
+  lengths.push_back(light.length);
+  widths.push_back(light.width);
+  tilt_angles.push_back(light.tilt_angle);
+  colors.push_back(light.color);
+  color_strengths.push_back(light.color_strength);
+  sizes.push_back(light.size);
+  angles.push_back(light.angle);
+}
+
+Light LightTable::light(size_t i) const
+{
+  Light light;
+  light.center = centers[i];
+  light.size = sizes[i];
+  light.angle = angles[i];
+  light.top = tops[i];
+  light.bottom = bottoms[i];
+  light.length = lengths[i];
+  light.width = widths[i];
+  light.tilt_angle = tilt_angles[i];
+  light.color = colors[i];
+  light.color_strength = color_strengths[i];
+  return light;
+}
+
+void LightTable::shift(const cv::Point2f & offset)
+{
+  for (size_t i = 0; i < size(); i++) {
+    centers[i] += offset;
+    tops[i] += offset;
+    bottoms[i] += offset;
+  }
+}
+
+Armor makeArmor(const LightTable & lights, const ArmorCandidate & candidate)
+{
+  Armor armor(lights.light(candidate.left), lights.light(candidate.right));
+  armor.armor_type = candidate.armor_type;
+  armor.score = candidate.score;
+  return armor;
+}
+
+}  // namespace rm_auto_aim
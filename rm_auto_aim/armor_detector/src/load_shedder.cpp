@@ -0,0 +1,78 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/load_shedder.hpp"
+
+namespace rm_auto_aim
+{
+LoadShedder::LoadShedder(const Params & init_params)
+: params(init_params),
+  level_(NORMAL),
+  latency_ms_(0.0),
+  processing_ms_(0.0),
+  over_budget_count_(0),
+  under_budget_count_(0),
+  frame_count_(0)
+{
+}
+
+bool LoadShedder::acceptFrame()
+{
+  if (level_ < DECIMATE || params.decimation <= 1) {
+    return true;
+  }
+  return frame_count_++ % params.decimation == 0;
+}
+
+bool LoadShedder::update(double frame_age_ms, double processing_ms)
+{
+  const double alpha = params.smoothing;
+  const double latency_ms = frame_age_ms + processing_ms;
+  if (latency_ms_ == 0.0 && processing_ms_ == 0.0) {
+    latency_ms_ = latency_ms;
+    processing_ms_ = processing_ms;
+  } else {
+    latency_ms_ = alpha * latency_ms + (1 - alpha) * latency_ms_;
+    processing_ms_ = alpha * processing_ms + (1 - alpha) * processing_ms_;
+  }
+
+  if (latency_ms_ > params.latency_budget_ms) {
+    under_budget_count_ = 0;
+    if (++over_budget_count_ >= params.escalate_frames && level_ < DECIMATE) {
+      over_budget_count_ = 0;
+      level_ = static_cast<Level>(level_ + 1);
+      frame_count_ = 0;
+      return true;
+    }
+  } else if (latency_ms_ < params.latency_budget_ms * params.recover_ratio) {
+    over_budget_count_ = 0;
+    if (++under_budget_count_ >= params.recover_frames && level_ > NORMAL) {
+      under_budget_count_ = 0;
+      level_ = static_cast<Level>(level_ - 1);
+      return true;
+    }
+  } else {
+    over_budget_count_ = 0;
+    under_budget_count_ = 0;
+  }
+  return false;
+}
+
+const char * LoadShedder::levelName(Level level)
+{
+  switch (level) {
+    case NORMAL:
+      return "NORMAL";
+    case SKIP_DEBUG:
+      return "SKIP_DEBUG";
+    case TOP_K:
+      return "TOP_K";
+    case ROI_ONLY:
+      return "ROI_ONLY";
+    case DECIMATE:
+      return "DECIMATE";
+  }
+  return "UNKNOWN";
+}
+
+}  // namespace rm_auto_aim
@@ -14,31 +14,81 @@
 
 // STL
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <cstdio>
+#include <iterator>
 #include <map>
 #include <string>
 #include <vector>
 #include<fstream>
 
 #include "armor_detector/armor.hpp"
+#include "armor_detector/kernels.hpp"
 #include "armor_detector/number_classifier.hpp"
 
 namespace rm_auto_aim
 {
+// A cached result is reused if its center is within this many light lengths of the armor
+constexpr float kCacheMatchDistance = 0.5;
+// Frames a cached result may be carried over without being classified again
+constexpr int kMaxCacheAge = 3;
+// Weight of the newest sample in classify_cost_ms_
+constexpr double kCostSmoothing = 0.1;
+// Network results at least this confident are learned as templates
+constexpr float kLearnConfidence = 0.95;
+// Samples a template needs before it is used
+constexpr int kMinTemplateSamples = 20;
+// A template match is only accepted if the runner-up is this much less similar
+constexpr float kMinTemplateMargin = 0.03;
+// Number images differing in at most this many bits from the previous frame's reuse its result
+constexpr int kMaxReuseDistance = 8;
+// Side length of the blank frame used by warmUp
+constexpr int kWarmUpImageSize = 64;
+
 NumberClassifier::NumberClassifier(
   const std::string & model_path, const std::string & label_path, const double thre)
-: threshold(thre)
+: threshold(thre),
+  similarity_threshold(0.9),
+  reject_similarity(0.3),
+  template_accepted_count(0),
+  template_rejected_count(0),
+  reused_count(0),
+  cached_count(0),
+  dropped_count(0),
+  classify_cost_ms_(0.0)
 {
-  net_ = cv::dnn::readNetFromONNX(model_path);
-
   std::ifstream label_file(label_path);
   std::string line;
   while (std::getline(label_file, line)) {
     class_names_.push_back(line[0]);
   }
+  logits_.resize(class_names_.size());
+
+  // The native MLP runs on the packed number directly, other models go through cv::dnn
+  use_mlp_ = mlp_.load(model_path) && mlp_.classes() == static_cast<int>(class_names_.size());
+  if (!use_mlp_) {
+    net_ = cv::dnn::readNetFromONNX(model_path);
+  }
+
+  // 'N' (not a number) has no consistent pattern to learn
+  std::vector<char> template_labels;
+  std::copy_if(
+    class_names_.begin(), class_names_.end(), std::back_inserter(template_labels),
+    [](char label) { return label != 'N'; });
+  templates_ = std::make_unique<NumberTemplates>(template_labels, kMinTemplateSamples);
+}
+
+bool NumberClassifier::loadTemplates(const std::string & path) { return templates_->load(path); }
+
+bool NumberClassifier::saveTemplates(const std::string & path) const
+{
+  return templates_->save(path);
 }
 
-void NumberClassifier::extractNumbers(const cv::Mat & src, std::vector<Armor> & armors)
+void NumberClassifier::extractNumbers(
+  const cv::Mat & src, std::vector<Armor> & armors, const FrameDeadline * deadline)
 {
   // Light length in image
   const int light_length = 12;
@@ -49,7 +99,24 @@ void NumberClassifier::extractNumbers(const cv::Mat & src, std::vector<Armor> &
   // Number ROI size
   const cv::Size roi_size(20, 28);
 
-  for (auto & armor : armors) {
+  const auto & k = kernels();
+
+  // The number images of the frame are stacked in one buffer, each armor's number_img is a view
+  // of its rows, so the images share one allocation. The transform and the network input below
+  // still allocate for every armor.
+  cv::Mat number_images;
+  if (!armors.empty()) {
+    number_images.create(
+      roi_size.height * static_cast<int>(armors.size()), roi_size.width, CV_8UC1);
+  }
+
+  for (size_t i = 0; i < armors.size(); i++) {
+    auto & armor = armors[i];
+    if (deadline != nullptr && deadline->expired()) {
+      armor.number_img = cv::Mat();
+      continue;
+    }
+
     // Warp perspective transform
     cv::Point2f lights_vertices[4] = {
       armor.left_light.bottom, armor.left_light.top, armor.right_light.top,
@@ -64,58 +131,104 @@ void NumberClassifier::extractNumbers(const cv::Mat & src, std::vector<Armor> &
       cv::Point(warp_width - 1, top_light_y),
       cv::Point(warp_width - 1, bottom_light_y),
     };
-    cv::Mat number_image;
-    auto rotation_matrix = cv::getPerspectiveTransform(lights_vertices, target_vertices);
-    cv::warpPerspective(src, number_image, rotation_matrix, cv::Size(warp_width, warp_height));
+    // Map from the warped image back to src, shifted to the ROI in the middle
+    cv::Mat h = cv::getPerspectiveTransform(target_vertices, lights_vertices);
+    double roi_x = (warp_width - roi_size.width) / 2;
+    h = h * (cv::Mat_<double>(3, 3) << 1, 0, roi_x, 0, 1, 0, 0, 0, 1);
 
-    // Get ROI
-    number_image =
-      number_image(cv::Rect(cv::Point((warp_width - roi_size.width) / 2, 0), roi_size));
+    // Only sample the ROI, directly in gray
+    int first_row = roi_size.height * static_cast<int>(i);
+    cv::Mat number_image = number_images.rowRange(first_row, first_row + roi_size.height);
+    k.warpPerspectiveGray(
+      src.ptr<uint8_t>(), src.cols, src.rows, src.step, h.ptr<double>(),
+      number_image.ptr<uint8_t>(), roi_size.width, roi_size.height, number_image.step);
 
     // Binarize
-    cv::cvtColor(number_image, number_image, cv::COLOR_RGB2GRAY);
-    cv::threshold(number_image, number_image, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+    int thresh =
+      k.otsu(number_image.ptr<uint8_t>(), roi_size.width, roi_size.height, number_image.step);
+    for (int row = 0; row < roi_size.height; row++) {
+      auto pixels = number_image.ptr<uint8_t>(row);
+      k.threshold(pixels, pixels, roi_size.width, thresh);
+    }
 
     armor.number_img = number_image;
+
+    // Pack the network input, scaled to 0/1 and resized the same way cv::dnn::blobFromImage
+    // does, so that the packed bits are exactly what the network sees
+    cv::Mat input = number_image / 255;
+    cv::resize(input, input, cv::Size(kNumberCols, kNumberRows));
+    armor.number_bits = packNumber(input.ptr<uint8_t>(), input.step);
   }
 }
 
-void NumberClassifier::doClassify(std::vector<Armor> & armors)
+void NumberClassifier::doClassify(std::vector<Armor> & armors, const FrameDeadline * deadline)
 {
+  template_accepted_count = 0;
+  template_rejected_count = 0;
+  reused_count = 0;
+  cached_count = 0;
+  dropped_count = 0;
+  next_cache_.clear();
+
   for (auto & armor : armors) {
-    cv::Mat image = armor.number_img.clone();
+    armor.similarity = 0;
 
-    // Normalize
-    image = image / 255.0;
+    // Fall back to the previous frame when classifying would overrun the deadline
+    if (
+      armor.number_img.empty() ||
+      (deadline != nullptr && deadline->remainingMs() < classify_cost_ms_)) {
+      if (classifyFromCache(armor, false)) {
+        cached_count++;
+      } else {
+        armor.number = 'N';
+        armor.confidence = 0;
+        armor.classfication_result.clear();
+        dropped_count++;
+      }
+      continue;
+    }
 
-    // Create blob from image
-    cv::Mat blob;
-    cv::dnn::blobFromImage(image, blob, 1., cv::Size(28, 20));
+    // The same number at the same place as in the previous frame keeps its result
+    if (classifyFromCache(armor, true)) {
+      reused_count++;
+      continue;
+    }
 
-    // Set the input blob for the neural network
-    net_.setInput(blob);
-    // Forward pass the image blob through the model
-    cv::Mat outputs = net_.forward();
+    // Cheap template pre-classifier, only ambiguous numbers go on to the network
+    if (classifyByTemplates(armor)) {
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    runNetwork(armor);
 
     // Do softmax
-    float max_prob = *std::max_element(outputs.begin<float>(), outputs.end<float>());
-    cv::Mat softmax_prob;
-    cv::exp(outputs - max_prob, softmax_prob);
-    float sum = static_cast<float>(cv::sum(softmax_prob)[0]);
-    softmax_prob /= sum;
-
-    double confidence;
-    cv::Point class_id_point;
-    minMaxLoc(softmax_prob.reshape(1, 1), nullptr, &confidence, nullptr, &class_id_point);
-    int label_id = class_id_point.x;
-
-    armor.confidence = confidence;
+    float max_logit = *std::max_element(logits_.begin(), logits_.end());
+    float sum = 0;
+    for (auto & logit : logits_) {
+      logit = std::exp(logit - max_logit);
+      sum += logit;
+    }
+    int label_id = std::max_element(logits_.begin(), logits_.end()) - logits_.begin();
+
+    armor.confidence = logits_[label_id] / sum;
     armor.number = class_names_[label_id];
 
-    std::stringstream result_ss;
-    result_ss << armor.number << ":_" << std::fixed << std::setprecision(1)
-              << armor.confidence * 100.0 << "%";
-    armor.classfication_result = result_ss.str();
+    char result[16];
+    std::snprintf(result, sizeof(result), "%c:_%.1f%%", armor.number, armor.confidence * 100.0);
+    armor.classfication_result = result;
+
+    if (armor.confidence >= kLearnConfidence && armor.number != 'N') {
+      templates_->learn(armor.number, armor.number_bits);
+    }
+
+    next_cache_.push_back(
+      {armor.center, armor.armor_type, armor.number, armor.confidence, 0, armor.number_bits});
+
+    std::chrono::duration<double, std::milli> cost = std::chrono::steady_clock::now() - start;
+    classify_cost_ms_ = classify_cost_ms_ == 0.0 ? cost.count()
+                                                 : kCostSmoothing * cost.count() +
+                                                     (1 - kCostSmoothing) * classify_cost_ms_;
   }
 
   armors.erase(
@@ -136,6 +249,127 @@ void NumberClassifier::doClassify(std::vector<Armor> & armors)
         return mismatch;
       }),
     armors.end());
+
+  updateCache(armors);
+}
+
+void NumberClassifier::warmUp()
+{
+  // A small armor in the middle of a blank frame
+  cv::Mat src(kWarmUpImageSize, kWarmUpImageSize, CV_8UC3, cv::Scalar::all(0));
+  float center = kWarmUpImageSize / 2.0f;
+  Light left(cv::RotatedRect(cv::Point2f(center / 2, center), cv::Size2f(4, 12), 0));
+  Light right(cv::RotatedRect(cv::Point2f(center * 3 / 2, center), cv::Size2f(4, 12), 0));
+  std::vector<Armor> armors = {Armor(left, right)};
+  armors[0].armor_type = SMALL;
+
+  extractNumbers(src, armors);
+  runNetwork(armors[0]);
+}
+
+void NumberClassifier::runNetwork(const Armor & armor)
+{
+  if (use_mlp_) {
+    mlp_.forward(armor.number_bits, logits_.data());
+    return;
+  }
+
+  cv::Mat image = armor.number_img.clone();
+
+  // Normalize
+  image = image / 255.0;
+
+  // Create blob from image
+  cv::Mat blob;
+  cv::dnn::blobFromImage(image, blob, 1., cv::Size(28, 20));
+
+  // Set the input blob for the neural network
+  net_.setInput(blob);
+  // Forward pass the image blob through the model
+  cv::Mat outputs = net_.forward();
+  std::copy(outputs.begin<float>(), outputs.end<float>(), logits_.begin());
+}
+
+bool NumberClassifier::classifyByTemplates(Armor & armor)
+{
+  char label;
+  float best, second;
+  if (!templates_->match(armor.number_bits, label, best, second)) {
+    return false;
+  }
+  armor.similarity = best;
+
+  if (best >= similarity_threshold && best - second >= kMinTemplateMargin) {
+    armor.number = label;
+    armor.confidence = best;
+    template_accepted_count++;
+  } else if (templates_->complete() && best < reject_similarity) {
+    // Nothing like any number
+    armor.number = 'N';
+    armor.confidence = 0;
+    template_rejected_count++;
+  } else {
+    return false;
+  }
+
+  char result[16];
+  std::snprintf(result, sizeof(result), "%c:_%.1f%%", armor.number, armor.confidence * 100.0);
+  armor.classfication_result = result;
+  next_cache_.push_back(
+    {armor.center, armor.armor_type, armor.number, armor.confidence, 0, armor.number_bits});
+  return true;
+}
+
+bool NumberClassifier::classifyFromCache(Armor & armor, bool same_number)
+{
+  const CachedResult * match = nullptr;
+  float min_distance =
+    kCacheMatchDistance * (armor.left_light.length + armor.right_light.length) / 2;
+  for (const auto & result : cache_) {
+    float distance = cv::norm(armor.center - result.center);
+    if (
+      result.armor_type == armor.armor_type && result.age < kMaxCacheAge &&
+      distance < min_distance &&
+      (!same_number ||
+       hammingDistance(result.number_bits, armor.number_bits) <= kMaxReuseDistance)) {
+      min_distance = distance;
+      match = &result;
+    }
+  }
+  if (match == nullptr) {
+    return false;
+  }
+
+  armor.number = match->number;
+  armor.confidence = match->confidence;
+  // A matching number image is as good as classifying again, only blind reuse ages the result
+  int age = same_number ? match->age : match->age + 1;
+  next_cache_.push_back(
+    {armor.center, armor.armor_type, armor.number, armor.confidence, age,
+     same_number ? armor.number_bits : match->number_bits});
+
+  char result[32];
+  std::snprintf(
+    result, sizeof(result), same_number ? "%c:_%.1f%%" : "%c:_%.1f%%(cached)", armor.number,
+    armor.confidence * 100.0);
+  armor.classfication_result = result;
+  return true;
+}
+
+void NumberClassifier::updateCache(const std::vector<Armor> & armors)
+{
+  // Keep the results of the armors that passed the filter
+  next_cache_.erase(
+    std::remove_if(
+      next_cache_.begin(), next_cache_.end(),
+      [&armors](const CachedResult & result) {
+        return std::none_of(armors.begin(), armors.end(), [&result](const Armor & armor) {
+          return armor.center == result.center;
+        });
+      }),
+    next_cache_.end());
+  std::swap(cache_, next_cache_);
+  next_cache_.clear();
 }
 
 }  // namespace rm_auto_aim
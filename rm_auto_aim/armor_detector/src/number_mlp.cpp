@@ -0,0 +1,120 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/number_mlp.hpp"
+
+// STD
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "armor_detector/kernels.hpp"
+#include "armor_detector/onnx_reader.hpp"
+
+namespace rm_auto_aim
+{
+namespace
+{
+// Weight [out, in] and bias [out] of a fully connected layer, false if missing or mismatched
+bool getLayer(
+  std::map<std::string, OnnxTensor> & tensors, const std::string & name, int in, int & out,
+  std::vector<float> & weight, std::vector<float> & bias)
+{
+  auto w = tensors.find(name + ".weight");
+  auto b = tensors.find(name + ".bias");
+  if (w == tensors.end() || b == tensors.end() || w->second.dims.size() != 2) {
+    return false;
+  }
+  out = static_cast<int>(w->second.dims[0]);
+  if (
+    w->second.dims[1] != in || w->second.data.size() != static_cast<size_t>(out) * in ||
+    b->second.data.size() != static_cast<size_t>(out)) {
+    return false;
+  }
+  weight = std::move(w->second.data);
+  bias = std::move(b->second.data);
+  return true;
+}
+
+void relu(float * x, int n)
+{
+  for (int i = 0; i < n; i++) {
+    x[i] = std::max(x[i], 0.0f);
+  }
+}
+}  // namespace
+
+bool NumberMlp::load(const std::string & model_path)
+{
+  classes_ = 0;
+  std::map<std::string, OnnxTensor> tensors;
+  try {
+    tensors = readOnnxInitializers(model_path);
+  } catch (const std::runtime_error &) {
+    // Unreadable or not protobuf, the caller falls back to the OpenCV network
+    return false;
+  }
+
+  std::vector<float> w1;
+  int hidden1, hidden2, classes;
+  if (
+    !getLayer(tensors, "classifier.f1", kNumberBits, hidden1, w1, b1_) ||
+    !getLayer(tensors, "classifier.f2", hidden1, hidden2, w2_, b2_) ||
+    !getLayer(tensors, "classifier.output", hidden2, classes, w3_, b3_)) {
+    return false;
+  }
+
+  // Transpose so that the weights of one input are contiguous
+  w1_by_input_.resize(w1.size());
+  b1_all_set_ = b1_;
+  for (int i = 0; i < hidden1; i++) {
+    for (int j = 0; j < kNumberBits; j++) {
+      float weight = w1[i * kNumberBits + j];
+      w1_by_input_[j * hidden1 + i] = weight;
+      b1_all_set_[i] += weight;
+    }
+  }
+
+  hidden1_ = hidden1;
+  hidden2_ = hidden2;
+  classes_ = classes;
+  h1_.resize(hidden1_);
+  h2_.resize(hidden2_);
+  return true;
+}
+
+void NumberMlp::forward(const PackedNumber & input, float * logits)
+{
+  const auto & k = kernels();
+
+  // Walk whichever of the set or cleared bits are fewer
+  bool dense = 2 * countBits(input) > kNumberBits;
+  const auto & init = dense ? b1_all_set_ : b1_;
+  auto accumulate = dense ? k.sub : k.add;
+  std::copy(init.begin(), init.end(), h1_.begin());
+
+  float * h1 = h1_.data();
+  for (size_t w = 0; w < input.size(); w++) {
+    uint64_t word = dense ? ~input[w] : input[w];
+    // Padding bits of the last word
+    int valid = std::min(64, kNumberBits - static_cast<int>(w) * 64);
+    if (valid < 64) {
+      word &= (uint64_t{1} << valid) - 1;
+    }
+    while (word) {
+      int bit = static_cast<int>(w) * 64 + __builtin_ctzll(word);
+      word &= word - 1;
+      accumulate(h1, &w1_by_input_[bit * hidden1_], hidden1_);
+    }
+  }
+  relu(h1, hidden1_);
+
+  k.gemv(w2_.data(), b2_.data(), h1, hidden1_, hidden2_, h2_.data());
+  relu(h2_.data(), hidden2_);
+
+  k.gemv(w3_.data(), b3_.data(), h2_.data(), hidden2_, classes_, logits);
+}
+
+}  // namespace rm_auto_aim
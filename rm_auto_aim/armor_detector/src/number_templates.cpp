@@ -0,0 +1,153 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/number_templates.hpp"
+
+// STD
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rm_auto_aim
+{
+// Samples a template keeps learning from, enough for a stable majority
+constexpr int kMaxTemplateSamples = 1000;
+
+NumberTemplates::NumberTemplates(const std::vector<char> & labels, int min_samples)
+: min_samples_(min_samples)
+{
+  templates_.resize(labels.size());
+  for (size_t i = 0; i < labels.size(); i++) {
+    templates_[i].label = labels[i];
+    templates_[i].samples = 0;
+    templates_[i].counts.fill(0);
+    templates_[i].bits.fill(0);
+  }
+}
+
+NumberTemplates::Template * NumberTemplates::find(char label)
+{
+  auto it = std::find_if(
+    templates_.begin(), templates_.end(), [label](const Template & t) { return t.label == label; });
+  return it == templates_.end() ? nullptr : &*it;
+}
+
+void NumberTemplates::learn(char label, const PackedNumber & number)
+{
+  auto t = find(label);
+  if (t == nullptr || t->samples >= kMaxTemplateSamples) {
+    return;
+  }
+
+  t->samples++;
+  t->bits.fill(0);
+  for (int bit = 0; bit < kNumberBits; bit++) {
+    if (testBit(number, bit)) {
+      t->counts[bit]++;
+    }
+    if (2 * t->counts[bit] > static_cast<uint32_t>(t->samples)) {
+      t->bits[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+  }
+}
+
+bool NumberTemplates::complete() const
+{
+  return std::all_of(templates_.begin(), templates_.end(), [this](const Template & t) {
+    return t.samples >= min_samples_;
+  });
+}
+
+bool NumberTemplates::match(
+  const PackedNumber & number, char & label, float & best, float & second) const
+{
+  bool found = false;
+  best = second = 0;
+  for (const auto & t : templates_) {
+    if (t.samples < min_samples_) {
+      continue;
+    }
+    float similarity = overlapSimilarity(number, t.bits);
+    if (!found || similarity > best) {
+      second = best;
+      best = similarity;
+      label = t.label;
+      found = true;
+    } else if (similarity > second) {
+      second = similarity;
+    }
+  }
+  return found;
+}
+
+bool NumberTemplates::load(const std::string & path)
+{
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+
+  // Templates of another number image size would match garbage
+  int rows, cols;
+  std::string line;
+  if (
+    !std::getline(file, line) || !(std::istringstream(line) >> rows >> cols) ||
+    rows != kNumberRows || cols != kNumberCols) {
+    return false;
+  }
+
+  while (std::getline(file, line)) {
+    std::istringstream ss(line);
+    char label;
+    int samples;
+    PackedNumber bits;
+    if (!(ss >> label >> samples)) {
+      continue;
+    }
+    bool ok = true;
+    for (auto & word : bits) {
+      ok = ok && static_cast<bool>(ss >> std::hex >> word);
+    }
+    auto t = find(label);
+    if (!ok || t == nullptr || samples <= 0) {
+      continue;
+    }
+
+    // Resume learning as if all samples had been equal to the template
+    t->samples = std::min(samples, kMaxTemplateSamples);
+    t->bits = bits;
+    for (int bit = 0; bit < kNumberBits; bit++) {
+      t->counts[bit] = testBit(bits, bit) ? t->samples : 0;
+    }
+  }
+  return true;
+}
+
+bool NumberTemplates::save(const std::string & path) const
+{
+  std::ofstream file(path);
+  if (!file) {
+    return false;
+  }
+
+  file << kNumberRows << ' ' << kNumberCols << '\n';
+  char word[20];
+  for (const auto & t : templates_) {
+    if (t.samples < min_samples_) {
+      continue;
+    }
+    file << t.label << ' ' << t.samples;
+    for (auto bits : t.bits) {
+      std::snprintf(word, sizeof(word), " %016" PRIx64, bits);
+      file << word;
+    }
+    file << '\n';
+  }
+  return static_cast<bool>(file);
+}
+
+}  // namespace rm_auto_aim
@@ -0,0 +1,192 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/onnx_reader.hpp"
+
+// STD
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace rm_auto_aim
+{
+namespace
+{
+// Field numbers of the ONNX messages, see onnx.proto
+constexpr uint32_t kModelGraph = 7;
+constexpr uint32_t kGraphInitializer = 5;
+constexpr uint32_t kTensorDims = 1;
+constexpr uint32_t kTensorDataType = 2;
+constexpr uint32_t kTensorFloatData = 4;
+constexpr uint32_t kTensorName = 8;
+constexpr uint32_t kTensorRawData = 9;
+constexpr uint64_t kTensorFloat = 1;
+
+enum WireType { VARINT = 0, FIXED64 = 1, LENGTH_DELIMITED = 2, FIXED32 = 5 };
+
+// Reader of one protobuf message
+class WireReader
+{
+public:
+  WireReader(const char * begin, const char * end) : pos_(begin), end_(end) {}
+
+  bool done() const { return pos_ >= end_; }
+
+  uint64_t varint()
+  {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      check(1);
+      uint8_t byte = *pos_++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    throw std::runtime_error("Malformed varint");
+  }
+
+  void key(uint32_t & field, int & wire_type)
+  {
+    uint64_t k = varint();
+    field = static_cast<uint32_t>(k >> 3);
+    wire_type = static_cast<int>(k & 7);
+  }
+
+  WireReader message()
+  {
+    uint64_t size = varint();
+    check(size);
+    WireReader sub(pos_, pos_ + size);
+    pos_ += size;
+    return sub;
+  }
+
+  float fixed32()
+  {
+    check(4);
+    float value;
+    std::memcpy(&value, pos_, 4);
+    pos_ += 4;
+    return value;
+  }
+
+  void skip(int wire_type)
+  {
+    switch (wire_type) {
+      case VARINT:
+        varint();
+        break;
+      case FIXED64:
+        check(8);
+        pos_ += 8;
+        break;
+      case LENGTH_DELIMITED:
+        message();
+        break;
+      case FIXED32:
+        check(4);
+        pos_ += 4;
+        break;
+      default:
+        throw std::runtime_error("Unsupported wire type " + std::to_string(wire_type));
+    }
+  }
+
+  const char * pos() const { return pos_; }
+  size_t size() const { return end_ - pos_; }
+
+private:
+  void check(uint64_t n) const
+  {
+    if (n > static_cast<uint64_t>(end_ - pos_)) {
+      throw std::runtime_error("Truncated message");
+    }
+  }
+
+  const char * pos_;
+  const char * end_;
+};
+
+void readTensor(WireReader reader, std::map<std::string, OnnxTensor> & tensors)
+{
+  OnnxTensor tensor;
+  std::string name;
+  uint64_t data_type = 0;
+  while (!reader.done()) {
+    uint32_t field;
+    int wire_type;
+    reader.key(field, wire_type);
+    if (field == kTensorDims && wire_type == VARINT) {
+      tensor.dims.push_back(static_cast<int64_t>(reader.varint()));
+    } else if (field == kTensorDims && wire_type == LENGTH_DELIMITED) {
+      auto packed = reader.message();
+      while (!packed.done()) {
+        tensor.dims.push_back(static_cast<int64_t>(packed.varint()));
+      }
+    } else if (field == kTensorDataType && wire_type == VARINT) {
+      data_type = reader.varint();
+    } else if (field == kTensorFloatData && wire_type == FIXED32) {
+      tensor.data.push_back(reader.fixed32());
+    } else if (field == kTensorFloatData && wire_type == LENGTH_DELIMITED) {
+      auto packed = reader.message();
+      while (!packed.done()) {
+        tensor.data.push_back(packed.fixed32());
+      }
+    } else if (field == kTensorName && wire_type == LENGTH_DELIMITED) {
+      auto str = reader.message();
+      name.assign(str.pos(), str.size());
+    } else if (field == kTensorRawData && wire_type == LENGTH_DELIMITED) {
+      // Little-endian floats
+      auto raw = reader.message();
+      tensor.data.resize(raw.size() / sizeof(float));
+      std::memcpy(tensor.data.data(), raw.pos(), tensor.data.size() * sizeof(float));
+    } else {
+      reader.skip(wire_type);
+    }
+  }
+
+  if (data_type == kTensorFloat && !name.empty()) {
+    tensors[name] = std::move(tensor);
+  }
+}
+}  // namespace
+
+std::map<std::string, OnnxTensor> readOnnxInitializers(const std::string & path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  std::vector<char> buffer(
+    (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  std::map<std::string, OnnxTensor> tensors;
+  WireReader model(buffer.data(), buffer.data() + buffer.size());
+  while (!model.done()) {
+    uint32_t field;
+    int wire_type;
+    model.key(field, wire_type);
+    if (field != kModelGraph || wire_type != LENGTH_DELIMITED) {
+      model.skip(wire_type);
+      continue;
+    }
+
+    auto graph = model.message();
+    while (!graph.done()) {
+      graph.key(field, wire_type);
+      if (field == kGraphInitializer && wire_type == LENGTH_DELIMITED) {
+        readTensor(graph.message(), tensors);
+      } else {
+        graph.skip(wire_type);
+      }
+    }
+  }
+  return tensors;
+}
+
+}  // namespace rm_auto_aim
@@ -0,0 +1,23 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "armor_detector/packed_number.hpp"
+
+namespace rm_auto_aim
+{
+PackedNumber packNumber(const uint8_t * data, size_t step)
+{
+  PackedNumber packed{};
+  int bit = 0;
+  for (int i = 0; i < kNumberRows; i++) {
+    const uint8_t * row = data + i * step;
+    for (int j = 0; j < kNumberCols; j++, bit++) {
+      if (row[j]) {
+        packed[bit / 64] |= uint64_t{1} << (bit % 64);
+      }
+    }
+  }
+  return packed;
+}
+
+}  // namespace rm_auto_aim
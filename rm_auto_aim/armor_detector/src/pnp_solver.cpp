@@ -29,7 +29,7 @@ PnPSolver::PnPSolver(
   large_armor_points_.emplace_back(cv::Point3f(large_half_x, large_half_y, 0));
 }
 
-bool PnPSolver::solvePnP(const Armor & armor, geometry_msgs::msg::Point & point)
+bool PnPSolver::solvePnP(const Armor & armor, cv::Point3d & position)
 {
   std::vector<cv::Point2f> image_armor_points;
 
@@ -41,16 +41,17 @@ bool PnPSolver::solvePnP(const Armor & armor, geometry_msgs::msg::Point & point)
 
   // Solve pnp
   cv::Mat rvec, tvec;
-  auto object_points = armor.armor_type == SMALL ? small_armor_points_ : large_armor_points_;
+  const auto & object_points =
+    armor.armor_type == SMALL ? small_armor_points_ : large_armor_points_;
   bool success = cv::solvePnP(
     object_points, image_armor_points, camera_matrix_, dist_coeffs_, rvec, tvec, false,
     cv::SOLVEPNP_IPPE);
 
   if (success) {
-    // Convert to geometry_msgs::msg::Point
-    point.x = tvec.at<double>(0) * 0.001;
-    point.y = tvec.at<double>(1) * 0.001;
-    point.z = tvec.at<double>(2) * 0.001;
+    // Convert to meters
+    position.x = tvec.at<double>(0) * 0.001;
+    position.y = tvec.at<double>(1) * 0.001;
+    position.z = tvec.at<double>(2) * 0.001;
     return true;
   } else {
     return false;
@@ -9,6 +9,9 @@
 #include <vector>
 
 #include "armor_detector/detector_node.hpp"
+#include "armor_detector/msg_conversions.hpp"
+#include "auto_aim_utils/async_logger.hpp"
+#include "auto_aim_utils/tracing.hpp"
 
 using std::placeholders::_1;
 
@@ -20,15 +23,14 @@ RgbDetectorNode::RgbDetectorNode(const rclcpp::NodeOptions & options)
   cam_info_sub_ = this->create_subscription<sensor_msgs::msg::CameraInfo>(
     "/camera_info", rclcpp::SensorDataQoS(),
     [this](sensor_msgs::msg::CameraInfo::ConstSharedPtr camera_info) {
-      cam_center_ = cv::Point2f(camera_info->k[2], camera_info->k[5]);
-      cam_info_ = std::make_shared<sensor_msgs::msg::CameraInfo>(*camera_info);
-      pnp_solver_ = std::make_unique<PnPSolver>(camera_info->k, camera_info->d);
+      std::atomic_store(&cam_info_, camera_info);
+      std::atomic_store(&pnp_solver_, std::make_shared<PnPSolver>(camera_info->k, camera_info->d));
       cam_info_sub_.reset();
     });
 
   img_sub_ = std::make_shared<image_transport::Subscriber>(image_transport::create_subscription(
     this, "/image_raw", std::bind(&RgbDetectorNode::imageCallback, this, _1), transport_,
-    rmw_qos_profile_sensor_data));
+    rmw_qos_profile_sensor_data, hotPathOptions()));
 
   active_ = this->declare_parameter("active", true);
   active_param_sub_ = std::make_shared<rclcpp::ParameterEventHandler>(this);
@@ -40,53 +42,61 @@ RgbDetectorNode::RgbDetectorNode(const rclcpp::NodeOptions & options)
           img_sub_ =
             std::make_shared<image_transport::Subscriber>(image_transport::create_subscription(
               this, "/image_raw", std::bind(&RgbDetectorNode::imageCallback, this, _1), transport_,
-              rmw_qos_profile_sensor_data));
+              rmw_qos_profile_sensor_data, hotPathOptions()));
         }
       } else if (img_sub_ != nullptr) {
         img_sub_.reset();
       }
     });
+
+  startHotPathThread();
 }
 
+RgbDetectorNode::~RgbDetectorNode() { hot_path_thread_.reset(); }
+
 void RgbDetectorNode::imageCallback(const sensor_msgs::msg::Image::ConstSharedPtr & img_msg)
 {
+  if (!acceptFrame()) {
+    return;
+  }
+
   auto armors = detectArmors(img_msg);
 
-  if (pnp_solver_ != nullptr) {
-    armors_msg_.header = position_marker_.header = text_marker_.header = img_msg->header;
+  auto pnp_solver = std::atomic_load(&pnp_solver_);
+  if (pnp_solver != nullptr) {
+    armors_msg_.header = marker_back_.header = img_msg->header;
     armors_msg_.armors.clear();
-    marker_array_.markers.clear();
-    position_marker_.points.clear();
-    text_marker_.id = 0;
+    bool fill_markers = marker_subscribed_;
 
     auto_aim_interfaces::msg::Armor armor_msg;
     for (const auto & armor : armors) {
       // Fill the armor msg
-      geometry_msgs::msg::Point position;
-      bool success = pnp_solver_->solvePnP(armor, position);
+      cv::Point3d position;
+      AUTO_AIM_TRACE_BEGIN(img_msg->header.stamp, "pnp");
+      bool success = pnp_solver->solvePnP(armor, position);
+      AUTO_AIM_TRACE_END(img_msg->header.stamp, "pnp");
       if (success) {
         armor_msg.number = armor.number;
-        armor_msg.position = position;
-        armor_msg.distance_to_image_center = pnp_solver_->calculateDistanceToCenter(armor.center);
+        armor_msg.position = toMsg(position);
+        armor_msg.distance_to_image_center = pnp_solver->calculateDistanceToCenter(armor.center);
 
         armors_msg_.armors.emplace_back(armor_msg);
-        position_marker_.points.emplace_back(armor_msg.position);
 
-        text_marker_.id++;
-        text_marker_.pose.position = armor_msg.position;
-        text_marker_.pose.position.y -= 0.1;
-        text_marker_.text = armor.classfication_result;
-        marker_array_.markers.emplace_back(text_marker_);
+        if (fill_markers) {
+          marker_back_.armors.push_back({armor_msg.position, armor.number, armor.confidence});
+        }
       } else {
-        RCLCPP_WARN(this->get_logger(), "PnP failed!");
+        AUTO_AIM_LOG_WARN(this->get_logger(), "PnP failed!");
       }
     }
 
     // Publishing detected armors
-    armors_pub_->publish(armors_msg_);
+    publishArmors();
 
-    // Publishing marker
-    publishMarkers();
+    // Hand over to the marker timer
+    if (fill_markers) {
+      commitMarkers();
+    }
   }
 }
 
@@ -9,6 +9,8 @@
 #include <vector>
 
 #include "armor_detector/detector_node.hpp"
+#include "armor_detector/msg_conversions.hpp"
+#include "auto_aim_utils/tracing.hpp"
 
 using std::placeholders::_1;
 using std::placeholders::_2;
@@ -21,81 +23,94 @@ RgbDepthDetectorNode::RgbDepthDetectorNode(const rclcpp::NodeOptions & options)
   cam_info_sub_ = this->create_subscription<sensor_msgs::msg::CameraInfo>(
     "/aligned_depth_to_color/camera_info", 10,
     [this](sensor_msgs::msg::CameraInfo::ConstSharedPtr camera_info) {
-      cam_center_ = cv::Point2f(camera_info->k[2], camera_info->k[5]);
-      cam_info_ = std::make_shared<sensor_msgs::msg::CameraInfo>(*camera_info);
-      depth_processor_ = std::make_unique<DepthProcessor>(camera_info->k);
+      std::atomic_store(&cam_info_, camera_info);
+      std::atomic_store(&depth_processor_, std::make_shared<DepthProcessor>(camera_info->k));
       cam_info_sub_.reset();
     });
 
   // Synchronize color and depth image
-  color_img_sub_filter_.subscribe(
-    this, "/color/image_raw", transport_, rmw_qos_profile_sensor_data);
-  // Use "raw" because https://github.com/ros-perception/image_common/issues/222
-  depth_img_sub_filter_.subscribe(
-    this, "/aligned_depth_to_color/image_raw", "raw", rmw_qos_profile_sensor_data);
+  subscribeImages();
   sync_ =
     std::make_unique<ColorDepthSync>(SyncPolicy(10), color_img_sub_filter_, depth_img_sub_filter_);
   sync_->registerCallback(std::bind(&RgbDepthDetectorNode::colorDepthCallback, this, _1, _2));
 
+  // Only the image subscriptions are switched, sync_ may be running on the hot path thread
   active_ = this->declare_parameter("active", true);
   active_param_sub_ = std::make_shared<rclcpp::ParameterEventHandler>(this);
   active_cb_handle_ =
     active_param_sub_->add_parameter_callback("active", [this](const rclcpp::Parameter & p) {
+      if (p.as_bool() == active_) {
+        return;
+      }
       active_ = p.as_bool();
       if (active_) {
-        if (sync_ == nullptr) {
-          sync_ = std::make_unique<ColorDepthSync>(
-            SyncPolicy(10), color_img_sub_filter_, depth_img_sub_filter_);
-          sync_->registerCallback(
-            std::bind(&RgbDepthDetectorNode::colorDepthCallback, this, _1, _2));
-        }
-      } else if (sync_ != nullptr) {
-        sync_.reset();
+        subscribeImages();
+      } else {
+        color_img_sub_filter_.unsubscribe();
+        depth_img_sub_filter_.unsubscribe();
       }
     });
+
+  startHotPathThread();
+}
+
+RgbDepthDetectorNode::~RgbDepthDetectorNode() { hot_path_thread_.reset(); }
+
+void RgbDepthDetectorNode::subscribeImages()
+{
+  color_img_sub_filter_.subscribe(
+    this, "/color/image_raw", transport_, rmw_qos_profile_sensor_data, hotPathOptions());
+  // Use "raw" because https://github.com/ros-perception/image_common/issues/222
+  depth_img_sub_filter_.subscribe(
+    this, "/aligned_depth_to_color/image_raw", "raw", rmw_qos_profile_sensor_data,
+    hotPathOptions());
 }
 
 void RgbDepthDetectorNode::colorDepthCallback(
   const sensor_msgs::msg::Image::ConstSharedPtr & color_msg,
   const sensor_msgs::msg::Image::ConstSharedPtr & depth_msg)
 {
+  if (!acceptFrame()) {
+    return;
+  }
+
   auto armors = detectArmors(color_msg);
 
-  if (depth_processor_ != nullptr) {
+  auto depth_processor = std::atomic_load(&depth_processor_);
+  if (depth_processor != nullptr) {
     auto depth_img = cv_bridge::toCvShare(depth_msg, "16UC1")->image;
 
-    armors_msg_.header = position_marker_.header = text_marker_.header = depth_msg->header;
+    armors_msg_.header = marker_back_.header = depth_msg->header;
     armors_msg_.armors.clear();
-    marker_array_.markers.clear();
-    position_marker_.points.clear();
-    text_marker_.id = 0;
+    bool fill_markers = marker_subscribed_;
 
     auto_aim_interfaces::msg::Armor armor_msg;
     for (const auto & armor : armors) {
       // Fill the armor msg
       armor_msg.number = armor.number;
-      armor_msg.position = depth_processor_->getPosition(depth_img, armor.center);
+      AUTO_AIM_TRACE_BEGIN(color_msg->header.stamp, "depth_position");
+      armor_msg.position = toMsg(depth_processor->getPosition(depth_img, armor.center));
+      AUTO_AIM_TRACE_END(color_msg->header.stamp, "depth_position");
       armor_msg.distance_to_image_center =
-        depth_processor_->calculateDistanceToCenter(armor.center);
+        depth_processor->calculateDistanceToCenter(armor.center);
 
       // If z < 0.4m, the depth would turn to zero
       if (armor_msg.position.z != 0) {
         armors_msg_.armors.emplace_back(armor_msg);
-        position_marker_.points.emplace_back(armor_msg.position);
 
-        text_marker_.id++;
-        text_marker_.pose.position = armor_msg.position;
-        text_marker_.pose.position.y -= 0.1;
-        text_marker_.text = armor.classfication_result;
-        marker_array_.markers.emplace_back(text_marker_);
+        if (fill_markers) {
+          marker_back_.armors.push_back({armor_msg.position, armor.number, armor.confidence});
+        }
       }
     }
 
     // Publishing detected armors
-    armors_pub_->publish(armors_msg_);
+    publishArmors();
 
-    // Publishing marker
-    publishMarkers();
+    // Hand over to the marker timer
+    if (fill_markers) {
+      commitMarkers();
+    }
   }
 }
 
@@ -0,0 +1,76 @@
+// Copyright 2022 Chen Jun
+
+#ifndef ARMOR_DETECTOR__TEST__DETECTION_FIXTURES_HPP_
+#define ARMOR_DETECTOR__TEST__DETECTION_FIXTURES_HPP_
+
+#include <ament_index_cpp/get_package_share_directory.hpp>
+#include <opencv2/imgproc.hpp>
+
+// STL
+#include <string>
+#include <vector>
+
+#include "armor_detector/detector.hpp"
+#include "armor_detector/light_table.hpp"
+#include "armor_detector/number_classifier.hpp"
+
+// Detector, classifier and synthetic frames shared by the allocation and perf regression tests
+namespace rm_auto_aim
+{
+namespace fixtures
+{
+// Default parameters of the detector node
+inline Detector makeDetector()
+{
+  Detector::LightParams l = {0.1, 0.55, 40.0};
+  Detector::ArmorParams a = {0.6, 0.8, 2.8, 3.2, 4.3, 35.0};
+  Detector::ScoreParams s = {1.0, 1.0, 1.0, 1.0, 1.0, 150.0};
+  return Detector(160, RED, l, a, s);
+}
+
+inline NumberClassifier makeClassifier()
+{
+  auto pkg_path = ament_index_cpp::get_package_share_directory("armor_detector");
+  return NumberClassifier(pkg_path + "/model/fc.onnx", pkg_path + "/model/label.txt", 0.5);
+}
+
+// A frame with a red small armor with a dim number between its lights centered at each of xs on
+// the middle row, and clutter bright spots above them
+inline cv::Mat makeFrame(const cv::Size & size, const std::vector<int> & xs, int clutter = 0)
+{
+  cv::Mat frame(size, CV_8UC3, cv::Scalar::all(20));
+  int y = size.height / 2;
+  for (int x : xs) {
+    cv::rectangle(frame, cv::Rect(x - 33, y - 15, 6, 30), cv::Scalar(255, 200, 200), cv::FILLED);
+    cv::rectangle(frame, cv::Rect(x + 27, y - 15, 6, 30), cv::Scalar(255, 200, 200), cv::FILLED);
+    cv::putText(
+      frame, "3", cv::Point(x - 9, y + 10), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar::all(120), 3);
+  }
+  for (int i = 0; i < clutter; i++) {
+    cv::circle(frame, cv::Point(60 + 60 * i, 150 + 37 * (i % 5)), 8, cv::Scalar::all(230), -1);
+  }
+  return frame;
+}
+
+// The detector node's path: the light table and candidates are kept across frames, only the
+// candidates become Armors
+inline std::vector<Armor> detect(Detector & detector, const cv::Mat & frame)
+{
+  static LightTable lights;
+  static std::vector<ArmorCandidate> candidates;
+  auto binary_img = detector.preprocessImage(frame);
+  detector.findLights(frame, binary_img, lights);
+  detector.matchLights(lights, candidates);
+
+  std::vector<Armor> armors;
+  armors.reserve(candidates.size());
+  for (const auto & candidate : candidates) {
+    armors.push_back(makeArmor(lights, candidate));
+  }
+  return armors;
+}
+
+}  // namespace fixtures
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_DETECTOR__TEST__DETECTION_FIXTURES_HPP_
@@ -0,0 +1,139 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+// STL
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "armor_detector/pnp_solver.hpp"
+#include "auto_aim_utils/allocation_counter.hpp"
+#include "detection_fixtures.hpp"
+
+using auto_aim_utils::AllocationScope;
+using auto_aim_utils::AllocationStats;
+using rm_auto_aim::Armor;
+using rm_auto_aim::fixtures::detect;
+using rm_auto_aim::fixtures::makeClassifier;
+using rm_auto_aim::fixtures::makeDetector;
+
+namespace
+{
+constexpr int kWarmUpFrames = 30;
+constexpr int kFrames = 300;
+
+// A single armor in a VGA frame, centered at x
+cv::Mat makeFrame(int x) { return rm_auto_aim::fixtures::makeFrame(cv::Size(640, 480), {x}); }
+
+// For stages built on OpenCV calls that allocate their results: after warm-up every frame has
+// to allocate the same and free all of it, nothing may pile up from frame to frame
+template <typename Frame>
+void expectSteadyAllocations(const std::string & stage, Frame frame)
+{
+  for (int i = 0; i < kWarmUpFrames; i++) {
+    frame();
+  }
+
+  std::vector<AllocationStats> stats;
+  stats.reserve(kFrames);
+  std::string first_report;
+  for (int i = 0; i < kFrames; i++) {
+    AllocationScope scope;
+    frame();
+    stats.push_back(scope.stop());
+    if (i == 0) {
+      first_report = scope.report();
+    }
+  }
+
+  std::cout << stage << ": " << first_report << std::endl;
+  for (int i = 0; i < kFrames; i++) {
+    if (stats[i].allocations != stats[0].allocations || stats[i].frees != stats[i].allocations) {
+      ADD_FAILURE() << stage << " frame " << i << ": " << stats[i].allocations
+                    << " allocations and " << stats[i].frees << " frees, first frame "
+                    << first_report;
+      break;
+    }
+  }
+}
+
+// For stages that must not touch the heap at all after warm-up
+template <typename Frame>
+void expectNoAllocations(const std::string & stage, Frame frame)
+{
+  for (int i = 0; i < kWarmUpFrames; i++) {
+    frame();
+  }
+
+  AllocationScope scope;
+  for (int i = 0; i < kFrames; i++) {
+    frame();
+  }
+  auto stats = scope.stop();
+  EXPECT_EQ(stats.allocations, 0u) << stage << ": " << scope.report();
+}
+}  // namespace
+
+TEST(AllocationTest, detector)
+{
+  auto detector = makeDetector();
+  auto frame = makeFrame(320);
+  ASSERT_EQ(detect(detector, frame).size(), 1u);
+
+  expectSteadyAllocations("Detector", [&]() { detect(detector, frame); });
+}
+
+TEST(AllocationTest, extract_numbers)
+{
+  auto detector = makeDetector();
+  auto classifier = makeClassifier();
+  auto frame = makeFrame(320);
+  auto armors = detect(detector, frame);
+  ASSERT_EQ(armors.size(), 1u);
+
+  expectSteadyAllocations("NumberClassifier::extractNumbers", [&]() {
+    classifier.extractNumbers(frame, armors);
+    // Release the number image inside the frame that allocated it
+    armors[0].number_img.release();
+  });
+}
+
+TEST(AllocationTest, classify)
+{
+  auto detector = makeDetector();
+  auto classifier = makeClassifier();
+  // Alternating between two places every other frame, so that besides reusing the previous
+  // result the cache misses and the templates and the network run
+  std::vector<std::vector<Armor>> inputs;
+  for (int x : {200, 440}) {
+    auto frame = makeFrame(x);
+    auto armors = detect(detector, frame);
+    ASSERT_EQ(armors.size(), 1u);
+    classifier.extractNumbers(frame, armors);
+    inputs.push_back(armors);
+  }
+
+  std::vector<Armor> armors;
+  armors.reserve(4);
+  int frame_count = 0;
+  expectNoAllocations("NumberClassifier::doClassify", [&]() {
+    const auto & input = inputs[(frame_count++ / 2) % 2];
+    armors.assign(input.begin(), input.end());
+    classifier.doClassify(armors);
+  });
+}
+
+TEST(AllocationTest, pnp_solver)
+{
+  auto detector = makeDetector();
+  rm_auto_aim::PnPSolver pnp_solver({1000, 0, 320, 0, 1000, 240, 0, 0, 1}, {0, 0, 0, 0, 0});
+  auto armors = detect(detector, makeFrame(320));
+  ASSERT_EQ(armors.size(), 1u);
+
+  expectSteadyAllocations("PnPSolver", [&]() {
+    cv::Point3d position;
+    pnp_solver.solvePnP(armors[0], position);
+    pnp_solver.calculateDistanceToCenter(armors[0].center);
+  });
+}
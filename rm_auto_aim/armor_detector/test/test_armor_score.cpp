@@ -0,0 +1,120 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+#include <opencv2/core/types.hpp>
+
+// STL
+#include <vector>
+
+#include "armor_detector/detector.hpp"
+
+using rm_auto_aim::Armor;
+using rm_auto_aim::ArmorCandidate;
+using rm_auto_aim::Detector;
+using rm_auto_aim::Light;
+using rm_auto_aim::LightTable;
+
+namespace
+{
+Detector makeDetector()
+{
+  Detector::LightParams l_params;
+  l_params.min_ratio = 0.1;
+  l_params.max_ratio = 0.55;
+  l_params.max_angle = 40.0;
+  Detector::ArmorParams a_params;
+  a_params.min_light_ratio = 0.6;
+  a_params.min_small_center_distance = 0.8;
+  a_params.max_small_center_distance = 2.8;
+  a_params.min_large_center_distance = 3.2;
+  a_params.max_large_center_distance = 4.3;
+  a_params.max_angle = 35.0;
+  Detector::ScoreParams s_params;
+  s_params.light_ratio = 1.0;
+  s_params.center_distance = 1.0;
+  s_params.angle = 1.0;
+  s_params.color = 1.0;
+  s_params.area = 1.0;
+  s_params.reference_area = 150.0;
+  return Detector(160, rm_auto_aim::RED, l_params, a_params, s_params);
+}
+
+Light makeLight(cv::Point2f center, float length, float angle, float color_strength)
+{
+  Light light(cv::RotatedRect(center, cv::Size2f(length * 0.25f, length), angle));
+  light.color = rm_auto_aim::RED;
+  light.color_strength = color_strength;
+  return light;
+}
+}  // namespace
+
+TEST(ArmorScoreTest, plate_outscores_clutter)
+{
+  auto detector = makeDetector();
+
+  // Upright lights of equal length, in the middle of the small armor distance range
+  std::vector<Light> plate_lights = {
+    makeLight({100, 100}, 30, 0, 0.8), makeLight({154, 100}, 30, 0, 0.8)};
+  // Tilted pair of unequal, dim, small lights near the edges of the accepted ranges
+  std::vector<Light> clutter_lights = {
+    makeLight({400, 300}, 12, 0, 0.1), makeLight({425, 312}, 9, 0, 0.1)};
+
+  auto plates = detector.matchLights(plate_lights);
+  auto clutter = detector.matchLights(clutter_lights);
+  ASSERT_EQ(plates.size(), 1u);
+  ASSERT_EQ(clutter.size(), 1u);
+
+  EXPECT_GT(plates[0].score, 0.8f);
+  EXPECT_LT(clutter[0].score, 0.5f);
+  EXPECT_LE(plates[0].score, 1.0f);
+  EXPECT_GE(clutter[0].score, 0.0f);
+}
+
+TEST(ArmorScoreTest, rejected_pair_scores_zero)
+{
+  auto detector = makeDetector();
+
+  // Too far apart for either armor type
+  std::vector<Light> lights = {
+    makeLight({100, 100}, 30, 0, 0.8), makeLight({250, 100}, 30, 0, 0.8)};
+  EXPECT_TRUE(detector.matchLights(lights).empty());
+  ASSERT_EQ(detector.debug_armors.size(), 1u);
+  EXPECT_EQ(detector.debug_armors[0].score, 0.0f);
+}
+
+TEST(ArmorScoreTest, candidates_refer_to_light_table)
+{
+  auto detector = makeDetector();
+
+  // A blue light between two plates is never paired, the plates are listed right light first
+  LightTable lights;
+  lights.push_back(makeLight({154, 100}, 30, 0, 0.8));
+  lights.push_back(makeLight({100, 100}, 30, 0, 0.8));
+  auto blue = makeLight({300, 100}, 30, 0, 0.8);
+  blue.color = rm_auto_aim::BLUE;
+  lights.push_back(blue);
+  lights.push_back(makeLight({454, 100}, 30, 0, 0.8));
+  lights.push_back(makeLight({400, 100}, 30, 0, 0.8));
+  lights.shift({10, 20});
+
+  std::vector<ArmorCandidate> candidates;
+  detector.matchLights(lights, candidates);
+  ASSERT_EQ(candidates.size(), 2u);
+  EXPECT_EQ(candidates[0].left, 1);
+  EXPECT_EQ(candidates[0].right, 0);
+  EXPECT_EQ(candidates[1].left, 4);
+  EXPECT_EQ(candidates[1].right, 3);
+
+  auto armor = rm_auto_aim::makeArmor(lights, candidates[0]);
+  EXPECT_FLOAT_EQ(armor.left_light.center.x, 110);
+  EXPECT_FLOAT_EQ(armor.right_light.center.x, 164);
+  EXPECT_FLOAT_EQ(armor.center.y, 120);
+  EXPECT_EQ(armor.armor_type, candidates[0].armor_type);
+  EXPECT_EQ(armor.score, candidates[0].score);
+
+  // The same as pairing standalone lights
+  auto armors = detector.matchLights(std::vector<Light>{lights.light(0), lights.light(1)});
+  ASSERT_EQ(armors.size(), 1u);
+  EXPECT_EQ(armors[0].score, candidates[0].score);
+}
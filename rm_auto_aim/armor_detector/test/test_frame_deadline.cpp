@@ -0,0 +1,57 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+// STL
+#include <chrono>
+#include <thread>
+
+#include "armor_detector/frame_deadline.hpp"
+
+using rm_auto_aim::FrameDeadline;
+
+TEST(FrameDeadlineTest, disabled)
+{
+  FrameDeadline deadline;
+  deadline.start(0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  EXPECT_FALSE(deadline.expired());
+  deadline.finishStage(FrameDeadline::PREPROCESS);
+  EXPECT_FALSE(deadline.missed());
+  EXPECT_EQ(deadline.misses(FrameDeadline::PREPROCESS), 0u);
+}
+
+// Budgets are either far longer than the test or far shorter than the sleep, so that a loaded
+// machine can't flip the result
+TEST(FrameDeadlineTest, within_budget)
+{
+  FrameDeadline deadline;
+  deadline.start(1000.0);
+  EXPECT_FALSE(deadline.expired());
+  EXPECT_GT(deadline.remainingMs(), 0.0);
+  deadline.finishStage(FrameDeadline::PREPROCESS);
+  EXPECT_FALSE(deadline.missed());
+  EXPECT_EQ(deadline.misses(FrameDeadline::PREPROCESS), 0u);
+}
+
+TEST(FrameDeadlineTest, miss_counted_once_per_frame)
+{
+  FrameDeadline deadline;
+  for (int frame = 0; frame < 3; frame++) {
+    deadline.start(1e-3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_TRUE(deadline.expired());
+    EXPECT_LT(deadline.remainingMs(), 0.0);
+
+    // Only the stage that ran past the deadline is blamed
+    deadline.finishStage(FrameDeadline::CLASSIFY);
+    deadline.finishStage(FrameDeadline::EXTRACT_NUMBERS);
+    EXPECT_TRUE(deadline.missed());
+  }
+  EXPECT_EQ(deadline.misses(FrameDeadline::PREPROCESS), 0u);
+  EXPECT_EQ(deadline.misses(FrameDeadline::CLASSIFY), 3u);
+  EXPECT_EQ(deadline.misses(FrameDeadline::EXTRACT_NUMBERS), 0u);
+
+  deadline.start(1000.0);
+  EXPECT_FALSE(deadline.missed());
+}
@@ -0,0 +1,172 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "armor_detector/kernels.hpp"
+
+using rm_auto_aim::Isa;
+using rm_auto_aim::Kernels;
+
+namespace
+{
+std::vector<uint8_t> randomBytes(size_t n, std::mt19937 & rng)
+{
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<uint8_t> bytes(n);
+  for (auto & b : bytes) {
+    b = dist(rng);
+  }
+  return bytes;
+}
+
+std::vector<float> randomFloats(size_t n, std::mt19937 & rng)
+{
+  std::uniform_real_distribution<float> dist(-1, 1);
+  std::vector<float> floats(n);
+  for (auto & f : floats) {
+    f = dist(rng);
+  }
+  return floats;
+}
+}  // namespace
+
+TEST(KernelsTest, select)
+{
+  auto isas = rm_auto_aim::supportedIsas();
+  ASSERT_FALSE(isas.empty());
+  EXPECT_EQ(isas.front(), Isa::SCALAR);
+
+  EXPECT_TRUE(rm_auto_aim::selectKernels("scalar"));
+  EXPECT_EQ(rm_auto_aim::kernels().isa, Isa::SCALAR);
+  EXPECT_FALSE(rm_auto_aim::selectKernels("mmx"));
+  EXPECT_EQ(rm_auto_aim::kernels().isa, Isa::SCALAR);
+  EXPECT_TRUE(rm_auto_aim::selectKernels("auto"));
+  EXPECT_EQ(rm_auto_aim::kernels().isa, isas.back());
+
+  for (auto isa : isas) {
+    std::cout << "Supported: " << rm_auto_aim::isaName(isa) << std::endl;
+  }
+}
+
+TEST(KernelsTest, reference)
+{
+  const auto & k = *rm_auto_aim::kernelsFor(Isa::SCALAR);
+
+  uint8_t rgb[] = {255, 255, 255, 0, 0, 0, 200, 100, 50, 10, 20, 250};
+  uint8_t dst[4];
+  k.rgbThreshold(rgb, dst, 4, 100);
+  // Gray values 255, 0, 117, 34
+  EXPECT_EQ(dst[0], 255);
+  EXPECT_EQ(dst[1], 0);
+  EXPECT_EQ(dst[2], 255);
+  EXPECT_EQ(dst[3], 0);
+
+  uint8_t mask[] = {0, 255, 1, 255};
+  int64_t sum_r = 0, sum_b = 0;
+  k.colorVote(rgb, mask, 4, &sum_r, &sum_b);
+  EXPECT_EQ(sum_r, 210);
+  EXPECT_EQ(sum_b, 300);
+
+  // Two modes, the threshold falls in between
+  std::vector<uint8_t> gray(100, 20);
+  std::fill(gray.begin() + 60, gray.end(), 200);
+  int thresh = k.otsu(gray.data(), 10, 10, 10);
+  EXPECT_GE(thresh, 20);
+  EXPECT_LT(thresh, 200);
+
+  // Translation by (1, 1)
+  std::vector<uint8_t> src(4 * 4 * 3);
+  for (int i = 0; i < 16; i++) {
+    src[3 * i] = src[3 * i + 1] = src[3 * i + 2] = i * 10;
+  }
+  double h[9] = {1, 0, 1, 0, 1, 1, 0, 0, 1};
+  uint8_t warped[4 * 4];
+  k.warpPerspectiveGray(src.data(), 4, 4, 12, h, warped, 4, 4, 4);
+  EXPECT_EQ(warped[0], 50);
+  EXPECT_EQ(warped[2 * 4 + 1], 140);
+  // Outside of src
+  EXPECT_EQ(warped[3 * 4 + 3], 0);
+}
+
+TEST(KernelsTest, variants_match_scalar)
+{
+  const auto & ref = *rm_auto_aim::kernelsFor(Isa::SCALAR);
+  std::mt19937 rng(0);
+
+  const int n = 1000;
+  auto rgb = randomBytes(3 * n, rng);
+  auto mask = randomBytes(n, rng);
+  const int in = 256, out = 84;
+  auto w = randomFloats(in * out, rng);
+  auto b = randomFloats(out, rng);
+  auto x = randomFloats(in, rng);
+  double h[9] = {0.9, 0.1, 3.5, -0.05, 1.1, 2.0, 0.0005, 0.0002, 1};
+
+  std::vector<uint8_t> expected(n), actual(n);
+  std::vector<float> expected_f(in), actual_f(in);
+  for (auto isa : rm_auto_aim::supportedIsas()) {
+    SCOPED_TRACE(rm_auto_aim::isaName(isa));
+    const auto & k = *rm_auto_aim::kernelsFor(isa);
+    EXPECT_EQ(k.isa, isa);
+
+    ref.rgbThreshold(rgb.data(), expected.data(), n, 120);
+    k.rgbThreshold(rgb.data(), actual.data(), n, 120);
+    EXPECT_EQ(actual, expected);
+
+    ref.threshold(mask.data(), expected.data(), n, 77);
+    k.threshold(mask.data(), actual.data(), n, 77);
+    EXPECT_EQ(actual, expected);
+
+    int64_t r0 = 0, b0 = 0, r1 = 0, b1 = 0;
+    ref.colorVote(rgb.data(), mask.data(), n, &r0, &b0);
+    k.colorVote(rgb.data(), mask.data(), n, &r1, &b1);
+    EXPECT_EQ(r1, r0);
+    EXPECT_EQ(b1, b0);
+
+    EXPECT_EQ(k.otsu(mask.data(), 40, 25, 40), ref.otsu(mask.data(), 40, 25, 40));
+
+    ref.warpPerspectiveGray(rgb.data(), 25, 40, 75, h, expected.data(), 20, 28, 20);
+    k.warpPerspectiveGray(rgb.data(), 25, 40, 75, h, actual.data(), 20, 28, 20);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.begin() + 20 * 28, actual.begin()));
+
+    expected_f = actual_f = std::vector<float>(x.begin(), x.end());
+    ref.add(expected_f.data(), w.data(), in);
+    ref.sub(expected_f.data(), w.data() + in, in);
+    k.add(actual_f.data(), w.data(), in);
+    k.sub(actual_f.data(), w.data() + in, in);
+    EXPECT_EQ(actual_f, expected_f);
+
+    ref.gemv(w.data(), b.data(), x.data(), in, out, expected_f.data());
+    k.gemv(w.data(), b.data(), x.data(), in, out, actual_f.data());
+    EXPECT_TRUE(std::equal(expected_f.begin(), expected_f.begin() + out, actual_f.begin()));
+  }
+}
+
+TEST(KernelsTest, benchmark)
+{
+  std::mt19937 rng(0);
+  const int width = 1280, height = 1024;
+  auto rgb = randomBytes(3 * width * height, rng);
+  std::vector<uint8_t> binary(width * height);
+
+  for (auto isa : rm_auto_aim::supportedIsas()) {
+    const auto & k = *rm_auto_aim::kernelsFor(isa);
+    auto start = std::chrono::steady_clock::now();
+    const int loop_num = 20;
+    for (int i = 0; i < loop_num; i++) {
+      k.rgbThreshold(rgb.data(), binary.data(), width * height, 160);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << rm_auto_aim::isaName(isa) << " rgbThreshold: "
+              << std::chrono::duration<double, std::milli>(end - start).count() / loop_num << "ms"
+              << std::endl;
+  }
+}
@@ -0,0 +1,71 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+#include "armor_detector/load_shedder.hpp"
+
+using rm_auto_aim::LoadShedder;
+
+namespace
+{
+LoadShedder::Params params()
+{
+  LoadShedder::Params params;
+  params.latency_budget_ms = 10.0;
+  params.recover_ratio = 0.7;
+  params.escalate_frames = 3;
+  params.recover_frames = 5;
+  params.smoothing = 1.0;
+  params.decimation = 2;
+  return params;
+}
+}  // namespace
+
+TEST(LoadShedderTest, degrade_and_recover)
+{
+  LoadShedder shedder(params());
+  EXPECT_EQ(shedder.level(), LoadShedder::NORMAL);
+
+  // Each run of escalate_frames frames over budget steps one level down
+  int changes = 0;
+  for (int i = 0; i < 3 * 4; i++) {
+    changes += shedder.update(8.0, 5.0);
+  }
+  EXPECT_EQ(changes, 4);
+  EXPECT_EQ(shedder.level(), LoadShedder::DECIMATE);
+
+  // Stays at the last level
+  for (int i = 0; i < 10; i++) {
+    EXPECT_FALSE(shedder.update(8.0, 5.0));
+  }
+
+  // Between the recover threshold and the budget nothing changes
+  for (int i = 0; i < 10; i++) {
+    EXPECT_FALSE(shedder.update(4.0, 4.0));
+  }
+
+  // Recovers one level per recover_frames frames under the threshold
+  for (int i = 0; i < 5 * 4; i++) {
+    shedder.update(1.0, 3.0);
+  }
+  EXPECT_EQ(shedder.level(), LoadShedder::NORMAL);
+  EXPECT_DOUBLE_EQ(shedder.latency(), 4.0);
+  EXPECT_DOUBLE_EQ(shedder.processingRate(), 1000.0 / 3.0);
+}
+
+TEST(LoadShedderTest, decimate)
+{
+  LoadShedder shedder(params());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(shedder.acceptFrame());
+  }
+
+  while (shedder.level() != LoadShedder::DECIMATE) {
+    shedder.update(20.0, 20.0);
+  }
+  int accepted = 0;
+  for (int i = 0; i < 10; i++) {
+    accepted += shedder.acceptFrame();
+  }
+  EXPECT_EQ(accepted, 5);
+}
@@ -5,11 +5,17 @@
 #include <rclcpp/executors.hpp>
 #include <rclcpp/node_options.hpp>
 #include <rclcpp/utilities.hpp>
+#include <sensor_msgs/msg/camera_info.hpp>
+#include <sensor_msgs/msg/image.hpp>
 
 // STD
+#include <chrono>
+#include <cstdio>
 #include <memory>
+#include <thread>
 
 #include "armor_detector/detector_node.hpp"
+#include "auto_aim_interfaces/msg/armors.hpp"
 
 TEST(RgbDetectorNodeTest, NodeStartupTest)
 {
@@ -25,6 +31,61 @@ TEST(RgbDepthDetectorNodeTest, NodeStartupTest)
   node.reset();
 }
 
+// Time from constructing the node to the first armors message, with the camera streaming from
+// the start as after a restart in the middle of a match
+TEST(RgbDetectorNodeTest, TimeToFirstArmors)
+{
+  using Clock = std::chrono::steady_clock;
+  using Ms = std::chrono::duration<double, std::milli>;
+
+  auto start = Clock::now();
+  rclcpp::NodeOptions options;
+  auto node = std::make_shared<rm_auto_aim::RgbDetectorNode>(options);
+  auto constructed = Clock::now();
+
+  auto camera = std::make_shared<rclcpp::Node>("startup_test_camera");
+  auto cam_info_pub = camera->create_publisher<sensor_msgs::msg::CameraInfo>(
+    "/camera_info", rclcpp::SensorDataQoS());
+  auto image_pub =
+    camera->create_publisher<sensor_msgs::msg::Image>("/image_raw", rclcpp::SensorDataQoS());
+  bool received = false;
+  auto armors_sub = camera->create_subscription<auto_aim_interfaces::msg::Armors>(
+    "/detector/armors", rclcpp::SensorDataQoS(),
+    [&received](auto_aim_interfaces::msg::Armors::ConstSharedPtr) { received = true; });
+
+  sensor_msgs::msg::CameraInfo cam_info;
+  cam_info.k = {1000, 0, 320, 0, 1000, 240, 0, 0, 1};
+  cam_info.d = {0, 0, 0, 0, 0};
+  sensor_msgs::msg::Image image;
+  image.height = 480;
+  image.width = 640;
+  image.encoding = "rgb8";
+  image.step = image.width * 3;
+  image.data.resize(image.step * image.height);
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+  executor.add_node(camera);
+  // Camera at 100 Hz
+  while (!received && Clock::now() - start < std::chrono::seconds(10)) {
+    cam_info.header.stamp = image.header.stamp = camera->now();
+    cam_info_pub->publish(cam_info);
+    image_pub->publish(image);
+    executor.spin_some();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  auto first_armors = Clock::now();
+
+  ASSERT_TRUE(received);
+  std::printf(
+    "Constructor: %.1fms, first armors: %.1fms\n", Ms(constructed - start).count(),
+    Ms(first_armors - start).count());
+
+  executor.remove_node(camera);
+  executor.remove_node(node);
+  node.reset();
+}
+
 int main(int argc, char ** argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,125 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+#include <ament_index_cpp/get_package_share_directory.hpp>
+
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "armor_detector/number_mlp.hpp"
+#include "armor_detector/onnx_reader.hpp"
+
+using hrc = std::chrono::high_resolution_clock;
+using rm_auto_aim::kNumberBits;
+using rm_auto_aim::PackedNumber;
+
+namespace
+{
+std::string modelPath()
+{
+  return ament_index_cpp::get_package_share_directory("armor_detector") + "/model/fc.onnx";
+}
+
+// Plain float forward pass of the ONNX graph: Gemm(transB) -> Relu -> Gemm -> Relu -> Gemm
+std::vector<float> referenceForward(
+  std::map<std::string, rm_auto_aim::OnnxTensor> & tensors, const std::vector<float> & input)
+{
+  std::vector<float> x = input;
+  const char * layers[] = {"classifier.f1", "classifier.f2", "classifier.output"};
+  for (int l = 0; l < 3; l++) {
+    const auto & w = tensors[std::string(layers[l]) + ".weight"];
+    const auto & b = tensors[std::string(layers[l]) + ".bias"];
+    int out = w.dims[0], in = w.dims[1];
+    std::vector<float> y(out);
+    for (int i = 0; i < out; i++) {
+      double sum = b.data[i];
+      for (int j = 0; j < in; j++) {
+        sum += w.data[i * in + j] * x[j];
+      }
+      y[i] = l < 2 ? std::max(static_cast<float>(sum), 0.0f) : static_cast<float>(sum);
+    }
+    x = y;
+  }
+  return x;
+}
+}  // namespace
+
+TEST(NumberMlpTest, unreadable_model)
+{
+  rm_auto_aim::NumberMlp mlp;
+  EXPECT_FALSE(mlp.load("/nonexistent/fc.onnx"));
+
+  std::string path = ::testing::TempDir() + "garbage.onnx";
+  {
+    std::ofstream file(path);
+    file << "\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff";
+  }
+  EXPECT_FALSE(mlp.load(path));
+  EXPECT_FALSE(mlp.loaded());
+  std::remove(path.c_str());
+}
+
+TEST(NumberMlpTest, matches_reference)
+{
+  auto tensors = rm_auto_aim::readOnnxInitializers(modelPath());
+  rm_auto_aim::NumberMlp mlp;
+  ASSERT_TRUE(mlp.load(modelPath()));
+  ASSERT_EQ(mlp.classes(), 9);
+
+  std::mt19937 rng(0);
+  std::vector<float> logits(mlp.classes());
+  // Sparse and dense inputs take different paths through the first layer
+  for (double density : {0.0, 0.1, 0.3, 0.5, 0.7, 1.0}) {
+    std::bernoulli_distribution on(density);
+    for (int n = 0; n < 20; n++) {
+      PackedNumber packed{};
+      std::vector<float> input(kNumberBits);
+      for (int bit = 0; bit < kNumberBits; bit++) {
+        if (on(rng)) {
+          packed[bit / 64] |= uint64_t{1} << (bit % 64);
+          input[bit] = 1;
+        }
+      }
+
+      mlp.forward(packed, logits.data());
+      auto expected = referenceForward(tensors, input);
+      for (int i = 0; i < mlp.classes(); i++) {
+        EXPECT_NEAR(logits[i], expected[i], 1e-3) << "density " << density;
+      }
+    }
+  }
+}
+
+TEST(NumberMlpTest, benchmark)
+{
+  rm_auto_aim::NumberMlp mlp;
+  ASSERT_TRUE(mlp.load(modelPath()));
+
+  std::mt19937 rng(0);
+  std::bernoulli_distribution on(0.3);
+  PackedNumber packed{};
+  for (int bit = 0; bit < kNumberBits; bit++) {
+    if (on(rng)) {
+      packed[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+  }
+
+  std::vector<float> logits(mlp.classes());
+  int loop_num = 1000;
+  auto start = hrc::now();
+  for (int i = 0; i < loop_num; i++) {
+    mlp.forward(packed, logits.data());
+  }
+  auto end = hrc::now();
+  std::cout << "time_avg: "
+            << std::chrono::duration<double, std::micro>(end - start).count() / loop_num << "us"
+            << std::endl;
+}
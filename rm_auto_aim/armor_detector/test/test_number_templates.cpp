@@ -0,0 +1,134 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+// STL
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "armor_detector/number_templates.hpp"
+
+using rm_auto_aim::kNumberCols;
+using rm_auto_aim::kNumberRows;
+using rm_auto_aim::NumberTemplates;
+using rm_auto_aim::PackedNumber;
+
+namespace
+{
+using Image = std::vector<uint8_t>;
+
+// Vertical bar for '1', two horizontal bars for '2'
+Image pattern(char label)
+{
+  Image img(kNumberRows * kNumberCols, 0);
+  for (int i = 2; i < kNumberRows - 2; i++) {
+    for (int j = 0; j < kNumberCols; j++) {
+      bool on = label == '1' ? (j >= 12 && j < 16) : (i < 6 || i >= kNumberRows - 6);
+      img[i * kNumberCols + j] = on ? 255 : 0;
+    }
+  }
+  return img;
+}
+
+Image noisy(Image img, std::mt19937 & rng, double flip_rate)
+{
+  std::bernoulli_distribution flip(flip_rate);
+  for (auto & p : img) {
+    if (flip(rng)) {
+      p = p ? 0 : 255;
+    }
+  }
+  return img;
+}
+
+PackedNumber pack(const Image & img) { return rm_auto_aim::packNumber(img.data(), kNumberCols); }
+}  // namespace
+
+TEST(NumberTemplatesTest, pack)
+{
+  Image img(kNumberRows * kNumberCols, 0);
+  img[0] = 255;
+  img[kNumberRows * kNumberCols - 1] = 1;
+  auto packed = pack(img);
+  EXPECT_EQ(packed[0], 1u);
+  EXPECT_EQ(packed[8], uint64_t{1} << ((kNumberRows * kNumberCols - 1) % 64));
+  EXPECT_FLOAT_EQ(rm_auto_aim::overlapSimilarity(packed, packed), 1.0f);
+  EXPECT_FLOAT_EQ(rm_auto_aim::overlapSimilarity(packed, PackedNumber{}), 0.0f);
+  EXPECT_FLOAT_EQ(rm_auto_aim::overlapSimilarity(PackedNumber{}, PackedNumber{}), 0.0f);
+}
+
+TEST(NumberTemplatesTest, learn_and_match)
+{
+  std::mt19937 rng(42);
+  NumberTemplates templates({'1', '2'}, 10);
+
+  char label;
+  float best, second;
+  auto one = pack(pattern('1'));
+  EXPECT_FALSE(templates.match(one, label, best, second));
+
+  for (int i = 0; i < 20; i++) {
+    templates.learn('1', pack(noisy(pattern('1'), rng, 0.1)));
+  }
+  EXPECT_FALSE(templates.complete());
+  for (int i = 0; i < 20; i++) {
+    templates.learn('2', pack(noisy(pattern('2'), rng, 0.1)));
+  }
+  EXPECT_TRUE(templates.complete());
+
+  // The majority removes the noise
+  ASSERT_TRUE(templates.match(one, label, best, second));
+  EXPECT_EQ(label, '1');
+  EXPECT_FLOAT_EQ(best, 1.0f);
+  EXPECT_LT(second, 0.8f);
+
+  auto two = pack(noisy(pattern('2'), rng, 0.05));
+  ASSERT_TRUE(templates.match(two, label, best, second));
+  EXPECT_EQ(label, '2');
+  EXPECT_GT(best, 0.8f);
+
+  // Round trip through a file
+  std::string path = ::testing::TempDir() + "number_templates.txt";
+  ASSERT_TRUE(templates.save(path));
+  NumberTemplates loaded({'1', '2'}, 10);
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_TRUE(loaded.complete());
+  char loaded_label;
+  float loaded_best, loaded_second;
+  ASSERT_TRUE(loaded.match(two, loaded_label, loaded_best, loaded_second));
+  EXPECT_EQ(loaded_label, label);
+  EXPECT_FLOAT_EQ(loaded_best, best);
+
+  // Templates of another image size are refused
+  {
+    std::ofstream file(path);
+    file << kNumberRows + 1 << ' ' << kNumberCols << '\n';
+  }
+  NumberTemplates resized({'1', '2'}, 10);
+  EXPECT_FALSE(resized.load(path));
+  std::remove(path.c_str());
+}
+
+// The background is most of an image, it must not make a blank or speckled ROI look like a number
+TEST(NumberTemplatesTest, blank_is_not_similar)
+{
+  std::mt19937 rng(42);
+  NumberTemplates templates({'1', '2'}, 10);
+  for (int i = 0; i < 20; i++) {
+    templates.learn('1', pack(noisy(pattern('1'), rng, 0.1)));
+    templates.learn('2', pack(noisy(pattern('2'), rng, 0.1)));
+  }
+
+  char label;
+  float best, second;
+  Image blank(kNumberRows * kNumberCols, 0);
+  ASSERT_TRUE(templates.match(pack(blank), label, best, second));
+  EXPECT_FLOAT_EQ(best, 0.0f);
+
+  ASSERT_TRUE(templates.match(pack(noisy(blank, rng, 0.02)), label, best, second));
+  EXPECT_LT(best, 0.1f);
+}
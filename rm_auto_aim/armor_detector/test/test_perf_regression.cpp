@@ -0,0 +1,73 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+// STL
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "armor_detector/pnp_solver.hpp"
+#include "auto_aim_utils/perf_regression.hpp"
+#include "detection_fixtures.hpp"
+
+using rm_auto_aim::Armor;
+using rm_auto_aim::fixtures::detect;
+using rm_auto_aim::fixtures::makeClassifier;
+using rm_auto_aim::fixtures::makeDetector;
+
+namespace
+{
+// A full camera frame with two armors and some bright clutter, offset by x
+cv::Mat makeFrame(int x)
+{
+  return rm_auto_aim::fixtures::makeFrame(cv::Size(1280, 1024), {x, x + 400}, 20);
+}
+}  // namespace
+
+TEST(PerfRegressionTest, detection)
+{
+  auto classifier = makeClassifier();
+  rm_auto_aim::PnPSolver pnp_solver({1000, 0, 640, 0, 1000, 512, 0, 0, 1}, {0, 0, 0, 0, 0});
+  auto detector = makeDetector();
+  auto frame = makeFrame(300);
+  auto armors = detect(detector, frame);
+  ASSERT_EQ(armors.size(), 2u);
+
+  std::vector<auto_aim_utils::BenchmarkResult> results;
+  results.push_back(
+    auto_aim_utils::runBenchmark("detector", [&]() { detect(detector, frame); }));
+
+  results.push_back(auto_aim_utils::runBenchmark(
+    "extract_numbers", [&]() { classifier.extractNumbers(frame, armors); }));
+
+  // Alternating between two places so that the previous frame's results are never reused
+  std::vector<std::vector<Armor>> inputs;
+  for (int x : {300, 340}) {
+    auto shifted = makeFrame(x);
+    auto input = detect(detector, shifted);
+    classifier.extractNumbers(shifted, input);
+    inputs.push_back(input);
+  }
+  std::vector<Armor> classified;
+  size_t input = 0;
+  results.push_back(auto_aim_utils::runBenchmark("classify", [&]() {
+    const auto & next = inputs[input++ % inputs.size()];
+    classified.assign(next.begin(), next.end());
+    classifier.doClassify(classified);
+  }));
+
+  results.push_back(auto_aim_utils::runBenchmark("pnp", [&]() {
+    cv::Point3d position;
+    for (const auto & armor : armors) {
+      pnp_solver.solvePnP(armor, position);
+    }
+  }));
+
+  auto comparison = auto_aim_utils::checkBaseline(results, PERF_BASELINE_PATH);
+  std::cout << comparison.report;
+  EXPECT_FALSE(comparison.regressed) << comparison.report;
+  if (comparison.missing_baseline) {
+    GTEST_SKIP() << "No baseline for this machine class";
+  }
+}
@@ -16,24 +16,28 @@ struct KalmanFilterMatrices
   Eigen::MatrixXd P;  // error estimate covariance matrix
 };
 
+// All working matrices are sized in the constructor, predict() and update() do not allocate
 class KalmanFilter
 {
 public:
   explicit KalmanFilter(const KalmanFilterMatrices & matrices);
 
   // Initialize the filter with a guess for initial states.
-  void init(const Eigen::VectorXd & x0);
+  // Also resets the error estimate covariance to its initial value.
+  void init(const Eigen::Ref<const Eigen::VectorXd> & x0);
 
   // Computes a predicted state
-  Eigen::MatrixXd predict(const Eigen::MatrixXd & F);
+  const Eigen::VectorXd & predict(const Eigen::MatrixXd & F);
 
   // Update the estimated state based on measurement
-  Eigen::MatrixXd update(const Eigen::VectorXd & z);
+  const Eigen::VectorXd & update(const Eigen::Ref<const Eigen::VectorXd> & z);
 
 private:
   // Invariant matrices
   Eigen::MatrixXd F, H, Q, R;
 
+  // Initial error estimate covariance matrix
+  Eigen::MatrixXd P0;
   // Priori error estimate covariance matrix
   Eigen::MatrixXd P_pre;
   // Posteriori error estimate covariance matrix
@@ -43,15 +47,17 @@ private:
   Eigen::MatrixXd K;
 
   // System dimensions
-  int n;
-
-  // N-size identity
-  Eigen::MatrixXd I;
+  int n, m;
 
   // Predicted state
   Eigen::VectorXd x_pre;
   // Updated state
   Eigen::VectorXd x_post;
+
+  // Intermediate results: F * P, P * H^T, H * P, innovation covariance and its inverse
+  Eigen::MatrixXd FP_, PHt_, HP_, S_, S_inv_;
+  Eigen::VectorXd innovation_;
+  Eigen::PartialPivLU<Eigen::MatrixXd> lu_;
 };
 
 }  // namespace rm_auto_aim
@@ -0,0 +1,67 @@
+// Copyright 2022 Chen Jun
+
+#ifndef ARMOR_PROCESSOR__LATENCY_STATS_HPP_
+#define ARMOR_PROCESSOR__LATENCY_STATS_HPP_
+
+// STD
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "auto_aim_interfaces/msg/frame_trace.hpp"
+
+namespace rm_auto_aim
+{
+// Capture-to-target latency over a sliding window of frame traces, split into the stages of
+// the pipeline and the hand-overs between them
+class LatencyStats
+{
+public:
+  enum Segment {
+    CAPTURE,       // Frame grabbed to published by the camera
+    TO_DETECTOR,   // Camera to detector callback, transport and queueing
+    DETECT,        // Detector callback
+    TO_PROCESSOR,  // Detector to processor, transport and queueing
+    TF_WAIT,       // Held by the tf2 filter until the transform is available
+    TRACK,         // Processor callback
+    TOTAL,         // Frame grabbed (or stamped if the camera trace is missing) to target
+    SEGMENT_COUNT
+  };
+  using Durations = std::array<double, SEGMENT_COUNT>;
+
+  explicit LatencyStats(size_t window);
+
+  // Add a complete trace, returns false and ignores it if the target was never published
+  bool add(const auto_aim_interfaces::msg::FrameTrace & trace);
+
+  // Durations in milliseconds of the trace's segments, 0 for stages it did not pass
+  static Durations segments(const auto_aim_interfaces::msg::FrameTrace & trace);
+
+  static const char * name(Segment segment);
+
+  size_t size() const { return size_; }
+
+  // Frames in the window without the camera's part of the trace
+  size_t untracedCaptures() const { return untraced_captures_; }
+
+  // The p-th percentile (0-100) of a segment over the window, in milliseconds
+  double percentile(Segment segment, double p);
+
+  // Mean durations of the frames whose total latency is at or above its p-th percentile,
+  // showing which stages the slow frames lose their time in
+  Durations tailBreakdown(double p);
+
+  void clear();
+
+private:
+  std::vector<Durations> samples_;
+  std::vector<bool> untraced_;
+  std::vector<double> scratch_;
+  size_t next_;
+  size_t size_;
+  size_t untraced_captures_;
+};
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_PROCESSOR__LATENCY_STATS_HPP_
@@ -0,0 +1,36 @@
+// Copyright 2022 Chen Jun
+
+#ifndef ARMOR_PROCESSOR__LATENCY_TRACER_NODE_HPP_
+#define ARMOR_PROCESSOR__LATENCY_TRACER_NODE_HPP_
+
+#include <rclcpp/rclcpp.hpp>
+
+// STD
+#include <memory>
+
+#include "armor_processor/latency_stats.hpp"
+#include "auto_aim_interfaces/msg/target.hpp"
+
+namespace rm_auto_aim
+{
+// Collects the frame traces carried by the targets and periodically logs the capture-to-target
+// latency percentiles, attributed to the pipeline stages
+class LatencyTracerNode : public rclcpp::Node
+{
+public:
+  explicit LatencyTracerNode(const rclcpp::NodeOptions & options);
+
+private:
+  void report();
+
+  LatencyStats stats_;
+  double tail_percentile_;
+  size_t incomplete_traces_;
+
+  rclcpp::Subscription<auto_aim_interfaces::msg::Target>::SharedPtr target_sub_;
+  rclcpp::TimerBase::SharedPtr report_timer_;
+};
+
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_PROCESSOR__LATENCY_TRACER_NODE_HPP_
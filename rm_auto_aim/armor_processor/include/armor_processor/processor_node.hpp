@@ -15,7 +15,12 @@
 #include <visualization_msgs/msg/marker_array.hpp>
 
 // STD
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -23,8 +28,12 @@
 #include "armor_processor/spin_observer.hpp"
 #include "armor_processor/tracker.hpp"
 #include "auto_aim_interfaces/msg/armors.hpp"
+#include "auto_aim_interfaces/msg/perf_counters.hpp"
 #include "auto_aim_interfaces/msg/spin_info.hpp"
 #include "auto_aim_interfaces/msg/target.hpp"
+#include "auto_aim_utils/callback_group_thread.hpp"
+#include "auto_aim_utils/live_metrics.hpp"
+#include "auto_aim_utils/perf_counters.hpp"
 
 namespace rm_auto_aim
 {
@@ -37,7 +46,18 @@ public:
 private:
   void armorsCallback(const auto_aim_interfaces::msg::Armors::SharedPtr armors_ptr);
 
-  void publishMarkers(const auto_aim_interfaces::msg::Target & target_msg);
+  // Record when an Armors message arrived, before the tf2 filter waits for its transform
+  void armorsArrived(const auto_aim_interfaces::msg::Armors::ConstSharedPtr & armors_msg);
+
+  // Arrival time in nanoseconds of the Armors with the stamp, 0 if unknown
+  int64_t arrivalTime(const builtin_interfaces::msg::Time & stamp);
+
+  void publishMarkers();
+
+  void publishPerfCounters();
+
+  // Record the time since stage_start into a live metrics histogram and restart it
+  void recordStage(size_t histogram, std::chrono::steady_clock::time_point & stage_start);
 
   // Last time received msg
   rclcpp::Time last_time_;
@@ -61,18 +81,50 @@ private:
   message_filters::Subscriber<auto_aim_interfaces::msg::Armors> armors_sub_;
   std::shared_ptr<tf2_filter> tf2_filter_;
 
+  // Arrival times of the latest Armors for their frame traces, a ring shared by the hot path
+  // thread and the tf thread releasing the filtered messages
+  struct Arrival
+  {
+    builtin_interfaces::msg::Time stamp;
+    int64_t time_ns;
+  };
+  std::vector<Arrival> arrivals_;
+  size_t arrival_next_;
+  std::mutex arrival_mutex_;
+
   // Publisher
   rclcpp::Publisher<auto_aim_interfaces::msg::Target>::SharedPtr target_pub_;
 
   // Visualization marker publisher
-  visualization_msgs::msg::Marker position_marker_;
-  visualization_msgs::msg::Marker velocity_marker_;
+  // armorsCallback only stores the latest target, markers are built and published by a timer
+  auto_aim_interfaces::msg::Target marker_target_;
+  bool marker_fresh_;
+  std::atomic<bool> marker_subscribed_;
+  std::mutex marker_mutex_;
+  visualization_msgs::msg::MarkerArray marker_array_;
   rclcpp::Publisher<visualization_msgs::msg::MarkerArray>::SharedPtr marker_pub_;
+  rclcpp::TimerBase::SharedPtr marker_timer_;
+
+  // Hardware counters per stage, nullptr if disabled. Frames released by the tf2 filter on
+  // another thread than the first counted frame are not counted.
+  std::unique_ptr<auto_aim_utils::StageCounters> stage_counters_;
+  auto_aim_interfaces::msg::PerfCounters perf_counters_msg_;
+  rclcpp::Publisher<auto_aim_interfaces::msg::PerfCounters>::SharedPtr perf_counters_pub_;
+  rclcpp::TimerBase::SharedPtr perf_counters_timer_;
+
+  // Counters, tracker state and latency histograms in shared memory for aimtop, null if disabled
+  std::unique_ptr<auto_aim_utils::LiveMetrics> live_metrics_;
 
   // Debug information publishers
-  bool debug_;
+  std::atomic<bool> debug_;
   std::shared_ptr<rclcpp::ParameterEventHandler> debug_param_sub_;
   std::shared_ptr<rclcpp::ParameterCallbackHandle> debug_cb_handle_;
+
+  // The armors callback runs in its own callback group, spun by a dedicated real-time thread
+  // unless realtime.dedicated_thread is false. Declared last so it stops before anything else
+  // is destroyed.
+  rclcpp::CallbackGroup::SharedPtr hot_path_group_;
+  std::unique_ptr<auto_aim_utils::CallbackGroupThread> hot_path_thread_;
 };
 
 }  // namespace rm_auto_aim
@@ -19,6 +19,7 @@
 
 namespace rm_auto_aim
 {
+// The KF is created once and reset in place, update() does not allocate
 class Tracker
 {
 public:
@@ -9,22 +9,38 @@ KalmanFilter::KalmanFilter(const KalmanFilterMatrices & matrices)
   H(matrices.H),
   Q(matrices.Q),
   R(matrices.R),
+  P0(matrices.P),
+  P_pre(matrices.P),
   P_post(matrices.P),
   n(matrices.F.rows()),
-  I(Eigen::MatrixXd::Identity(n, n)),
-  x_pre(n),
-  x_post(n)
+  m(matrices.H.rows()),
+  x_pre(Eigen::VectorXd::Zero(n)),
+  x_post(Eigen::VectorXd::Zero(n)),
+  FP_(n, n),
+  PHt_(n, m),
+  HP_(m, n),
+  S_(m, m),
+  S_inv_(m, m),
+  innovation_(m),
+  lu_(m)
 {
+  K.resize(n, m);
 }
 
-void KalmanFilter::init(const Eigen::VectorXd & x0) { x_post = x0; }
+void KalmanFilter::init(const Eigen::Ref<const Eigen::VectorXd> & x0)
+{
+  x_post = x0;
+  P_post = P0;
+}
 
-Eigen::MatrixXd KalmanFilter::predict(const Eigen::MatrixXd & F)
+const Eigen::VectorXd & KalmanFilter::predict(const Eigen::MatrixXd & F)
 {
   this->F = F;
 
-  x_pre = F * x_post;
-  P_pre = F * P_post * F.transpose() + Q;
+  x_pre.noalias() = F * x_post;
+  FP_.noalias() = F * P_post;
+  P_pre.noalias() = FP_ * F.transpose();
+  P_pre += Q;
 
   // handle the case when there will be no measurement before the next predict
   x_post = x_pre;
@@ -33,11 +49,31 @@ Eigen::MatrixXd KalmanFilter::predict(const Eigen::MatrixXd & F)
   return x_pre;
 }
 
-Eigen::MatrixXd KalmanFilter::update(const Eigen::VectorXd & z)
+const Eigen::VectorXd & KalmanFilter::update(const Eigen::Ref<const Eigen::VectorXd> & z)
 {
-  K = P_pre * H.transpose() * (H * P_pre * H.transpose() + R).inverse();
-  x_post = x_pre + K * (z - H * x_pre);
-  P_post = (I - K * H) * P_pre;
+  // K = P * H^T * (H * P * H^T + R)^-1
+  PHt_.noalias() = P_pre * H.transpose();
+  S_ = R;
+  S_.noalias() += H * PHt_;
+  // S^-1 = U^-1 * L^-1 * P, solved in place since PartialPivLU::inverse() allocates temporaries
+  lu_.compute(S_);
+  S_inv_.setZero();
+  for (int i = 0; i < m; i++) {
+    S_inv_(lu_.permutationP().indices()(i), i) = 1;
+  }
+  lu_.matrixLU().triangularView<Eigen::UnitLower>().solveInPlace(S_inv_);
+  lu_.matrixLU().triangularView<Eigen::Upper>().solveInPlace(S_inv_);
+  K.noalias() = PHt_ * S_inv_;
+
+  innovation_ = z;
+  innovation_.noalias() -= H * x_pre;
+  x_post = x_pre;
+  x_post.noalias() += K * innovation_;
+
+  // (I - K * H) * P
+  HP_.noalias() = H * P_pre;
+  P_post = P_pre;
+  P_post.noalias() -= K * HP_;
 
   return x_post;
 }
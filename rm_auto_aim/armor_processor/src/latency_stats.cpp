@@ -0,0 +1,141 @@
+// Copyright 2022 Chen Jun
+
+#include "armor_processor/latency_stats.hpp"
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace rm_auto_aim
+{
+using auto_aim_interfaces::msg::FrameTrace;
+
+namespace
+{
+double elapsedMs(int64_t from_ns, int64_t to_ns)
+{
+  return from_ns == 0 || to_ns == 0 ? 0.0 : std::max(to_ns - from_ns, int64_t(0)) * 1e-6;
+}
+}  // namespace
+
+LatencyStats::LatencyStats(size_t window)
+: samples_(std::max(window, size_t(1))),
+  untraced_(samples_.size(), false),
+  next_(0),
+  size_(0),
+  untraced_captures_(0)
+{
+  scratch_.reserve(samples_.size());
+}
+
+LatencyStats::Durations LatencyStats::segments(const FrameTrace & trace)
+{
+  const auto & enter = trace.enter_ns;
+  const auto & exit = trace.exit_ns;
+  // Without the camera's part, the frame starts at its stamp
+  int64_t stamp_ns = int64_t(trace.capture_stamp.sec) * 1000000000 + trace.capture_stamp.nanosec;
+  bool captured = enter[FrameTrace::CAPTURE] != 0;
+  int64_t start_ns = captured ? enter[FrameTrace::CAPTURE] : stamp_ns;
+  int64_t published_ns = captured ? exit[FrameTrace::CAPTURE] : stamp_ns;
+  int64_t processor_ns =
+    enter[FrameTrace::TF_WAIT] != 0 ? enter[FrameTrace::TF_WAIT] : enter[FrameTrace::TRACK];
+
+  Durations durations;
+  durations[CAPTURE] = elapsedMs(enter[FrameTrace::CAPTURE], exit[FrameTrace::CAPTURE]);
+  durations[TO_DETECTOR] = elapsedMs(published_ns, enter[FrameTrace::DETECT]);
+  durations[DETECT] = elapsedMs(enter[FrameTrace::DETECT], exit[FrameTrace::DETECT]);
+  durations[TO_PROCESSOR] = elapsedMs(exit[FrameTrace::DETECT], processor_ns);
+  durations[TF_WAIT] = elapsedMs(enter[FrameTrace::TF_WAIT], exit[FrameTrace::TF_WAIT]);
+  durations[TRACK] = elapsedMs(enter[FrameTrace::TRACK], exit[FrameTrace::TRACK]);
+  durations[TOTAL] = elapsedMs(start_ns, exit[FrameTrace::TRACK]);
+  return durations;
+}
+
+bool LatencyStats::add(const FrameTrace & trace)
+{
+  if (trace.exit_ns[FrameTrace::TRACK] == 0) {
+    return false;
+  }
+
+  bool untraced = trace.enter_ns[FrameTrace::CAPTURE] == 0;
+  if (size_ == samples_.size()) {
+    untraced_captures_ -= untraced_[next_];
+  } else {
+    size_++;
+  }
+  samples_[next_] = segments(trace);
+  untraced_[next_] = untraced;
+  untraced_captures_ += untraced;
+  next_ = (next_ + 1) % samples_.size();
+  return true;
+}
+
+const char * LatencyStats::name(Segment segment)
+{
+  switch (segment) {
+    case CAPTURE:
+      return "capture";
+    case TO_DETECTOR:
+      return "to_detector";
+    case DETECT:
+      return "detect";
+    case TO_PROCESSOR:
+      return "to_processor";
+    case TF_WAIT:
+      return "tf_wait";
+    case TRACK:
+      return "track";
+    case TOTAL:
+      return "total";
+    default:
+      return "unknown";
+  }
+}
+
+double LatencyStats::percentile(Segment segment, double p)
+{
+  if (size_ == 0) {
+    return 0.0;
+  }
+
+  scratch_.clear();
+  for (size_t i = 0; i < size_; i++) {
+    scratch_.push_back(samples_[i][segment]);
+  }
+  auto rank = static_cast<size_t>(std::ceil(std::min(std::max(p, 0.0), 100.0) / 100 * size_));
+  auto nth = scratch_.begin() + (rank == 0 ? 0 : rank - 1);
+  std::nth_element(scratch_.begin(), nth, scratch_.end());
+  return *nth;
+}
+
+LatencyStats::Durations LatencyStats::tailBreakdown(double p)
+{
+  Durations mean{};
+  if (size_ == 0) {
+    return mean;
+  }
+
+  double threshold = percentile(TOTAL, p);
+  size_t count = 0;
+  for (size_t i = 0; i < size_; i++) {
+    if (samples_[i][TOTAL] >= threshold) {
+      for (size_t s = 0; s < SEGMENT_COUNT; s++) {
+        mean[s] += samples_[i][s];
+      }
+      count++;
+    }
+  }
+  for (auto & duration : mean) {
+    duration /= count;
+  }
+  return mean;
+}
+
+void LatencyStats::clear()
+{
+  next_ = size_ = untraced_captures_ = 0;
+  std::fill(untraced_.begin(), untraced_.end(), false);
+}
+
+}  // namespace rm_auto_aim
@@ -0,0 +1,78 @@
+// Copyright 2022 Chen Jun
+
+#include "armor_processor/latency_tracer_node.hpp"
+
+// STD
+#include <chrono>
+#include <memory>
+
+namespace rm_auto_aim
+{
+namespace
+{
+// The window is the number of frames the percentiles are taken over, at least one
+rcl_interfaces::msg::ParameterDescriptor windowDescriptor()
+{
+  rcl_interfaces::msg::ParameterDescriptor param_desc;
+  param_desc.description = "Frames the latency percentiles are computed over";
+  param_desc.integer_range.resize(1);
+  param_desc.integer_range[0].step = 1;
+  param_desc.integer_range[0].from_value = 1;
+  param_desc.integer_range[0].to_value = 1000000;
+  return param_desc;
+}
+}  // namespace
+
+LatencyTracerNode::LatencyTracerNode(const rclcpp::NodeOptions & options)
+: Node("latency_tracer", options),
+  stats_(this->declare_parameter("window", 1000, windowDescriptor())),
+  tail_percentile_(this->declare_parameter("tail_percentile", 99.0)),
+  incomplete_traces_(0)
+{
+  RCLCPP_INFO(this->get_logger(), "Starting LatencyTracerNode!");
+
+  // Only copies the trace into the window, the percentiles are computed by the report timer
+  target_sub_ = this->create_subscription<auto_aim_interfaces::msg::Target>(
+    "/processor/target", rclcpp::SensorDataQoS(),
+    [this](auto_aim_interfaces::msg::Target::ConstSharedPtr target) {
+      if (!stats_.add(target->trace)) {
+        incomplete_traces_++;
+      }
+    });
+
+  double report_period = this->declare_parameter("report_period", 5.0);
+  report_timer_ = this->create_wall_timer(
+    std::chrono::duration<double>(report_period), [this]() { report(); });
+}
+
+void LatencyTracerNode::report()
+{
+  if (stats_.size() == 0) {
+    return;
+  }
+
+  auto tail = stats_.tailBreakdown(tail_percentile_);
+  RCLCPP_INFO(
+    this->get_logger(),
+    "Capture to target in ms over %zu frames (%zu without camera trace, %zu incomplete), "
+    "tail is the mean of the frames above p%.0f in total:",
+    stats_.size(), stats_.untracedCaptures(), incomplete_traces_, tail_percentile_);
+  for (int s = 0; s < LatencyStats::SEGMENT_COUNT; s++) {
+    auto segment = static_cast<LatencyStats::Segment>(s);
+    RCLCPP_INFO(
+      this->get_logger(), "  %-12s p50 %6.2f  p90 %6.2f  p99 %6.2f  max %6.2f  tail %6.2f",
+      LatencyStats::name(segment), stats_.percentile(segment, 50),
+      stats_.percentile(segment, 90), stats_.percentile(segment, 99),
+      stats_.percentile(segment, 100), tail[segment]);
+  }
+  incomplete_traces_ = 0;
+}
+
+}  // namespace rm_auto_aim
+
+#include "rclcpp_components/register_node_macro.hpp"
+
+// Register the component with class_loader.
+// This acts as a sort of entry point, allowing the component to be discoverable when its library
+// is being loaded into a running process.
+RCLCPP_COMPONENTS_REGISTER_NODE(rm_auto_aim::LatencyTracerNode)
@@ -3,16 +3,53 @@
 #include "armor_processor/processor_node.hpp"
 
 // STD
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "auto_aim_utils/async_logger.hpp"
+#include "auto_aim_utils/perf_counters_msg.hpp"
+#include "auto_aim_utils/realtime_parameters.hpp"
+#include "auto_aim_utils/tracing.hpp"
+
 namespace rm_auto_aim
 {
+// Number of Armors arrival times kept for the messages waiting in the tf2 filter
+constexpr size_t kArrivalHistory = 16;
+// Stages of the armors callback with hardware counters
+enum CounterStage { TF_TRANSFORM = 0, TRACKER_UPDATE, SPIN_OBSERVER_UPDATE };
+// Live metrics
+enum MetricsCounter { FRAMES_COUNTER = 0, TF_FAILURES_COUNTER, TRACKER_INITS_COUNTER };
+enum MetricsGauge { TRACKER_STATE_GAUGE = 0, TARGET_SPINNING_GAUGE };
+enum MetricsHistogram {
+  TF_WAIT_HISTOGRAM = 0,
+  TF_TRANSFORM_HISTOGRAM,
+  TRACKER_UPDATE_HISTOGRAM,
+  SPIN_OBSERVER_UPDATE_HISTOGRAM,
+  CAPTURE_TO_TARGET_HISTOGRAM,
+};
+
 ArmorProcessorNode::ArmorProcessorNode(const rclcpp::NodeOptions & options)
 : Node("armor_processor", options), last_time_(0), dt_(0.0)
 {
   RCLCPP_INFO(this->get_logger(), "Starting ProcessorNode!");
 
+  // The armors subscription runs in hot_path_group_. By default it is spun by a dedicated
+  // real-time thread, leaving parameter events, tf and timers to the node's own executor.
+  auto realtime_config = auto_aim_utils::declareRealtimeParameters(this, "realtime");
+  bool dedicated_hot_path = this->declare_parameter("realtime.dedicated_thread", true);
+  hot_path_group_ = this->create_callback_group(
+    rclcpp::CallbackGroupType::MutuallyExclusive, !dedicated_hot_path);
+  // The profile is only applied to a thread the node owns, never to the executor or component
+  // container thread that runs the callbacks of other nodes as well
+  if (!dedicated_hot_path && auto_aim_utils::isRealtimeConfigured(realtime_config)) {
+    RCLCPP_WARN(
+      this->get_logger(), "realtime.* is only applied to the dedicated hot path thread, ignored");
+  }
+
   // Kalman Filter initial matrix
   // A - state transition matrix
   // clang-format off
@@ -73,7 +110,14 @@ ArmorProcessorNode::ArmorProcessorNode(const rclcpp::NodeOptions & options)
   tf2_buffer_->setCreateTimerInterface(timer_interface);
   tf2_listener_ = std::make_shared<tf2_ros::TransformListener>(*tf2_buffer_);
   // subscriber and filter
-  armors_sub_.subscribe(this, "/detector/armors", rmw_qos_profile_sensor_data);
+  rclcpp::SubscriptionOptions armors_sub_options;
+  armors_sub_options.callback_group = hot_path_group_;
+  armors_sub_.subscribe(
+    this, "/detector/armors", rmw_qos_profile_sensor_data, armors_sub_options);
+  // Registered ahead of the filter, so it sees every message before the filter holds it back
+  arrivals_.resize(kArrivalHistory);
+  arrival_next_ = 0;
+  armors_sub_.registerCallback(&ArmorProcessorNode::armorsArrived, this);
   target_frame_ = this->declare_parameter("target_frame", "shooter_link");
   tf2_filter_ = std::make_shared<tf2_filter>(
     armors_sub_, *tf2_buffer_, target_frame_, 10, this->get_node_logging_interface(),
@@ -87,20 +131,64 @@ ArmorProcessorNode::ArmorProcessorNode(const rclcpp::NodeOptions & options)
 
   // Visualization Marker Publisher
   // See http://wiki.ros.org/rviz/DisplayTypes/Marker
-  position_marker_.ns = "position";
-  position_marker_.type = visualization_msgs::msg::Marker::SPHERE;
-  position_marker_.scale.x = position_marker_.scale.y = position_marker_.scale.z = 0.1;
-  position_marker_.color.a = 1.0;
-  position_marker_.color.g = 1.0;
-  velocity_marker_.type = visualization_msgs::msg::Marker::ARROW;
-  velocity_marker_.ns = "velocity";
-  velocity_marker_.scale.x = 0.03;
-  velocity_marker_.scale.y = 0.05;
-  velocity_marker_.color.a = 1.0;
-  velocity_marker_.color.b = 1.0;
+  visualization_msgs::msg::Marker position_marker;
+  position_marker.ns = "position";
+  position_marker.type = visualization_msgs::msg::Marker::SPHERE;
+  position_marker.scale.x = position_marker.scale.y = position_marker.scale.z = 0.1;
+  position_marker.color.a = 1.0;
+  position_marker.color.g = 1.0;
+  visualization_msgs::msg::Marker velocity_marker;
+  velocity_marker.type = visualization_msgs::msg::Marker::ARROW;
+  velocity_marker.ns = "velocity";
+  velocity_marker.scale.x = 0.03;
+  velocity_marker.scale.y = 0.05;
+  velocity_marker.color.a = 1.0;
+  velocity_marker.color.b = 1.0;
+  velocity_marker.points.resize(2);
+  marker_array_.markers = {position_marker, velocity_marker};
+  marker_subscribed_ = false;
+  marker_fresh_ = false;
   marker_pub_ =
     this->create_publisher<visualization_msgs::msg::MarkerArray>("/processor/marker", 10);
 
+  // Markers are published at marker_rate (<= 0 disables them) instead of on every message
+  double marker_rate = this->declare_parameter("marker_rate", 20.0);
+  if (marker_rate > 0) {
+    marker_timer_ = this->create_wall_timer(
+      std::chrono::duration<double>(1.0 / marker_rate), [this]() { publishMarkers(); });
+  }
+
+  // Hardware counters (cycles, instructions, cache and branch misses) of each processing stage,
+  // recorded on the hot path thread and published as a summary at report_period
+  if (this->declare_parameter("perf_counters.enable", false)) {
+    stage_counters_ = std::make_unique<auto_aim_utils::StageCounters>(
+      std::vector<std::string>{"tf_transform", "tracker_update", "spin_observer_update"},
+      this->declare_parameter("perf_counters.history", 300));
+    perf_counters_pub_ = this->create_publisher<auto_aim_interfaces::msg::PerfCounters>(
+      "/processor/perf_counters", 10);
+    double report_period = this->declare_parameter("perf_counters.report_period", 1.0);
+    perf_counters_timer_ = this->create_wall_timer(
+      std::chrono::duration<double>(report_period), [this]() { publishPerfCounters(); });
+  }
+
+  // Frame and tf failure counters, the tracker and spin state and latency histograms of each
+  // stage in shared memory, watched with aimtop
+  if (this->declare_parameter("live_metrics.enable", true)) {
+    try {
+      live_metrics_ = std::make_unique<auto_aim_utils::LiveMetrics>(
+        this->get_fully_qualified_name(),
+        std::vector<std::string>{"frames", "tf_failures", "tracker_inits"},
+        std::vector<std::string>{"tracker_state", "target_spinning"},
+        std::vector<std::string>{
+          "tf_wait", "tf_transform", "tracker_update", "spin_observer_update",
+          "capture_to_target"});
+      live_metrics_->setLabels(TRACKER_STATE_GAUGE, {"LOST", "DETECTING", "TRACKING", "TEMP_LOST"});
+      live_metrics_->setLabels(TARGET_SPINNING_GAUGE, {"no", "yes"});
+    } catch (const std::runtime_error & e) {
+      RCLCPP_WARN(this->get_logger(), "Live metrics unavailable: %s", e.what());
+    }
+  }
+
   // Debug Publishers
   debug_ = this->declare_parameter("debug", true);
   // if (debug_) {
@@ -112,12 +200,52 @@ ArmorProcessorNode::ArmorProcessorNode(const rclcpp::NodeOptions & options)
       debug_ = p.as_bool();
       // debug_ ? createDebugPublishers() : destroyDebugPublishers();
     });
+
+  if (dedicated_hot_path) {
+    hot_path_thread_ = std::make_unique<auto_aim_utils::CallbackGroupThread>(
+      this, hot_path_group_, realtime_config, "processor");
+  }
+}
+
+void ArmorProcessorNode::armorsArrived(
+  const auto_aim_interfaces::msg::Armors::ConstSharedPtr & armors_msg)
+{
+  auto arrival_ns = this->now().nanoseconds();
+  std::lock_guard<std::mutex> lock(arrival_mutex_);
+  arrivals_[arrival_next_] = {armors_msg->header.stamp, arrival_ns};
+  arrival_next_ = (arrival_next_ + 1) % arrivals_.size();
+}
+
+int64_t ArmorProcessorNode::arrivalTime(const builtin_interfaces::msg::Time & stamp)
+{
+  std::lock_guard<std::mutex> lock(arrival_mutex_);
+  for (const auto & arrival : arrivals_) {
+    if (arrival.stamp == stamp) {
+      return arrival.time_ns;
+    }
+  }
+  return 0;
 }
 
 void ArmorProcessorNode::armorsCallback(
   const auto_aim_interfaces::msg::Armors::SharedPtr armors_msg)
 {
+  // The frame waited for its transform from arrival until now
+  using auto_aim_interfaces::msg::FrameTrace;
+  auto start_ns = this->now().nanoseconds();
+  auto trace = armors_msg->trace;
+  trace.enter_ns[FrameTrace::TF_WAIT] = arrivalTime(armors_msg->header.stamp);
+  trace.exit_ns[FrameTrace::TF_WAIT] = trace.enter_ns[FrameTrace::TRACK] = start_ns;
+  auto stage_start = std::chrono::steady_clock::now();
+  if (live_metrics_ != nullptr && trace.enter_ns[FrameTrace::TF_WAIT] != 0) {
+    live_metrics_->record(
+      TF_WAIT_HISTOGRAM, (start_ns - trace.enter_ns[FrameTrace::TF_WAIT]) * 1e-6);
+  }
+
   // Tranform armor position from image frame to world coordinate
+  // Traced by the image stamp the armors were detected in, which the detector keys its stages by
+  AUTO_AIM_TRACE_BEGIN(armors_msg->trace.capture_stamp, "tf_transform");
+  bool count_stages = stage_counters_ != nullptr && stage_counters_->startFrame();
   for (auto & armor : armors_msg->armors) {
     geometry_msgs::msg::PointStamped ps;
     ps.header = armors_msg->header;
@@ -125,19 +253,32 @@ void ArmorProcessorNode::armorsCallback(
     try {
       armor.position = tf2_buffer_->transform(ps, target_frame_).point;
     } catch (const tf2::ExtrapolationException & ex) {
-      RCLCPP_ERROR(get_logger(), "Error while transforming %s", ex.what());
+      AUTO_AIM_LOG_ERROR(get_logger(), "Error while transforming %s", ex.what());
+      if (live_metrics_ != nullptr) {
+        live_metrics_->add(TF_FAILURES_COUNTER);
+      }
+      AUTO_AIM_TRACE_END(armors_msg->trace.capture_stamp, "tf_transform");
       return;
     }
   }
+  AUTO_AIM_TRACE_END(armors_msg->trace.capture_stamp, "tf_transform");
+  if (count_stages) {
+    stage_counters_->finishStage(TF_TRANSFORM);
+  }
+  recordStage(TF_TRANSFORM_HISTOGRAM, stage_start);
 
   auto_aim_interfaces::msg::Target target_msg;
   rclcpp::Time time = armors_msg->header.stamp;
   target_msg.header.stamp = time;
   target_msg.header.frame_id = target_frame_;
 
+  AUTO_AIM_TRACE_BEGIN(armors_msg->trace.capture_stamp, "tracker_update");
   if (tracker_->tracker_state == Tracker::LOST) {
     tracker_->init(armors_msg);
     target_msg.tracking = false;
+    if (live_metrics_ != nullptr) {
+      live_metrics_->add(TRACKER_INITS_COUNTER);
+    }
   } else {
     // Set dt
     dt_ = (time - last_time_).seconds();
@@ -154,6 +295,12 @@ void ArmorProcessorNode::armorsCallback(
     }
   }
 
+  AUTO_AIM_TRACE_END(armors_msg->trace.capture_stamp, "tracker_update");
+  if (count_stages) {
+    stage_counters_->finishStage(TRACKER_UPDATE);
+  }
+  recordStage(TRACKER_UPDATE_HISTOGRAM, stage_start);
+
   if (target_msg.tracking) {
     target_msg.position.x = tracker_->target_state(0);
     target_msg.position.y = tracker_->target_state(1);
@@ -169,48 +316,107 @@ void ArmorProcessorNode::armorsCallback(
     spin_observer_->allow_following_range =
       get_parameter("spin_observer.allow_following_range").as_double();
 
+    AUTO_AIM_TRACE_BEGIN(armors_msg->trace.capture_stamp, "spin_observer_update");
     spin_observer_->update(target_msg);
+    AUTO_AIM_TRACE_END(armors_msg->trace.capture_stamp, "spin_observer_update");
+    if (count_stages) {
+      stage_counters_->finishStage(SPIN_OBSERVER_UPDATE);
+    }
+    recordStage(SPIN_OBSERVER_UPDATE_HISTOGRAM, stage_start);
     spin_info_pub_->publish(spin_observer_->spin_info_msg);
+    if (live_metrics_ != nullptr) {
+      live_metrics_->set(TARGET_SPINNING_GAUGE, spin_observer_->spin_info_msg.target_spinning);
+    }
   }
 
+  target_msg.trace = trace;
+  target_msg.trace.exit_ns[FrameTrace::TRACK] = this->now().nanoseconds();
+  if (live_metrics_ != nullptr) {
+    live_metrics_->add(FRAMES_COUNTER);
+    live_metrics_->set(TRACKER_STATE_GAUGE, tracker_->tracker_state);
+    live_metrics_->record(
+      CAPTURE_TO_TARGET_HISTOGRAM,
+      (target_msg.trace.exit_ns[FrameTrace::TRACK] - time.nanoseconds()) * 1e-6);
+  }
+  AUTO_AIM_TRACE_PUBLISHED(
+    "/processor/target", armors_msg->trace.capture_stamp, target_msg.trace.frame_number);
   target_pub_->publish(target_msg);
 
-  publishMarkers(target_msg);
+  if (marker_subscribed_) {
+    std::lock_guard<std::mutex> lock(marker_mutex_);
+    marker_target_ = target_msg;
+    marker_fresh_ = true;
+  }
 
   last_time_ = time;
 
   if (debug_) {
-    RCLCPP_INFO_STREAM(this->get_logger(), "Tracker state:" << tracker_->tracker_state);
+    AUTO_AIM_LOG(INFO, this->get_logger(), 0, "Tracker state:%d", tracker_->tracker_state);
   }
 }
 
-void ArmorProcessorNode::publishMarkers(const auto_aim_interfaces::msg::Target & target_msg)
+void ArmorProcessorNode::recordStage(
+  size_t histogram, std::chrono::steady_clock::time_point & stage_start)
 {
-  position_marker_.header = target_msg.header;
-  velocity_marker_.header = target_msg.header;
+  if (live_metrics_ == nullptr) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  live_metrics_->record(
+    histogram, std::chrono::duration<double, std::milli>(now - stage_start).count());
+  stage_start = now;
+}
 
-  if (target_msg.tracking) {
-    position_marker_.action = visualization_msgs::msg::Marker::ADD;
-    position_marker_.pose.position = target_msg.position;
-    position_marker_.color.r = target_msg.suggest_fire ? 0. : 1.;
-
-    velocity_marker_.action = visualization_msgs::msg::Marker::ADD;
-    velocity_marker_.points.clear();
-    velocity_marker_.points.emplace_back(target_msg.position);
-    geometry_msgs::msg::Point arrow_end = target_msg.position;
-    arrow_end.x += target_msg.velocity.x;
-    arrow_end.y += target_msg.velocity.y;
-    arrow_end.z += target_msg.velocity.z;
-    velocity_marker_.points.emplace_back(arrow_end);
-  } else {
-    position_marker_.action = visualization_msgs::msg::Marker::DELETE;
-    velocity_marker_.action = visualization_msgs::msg::Marker::DELETE;
+void ArmorProcessorNode::publishPerfCounters()
+{
+  if (stage_counters_->failed()) {
+    RCLCPP_WARN_ONCE(
+      this->get_logger(), "Hardware counters unavailable: %s", stage_counters_->error().c_str());
+    return;
+  }
+
+  perf_counters_msg_.header.stamp = this->now();
+  auto_aim_utils::toMsg(stage_counters_->summary(), perf_counters_msg_);
+  perf_counters_pub_->publish(perf_counters_msg_);
+}
+
+void ArmorProcessorNode::publishMarkers()
+{
+  // Let armorsCallback skip handing over the target when nobody is listening
+  marker_subscribed_ = marker_pub_->get_subscription_count() > 0;
+  if (!marker_subscribed_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(marker_mutex_);
+    if (!marker_fresh_) {
+      return;
+    }
+    marker_fresh_ = false;
+
+    auto & position_marker = marker_array_.markers[0];
+    auto & velocity_marker = marker_array_.markers[1];
+    position_marker.header = marker_target_.header;
+    velocity_marker.header = marker_target_.header;
+
+    if (marker_target_.tracking) {
+      position_marker.action = visualization_msgs::msg::Marker::ADD;
+      position_marker.pose.position = marker_target_.position;
+      position_marker.color.r = marker_target_.suggest_fire ? 0. : 1.;
+
+      velocity_marker.action = visualization_msgs::msg::Marker::ADD;
+      velocity_marker.points[0] = marker_target_.position;
+      velocity_marker.points[1].x = marker_target_.position.x + marker_target_.velocity.x;
+      velocity_marker.points[1].y = marker_target_.position.y + marker_target_.velocity.y;
+      velocity_marker.points[1].z = marker_target_.position.z + marker_target_.velocity.z;
+    } else {
+      position_marker.action = visualization_msgs::msg::Marker::DELETE;
+      velocity_marker.action = visualization_msgs::msg::Marker::DELETE;
+    }
   }
 
-  visualization_msgs::msg::MarkerArray marker_array;
-  marker_array.markers.emplace_back(position_marker_);
-  marker_array.markers.emplace_back(velocity_marker_);
-  marker_pub_->publish(marker_array);
+  marker_pub_->publish(marker_array_);
 }
 
 }  // namespace rm_auto_aim
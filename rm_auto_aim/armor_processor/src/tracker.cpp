@@ -13,7 +13,9 @@ Tracker::Tracker(
   int lost_threshold)
 : tracker_state(LOST),
   tracking_id(0),
+  target_state(Eigen::VectorXd::Zero(6)),
   kf_matrices_(kf_matrices),
+  kf_(std::make_unique<KalmanFilter>(kf_matrices)),
   tracking_velocity_(Eigen::Vector3d::Zero()),
   max_match_distance_(max_match_distance),
   tracking_threshold_(tracking_threshold),
@@ -30,22 +32,21 @@ void Tracker::init(const Armors::SharedPtr & armors_msg)
   // TODO(chenjun): need more judgement
   // Simply choose the armor that is closest to image center
   double min_distance = DBL_MAX;
-  auto chosen_armor = armors_msg->armors[0];
+  const Armor * chosen_armor = &armors_msg->armors[0];
   for (const auto & armor : armors_msg->armors) {
     if (armor.distance_to_image_center < min_distance) {
       min_distance = armor.distance_to_image_center;
-      chosen_armor = armor;
+      chosen_armor = &armor;
     }
   }
 
   // KF init
-  kf_ = std::make_unique<KalmanFilter>(kf_matrices_);
-  Eigen::VectorXd init_state(6);
-  const auto position = chosen_armor.position;
+  Eigen::Matrix<double, 6, 1> init_state;
+  const auto & position = chosen_armor->position;
   init_state << position.x, position.y, position.z, 0, 0, 0;
   kf_->init(init_state);
 
-  tracking_id = chosen_armor.number;
+  tracking_id = chosen_armor->number;
   tracker_state = DETECTING;
 }
 
@@ -53,23 +54,23 @@ void Tracker::update(const Armors::SharedPtr & armors_msg, const double & dt)
 {
   // KF predict
   kf_matrices_.F(0, 3) = kf_matrices_.F(1, 4) = kf_matrices_.F(2, 5) = dt;
-  Eigen::VectorXd kf_prediction = kf_->predict(kf_matrices_.F);
+  const Eigen::VectorXd & kf_prediction = kf_->predict(kf_matrices_.F);
 
   bool matched = false;
   // Use KF prediction as default target state if no matched armor is found
   target_state = kf_prediction;
 
   if (!armors_msg->armors.empty()) {
-    Armor matched_armor;
+    const Armor * matched_armor = nullptr;
     double min_position_diff = DBL_MAX;
+    const Eigen::Vector3d predicted_position = kf_prediction.head(3);
     for (const auto & armor : armors_msg->armors) {
       Eigen::Vector3d position_vec(armor.position.x, armor.position.y, armor.position.z);
-      Eigen::Vector3d predicted_position = kf_prediction.head(3);
       // Difference of the current armor position and tracked armor's predicted position
       double position_diff = (predicted_position - position_vec).norm();
       if (position_diff < min_position_diff) {
         min_position_diff = position_diff;
-        matched_armor = armor;
+        matched_armor = &armor;
       }
     }
 
@@ -77,7 +78,7 @@ void Tracker::update(const Armors::SharedPtr & armors_msg, const double & dt)
       // Matching armor found
       matched = true;
       Eigen::Vector3d position_vec(
-        matched_armor.position.x, matched_armor.position.y, matched_armor.position.z);
+        matched_armor->position.x, matched_armor->position.y, matched_armor->position.z);
       target_state = kf_->update(position_vec);
     } else {
       // Check if there is same id armor in current frame
@@ -85,8 +86,7 @@ void Tracker::update(const Armors::SharedPtr & armors_msg, const double & dt)
         if (armor.number == tracking_id) {
           matched = true;
           // Reset KF
-          kf_ = std::make_unique<KalmanFilter>(kf_matrices_);
-          Eigen::VectorXd init_state(6);
+          Eigen::Matrix<double, 6, 1> init_state;
           // Set init state with current armor position and tracking velocity before
           init_state << armor.position.x, armor.position.y, armor.position.z, tracking_velocity_;
           kf_->init(init_state);
@@ -0,0 +1,104 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+// STD
+#include <vector>
+
+#include "armor_processor/kalman_filter.hpp"
+#include "armor_processor/tracker.hpp"
+#include "auto_aim_utils/allocation_counter.hpp"
+#include "tracking_fixtures.hpp"
+
+using auto_aim_utils::AllocationScope;
+using rm_auto_aim::KalmanFilter;
+using rm_auto_aim::Tracker;
+using rm_auto_aim::fixtures::kDt;
+using rm_auto_aim::fixtures::makeMatrices;
+
+namespace
+{
+constexpr int kWarmUpFrames = 50;
+constexpr int kFrames = 1000;
+// Frames of a moving target, with empty frames, a decoy and jumps that reset the KF
+std::vector<Tracker::Armors::SharedPtr> makeFrames(int count)
+{
+  rm_auto_aim::fixtures::SceneOptions options;
+  options.frames = count;
+  options.armors = 2;
+  options.decoy_spacing = 2.0;
+  options.decoy_center_distance = 190.0;
+  return rm_auto_aim::fixtures::makeFrames(
+    options, [](int i, std::vector<Tracker::Armor> & armors) {
+      if (i % 17 == 0) {
+        armors.clear();
+        return;
+      }
+      // The decoy only every 5 frames
+      if (i % 5 != 0) {
+        armors.pop_back();
+      }
+      // Jump away every 101 frames, matched again by number
+      if ((i / 101) % 2 == 1) {
+        for (auto & armor : armors) {
+          armor.position.x += 1.0;
+        }
+      }
+    });
+}
+
+// The processor node's use of the tracker for one frame
+void track(Tracker & tracker, const Tracker::Armors::SharedPtr & msg)
+{
+  if (tracker.tracker_state == Tracker::LOST) {
+    tracker.init(msg);
+  } else {
+    tracker.update(msg, kDt);
+  }
+}
+}  // namespace
+
+TEST(AllocationTest, kalman_filter_steady_state)
+{
+  auto matrices = makeMatrices();
+  KalmanFilter kf(matrices);
+  Eigen::Matrix<double, 6, 1> x0 = Eigen::Matrix<double, 6, 1>::Zero();
+  kf.init(x0);
+
+  Eigen::Vector3d z;
+  for (int i = 0; i < kWarmUpFrames; i++) {
+    kf.predict(matrices.F);
+    z << i * kDt, 0, 0;
+    kf.update(z);
+  }
+
+  AllocationScope scope;
+  for (int i = 0; i < kFrames; i++) {
+    kf.predict(matrices.F);
+    z << i * kDt, 0.1, 0.2;
+    kf.update(z);
+    if (i % 100 == 0) {
+      kf.init(x0);
+    }
+  }
+  auto stats = scope.stop();
+  EXPECT_EQ(stats.allocations, 0u) << scope.report();
+}
+
+TEST(AllocationTest, tracker_steady_state)
+{
+  Tracker tracker(makeMatrices(), 0.2, 5, 10);
+  auto warm_up = makeFrames(kWarmUpFrames);
+  auto frames = makeFrames(kFrames);
+  for (const auto & msg : warm_up) {
+    track(tracker, msg);
+  }
+
+  AllocationScope scope;
+  for (const auto & msg : frames) {
+    track(tracker, msg);
+  }
+  auto stats = scope.stop();
+  EXPECT_EQ(stats.allocations, 0u) << scope.report();
+  EXPECT_NE(tracker.tracker_state, Tracker::LOST);
+}
@@ -0,0 +1,117 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "armor_processor/latency_stats.hpp"
+
+using auto_aim_interfaces::msg::FrameTrace;
+using rm_auto_aim::LatencyStats;
+
+namespace
+{
+constexpr int64_t kMs = 1000000;
+constexpr int64_t kStampSec = 100;
+constexpr int64_t kStampNs = kStampSec * 1000 * kMs;
+
+// A frame through every stage, the detector taking detect_ms and the tf2 filter tf_wait_ms
+FrameTrace makeTrace(double detect_ms, double tf_wait_ms, bool camera = true)
+{
+  FrameTrace trace;
+  trace.capture_stamp.sec = kStampSec;
+  int64_t t = kStampNs;
+  if (camera) {
+    trace.frame_number = 1;
+    trace.enter_ns[FrameTrace::CAPTURE] = t - 2 * kMs;
+    trace.exit_ns[FrameTrace::CAPTURE] = t;
+  }
+  t += kMs;
+  trace.enter_ns[FrameTrace::DETECT] = t;
+  t += static_cast<int64_t>(detect_ms * kMs);
+  trace.exit_ns[FrameTrace::DETECT] = t;
+  t += kMs;
+  trace.enter_ns[FrameTrace::TF_WAIT] = t;
+  t += static_cast<int64_t>(tf_wait_ms * kMs);
+  trace.exit_ns[FrameTrace::TF_WAIT] = trace.enter_ns[FrameTrace::TRACK] = t;
+  t += kMs;
+  trace.exit_ns[FrameTrace::TRACK] = t;
+  return trace;
+}
+}  // namespace
+
+TEST(LatencyStatsTest, segments)
+{
+  auto durations = LatencyStats::segments(makeTrace(5, 3));
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::CAPTURE], 2);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::TO_DETECTOR], 1);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::DETECT], 5);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::TO_PROCESSOR], 1);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::TF_WAIT], 3);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::TRACK], 1);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::TOTAL], 13);
+}
+
+TEST(LatencyStatsTest, missing_camera_trace_starts_at_stamp)
+{
+  auto durations = LatencyStats::segments(makeTrace(5, 3, false));
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::CAPTURE], 0);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::TO_DETECTOR], 1);
+  EXPECT_DOUBLE_EQ(durations[LatencyStats::TOTAL], 11);
+
+  LatencyStats stats(10);
+  stats.add(makeTrace(5, 3, false));
+  stats.add(makeTrace(5, 3));
+  EXPECT_EQ(stats.untracedCaptures(), 1u);
+}
+
+TEST(LatencyStatsTest, incomplete_trace_is_ignored)
+{
+  LatencyStats stats(10);
+  auto trace = makeTrace(5, 3);
+  trace.exit_ns[FrameTrace::TRACK] = 0;
+  EXPECT_FALSE(stats.add(trace));
+  EXPECT_EQ(stats.size(), 0u);
+}
+
+TEST(LatencyStatsTest, percentiles)
+{
+  LatencyStats stats(100);
+  for (int i = 1; i <= 100; i++) {
+    stats.add(makeTrace(i, 0));
+  }
+  EXPECT_DOUBLE_EQ(stats.percentile(LatencyStats::DETECT, 50), 50);
+  EXPECT_DOUBLE_EQ(stats.percentile(LatencyStats::DETECT, 99), 99);
+  EXPECT_DOUBLE_EQ(stats.percentile(LatencyStats::DETECT, 100), 100);
+  EXPECT_DOUBLE_EQ(stats.percentile(LatencyStats::DETECT, 0), 1);
+}
+
+TEST(LatencyStatsTest, window_slides)
+{
+  LatencyStats stats(10);
+  for (int i = 0; i < 10; i++) {
+    stats.add(makeTrace(1, 0, false));
+  }
+  for (int i = 0; i < 10; i++) {
+    stats.add(makeTrace(20, 0));
+  }
+  EXPECT_EQ(stats.size(), 10u);
+  EXPECT_EQ(stats.untracedCaptures(), 0u);
+  EXPECT_DOUBLE_EQ(stats.percentile(LatencyStats::DETECT, 0), 20);
+}
+
+TEST(LatencyStatsTest, tail_is_attributed_to_its_stage)
+{
+  // 2% of the frames wait 30ms for their transform, the rest are slow to detect only slightly
+  LatencyStats stats(100);
+  for (int i = 0; i < 98; i++) {
+    stats.add(makeTrace(6, 0));
+  }
+  stats.add(makeTrace(5, 30));
+  stats.add(makeTrace(5, 30));
+
+  auto tail = stats.tailBreakdown(99);
+  EXPECT_DOUBLE_EQ(tail[LatencyStats::TF_WAIT], 30);
+  EXPECT_DOUBLE_EQ(tail[LatencyStats::DETECT], 5);
+  EXPECT_DOUBLE_EQ(stats.percentile(LatencyStats::TF_WAIT, 50), 0);
+}
@@ -0,0 +1,48 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+// STD
+#include <iostream>
+#include <vector>
+
+#include "armor_processor/kalman_filter.hpp"
+#include "armor_processor/tracker.hpp"
+#include "auto_aim_utils/perf_regression.hpp"
+#include "tracking_fixtures.hpp"
+
+using rm_auto_aim::KalmanFilter;
+using rm_auto_aim::Tracker;
+using rm_auto_aim::fixtures::kDt;
+
+TEST(PerfRegressionTest, tracking)
+{
+  std::vector<auto_aim_utils::BenchmarkResult> results;
+
+  auto matrices = rm_auto_aim::fixtures::makeMatrices();
+  KalmanFilter kf(matrices);
+  kf.init(Eigen::Matrix<double, 6, 1>::Zero());
+  Eigen::Vector3d z(3.0, 0.5, 0.2);
+  results.push_back(auto_aim_utils::runBenchmark("kalman_filter", [&]() {
+    kf.predict(matrices.F);
+    kf.update(z);
+  }));
+
+  Tracker tracker(matrices, 0.2, 5, 10);
+  // A target moving sideways among two other armors
+  rm_auto_aim::fixtures::SceneOptions scene;
+  scene.armors = 3;
+  auto frames = rm_auto_aim::fixtures::makeFrames(scene);
+  tracker.init(frames[0]);
+  size_t frame = 0;
+  results.push_back(auto_aim_utils::runBenchmark("tracker_update", [&]() {
+    tracker.update(frames[frame++ % frames.size()], kDt);
+  }));
+
+  auto comparison = auto_aim_utils::checkBaseline(results, PERF_BASELINE_PATH);
+  std::cout << comparison.report;
+  EXPECT_FALSE(comparison.regressed) << comparison.report;
+  if (comparison.missing_baseline) {
+    GTEST_SKIP() << "No baseline for this machine class";
+  }
+}
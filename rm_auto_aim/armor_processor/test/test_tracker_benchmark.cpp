@@ -0,0 +1,175 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+#include <rclcpp/clock.hpp>
+
+// STD
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "armor_processor/kalman_filter.hpp"
+#include "armor_processor/spin_observer.hpp"
+#include "armor_processor/tracker.hpp"
+#include "auto_aim_utils/allocation_counter.hpp"
+#include "auto_aim_utils/perf_regression.hpp"
+#include "tracking_fixtures.hpp"
+
+using rm_auto_aim::KalmanFilter;
+using rm_auto_aim::SpinObserver;
+using rm_auto_aim::Tracker;
+using rm_auto_aim::fixtures::kDt;
+using rm_auto_aim::fixtures::makeMatrices;
+
+namespace
+{
+// Frames in a sequence, played in a loop
+constexpr int kSequenceFrames = 1000;
+// Calls timed together per sample, and calls counted for allocations
+constexpr int kBatch = 100;
+constexpr int kAllocationCalls = 10000;
+constexpr int kTrackingThreshold = 5;
+
+enum class Pattern {
+  // The tracked armor moves smoothly and is matched every frame
+  MATCHED,
+  // The tracked armor jumps beyond max_match_distance every frame and is found again by its
+  // number, resetting the KF, as while the target spins
+  RESET,
+  // Every other frame is empty after the tracker reached TRACKING, only predicting
+  GAPS,
+};
+
+// The tracked armor (number 3) first, then decoys of other numbers farther from the center
+std::vector<Tracker::Armors::SharedPtr> makeFrames(int armor_count, Pattern pattern)
+{
+  rm_auto_aim::fixtures::SceneOptions options;
+  options.frames = kSequenceFrames;
+  options.armors = armor_count;
+  options.decoy_spacing = 0.6;
+  options.decoy_center_distance = 50.0;
+  options.sway = 0.3;
+  options.noise = 0.005;
+  return rm_auto_aim::fixtures::makeFrames(
+    options, [pattern](int i, std::vector<Tracker::Armor> & armors) {
+      if (pattern == Pattern::GAPS && i > kTrackingThreshold && i % 2 == 1) {
+        armors.clear();
+      }
+      if (pattern == Pattern::RESET && i % 2 == 1) {
+        for (auto & armor : armors) {
+          armor.position.x += 0.5;
+        }
+      }
+    });
+}
+
+// Time fn per call and count its heap allocations per call, then print a row of the report
+void bench(const std::string & name, const std::function<void()> & fn)
+{
+  auto_aim_utils::BenchmarkOptions options;
+  options.warm_up = 1000;
+  options.iterations = 200;
+  options.batch = kBatch;
+  auto result = auto_aim_utils::runBenchmark(name, fn, options);
+
+  auto_aim_utils::AllocationScope scope;
+  for (int i = 0; i < kAllocationCalls; i++) {
+    fn();
+  }
+  auto stats = scope.stop();
+
+  std::printf(
+    "%-36s %10.1f  [%8.1f, %8.1f] %12.3f\n", name.c_str(), result.median_us * 1e3,
+    result.ci_low_us * 1e3, result.ci_high_us * 1e3,
+    static_cast<double>(stats.allocations) / kAllocationCalls);
+}
+
+void printHeader()
+{
+  std::printf("%-36s %10s  %20s %12s\n", "benchmark", "ns/op", "95% CI", "allocs/op");
+}
+}  // namespace
+
+TEST(TrackerBenchmark, kalman_filter)
+{
+  printHeader();
+  auto matrices = makeMatrices();
+  KalmanFilter kf(matrices);
+  Eigen::Matrix<double, 6, 1> x0 = Eigen::Matrix<double, 6, 1>::Zero();
+  kf.init(x0);
+  Eigen::Vector3d z(3.0, 0.3, 0.2);
+
+  bench("kf_predict", [&]() { kf.predict(matrices.F); });
+  bench("kf_update", [&]() { kf.update(z); });
+  bench("kf_predict_update", [&]() {
+    kf.predict(matrices.F);
+    kf.update(z);
+  });
+  bench("kf_init", [&]() { kf.init(x0); });
+}
+
+TEST(TrackerBenchmark, tracker_update)
+{
+  printHeader();
+  struct Case
+  {
+    const char * name;
+    Pattern pattern;
+  };
+  for (const auto & c : {Case{"matched", Pattern::MATCHED}, Case{"reset", Pattern::RESET},
+                         Case{"gaps", Pattern::GAPS}}) {
+    for (int armor_count : {1, 2, 4, 8}) {
+      Tracker tracker(makeMatrices(), 0.2, kTrackingThreshold, 1000000);
+      auto frames = makeFrames(armor_count, c.pattern);
+      tracker.init(frames[0]);
+      size_t frame = 0;
+      bench(
+        std::string("tracker_update_") + c.name + "_" + std::to_string(armor_count),
+        [&]() { tracker.update(frames[frame++ % frames.size()], kDt); });
+      EXPECT_NE(tracker.tracker_state, Tracker::LOST);
+    }
+  }
+
+  // Choosing the armor closest to the image center and initializing the KF, as after LOST
+  for (int armor_count : {1, 8}) {
+    Tracker tracker(makeMatrices(), 0.2, kTrackingThreshold, 5);
+    auto frames = makeFrames(armor_count, Pattern::MATCHED);
+    size_t frame = 0;
+    bench(
+      "tracker_init_" + std::to_string(armor_count),
+      [&]() { tracker.init(frames[frame++ % frames.size()]); });
+  }
+}
+
+TEST(TrackerBenchmark, spin_observer_update)
+{
+  printHeader();
+  auto clock = std::make_shared<rclcpp::Clock>(RCL_ROS_TIME);
+
+  // Target at 3 m, either moving slowly or jumping between the armors of a spinning robot
+  for (bool spinning : {false, true}) {
+    std::vector<auto_aim_interfaces::msg::Target> targets(kSequenceFrames);
+    for (int i = 0; i < kSequenceFrames; i++) {
+      auto & target = targets[i];
+      target.header.stamp.sec = 1000 + i / 100;
+      target.header.stamp.nanosec = (i % 100) * 10000000u;
+      target.header.frame_id = "shooter_link";
+      target.tracking = true;
+      double yaw = spinning ? 0.3 * ((i / 10) % 2) : 0.001 * i;
+      target.position.x = 3.0 * std::cos(yaw);
+      target.position.y = 3.0 * std::sin(yaw);
+    }
+
+    SpinObserver observer(clock, 0.2, 0.5, 0.3);
+    std::vector<auto_aim_interfaces::msg::Target> work(1);
+    size_t frame = 0;
+    bench(spinning ? "spin_observer_update_spinning" : "spin_observer_update_steady", [&]() {
+      work[0] = targets[frame++ % targets.size()];
+      observer.update(work[0]);
+    });
+  }
+}
@@ -0,0 +1,83 @@
+// Copyright 2022 Chen Jun
+
+#ifndef ARMOR_PROCESSOR__TEST__TRACKING_FIXTURES_HPP_
+#define ARMOR_PROCESSOR__TEST__TRACKING_FIXTURES_HPP_
+
+// STD
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "armor_processor/kalman_filter.hpp"
+#include "armor_processor/tracker.hpp"
+
+// Kalman filter model and synthetic armor sequences shared by the allocation, benchmark and perf
+// regression tests
+namespace rm_auto_aim
+{
+namespace fixtures
+{
+constexpr double kDt = 0.01;
+
+// The constant velocity model of the processor node: 6 states (position, velocity),
+// 3 measurements (position)
+inline KalmanFilterMatrices makeMatrices()
+{
+  Eigen::MatrixXd f = Eigen::MatrixXd::Identity(6, 6);
+  f(0, 3) = f(1, 4) = f(2, 5) = kDt;
+  Eigen::MatrixXd h = Eigen::MatrixXd::Identity(3, 6);
+  Eigen::MatrixXd q = Eigen::MatrixXd::Identity(6, 6) * 1e-2;
+  Eigen::MatrixXd r = Eigen::MatrixXd::Identity(3, 3) * 5e-2;
+  Eigen::MatrixXd p = Eigen::MatrixXd::Identity(6, 6);
+  return KalmanFilterMatrices{f, h, q, r, p};
+}
+
+struct SceneOptions
+{
+  int frames = 1000;
+  // The tracked armor (number 3) first, then decoys of the following numbers
+  int armors = 1;
+  // Sideways spacing (m) and image center distance (px) added for each decoy
+  double decoy_spacing = 1.5;
+  double decoy_center_distance = 100.0;
+  // Amplitude (m) of the sideways motion and standard deviation (m) of the position noise
+  double sway = 0.5;
+  double noise = 0.01;
+};
+
+// Armors at 3 m moving sideways together, frame i at i * kDt. edit may change the armors of
+// each frame, e.g. to drop or move some of them. Built up front so that tests do not count or
+// time the messages themselves.
+inline std::vector<Tracker::Armors::SharedPtr> makeFrames(
+  const SceneOptions & options,
+  const std::function<void(int, std::vector<Tracker::Armor> &)> & edit = nullptr)
+{
+  std::default_random_engine engine;
+  std::normal_distribution<double> noise(0.0, options.noise);
+  std::vector<Tracker::Armors::SharedPtr> frames;
+  for (int i = 0; i < options.frames; i++) {
+    auto msg = std::make_shared<Tracker::Armors>();
+    for (int j = 0; j < options.armors; j++) {
+      Tracker::Armor armor;
+      armor.number = 3 + j;
+      armor.distance_to_image_center = 10.0 + options.decoy_center_distance * j;
+      armor.position.x = 3.0 + noise(engine);
+      armor.position.y =
+        options.sway * std::sin(i * kDt) + options.decoy_spacing * j + noise(engine);
+      armor.position.z = 0.2 + noise(engine);
+      msg->armors.push_back(armor);
+    }
+    if (edit) {
+      edit(i, msg->armors);
+    }
+    frames.push_back(msg);
+  }
+  return frames;
+}
+
+}  // namespace fixtures
+}  // namespace rm_auto_aim
+
+#endif  // ARMOR_PROCESSOR__TEST__TRACKING_FIXTURES_HPP_
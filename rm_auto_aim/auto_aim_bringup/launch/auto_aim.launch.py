@@ -43,4 +43,12 @@ def generate_launch_description():
                 'debug': LaunchConfiguration('debug'),
             }],
         ),
+
+        Node(
+            package='armor_processor',
+            executable='latency_tracer_node',
+            output='screen',
+            emulate_tty=True,
+            parameters=[LaunchConfiguration('params_file')],
+        ),
     ])
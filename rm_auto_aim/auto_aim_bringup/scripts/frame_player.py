@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+# Copyright 2022 Chen Jun
+# Licensed under the MIT License.
+
+"""
+Publish recorded or synthetic camera frames at a given rate, standing in for hik_camera.
+
+Publishes /image_raw, /camera_info and the /camera/trace that starts each frame's latency
+trace. With frames_dir empty, the frames show two armors of detect_color moving sideways.
+The rate parameter can be changed while running.
+"""
+
+import glob
+import os
+import threading
+import time
+
+from auto_aim_interfaces.msg import FrameTrace
+import numpy as np
+from rcl_interfaces.msg import SetParametersResult
+import rclpy
+from rclpy.node import Node
+from rclpy.qos import qos_profile_sensor_data
+from sensor_msgs.msg import CameraInfo
+from sensor_msgs.msg import Image
+
+# Number of distinct synthetic frames played in a loop
+SYNTHETIC_FRAMES = 60
+
+
+def synthetic_frame(width, height, color, offset):
+    """Two small armors with lights of the given color (0-red, 1-blue) in an RGB image."""
+    import cv2
+
+    light = (255, 200, 200) if color == 0 else (200, 200, 255)
+    img = np.full((height, width, 3), 20, dtype=np.uint8)
+    light_length = height // 16
+    light_width = max(light_length // 5, 2)
+    y = height // 2
+    for center in (width // 3 + offset, 2 * width // 3 + offset):
+        for x in (center - light_length, center + light_length):
+            cv2.rectangle(img, (x - light_width // 2, y - light_length // 2),
+                          (x + light_width // 2, y + light_length // 2), light, cv2.FILLED)
+        cv2.putText(img, '3', (center - light_length // 3, y + light_length // 3),
+                    cv2.FONT_HERSHEY_SIMPLEX, light_length / 30.0, (120, 120, 120), 2)
+    return img
+
+
+def recorded_frames(frames_dir, width, height):
+    import cv2
+
+    frames = []
+    for path in sorted(glob.glob(os.path.join(frames_dir, '*'))):
+        img = cv2.imread(path, cv2.IMREAD_COLOR)
+        if img is None:
+            continue
+        frames.append(cv2.cvtColor(cv2.resize(img, (width, height)), cv2.COLOR_BGR2RGB))
+    return frames
+
+
+class FramePlayer(Node):
+
+    def __init__(self):
+        super().__init__('frame_player')
+        self.rate = self.declare_parameter('rate', 30.0).value
+        frames_dir = self.declare_parameter('frames_dir', '').value
+        width = self.declare_parameter('width', 640).value
+        height = self.declare_parameter('height', 480).value
+        color = self.declare_parameter('detect_color', 0).value
+        frame_id = self.declare_parameter('frame_id', 'camera_optical_frame').value
+
+        if frames_dir:
+            images = recorded_frames(frames_dir, width, height)
+            if not images:
+                raise RuntimeError('No images in {}'.format(frames_dir))
+        else:
+            images = [synthetic_frame(width, height, color, i - SYNTHETIC_FRAMES // 2)
+                      for i in range(SYNTHETIC_FRAMES)]
+        # Messages are built once, only the stamps change while playing
+        self.images = []
+        for img in images:
+            msg = Image()
+            msg.header.frame_id = frame_id
+            msg.height, msg.width = img.shape[:2]
+            msg.encoding = 'rgb8'
+            msg.step = msg.width * 3
+            msg.data = img.tobytes()
+            self.images.append(msg)
+
+        self.camera_info = CameraInfo()
+        self.camera_info.header.frame_id = frame_id
+        self.camera_info.width, self.camera_info.height = width, height
+        focal = float(width)
+        self.camera_info.k = [focal, 0.0, width / 2.0, 0.0, focal, height / 2.0, 0.0, 0.0, 1.0]
+        self.camera_info.d = [0.0] * 5
+        self.camera_info.distortion_model = 'plumb_bob'
+
+        self.image_pub = self.create_publisher(Image, '/image_raw', qos_profile_sensor_data)
+        self.info_pub = self.create_publisher(CameraInfo, '/camera_info', qos_profile_sensor_data)
+        self.trace_pub = self.create_publisher(FrameTrace, '/camera/trace',
+                                               qos_profile_sensor_data)
+        self.add_on_set_parameters_callback(self.on_parameters)
+
+        self.get_logger().info('Playing {} {} frames at {} Hz'.format(
+            len(self.images), 'recorded' if frames_dir else 'synthetic', self.rate))
+        self.running = True
+        self.thread = threading.Thread(target=self.play, daemon=True)
+        self.thread.start()
+
+    def on_parameters(self, params):
+        for param in params:
+            if param.name == 'rate':
+                if param.value <= 0:
+                    return SetParametersResult(successful=False, reason='rate must be > 0')
+                self.rate = param.value
+                self.get_logger().info('Rate set to {} Hz'.format(self.rate))
+        return SetParametersResult(successful=True)
+
+    def play(self):
+        # Absolute deadlines, so that a late frame does not shift all later ones
+        frame_number = 0
+        next_time = time.monotonic()
+        while self.running and rclpy.ok():
+            frame_number += 1
+            msg = self.images[frame_number % len(self.images)]
+            stamp = self.get_clock().now().to_msg()
+            trace = FrameTrace()
+            trace.frame_number = frame_number
+            trace.capture_stamp = stamp
+            now_ns = time.time_ns()
+            trace.enter_ns[FrameTrace.CAPTURE] = now_ns
+            trace.exit_ns[FrameTrace.CAPTURE] = now_ns
+            self.trace_pub.publish(trace)
+
+            msg.header.stamp = stamp
+            self.camera_info.header.stamp = stamp
+            self.info_pub.publish(self.camera_info)
+            self.image_pub.publish(msg)
+
+            next_time += 1.0 / self.rate
+            delay = next_time - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            else:
+                # Fell behind, do not try to catch up with a burst
+                next_time = time.monotonic()
+
+
+def main(args=None):
+    rclpy.init(args=args)
+    node = FramePlayer()
+    try:
+        rclpy.spin(node)
+    except KeyboardInterrupt:
+        pass
+    node.running = False
+    node.thread.join()
+    node.destroy_node()
+    rclpy.shutdown()
+
+
+if __name__ == '__main__':
+    main()
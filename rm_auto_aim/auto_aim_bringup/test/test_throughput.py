@@ -0,0 +1,231 @@
+# Copyright 2022 Chen Jun
+# Licensed under the MIT License.
+
+"""
+End-to-end throughput and latency of /image_raw -> /detector/armors -> /processor/target.
+
+The frame player feeds synthetic frames at increasing rates. Each rate is measured for
+MEASURE_SECONDS after SETTLE_SECONDS, by the frames offered (/camera/trace), the targets
+delivered and their latency from the image stamp, counting only frames stamped within the
+measurement. The saturation rate is the highest rate the chain keeps up with.
+"""
+
+import os
+import threading
+import time
+import unittest
+
+from ament_index_python.packages import get_package_share_directory
+from auto_aim_interfaces.msg import FrameTrace
+from auto_aim_interfaces.msg import Target
+import launch
+import launch_ros.actions
+import launch_testing.actions
+import launch_testing.asserts
+import pytest
+from rcl_interfaces.msg import Parameter
+from rcl_interfaces.msg import ParameterType
+from rcl_interfaces.msg import ParameterValue
+from rcl_interfaces.srv import SetParameters
+import rclpy
+from rclpy.executors import SingleThreadedExecutor
+from rclpy.qos import qos_profile_sensor_data
+
+# Offered frame rates, in Hz
+RATES = [25.0, 50.0, 100.0, 200.0, 400.0]
+SETTLE_SECONDS = 1.0
+MEASURE_SECONDS = 3.0
+# A rate is kept up with if this share of its frames is delivered within the latency limit
+MIN_DELIVERED_RATIO = 0.95
+MAX_P99_LATENCY_MS = 50.0
+# The saturation rate depends on the machine and is only reported, unless a minimum is given
+# in AUTO_AIM_MIN_SATURATION_RATE (Hz), e.g. on a reference machine
+MIN_SATURATION_RATE = float(os.environ.get('AUTO_AIM_MIN_SATURATION_RATE', '0'))
+
+
+@pytest.mark.launch_test
+def generate_test_description():
+    params_file = os.path.join(
+        get_package_share_directory('auto_aim_bringup'), 'config/default.yaml')
+    return launch.LaunchDescription([
+        launch_ros.actions.Node(
+            package='armor_detector',
+            executable='rgb_detector_node',
+            name='armor_detector',
+            parameters=[params_file, {'debug': False, 'detect_color': 0}],
+        ),
+        launch_ros.actions.Node(
+            package='armor_processor',
+            executable='armor_processor_node',
+            name='armor_processor',
+            parameters=[params_file, {'debug': False}],
+        ),
+        # Camera looking along the x axis of shooter_link
+        launch_ros.actions.Node(
+            package='tf2_ros',
+            executable='static_transform_publisher',
+            arguments=['0', '0', '0', '-0.5', '0.5', '-0.5', '0.5',
+                       'shooter_link', 'camera_optical_frame'],
+        ),
+        launch_ros.actions.Node(
+            package='auto_aim_bringup',
+            executable='frame_player.py',
+            name='frame_player',
+            parameters=[{'rate': RATES[0], 'detect_color': 0}],
+        ),
+        launch_testing.actions.ReadyToTest(),
+    ])
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(int(p / 100.0 * len(ordered)), len(ordered) - 1)]
+
+
+class Measurement:
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset(0)
+
+    def reset(self, start_ns):
+        """Count the frames stamped from start_ns on, until close()."""
+        with self.lock:
+            self.start_ns = start_ns
+            self.end_ns = None
+            self.offered = 0
+            self.latencies_ms = []
+            self.detect_ms = []
+
+    def close(self, end_ns):
+        """Ignore the frames stamped from end_ns on, their targets may still arrive."""
+        with self.lock:
+            self.end_ns = end_ns
+
+    def in_window(self, stamp):
+        stamp_ns = stamp.sec * 10**9 + stamp.nanosec
+        return self.start_ns <= stamp_ns and (self.end_ns is None or stamp_ns < self.end_ns)
+
+    def on_trace(self, msg):
+        with self.lock:
+            if self.in_window(msg.capture_stamp):
+                self.offered += 1
+
+    def on_target(self, msg, now_ns):
+        stamp_ns = msg.header.stamp.sec * 10**9 + msg.header.stamp.nanosec
+        trace = msg.trace
+        with self.lock:
+            # Targets of frames offered before the reset would push the ratio above 1
+            if not self.in_window(msg.header.stamp):
+                return
+            self.latencies_ms.append((now_ns - stamp_ns) * 1e-6)
+            if trace.enter_ns[FrameTrace.DETECT] > 0:
+                self.detect_ms.append(
+                    (trace.exit_ns[FrameTrace.DETECT] - trace.enter_ns[FrameTrace.DETECT]) * 1e-6)
+
+    def snapshot(self):
+        with self.lock:
+            return self.offered, list(self.latencies_ms), list(self.detect_ms)
+
+
+class TestThroughput(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        rclpy.init()
+        cls.node = rclpy.create_node('throughput_test')
+        cls.measurement = Measurement()
+        cls.node.create_subscription(
+            FrameTrace, '/camera/trace', cls.measurement.on_trace, qos_profile_sensor_data)
+        cls.node.create_subscription(
+            Target, '/processor/target',
+            lambda msg: cls.measurement.on_target(msg, cls.node.get_clock().now().nanoseconds),
+            qos_profile_sensor_data)
+        cls.set_rate_client = cls.node.create_client(
+            SetParameters, '/frame_player/set_parameters')
+        cls.executor = SingleThreadedExecutor()
+        cls.executor.add_node(cls.node)
+        cls.spin_thread = threading.Thread(target=cls.executor.spin, daemon=True)
+        cls.spin_thread.start()
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.executor.shutdown()
+        cls.node.destroy_node()
+        rclpy.shutdown()
+
+    def set_rate(self, rate):
+        request = SetParameters.Request()
+        request.parameters = [Parameter(
+            name='rate',
+            value=ParameterValue(type=ParameterType.PARAMETER_DOUBLE, double_value=rate))]
+        future = self.set_rate_client.call_async(request)
+        deadline = time.monotonic() + 5.0
+        while not future.done() and time.monotonic() < deadline:
+            time.sleep(0.01)
+        self.assertTrue(future.done() and future.result().results[0].successful,
+                        'Could not set the frame player rate to {}'.format(rate))
+
+    def wait_for_targets(self, timeout):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            if self.measurement.snapshot()[1]:
+                return True
+            time.sleep(0.1)
+        return False
+
+    def test_throughput(self):
+        self.assertTrue(self.set_rate_client.wait_for_service(timeout_sec=30.0),
+                        'Frame player did not start')
+        # The classifier loads in the background, frames are dropped until it is ready
+        self.assertTrue(self.wait_for_targets(30.0), 'No /processor/target received')
+
+        rows = []
+        for rate in RATES:
+            self.set_rate(rate)
+            time.sleep(SETTLE_SECONDS)
+            self.measurement.reset(self.node.get_clock().now().nanoseconds)
+            time.sleep(MEASURE_SECONDS)
+            self.measurement.close(self.node.get_clock().now().nanoseconds)
+            # Give the last frames of the window time to come through
+            time.sleep(MAX_P99_LATENCY_MS * 1e-3)
+            offered, latencies, detect = self.measurement.snapshot()
+            delivered_ratio = len(latencies) / offered if offered else 0.0
+            rows.append({
+                'rate': rate,
+                'offered': offered / MEASURE_SECONDS,
+                'delivered': len(latencies) / MEASURE_SECONDS,
+                'ratio': delivered_ratio,
+                'p50': percentile(latencies, 50) if latencies else float('inf'),
+                'p99': percentile(latencies, 99) if latencies else float('inf'),
+                'detect': sum(detect) / len(detect) if detect else 0.0,
+            })
+
+        kept_up = [row for row in rows
+                   if row['ratio'] >= MIN_DELIVERED_RATIO and row['p99'] <= MAX_P99_LATENCY_MS]
+        saturation = max((row['rate'] for row in kept_up), default=0.0)
+
+        report = ['{:>8} {:>10} {:>10} {:>9} {:>9} {:>9} {:>10}'.format(
+            'rate', 'offered', 'delivered', 'ratio', 'p50(ms)', 'p99(ms)', 'detect(ms)')]
+        for row in rows:
+            report.append('{rate:>8.0f} {offered:>10.1f} {delivered:>10.1f} {ratio:>9.2f} '
+                          '{p50:>9.2f} {p99:>9.2f} {detect:>10.2f}'.format(**row))
+        report.append('Saturation rate: {:.0f} Hz'.format(saturation))
+        if any(row['offered'] < MIN_DELIVERED_RATIO * row['rate'] for row in kept_up):
+            report.append('The frame player fell behind, the saturation rate is a lower bound')
+        report = '\n'.join(report)
+        print(report)
+
+        base = rows[0]
+        self.assertGreaterEqual(base['ratio'], MIN_DELIVERED_RATIO, report)
+        self.assertLessEqual(base['p99'], MAX_P99_LATENCY_MS, report)
+        if MIN_SATURATION_RATE > 0:
+            self.assertGreaterEqual(saturation, MIN_SATURATION_RATE, report)
+
+
+@launch_testing.post_shutdown_test()
+class TestShutdown(unittest.TestCase):
+
+    def test_exit_codes(self, proc_info):
+        launch_testing.asserts.assertExitCodes(
+            proc_info, allowable_exit_codes=[0, -2, -15])
@@ -0,0 +1,18 @@
+# Link the allocation counter of auto_aim_utils into a test executable. It replaces malloc and
+# the global operator new of the whole executable, so never link it into a library.
+function(auto_aim_utils_link_allocation_counter target)
+  target_link_libraries(${target}
+    "${auto_aim_utils_DIR}/../../../lib/libauto_aim_utils_allocation_counter.a"
+    ${CMAKE_DL_LIBS})
+  target_include_directories(${target} PRIVATE ${auto_aim_utils_INCLUDE_DIRS})
+  # Export the symbols of the executable, so that the reported call stacks have names
+  set_target_properties(${target} PROPERTIES ENABLE_EXPORTS ON)
+endfunction()
+
+# Link the benchmark statistics and baseline comparison of the perf regression tests
+function(auto_aim_utils_link_perf_regression target)
+  target_link_libraries(${target}
+    "${auto_aim_utils_DIR}/../../../lib/libauto_aim_utils_perf_regression.a"
+    ${auto_aim_utils_LIBRARIES})
+  target_include_directories(${target} PRIVATE ${auto_aim_utils_INCLUDE_DIRS})
+endfunction()
@@ -0,0 +1,46 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__ALLOCATION_COUNTER_HPP_
+#define AUTO_AIM_UTILS__ALLOCATION_COUNTER_HPP_
+
+// STD
+#include <cstddef>
+#include <string>
+
+namespace auto_aim_utils
+{
+// Heap allocations of all threads while an AllocationScope is active. Only for tests: the
+// auto_aim_utils_allocation_counter library interposes malloc and the global operator new of
+// the executable it is linked into, see auto_aim_utils_link_allocation_counter().
+struct AllocationStats
+{
+  size_t allocations = 0;
+  size_t frees = 0;
+  size_t bytes = 0;
+};
+
+class AllocationScope
+{
+public:
+  // Start counting, scopes must not overlap
+  AllocationScope();
+  ~AllocationScope();
+
+  AllocationScope(const AllocationScope &) = delete;
+  AllocationScope & operator=(const AllocationScope &) = delete;
+
+  // Stop counting and return what was counted
+  AllocationStats stop();
+
+  // Call stacks of the first allocations in the scope, for failure messages
+  std::string report() const;
+
+private:
+  bool active_;
+  AllocationStats stats_;
+};
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__ALLOCATION_COUNTER_HPP_
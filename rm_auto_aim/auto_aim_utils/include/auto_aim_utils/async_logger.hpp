@@ -0,0 +1,182 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__ASYNC_LOGGER_HPP_
+#define AUTO_AIM_UTILS__ASYNC_LOGGER_HPP_
+
+#include <rcutils/logging.h>
+
+// STD
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace auto_aim_utils
+{
+// One logging statement of one logger. Its first message opens a window of period_ns, calls
+// within the window are only counted and reported together when it ends. The strings are
+// copies, so that a site does not point into a library that has been unloaded.
+struct LogSite
+{
+  LogSite(
+    int severity, const char * logger_name, const char * file, const char * function, int line,
+    int64_t period_ms);
+
+  // Whether this call opens a new window and should be logged, otherwise it is only counted
+  bool claim();
+
+  const int severity;
+  const std::string logger_name;
+  const std::string file;
+  const std::string function;
+  const int line;
+  const int64_t period_ns;
+
+  std::atomic<int64_t> window_end_ns;
+  std::atomic<uint64_t> suppressed;
+};
+
+class AsyncLogger;
+
+// The sites of one logging statement by logger, held in a function-local static of the
+// statement. Zero-initialized and trivially destructible, it only caches pointers to sites
+// owned by the AsyncLogger, so nothing refers to it once its library is unloaded.
+struct LogSiteCache
+{
+  static constexpr int kSize = 4;
+
+  // The site of logger_name, from the cache or, for more than kSize loggers, from the logger
+  LogSite & get(
+    AsyncLogger & async_logger, int severity, const char * logger_name, const char * file,
+    const char * function, int line, int64_t period_ms);
+
+  std::atomic<LogSite *> sites[kSize];
+};
+
+// Logging that costs the calling thread a clock read, or a vsnprintf into a preallocated ring
+// slot at most once per period of a call site (see LogSite::claim()). A background thread
+// drains the ring into rcutils (stdout and /rosout) and reports what was suppressed as
+// "message (x37 in the last 1.0s)".
+class AsyncLogger
+{
+public:
+  using Sink = std::function<void(const LogSite & site, const char * text)>;
+
+  // Messages longer than this are truncated
+  static constexpr size_t kMaxMessageLength = 256;
+
+  // capacity is rounded up to a power of two. Messages that find the ring full are counted as
+  // suppressed and the drops are reported.
+  explicit AsyncLogger(
+    Sink sink = rcutilsSink, size_t capacity = 256,
+    std::chrono::milliseconds poll_period = std::chrono::milliseconds(20));
+  ~AsyncLogger();
+
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger & operator=(const AsyncLogger &) = delete;
+
+  // Process-wide logger used by the AUTO_AIM_LOG macros, started on first use and never
+  // destroyed. At exit its thread is stopped and everything queued is written out; messages
+  // logged after that stay queued.
+  static AsyncLogger & instance();
+
+  // The site of a logging statement for a logger, created on first use and never freed, so
+  // that it outlives the library the statement is in. Takes a mutex, see LogSiteCache.
+  LogSite & site(
+    int severity, const char * logger_name, const char * file, const char * function, int line,
+    int64_t period_ms);
+
+  // Queue a message of a site that claimed it. Safe to call from any number of threads, never
+  // blocks or allocates.
+  void log(LogSite & site, const char * format, ...) __attribute__((format(printf, 3, 4)));
+
+  // Write out everything queued and all suppressed counts, windows open or not
+  void flush();
+
+  // Messages lost because the ring was full
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  static void rcutilsSink(const LogSite & site, const char * text);
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    LogSite * site;
+    // Calls of the site this message stands for
+    uint64_t count;
+    char text[kMaxMessageLength];
+  };
+
+  // State of the sites seen so far, only touched while holding drain_mutex_
+  struct SiteState
+  {
+    std::string last_text;
+    int64_t last_report_ns;
+  };
+
+  // Join the drain thread and flush
+  void stop();
+  void run();
+  void drain(int64_t now_ns, bool force);
+  void report(LogSite & site, SiteState & state, uint64_t count, int64_t now_ns);
+
+  Sink sink_;
+  std::chrono::milliseconds poll_period_;
+
+  // Bounded multi-producer queue (Vyukov), consumed under drain_mutex_
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  alignas(64) std::atomic<size_t> enqueue_pos_;
+  alignas(64) size_t dequeue_pos_;
+
+  std::atomic<uint64_t> dropped_;
+  uint64_t reported_dropped_;
+  LogSite drop_site_;
+
+  std::mutex drain_mutex_;
+  std::unordered_map<LogSite *, SiteState> sites_;
+
+  // Sites by statement and logger, see site()
+  std::mutex registry_mutex_;
+  std::unordered_map<std::string, LogSite *> registry_;
+
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+}  // namespace auto_aim_utils
+
+// Log through the process-wide AsyncLogger, at most one message per period_ms of the call
+// site and logger, with the calls in between counted. Calls below the logger's level cost only
+// the level check. The arguments are only evaluated for the calls that are logged. A period of
+// 0 writes every call, still off-thread.
+#define AUTO_AIM_LOG(severity, logger, period_ms, ...)                                         \
+  do {                                                                                         \
+    static auto_aim_utils::LogSiteCache auto_aim_log_sites;                                    \
+    const char * auto_aim_log_name = (logger).get_name();                                      \
+    if (rcutils_logging_logger_is_enabled_for(                                                 \
+          auto_aim_log_name, RCUTILS_LOG_SEVERITY_##severity)) {                               \
+      auto & auto_aim_log_async = auto_aim_utils::AsyncLogger::instance();                     \
+      auto & auto_aim_log_site = auto_aim_log_sites.get(                                       \
+        auto_aim_log_async, RCUTILS_LOG_SEVERITY_##severity, auto_aim_log_name, __FILE__,      \
+        __func__, __LINE__, period_ms);                                                        \
+      if (auto_aim_log_site.claim()) {                                                         \
+        auto_aim_log_async.log(auto_aim_log_site, __VA_ARGS__);                                \
+      }                                                                                        \
+    }                                                                                          \
+  } while (0)
+
+#define AUTO_AIM_LOG_DEBUG(logger, ...) AUTO_AIM_LOG(DEBUG, logger, 1000, __VA_ARGS__)
+#define AUTO_AIM_LOG_INFO(logger, ...) AUTO_AIM_LOG(INFO, logger, 1000, __VA_ARGS__)
+#define AUTO_AIM_LOG_WARN(logger, ...) AUTO_AIM_LOG(WARN, logger, 1000, __VA_ARGS__)
+#define AUTO_AIM_LOG_ERROR(logger, ...) AUTO_AIM_LOG(ERROR, logger, 1000, __VA_ARGS__)
+
+#endif  // AUTO_AIM_UTILS__ASYNC_LOGGER_HPP_
@@ -0,0 +1,39 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__CALLBACK_GROUP_THREAD_HPP_
+#define AUTO_AIM_UTILS__CALLBACK_GROUP_THREAD_HPP_
+
+#include <rclcpp/rclcpp.hpp>
+
+// STD
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "auto_aim_utils/realtime.hpp"
+
+namespace auto_aim_utils
+{
+// Spins a single callback group of a node on its own thread with its own real-time profile.
+// The group must be created with automatically_add_to_executor_with_node = false, so that
+// everything else of the node (parameter events, tf, timers) stays on the regular executor.
+class CallbackGroupThread
+{
+public:
+  // Throws std::runtime_error if the real-time profile fails and config.required is set
+  CallbackGroupThread(
+    rclcpp::Node * node, rclcpp::CallbackGroup::SharedPtr callback_group,
+    const RealtimeConfig & config, const std::string & thread_name);
+
+  ~CallbackGroupThread();
+
+private:
+  rclcpp::executors::SingleThreadedExecutor executor_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__CALLBACK_GROUP_THREAD_HPP_
@@ -0,0 +1,122 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__LIVE_METRICS_HPP_
+#define AUTO_AIM_UTILS__LIVE_METRICS_HPP_
+
+// STD
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace auto_aim_utils
+{
+struct MetricsSegment;
+
+// Latency histograms have 4 buckets per power of two of microseconds, up to about a minute
+constexpr size_t kHistogramBuckets = 104;
+
+size_t histogramBucket(int64_t ns);
+// Lower bound of a bucket in ms
+double histogramBucketMs(size_t bucket);
+// Percentile (0-100) of the bucket counts in ms, the middle of the bucket it falls into
+double histogramPercentileMs(const std::vector<uint64_t> & buckets, double percentile);
+
+// Counters, gauges and latency histograms of a node in a POSIX shared memory segment
+// "/auto_aim_metrics.<name>", for aimtop to read without any cost to the node. The name is the
+// fully qualified name of the node with its '/' replaced by '.', e.g. "/auto_aim_metrics.a.b" for
+// "/a/b", so that nodes of the same name in different namespaces do not collide.
+//
+// The metrics are named up front. Counters and gauges are single atomics that any thread may
+// update. Each histogram is guarded by a seqlock and must only be recorded by one thread at a
+// time; readers retry a copy that raced with an update.
+class LiveMetrics
+{
+public:
+  static constexpr size_t kMaxCounters = 16;
+  static constexpr size_t kMaxGauges = 16;
+  static constexpr size_t kMaxHistograms = 12;
+
+  // Create the segment, replacing a stale one of the same name whose process has exited. Throws
+  // std::runtime_error, also if the segment belongs to a process that is still running.
+  LiveMetrics(
+    const std::string & name, const std::vector<std::string> & counters,
+    const std::vector<std::string> & gauges, const std::vector<std::string> & histograms);
+  ~LiveMetrics();
+
+  LiveMetrics(const LiveMetrics &) = delete;
+  LiveMetrics & operator=(const LiveMetrics &) = delete;
+
+  // Names aimtop shows for the integral values 0, 1, ... of a gauge, e.g. the states of an enum
+  void setLabels(size_t gauge, const std::vector<std::string> & labels);
+
+  void add(size_t counter, uint64_t n = 1);
+  void set(size_t gauge, double value);
+  void record(size_t histogram, double ms);
+
+  const std::string & segmentName() const { return segment_name_; }
+
+private:
+  void touch();
+
+  std::string segment_name_;
+  MetricsSegment * segment_;
+};
+
+struct MetricsSnapshot
+{
+  struct Gauge
+  {
+    std::string name;
+    double value = 0.0;
+    std::vector<std::string> labels;
+  };
+
+  struct Histogram
+  {
+    std::string name;
+    uint64_t count = 0;
+    double sum_ms = 0.0;
+    // Largest sample since the node started, there is no per-interval max
+    double max_ms = 0.0;
+    std::vector<uint64_t> buckets;
+  };
+
+  std::string name;
+  int pid = 0;
+  // Changes whenever the node is restarted
+  uint64_t id = 0;
+  // Seconds since the node last updated a metric
+  double idle_s = 0.0;
+  std::vector<std::pair<std::string, uint64_t>> counters;
+  std::vector<Gauge> gauges;
+  std::vector<Histogram> histograms;
+};
+
+// Read-only mapping of a LiveMetrics segment
+class LiveMetricsReader
+{
+public:
+  // Throws std::runtime_error if the segment does not exist or has another layout version
+  explicit LiveMetricsReader(const std::string & segment_name);
+  ~LiveMetricsReader();
+
+  LiveMetricsReader(const LiveMetricsReader &) = delete;
+  LiveMetricsReader & operator=(const LiveMetricsReader &) = delete;
+
+  // Copy the metrics out, false if a histogram kept changing while being copied
+  bool read(MetricsSnapshot & snapshot) const;
+
+  // Segment names of all nodes that have created one, including nodes that have crashed
+  static std::vector<std::string> list();
+
+private:
+  const MetricsSegment * segment_;
+};
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__LIVE_METRICS_HPP_
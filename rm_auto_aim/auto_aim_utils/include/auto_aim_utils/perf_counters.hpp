@@ -0,0 +1,101 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__PERF_COUNTERS_HPP_
+#define AUTO_AIM_UTILS__PERF_COUNTERS_HPP_
+
+// STD
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace auto_aim_utils
+{
+// Hardware counters of the calling thread, opened with perf_event_open as one group so that
+// they are scheduled and read together. Only user space is counted, which works with the
+// default kernel.perf_event_paranoid of 2.
+class PerfCounters
+{
+public:
+  enum Counter { CYCLES = 0, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTER_NUM };
+  using Values = std::array<uint64_t, COUNTER_NUM>;
+
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters & operator=(const PerfCounters &) = delete;
+
+  // Start counting the calling thread
+  bool open(std::string & error);
+  bool isOpen() const { return fds_[0] >= 0; }
+  void close();
+
+  // Running totals since open(), scaled up if the kernel had to multiplex the group
+  bool read(Values & values) const;
+
+  static const char * counterName(Counter counter);
+
+private:
+  std::array<int, COUNTER_NUM> fds_;
+};
+
+// Counter deltas of each pipeline stage over the latest frames. Frames are recorded by the
+// thread that recorded the first one, which the counters are opened on; frames on any other
+// thread are skipped. The summary may be taken from another thread.
+class StageCounters
+{
+public:
+  struct StageSummary
+  {
+    std::string stage;
+    size_t samples = 0;
+    // Means per frame
+    std::array<double, PerfCounters::COUNTER_NUM> mean{};
+    double ipc = 0.0;
+    // Misses per thousand instructions
+    double cache_mpki = 0.0;
+    double branch_mpki = 0.0;
+  };
+
+  StageCounters(const std::vector<std::string> & stage_names, size_t history);
+
+  // Mark the start of a frame, false if it is not recorded because the counters are
+  // unavailable (see failed()) or it runs on another thread
+  bool startFrame();
+
+  // Record the counts since the previous mark for the stage
+  void finishStage(size_t stage);
+
+  std::vector<StageSummary> summary() const;
+
+  // Whether the counters could not be opened, error() tells why
+  bool failed() const { return failed_; }
+  const std::string & error() const { return error_; }
+
+private:
+  PerfCounters counters_;
+  std::atomic<bool> failed_;
+  std::string error_;
+  std::thread::id owner_;
+
+  // Marks of the current frame, only touched by the owner thread
+  bool recording_;
+  PerfCounters::Values last_;
+
+  std::vector<std::string> stage_names_;
+  // Ring of deltas per stage, written by the owner thread
+  std::vector<std::vector<PerfCounters::Values>> history_;
+  std::vector<size_t> next_;
+  std::vector<size_t> size_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__PERF_COUNTERS_HPP_
@@ -0,0 +1,36 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__PERF_COUNTERS_MSG_HPP_
+#define AUTO_AIM_UTILS__PERF_COUNTERS_MSG_HPP_
+
+// STD
+#include <vector>
+
+#include "auto_aim_interfaces/msg/perf_counters.hpp"
+#include "auto_aim_utils/perf_counters.hpp"
+
+namespace auto_aim_utils
+{
+inline void toMsg(
+  const std::vector<StageCounters::StageSummary> & summary,
+  auto_aim_interfaces::msg::PerfCounters & msg)
+{
+  msg.stages.resize(summary.size());
+  for (size_t i = 0; i < summary.size(); i++) {
+    auto & stage = msg.stages[i];
+    stage.stage = summary[i].stage;
+    stage.samples = summary[i].samples;
+    stage.cycles = summary[i].mean[PerfCounters::CYCLES];
+    stage.instructions = summary[i].mean[PerfCounters::INSTRUCTIONS];
+    stage.cache_misses = summary[i].mean[PerfCounters::CACHE_MISSES];
+    stage.branch_misses = summary[i].mean[PerfCounters::BRANCH_MISSES];
+    stage.ipc = summary[i].ipc;
+    stage.cache_mpki = summary[i].cache_mpki;
+    stage.branch_mpki = summary[i].branch_mpki;
+  }
+}
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__PERF_COUNTERS_MSG_HPP_
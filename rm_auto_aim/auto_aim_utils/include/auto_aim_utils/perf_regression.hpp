@@ -0,0 +1,100 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__PERF_REGRESSION_HPP_
+#define AUTO_AIM_UTILS__PERF_REGRESSION_HPP_
+
+// STD
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace auto_aim_utils
+{
+struct BenchmarkOptions
+{
+  int warm_up = 50;
+  int iterations = 500;
+  // Calls of fn timed together as one sample, for operations too short to time one by one.
+  // Samples are per call either way.
+  int batch = 1;
+  // CPU to pin the benchmark to, -1 picks AUTO_AIM_PERF_CPU or the last allowed CPU
+  int cpu = -1;
+};
+
+struct BenchmarkResult
+{
+  std::string name;
+  // CPU the benchmark was pinned to, -1 if pinning failed
+  int cpu = -1;
+  std::vector<double> samples_us;
+  // Median and its 95% confidence interval
+  double median_us = 0;
+  double ci_low_us = 0;
+  double ci_high_us = 0;
+};
+
+// Median of the samples and its distribution-free 95% confidence interval from order
+// statistics, no assumption about the shape of the timing distribution
+void summarizeSamples(BenchmarkResult & result);
+
+// Pin the calling thread, run fn warm_up times, then time iterations samples
+BenchmarkResult runBenchmark(
+  const std::string & name, const std::function<void()> & fn,
+  const BenchmarkOptions & options = BenchmarkOptions());
+
+// AUTO_AIM_MACHINE_CLASS, or the CPU model, plus "_debug" in builds without NDEBUG.
+// Lowercase letters, digits and '_' only.
+std::string machineClass();
+
+// Committed medians of the benchmarks per machine class. The text file has a
+// "machine <class> <tolerance>" line followed by "<benchmark> <median_us>" lines per class.
+class PerfBaseline
+{
+public:
+  struct Machine
+  {
+    // Relative slowdown of the median that is still accepted
+    double tolerance = 0.1;
+    std::map<std::string, double> medians_us;
+  };
+
+  bool load(const std::string & path, std::string & error);
+  bool save(const std::string & path, std::string & error) const;
+
+  // Replace the medians of the benchmarks in results, keeping the class' tolerance
+  void record(
+    const std::string & machine_class, const std::vector<BenchmarkResult> & results,
+    double default_tolerance = 0.1);
+
+  const Machine * find(const std::string & machine_class) const;
+
+private:
+  std::map<std::string, Machine> machines_;
+};
+
+struct PerfComparison
+{
+  // At least one benchmark is slower than its baseline beyond the tolerance, even at the low
+  // end of its confidence interval
+  bool regressed = false;
+  // The machine class has no baseline, nothing was compared
+  bool missing_baseline = false;
+  // Table of baseline, median, confidence interval and verdict per benchmark
+  std::string report;
+};
+
+PerfComparison compareWithBaseline(
+  const std::vector<BenchmarkResult> & results, const PerfBaseline & baseline,
+  const std::string & machine_class);
+
+// Compare with the baseline file, or with AUTO_AIM_PERF_RECORD=1 record the results into it.
+// A test fails if regressed (also set for an unreadable file) and skips if missing_baseline.
+// With AUTO_AIM_PERF_REQUIRE_BASELINE=1 a missing baseline also sets regressed.
+PerfComparison checkBaseline(
+  const std::vector<BenchmarkResult> & results, const std::string & baseline_path);
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__PERF_REGRESSION_HPP_
@@ -0,0 +1,43 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__REALTIME_HPP_
+#define AUTO_AIM_UTILS__REALTIME_HPP_
+
+// STD
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace auto_aim_utils
+{
+struct RealtimeConfig
+{
+  // CPUs the thread may run on, empty keeps the inherited affinity
+  std::vector<int64_t> cpu_affinity;
+  // SCHED_FIFO priority (1-99), 0 keeps the default SCHED_OTHER policy
+  int priority = 0;
+  // Lock all current and future pages of the process into RAM
+  bool lock_memory = false;
+  // Stack size to touch up front so that page faults do not happen in the hot path. Clamped to
+  // the stack the thread has left, which is an error.
+  int prefault_stack_kb = 0;
+  // Treat a failure to apply the config as fatal instead of only warning about it
+  bool required = false;
+};
+
+// Whether the config changes anything about a thread
+bool isRealtimeConfigured(const RealtimeConfig & config);
+
+// Apply the config to the calling thread
+bool applyRealtimeConfig(const RealtimeConfig & config, std::string & error);
+
+// Read back the scheduling state of the calling thread and compare it with the config
+bool checkRealtimeConfig(const RealtimeConfig & config, std::string & error);
+
+// Human readable summary of the calling thread's scheduling state
+std::string describeCurrentThread();
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__REALTIME_HPP_
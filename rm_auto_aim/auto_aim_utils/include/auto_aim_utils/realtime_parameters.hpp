@@ -0,0 +1,27 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__REALTIME_PARAMETERS_HPP_
+#define AUTO_AIM_UTILS__REALTIME_PARAMETERS_HPP_
+
+#include <rclcpp/rclcpp.hpp>
+
+// STD
+#include <string>
+
+#include "auto_aim_utils/realtime.hpp"
+
+namespace auto_aim_utils
+{
+// Declare <prefix>.cpu_affinity, <prefix>.priority, <prefix>.lock_memory,
+// <prefix>.prefault_stack_kb and <prefix>.required on the node
+RealtimeConfig declareRealtimeParameters(rclcpp::Node * node, const std::string & prefix);
+
+// Apply and check the config on the calling thread, logging the result through the node.
+// Throws std::runtime_error if it fails and config.required is set.
+void setupRealtimeThread(
+  rclcpp::Node * node, const RealtimeConfig & config, const std::string & thread_name);
+
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_UTILS__REALTIME_PARAMETERS_HPP_
@@ -0,0 +1,37 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// LTTng tracepoint provider of the auto-aim stack, only compiled with AUTO_AIM_TRACING
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER auto_aim
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "auto_aim_utils/tp_call.h"
+
+#if !defined(AUTO_AIM_UTILS__TP_CALL_H_) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define AUTO_AIM_UTILS__TP_CALL_H_
+
+#include <lttng/tracepoint.h>
+#include <stdint.h>
+
+TRACEPOINT_EVENT(
+  auto_aim, stage_begin,
+  TP_ARGS(int64_t, stamp_ns_arg, const char *, stage_arg),
+  TP_FIELDS(ctf_integer(int64_t, stamp_ns, stamp_ns_arg) ctf_string(stage, stage_arg)))
+
+TRACEPOINT_EVENT(
+  auto_aim, stage_end,
+  TP_ARGS(int64_t, stamp_ns_arg, const char *, stage_arg),
+  TP_FIELDS(ctf_integer(int64_t, stamp_ns, stamp_ns_arg) ctf_string(stage, stage_arg)))
+
+TRACEPOINT_EVENT(
+  auto_aim, frame_published,
+  TP_ARGS(const char *, topic_arg, int64_t, stamp_ns_arg, uint32_t, frame_number_arg),
+  TP_FIELDS(
+    ctf_string(topic, topic_arg) ctf_integer(int64_t, stamp_ns, stamp_ns_arg)
+      ctf_integer(uint32_t, frame_number, frame_number_arg)))
+
+#endif  // AUTO_AIM_UTILS__TP_CALL_H_
+
+#include <lttng/tracepoint-event.h>
@@ -0,0 +1,46 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef AUTO_AIM_UTILS__TRACING_HPP_
+#define AUTO_AIM_UTILS__TRACING_HPP_
+
+#include <builtin_interfaces/msg/time.hpp>
+
+// STD
+#include <cstdint>
+
+#include "auto_aim_utils/tracing_config.hpp"
+
+// LTTng userspace tracepoints at the hot path boundaries, provider "auto_aim".
+// Only emitted when built with -DAUTO_AIM_TRACING=ON, otherwise the macros expand to nothing
+// and their arguments are not evaluated.
+//
+// Stages are keyed by the stamp of the frame they work on. Camera stages that run before the
+// frame is stamped pass an empty stamp and belong to the next frame_published on their thread.
+#ifdef AUTO_AIM_TRACING_ENABLED
+
+namespace auto_aim_utils
+{
+namespace tracing
+{
+void stageBegin(const builtin_interfaces::msg::Time & stamp, const char * stage);
+void stageEnd(const builtin_interfaces::msg::Time & stamp, const char * stage);
+void framePublished(
+  const char * topic, const builtin_interfaces::msg::Time & stamp, uint32_t frame_number);
+}  // namespace tracing
+}  // namespace auto_aim_utils
+
+#define AUTO_AIM_TRACE_BEGIN(stamp, stage) auto_aim_utils::tracing::stageBegin(stamp, stage)
+#define AUTO_AIM_TRACE_END(stamp, stage) auto_aim_utils::tracing::stageEnd(stamp, stage)
+#define AUTO_AIM_TRACE_PUBLISHED(topic, stamp, frame_number) \
+  auto_aim_utils::tracing::framePublished(topic, stamp, frame_number)
+
+#else
+
+#define AUTO_AIM_TRACE_BEGIN(stamp, stage) ((void)0)
+#define AUTO_AIM_TRACE_END(stamp, stage) ((void)0)
+#define AUTO_AIM_TRACE_PUBLISHED(topic, stamp, frame_number) ((void)0)
+
+#endif  // AUTO_AIM_TRACING_ENABLED
+
+#endif  // AUTO_AIM_UTILS__TRACING_HPP_
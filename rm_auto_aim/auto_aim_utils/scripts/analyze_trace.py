@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+# Copyright 2022 Chen Jun
+# Licensed under the MIT License.
+
+"""
+Per-stage latency tables and critical paths from an auto-aim LTTng trace.
+
+Build the stack with -DAUTO_AIM_TRACING=ON and record a session with
+
+    lttng create auto_aim
+    lttng enable-event -u 'auto_aim:*'
+    lttng add-context -u -t vtid -t procname
+    lttng start
+    (run the stack)
+    lttng stop && lttng destroy
+
+then analyze it with
+
+    ros2 run auto_aim_utils analyze_trace.py ~/lttng-traces/auto_aim-<date>
+
+Stages are matched into frames by the stamp of the image they work on. Camera stages that run
+before the frame is stamped are given to the next image published on the same thread.
+"""
+
+import argparse
+from collections import defaultdict
+from collections import namedtuple
+import math
+import sys
+
+Event = namedtuple('Event', ['name', 'time_ns', 'vtid', 'procname', 'fields'])
+
+
+class Stage:
+
+    def __init__(self, name, stamp_ns, begin_ns, end_ns, vtid, procname):
+        self.name = name
+        self.stamp_ns = stamp_ns
+        self.begin_ns = begin_ns
+        self.end_ns = end_ns
+        self.vtid = vtid
+        self.procname = procname
+
+    def duration_ms(self):
+        return (self.end_ns - self.begin_ns) * 1e-6
+
+    def contains(self, other):
+        return (self is not other and self.vtid == other.vtid and
+                self.begin_ns <= other.begin_ns and other.end_ns <= self.end_ns)
+
+
+def read_events(path):
+    """Read the auto_aim events of a trace with the babeltrace2 bindings."""
+    import bt2
+
+    for msg in bt2.TraceCollectionMessageIterator(path):
+        if type(msg) is not bt2._EventMessageConst:
+            continue
+        event = msg.event
+        provider, _, name = event.name.partition(':')
+        if provider != 'auto_aim':
+            continue
+        fields = {key: event.payload_field[key] for key in event.payload_field}
+        yield Event(
+            name=name,
+            time_ns=msg.default_clock_snapshot.ns_from_origin,
+            vtid=int(event['vtid']),
+            procname=str(event['procname']),
+            fields={key: str(value) if key in ('stage', 'topic') else int(value)
+                    for key, value in fields.items()})
+
+
+def collect_stages(events):
+    """Pair stage_begin with stage_end and key camera stages by the frame they produced."""
+    stages = []
+    publishes = []
+    open_stages = {}
+    # Camera stages before the frame is stamped, the last one of each name per thread
+    unstamped = defaultdict(dict)
+
+    for event in sorted(events, key=lambda e: e.time_ns):
+        if event.name == 'stage_begin':
+            open_stages[(event.vtid, event.fields['stage'])] = event
+        elif event.name == 'stage_end':
+            begin = open_stages.pop((event.vtid, event.fields['stage']), None)
+            if begin is None:
+                continue
+            stage = Stage(event.fields['stage'], event.fields['stamp_ns'], begin.time_ns,
+                          event.time_ns, event.vtid, event.procname)
+            if stage.stamp_ns == 0:
+                unstamped[event.vtid][stage.name] = stage
+            else:
+                stages.append(stage)
+        elif event.name == 'frame_published':
+            for stage in unstamped.pop(event.vtid, {}).values():
+                stage.stamp_ns = event.fields['stamp_ns']
+                stages.append(stage)
+            publishes.append(event)
+
+    return stages, publishes
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    rank = max(int(math.ceil(p / 100.0 * len(ordered))), 1)
+    return ordered[rank - 1]
+
+
+def summarize(values):
+    return (len(values), sum(values) / len(values), percentile(values, 50),
+            percentile(values, 90), percentile(values, 99), max(values))
+
+
+def print_table(title, rows):
+    print(title)
+    print('  {:<40} {:>7} {:>8} {:>8} {:>8} {:>8} {:>8}'.format(
+        'stage', 'count', 'mean', 'p50', 'p90', 'p99', 'max'))
+    for name, values in rows:
+        print('  {:<40} {:>7} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}'.format(
+            name, *summarize(values)))
+    print()
+
+
+def stage_table(stages):
+    """Durations in ms of every stage name, in pipeline order."""
+    durations = defaultdict(list)
+    for stage in stages:
+        durations[stage.name].append(stage.duration_ms())
+    frames = group_frames(stages)
+    offsets = defaultdict(list)
+    for frame in frames.values():
+        start = min(stage.begin_ns for stage in frame)
+        for stage in frame:
+            offsets[stage.name].append(stage.begin_ns - start)
+    order = sorted(durations, key=lambda name: percentile(offsets[name], 50))
+    return [(name, durations[name]) for name in order]
+
+
+def group_frames(stages):
+    frames = defaultdict(list)
+    for stage in stages:
+        frames[stage.stamp_ns].append(stage)
+    return frames
+
+
+def critical_path(frame, end_ns):
+    """
+    Split a frame into its outermost stages and the waits between them.
+
+    Returns (segment name, duration in ms) pairs covering the frame's first stage begin to
+    end_ns. Stages nested in another stage of the same thread are left out, they are already
+    counted by the outer one.
+    """
+    outer = sorted((stage for stage in frame
+                    if not any(other.contains(stage) for other in frame)),
+                   key=lambda stage: stage.begin_ns)
+    path = []
+    reached_ns = outer[0].begin_ns
+    previous = None
+    for stage in outer:
+        if previous is not None and stage.begin_ns > reached_ns:
+            path.append(('{} -> {}'.format(previous, stage.name),
+                         (stage.begin_ns - reached_ns) * 1e-6))
+        path.append((stage.name, stage.duration_ms()))
+        reached_ns = max(reached_ns, stage.end_ns)
+        previous = stage.name
+    if end_ns > reached_ns:
+        path.append(('{} -> publish'.format(previous), (end_ns - reached_ns) * 1e-6))
+    return path
+
+
+def complete_frames(stages, publishes, first_stage, last_topic):
+    """Frames from first_stage to the publish of last_topic, with their total latency in ms."""
+    published = {event.fields['stamp_ns']: event.time_ns
+                 for event in publishes if event.fields['topic'] == last_topic}
+    frames = []
+    for stamp_ns, frame in group_frames(stages).items():
+        if stamp_ns not in published or not any(s.name == first_stage for s in frame):
+            continue
+        start_ns = min(stage.begin_ns for stage in frame)
+        end_ns = published[stamp_ns]
+        frames.append((stamp_ns, (end_ns - start_ns) * 1e-6, critical_path(frame, end_ns)))
+    return frames
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('trace', help='LTTng trace directory')
+    parser.add_argument('--first-stage', default='camera_grab',
+                        help='stage a complete frame starts with')
+    parser.add_argument('--last-topic', default='/processor/target',
+                        help='topic a complete frame ends with')
+    parser.add_argument('--slowest', type=int, default=5,
+                        help='number of slowest frames whose critical path is printed')
+    args = parser.parse_args(argv)
+
+    stages, publishes = collect_stages(read_events(args.trace))
+    if not stages:
+        print('No auto_aim stages in {}, was the stack built with -DAUTO_AIM_TRACING=ON?'
+              .format(args.trace))
+        return 1
+
+    print_table('Stage durations (ms)', stage_table(stages))
+
+    frames = complete_frames(stages, publishes, args.first_stage, args.last_topic)
+    if not frames:
+        print('No frame went from {} to {}'.format(args.first_stage, args.last_topic))
+        return 0
+
+    # Critical path segments in the order they first appear, and their share of the total
+    segments = defaultdict(list)
+    for _, _, path in frames:
+        for name, duration in path:
+            segments[name].append(duration)
+    totals = [total for _, total, _ in frames]
+    print_table('Critical path of {} complete frames (ms)'.format(len(frames)),
+                list(segments.items()) + [('total', totals)])
+    mean_total = sum(totals) / len(totals)
+    print('Share of the mean total latency')
+    for name, durations in segments.items():
+        print('  {:<40} {:>6.1f}%'.format(name, 100.0 * sum(durations) / len(frames) / mean_total))
+    print()
+
+    for stamp_ns, total, path in sorted(frames, key=lambda frame: -frame[1])[:args.slowest]:
+        print('Frame {} total {:.3f}ms'.format(stamp_ns, total))
+        for name, duration in path:
+            print('  {:<40} {:>8.3f}'.format(name, duration))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,265 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/async_logger.hpp"
+
+#include <pthread.h>
+
+// STD
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <type_traits>
+
+namespace auto_aim_utils
+{
+namespace
+{
+int64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+size_t roundUpToPowerOfTwo(size_t n)
+{
+  size_t power = 1;
+  while (power < n) {
+    power <<= 1;
+  }
+  return power;
+}
+}  // namespace
+
+LogSite::LogSite(
+  int severity, const char * logger_name, const char * file, const char * function, int line,
+  int64_t period_ms)
+: severity(severity),
+  logger_name(logger_name),
+  file(file),
+  function(function),
+  line(line),
+  period_ns(period_ms * 1000000),
+  window_end_ns(0),
+  suppressed(0)
+{
+}
+
+bool LogSite::claim()
+{
+  // Within the window, or another thread just opened it
+  int64_t now_ns = nowNs();
+  int64_t end_ns = window_end_ns.load(std::memory_order_relaxed);
+  if (
+    now_ns < end_ns || !window_end_ns.compare_exchange_strong(
+                         end_ns, now_ns + period_ns, std::memory_order_relaxed)) {
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+LogSite & LogSiteCache::get(
+  AsyncLogger & async_logger, int severity, const char * logger_name, const char * file,
+  const char * function, int line, int64_t period_ms)
+{
+  // Entries are filled in order and never change once set
+  for (auto & entry : sites) {
+    LogSite * site = entry.load(std::memory_order_acquire);
+    if (site == nullptr) {
+      break;
+    }
+    if (site->logger_name == logger_name) {
+      return *site;
+    }
+  }
+
+  LogSite & site = async_logger.site(severity, logger_name, file, function, line, period_ms);
+  for (auto & entry : sites) {
+    LogSite * expected = nullptr;
+    if (
+      entry.compare_exchange_strong(expected, &site, std::memory_order_acq_rel) ||
+      expected == &site) {
+      break;
+    }
+  }
+  return site;
+}
+
+AsyncLogger::AsyncLogger(Sink sink, size_t capacity, std::chrono::milliseconds poll_period)
+: sink_(std::move(sink)),
+  poll_period_(poll_period),
+  mask_(roundUpToPowerOfTwo(capacity) - 1),
+  enqueue_pos_(0),
+  dequeue_pos_(0),
+  dropped_(0),
+  reported_dropped_(0),
+  drop_site_(
+    RCUTILS_LOG_SEVERITY_WARN, "auto_aim_utils.async_logger", __FILE__, __func__, __LINE__, 0),
+  running_(true)
+{
+  slots_.reset(new Slot[mask_ + 1]);
+  for (size_t i = 0; i <= mask_; i++) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  thread_ = std::thread([this]() { run(); });
+  pthread_setname_np(thread_.native_handle(), "auto_aim_log");
+}
+
+AsyncLogger::~AsyncLogger() { stop(); }
+
+AsyncLogger & AsyncLogger::instance()
+{
+  // Never destroyed, statements may still log while statics are destroyed at exit. The drain
+  // thread is stopped and the ring flushed by an exit handler instead.
+  // Placement new, as C++14 new does not honor the alignment of the ring positions
+  static std::aligned_storage<sizeof(AsyncLogger), alignof(AsyncLogger)>::type storage;
+  static AsyncLogger * logger = []() {
+    auto created = new (&storage) AsyncLogger;
+    std::atexit([]() { instance().stop(); });
+    return created;
+  }();
+  return *logger;
+}
+
+LogSite & AsyncLogger::site(
+  int severity, const char * logger_name, const char * file, const char * function, int line,
+  int64_t period_ms)
+{
+  std::string key = std::string(file) + ':' + std::to_string(line) + ':' + function + ':' +
+                    std::to_string(severity) + ':' + logger_name;
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  auto & site = registry_[key];
+  if (site == nullptr) {
+    // Never freed, a statement may log again while statics are destroyed at exit
+    site = new LogSite(severity, logger_name, file, function, line, period_ms);
+  }
+  return *site;
+}
+
+void AsyncLogger::log(LogSite & site, const char * format, ...)
+{
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot * slot;
+  while (true) {
+    slot = &slots_[pos & mask_];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // Full, keep the call in the count of the site
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      site.suppressed.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->site = &site;
+  slot->count = site.suppressed.exchange(0, std::memory_order_relaxed) + 1;
+  va_list args;
+  va_start(args, format);
+  std::vsnprintf(slot->text, kMaxMessageLength, format, args);
+  va_end(args);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void AsyncLogger::flush()
+{
+  std::lock_guard<std::mutex> lock(drain_mutex_);
+  drain(nowNs(), true);
+}
+
+void AsyncLogger::stop()
+{
+  running_ = false;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  flush();
+}
+
+void AsyncLogger::rcutilsSink(const LogSite & site, const char * text)
+{
+  // The level may have been raised since the message was queued
+  if (!rcutils_logging_logger_is_enabled_for(site.logger_name.c_str(), site.severity)) {
+    return;
+  }
+  rcutils_log_location_t location = {
+    site.function.c_str(), site.file.c_str(), static_cast<size_t>(site.line)};
+  rcutils_log(&location, site.severity, site.logger_name.c_str(), "%s", text);
+}
+
+void AsyncLogger::run()
+{
+  while (running_) {
+    std::this_thread::sleep_for(poll_period_);
+    std::lock_guard<std::mutex> lock(drain_mutex_);
+    drain(nowNs(), false);
+  }
+}
+
+void AsyncLogger::drain(int64_t now_ns, bool force)
+{
+  while (true) {
+    Slot & slot = slots_[dequeue_pos_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+      break;
+    }
+    auto it = sites_.find(slot.site);
+    if (it == sites_.end()) {
+      it = sites_.emplace(slot.site, SiteState{"", now_ns - slot.site->period_ns}).first;
+    }
+    it->second.last_text = slot.text;
+    report(*slot.site, it->second, slot.count, now_ns);
+    slot.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    dequeue_pos_++;
+  }
+
+  // Calls counted in windows that have ended
+  for (auto & entry : sites_) {
+    LogSite & site = *entry.first;
+    if (!force && now_ns < site.window_end_ns.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    uint64_t count = site.suppressed.exchange(0, std::memory_order_relaxed);
+    if (count > 0) {
+      report(site, entry.second, count, now_ns);
+    }
+  }
+
+  uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+  if (dropped != reported_dropped_) {
+    char text[kMaxMessageLength];
+    std::snprintf(
+      text, sizeof(text), "%" PRIu64 " messages did not fit in the log queue, only counted",
+      dropped - reported_dropped_);
+    sink_(drop_site_, text);
+    reported_dropped_ = dropped;
+  }
+}
+
+void AsyncLogger::report(LogSite & site, SiteState & state, uint64_t count, int64_t now_ns)
+{
+  if (count == 1) {
+    sink_(site, state.last_text.c_str());
+  } else {
+    char text[kMaxMessageLength + 64];
+    std::snprintf(
+      text, sizeof(text), "%s (x%" PRIu64 " in the last %.1fs)", state.last_text.c_str(), count,
+      (now_ns - state.last_report_ns) * 1e-9);
+    sink_(site, text);
+  }
+  state.last_report_ns = now_ns;
+}
+
+}  // namespace auto_aim_utils
@@ -0,0 +1,56 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/callback_group_thread.hpp"
+
+// STD
+#include <chrono>
+#include <exception>
+#include <future>
+#include <string>
+
+#include "auto_aim_utils/realtime_parameters.hpp"
+
+namespace auto_aim_utils
+{
+CallbackGroupThread::CallbackGroupThread(
+  rclcpp::Node * node, rclcpp::CallbackGroup::SharedPtr callback_group,
+  const RealtimeConfig & config, const std::string & thread_name)
+: running_(true)
+{
+  executor_.add_callback_group(callback_group, node->get_node_base_interface());
+
+  std::promise<void> setup;
+  auto setup_result = setup.get_future();
+  thread_ = std::thread([this, node, config, thread_name, &setup]() {
+    try {
+      setupRealtimeThread(node, config, thread_name);
+      setup.set_value();
+    } catch (...) {
+      setup.set_exception(std::current_exception());
+      return;
+    }
+    // Not spin(), since a cancel() issued before spin() starts would be lost
+    while (running_ && rclcpp::ok()) {
+      executor_.spin_once(std::chrono::milliseconds(100));
+    }
+  });
+
+  try {
+    setup_result.get();
+  } catch (...) {
+    thread_.join();
+    throw;
+  }
+}
+
+CallbackGroupThread::~CallbackGroupThread()
+{
+  running_ = false;
+  executor_.cancel();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+}  // namespace auto_aim_utils
@@ -0,0 +1,430 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/live_metrics.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace auto_aim_utils
+{
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory atomics must be lock free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory atomics must be lock free");
+
+// Odr-used by std::min, C++14 needs the definitions
+constexpr size_t LiveMetrics::kMaxCounters;
+constexpr size_t LiveMetrics::kMaxGauges;
+constexpr size_t LiveMetrics::kMaxHistograms;
+
+constexpr uint32_t kMagic = 0x41494d4d;  // "AIMM"
+// Bumped whenever the layout below changes
+constexpr uint32_t kVersion = 1;
+constexpr size_t kNameLength = 32;
+constexpr size_t kLabelsLength = 128;
+const char kSegmentPrefix[] = "auto_aim_metrics.";
+// Copies of a histogram a reader attempts before giving up on it
+constexpr int kReadAttempts = 100;
+
+struct alignas(64) MetricsHeader
+{
+  // Written last, once the rest of the segment is initialized
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint64_t id;
+  char name[64];
+  int32_t pid;
+  uint32_t counter_count;
+  uint32_t gauge_count;
+  uint32_t histogram_count;
+  // Steady clock of the last update
+  std::atomic<int64_t> update_ns;
+};
+
+struct alignas(64) CounterEntry
+{
+  char name[kNameLength];
+  std::atomic<uint64_t> value;
+};
+
+struct alignas(64) GaugeEntry
+{
+  char name[kNameLength];
+  // '|' separated
+  char labels[kLabelsLength];
+  // Bits of a double
+  std::atomic<uint64_t> value;
+};
+
+struct alignas(64) HistogramEntry
+{
+  char name[kNameLength];
+  // Odd while an update is in progress
+  std::atomic<uint32_t> sequence;
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum_ns;
+  std::atomic<uint64_t> max_ns;
+  std::atomic<uint64_t> buckets[kHistogramBuckets];
+};
+
+struct MetricsSegment
+{
+  MetricsHeader header;
+  CounterEntry counters[LiveMetrics::kMaxCounters];
+  GaugeEntry gauges[LiveMetrics::kMaxGauges];
+  HistogramEntry histograms[LiveMetrics::kMaxHistograms];
+};
+
+namespace
+{
+int64_t steadyNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// "/a/b" -> "/auto_aim_metrics.a.b", '.' cannot appear in a ROS name so the mapping is unique
+std::string segmentNameOf(const std::string & name)
+{
+  std::string escaped = name.size() > 0 && name[0] == '/' ? name.substr(1) : name;
+  std::replace(escaped.begin(), escaped.end(), '/', '.');
+  return std::string("/") + kSegmentPrefix + escaped;
+}
+
+// Pid of the live process owning an existing segment, 0 if there is none. A segment of another
+// layout version or one whose owner has exited is stale.
+int segmentOwner(const std::string & segment_name)
+{
+  int fd = shm_open(segment_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  void * base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(MetricsHeader)) {
+    base = mmap(nullptr, sizeof(MetricsHeader), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) {
+    return 0;
+  }
+  auto header = static_cast<const MetricsHeader *>(base);
+  int pid = 0;
+  if (header->magic.load(std::memory_order_acquire) == kMagic && header->version == kVersion) {
+    pid = header->pid;
+  }
+  munmap(base, sizeof(MetricsHeader));
+  bool alive = pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+  return alive ? pid : 0;
+}
+
+std::runtime_error shmError(const std::string & what, const std::string & name)
+{
+  return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+}
+
+void copyName(char * dst, size_t size, const std::string & src)
+{
+  std::snprintf(dst, size, "%s", src.c_str());
+}
+
+uint64_t toBits(double value)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double fromBits(uint64_t bits)
+{
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Copy of a histogram taken under its seqlock
+bool readHistogram(const HistogramEntry & entry, MetricsSnapshot::Histogram & histogram)
+{
+  histogram.buckets.resize(kHistogramBuckets);
+  for (int attempt = 0; attempt < kReadAttempts; attempt++) {
+    uint32_t begin = entry.sequence.load(std::memory_order_acquire);
+    if (begin % 2 == 1) {
+      continue;
+    }
+    histogram.count = entry.count.load(std::memory_order_relaxed);
+    uint64_t sum_ns = entry.sum_ns.load(std::memory_order_relaxed);
+    uint64_t max_ns = entry.max_ns.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kHistogramBuckets; i++) {
+      histogram.buckets[i] = entry.buckets[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.sequence.load(std::memory_order_relaxed) == begin) {
+      histogram.sum_ms = sum_ns * 1e-6;
+      histogram.max_ms = max_ns * 1e-6;
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+size_t histogramBucket(int64_t ns)
+{
+  uint64_t us = ns > 0 ? ns / 1000 : 0;
+  if (us < 4) {
+    return us;
+  }
+  int octave = 63 - __builtin_clzll(us);
+  size_t bucket = (octave - 1) * 4 + ((us >> (octave - 2)) & 3);
+  return std::min(bucket, kHistogramBuckets - 1);
+}
+
+double histogramBucketMs(size_t bucket)
+{
+  if (bucket < 4) {
+    return bucket * 1e-3;
+  }
+  int octave = bucket / 4 + 1;
+  return static_cast<double>((4 + bucket % 4) << (octave - 2)) * 1e-3;
+}
+
+double histogramPercentileMs(const std::vector<uint64_t> & buckets, double percentile)
+{
+  uint64_t total = 0;
+  for (auto count : buckets) {
+    total += count;
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+  // Rank of the sample, counted from 1
+  auto rank = std::max<uint64_t>(static_cast<uint64_t>(percentile / 100.0 * total + 0.5), 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      double upper = i + 1 < kHistogramBuckets ? histogramBucketMs(i + 1) : histogramBucketMs(i);
+      return (histogramBucketMs(i) + upper) / 2;
+    }
+  }
+  return histogramBucketMs(buckets.size() - 1);
+}
+
+LiveMetrics::LiveMetrics(
+  const std::string & name, const std::vector<std::string> & counters,
+  const std::vector<std::string> & gauges, const std::vector<std::string> & histograms)
+: segment_name_(segmentNameOf(name))
+{
+  if (
+    counters.size() > kMaxCounters || gauges.size() > kMaxGauges ||
+    histograms.size() > kMaxHistograms) {
+    throw std::runtime_error("Too many metrics for " + segment_name_);
+  }
+
+  // A segment left over by a crashed node is unlinked, a reader still mapping it keeps its copy.
+  // One of a running node is left alone.
+  int owner = segmentOwner(segment_name_);
+  if (owner != 0) {
+    throw std::runtime_error(segment_name_ + " is in use by pid " + std::to_string(owner));
+  }
+  shm_unlink(segment_name_.c_str());
+  int fd = shm_open(segment_name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw shmError("shm_open", segment_name_);
+  }
+  if (ftruncate(fd, sizeof(MetricsSegment)) != 0) {
+    close(fd);
+    shm_unlink(segment_name_.c_str());
+    throw shmError("ftruncate", segment_name_);
+  }
+  void * base = mmap(nullptr, sizeof(MetricsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(segment_name_.c_str());
+    throw shmError("mmap", segment_name_);
+  }
+
+  // ftruncate zero-fills the segment, which is a valid initial state for every field
+  segment_ = new (base) MetricsSegment;
+  auto & header = segment_->header;
+  header.version = kVersion;
+  std::random_device rd;
+  header.id = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^ steadyNs();
+  copyName(header.name, sizeof(header.name), name);
+  header.pid = getpid();
+  header.counter_count = counters.size();
+  header.gauge_count = gauges.size();
+  header.histogram_count = histograms.size();
+  header.update_ns = steadyNs();
+  for (size_t i = 0; i < counters.size(); i++) {
+    copyName(segment_->counters[i].name, kNameLength, counters[i]);
+  }
+  for (size_t i = 0; i < gauges.size(); i++) {
+    copyName(segment_->gauges[i].name, kNameLength, gauges[i]);
+  }
+  for (size_t i = 0; i < histograms.size(); i++) {
+    copyName(segment_->histograms[i].name, kNameLength, histograms[i]);
+  }
+  header.magic.store(kMagic, std::memory_order_release);
+}
+
+LiveMetrics::~LiveMetrics()
+{
+  munmap(segment_, sizeof(MetricsSegment));
+  shm_unlink(segment_name_.c_str());
+}
+
+void LiveMetrics::setLabels(size_t gauge, const std::vector<std::string> & labels)
+{
+  std::string joined;
+  for (const auto & label : labels) {
+    joined += (joined.empty() ? "" : "|") + label;
+  }
+  copyName(segment_->gauges[gauge].labels, kLabelsLength, joined);
+}
+
+void LiveMetrics::add(size_t counter, uint64_t n)
+{
+  segment_->counters[counter].value.fetch_add(n, std::memory_order_relaxed);
+  touch();
+}
+
+void LiveMetrics::set(size_t gauge, double value)
+{
+  segment_->gauges[gauge].value.store(toBits(value), std::memory_order_relaxed);
+  touch();
+}
+
+void LiveMetrics::record(size_t histogram, double ms)
+{
+  auto & entry = segment_->histograms[histogram];
+  auto ns = static_cast<uint64_t>(std::max(ms, 0.0) * 1e6);
+  // Single writer, so plain loads and stores inside the seqlock
+  uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+  entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  entry.count.store(entry.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  entry.sum_ns.store(entry.sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+  if (ns > entry.max_ns.load(std::memory_order_relaxed)) {
+    entry.max_ns.store(ns, std::memory_order_relaxed);
+  }
+  auto & bucket = entry.buckets[histogramBucket(ns)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  entry.sequence.store(sequence + 2, std::memory_order_release);
+  touch();
+}
+
+void LiveMetrics::touch()
+{
+  segment_->header.update_ns.store(steadyNs(), std::memory_order_relaxed);
+}
+
+LiveMetricsReader::LiveMetricsReader(const std::string & segment_name)
+{
+  int fd = shm_open(segment_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw shmError("shm_open", segment_name);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(MetricsHeader)) {
+    close(fd);
+    throw std::runtime_error("Invalid metrics segment " + segment_name);
+  }
+  void * base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    throw shmError("mmap", segment_name);
+  }
+
+  auto header = static_cast<const MetricsHeader *>(base);
+  if (
+    header->magic.load(std::memory_order_acquire) != kMagic || header->version != kVersion ||
+    static_cast<size_t>(st.st_size) != sizeof(MetricsSegment)) {
+    uint32_t version = header->version;
+    munmap(base, st.st_size);
+    throw std::runtime_error(
+      "Incompatible metrics segment " + segment_name + " (version " + std::to_string(version) +
+      ", expected " + std::to_string(kVersion) + ")");
+  }
+  segment_ = static_cast<const MetricsSegment *>(base);
+}
+
+LiveMetricsReader::~LiveMetricsReader()
+{
+  munmap(const_cast<MetricsSegment *>(segment_), sizeof(MetricsSegment));
+}
+
+bool LiveMetricsReader::read(MetricsSnapshot & snapshot) const
+{
+  const auto & header = segment_->header;
+  snapshot.name = header.name;
+  snapshot.pid = header.pid;
+  snapshot.id = header.id;
+  snapshot.idle_s = (steadyNs() - header.update_ns.load(std::memory_order_relaxed)) * 1e-9;
+
+  snapshot.counters.resize(std::min<size_t>(header.counter_count, LiveMetrics::kMaxCounters));
+  for (size_t i = 0; i < snapshot.counters.size(); i++) {
+    const auto & entry = segment_->counters[i];
+    snapshot.counters[i] = {entry.name, entry.value.load(std::memory_order_relaxed)};
+  }
+
+  snapshot.gauges.resize(std::min<size_t>(header.gauge_count, LiveMetrics::kMaxGauges));
+  for (size_t i = 0; i < snapshot.gauges.size(); i++) {
+    const auto & entry = segment_->gauges[i];
+    auto & gauge = snapshot.gauges[i];
+    gauge.name = entry.name;
+    gauge.value = fromBits(entry.value.load(std::memory_order_relaxed));
+    gauge.labels.clear();
+    std::string labels(entry.labels, strnlen(entry.labels, kLabelsLength));
+    for (size_t begin = 0; !labels.empty() && begin <= labels.size();) {
+      size_t end = std::min(labels.find('|', begin), labels.size());
+      gauge.labels.push_back(labels.substr(begin, end - begin));
+      begin = end + 1;
+    }
+  }
+
+  bool consistent = true;
+  snapshot.histograms.resize(
+    std::min<size_t>(header.histogram_count, LiveMetrics::kMaxHistograms));
+  for (size_t i = 0; i < snapshot.histograms.size(); i++) {
+    snapshot.histograms[i].name = segment_->histograms[i].name;
+    consistent = readHistogram(segment_->histograms[i], snapshot.histograms[i]) && consistent;
+  }
+  return consistent;
+}
+
+std::vector<std::string> LiveMetricsReader::list()
+{
+  std::vector<std::string> names;
+  DIR * dir = opendir("/dev/shm");
+  if (dir == nullptr) {
+    return names;
+  }
+  while (dirent * entry = readdir(dir)) {
+    if (std::strncmp(entry->d_name, kSegmentPrefix, sizeof(kSegmentPrefix) - 1) == 0) {
+      names.push_back(std::string("/") + entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+}  // namespace auto_aim_utils
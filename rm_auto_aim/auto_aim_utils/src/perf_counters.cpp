@@ -0,0 +1,211 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/perf_counters.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// STD
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace auto_aim_utils
+{
+namespace
+{
+const std::array<uint64_t, PerfCounters::COUNTER_NUM> kEventConfigs = {
+  PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+  PERF_COUNT_HW_BRANCH_MISSES};
+
+// Layout of a PERF_FORMAT_GROUP read with the enabled and running times
+struct GroupRead
+{
+  uint64_t nr;
+  uint64_t time_enabled;
+  uint64_t time_running;
+  uint64_t values[PerfCounters::COUNTER_NUM];
+};
+
+int perfEventOpen(perf_event_attr & attr, int group_fd)
+{
+  // pid 0 and cpu -1: the calling thread on any CPU
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+}  // namespace
+
+PerfCounters::PerfCounters() { fds_.fill(-1); }
+
+PerfCounters::~PerfCounters() { close(); }
+
+bool PerfCounters::open(std::string & error)
+{
+  close();
+  for (size_t i = 0; i < COUNTER_NUM; i++) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kEventConfigs[i];
+    attr.disabled = i == 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+      PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[i] = perfEventOpen(attr, fds_[0]);
+    if (fds_[i] < 0) {
+      error = std::string("perf_event_open(") + counterName(static_cast<Counter>(i)) +
+              "): " + std::strerror(errno);
+      close();
+      return false;
+    }
+  }
+
+  ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  if (ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+    error = std::string("PERF_EVENT_IOC_ENABLE: ") + std::strerror(errno);
+    close();
+    return false;
+  }
+  return true;
+}
+
+void PerfCounters::close()
+{
+  // Members before the leader
+  for (size_t i = COUNTER_NUM; i-- > 0;) {
+    if (fds_[i] >= 0) {
+      ::close(fds_[i]);
+      fds_[i] = -1;
+    }
+  }
+}
+
+bool PerfCounters::read(Values & values) const
+{
+  GroupRead group;
+  if (!isOpen() || ::read(fds_[0], &group, sizeof(group)) != sizeof(group)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < COUNTER_NUM; i++) {
+    values[i] = group.time_running > 0 && group.time_running < group.time_enabled
+                  ? static_cast<uint64_t>(
+                      static_cast<double>(group.values[i]) * group.time_enabled /
+                      group.time_running)
+                  : group.values[i];
+  }
+  return true;
+}
+
+const char * PerfCounters::counterName(Counter counter)
+{
+  switch (counter) {
+    case CYCLES:
+      return "cycles";
+    case INSTRUCTIONS:
+      return "instructions";
+    case CACHE_MISSES:
+      return "cache_misses";
+    case BRANCH_MISSES:
+      return "branch_misses";
+    default:
+      return "unknown";
+  }
+}
+
+StageCounters::StageCounters(const std::vector<std::string> & stage_names, size_t history)
+: failed_(false),
+  recording_(false),
+  stage_names_(stage_names),
+  history_(stage_names.size(), std::vector<PerfCounters::Values>(std::max(history, size_t(1)))),
+  next_(stage_names.size(), 0),
+  size_(stage_names.size(), 0)
+{
+}
+
+bool StageCounters::startFrame()
+{
+  recording_ = false;
+  if (failed_) {
+    return false;
+  }
+
+  if (!counters_.isOpen()) {
+    // Opened on the first frame so that they count the thread running the stages
+    // error_ is written before failed_ is set, so other threads may read it once failed()
+    if (!counters_.open(error_)) {
+      failed_ = true;
+      return false;
+    }
+    owner_ = std::this_thread::get_id();
+  } else if (std::this_thread::get_id() != owner_) {
+    return false;
+  }
+
+  recording_ = counters_.read(last_);
+  return recording_;
+}
+
+void StageCounters::finishStage(size_t stage)
+{
+  if (!recording_ || std::this_thread::get_id() != owner_ || stage >= history_.size()) {
+    return;
+  }
+
+  PerfCounters::Values now;
+  if (!counters_.read(now)) {
+    recording_ = false;
+    return;
+  }
+  PerfCounters::Values delta;
+  for (size_t i = 0; i < PerfCounters::COUNTER_NUM; i++) {
+    delta[i] = now[i] >= last_[i] ? now[i] - last_[i] : 0;
+  }
+  last_ = now;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto & ring = history_[stage];
+  ring[next_[stage]] = delta;
+  next_[stage] = (next_[stage] + 1) % ring.size();
+  size_[stage] = std::min(size_[stage] + 1, ring.size());
+}
+
+std::vector<StageCounters::StageSummary> StageCounters::summary() const
+{
+  std::vector<StageSummary> summaries(stage_names_.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t s = 0; s < stage_names_.size(); s++) {
+    auto & summary = summaries[s];
+    summary.stage = stage_names_[s];
+    summary.samples = size_[s];
+    if (summary.samples == 0) {
+      continue;
+    }
+
+    for (size_t i = 0; i < summary.samples; i++) {
+      for (size_t c = 0; c < PerfCounters::COUNTER_NUM; c++) {
+        summary.mean[c] += history_[s][i][c];
+      }
+    }
+    for (auto & mean : summary.mean) {
+      mean /= summary.samples;
+    }
+
+    double cycles = summary.mean[PerfCounters::CYCLES];
+    double kilo_instructions = summary.mean[PerfCounters::INSTRUCTIONS] / 1000;
+    summary.ipc = cycles > 0 ? summary.mean[PerfCounters::INSTRUCTIONS] / cycles : 0.0;
+    if (kilo_instructions > 0) {
+      summary.cache_mpki = summary.mean[PerfCounters::CACHE_MISSES] / kilo_instructions;
+      summary.branch_mpki = summary.mean[PerfCounters::BRANCH_MISSES] / kilo_instructions;
+    }
+  }
+  return summaries;
+}
+
+}  // namespace auto_aim_utils
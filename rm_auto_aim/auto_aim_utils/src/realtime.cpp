@@ -0,0 +1,185 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/realtime.hpp"
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// STD
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace auto_aim_utils
+{
+namespace
+{
+std::string errnoString(const std::string & what, int err)
+{
+  return what + ": " + std::strerror(err);
+}
+
+// Stack left below this frame for prefaulting, keeping a margin for the frames that follow
+constexpr size_t kStackMargin = 64 * 1024;
+
+// Touch every page of the requested stack size once, so later use of it does not fault. A size
+// that does not fit in the thread's stack is clamped to what does and reported.
+bool prefaultStack(int size_kb, std::string & error)
+{
+  if (size_kb <= 0) {
+    return true;
+  }
+  size_t size = static_cast<size_t>(size_kb) * 1024;
+
+  pthread_attr_t attr;
+  int err = pthread_getattr_np(pthread_self(), &attr);
+  if (err != 0) {
+    error = errnoString("pthread_getattr_np", err);
+    return false;
+  }
+  void * stack_addr;
+  size_t stack_size;
+  err = pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+  pthread_attr_destroy(&attr);
+  if (err != 0) {
+    error = errnoString("pthread_attr_getstack", err);
+    return false;
+  }
+  // The stack grows down towards stack_addr
+  unsigned char here;
+  auto used = static_cast<size_t>(static_cast<unsigned char *>(stack_addr) + stack_size - &here);
+  size_t available = stack_size > used + kStackMargin ? stack_size - used - kStackMargin : 0;
+  bool fits = size <= available;
+  if (!fits) {
+    error = "prefault_stack_kb " + std::to_string(size_kb) + " exceeds the " +
+            std::to_string(available / 1024) + " KiB of stack available";
+    size = available;
+  }
+
+  volatile unsigned char * stack = static_cast<unsigned char *>(alloca(size));
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  for (size_t i = 0; i < size; i += page_size) {
+    stack[i] = 0;
+  }
+  return fits;
+}
+}  // namespace
+
+bool isRealtimeConfigured(const RealtimeConfig & config)
+{
+  return !config.cpu_affinity.empty() || config.priority > 0 || config.lock_memory ||
+         config.prefault_stack_kb > 0;
+}
+
+bool applyRealtimeConfig(const RealtimeConfig & config, std::string & error)
+{
+  std::ostringstream errors;
+
+  if (config.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    int err = errno;
+    rlimit limit;
+    getrlimit(RLIMIT_MEMLOCK, &limit);
+    errors << errnoString("mlockall", err) << " (RLIMIT_MEMLOCK=" << limit.rlim_cur << "); ";
+  }
+
+  if (!config.cpu_affinity.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const auto cpu : config.cpu_affinity) {
+      if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        errors << "invalid cpu " << cpu << "; ";
+        continue;
+      }
+      CPU_SET(static_cast<int>(cpu), &cpu_set);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (err != 0) {
+      errors << errnoString("pthread_setaffinity_np", err) << "; ";
+    }
+  }
+
+  if (config.priority > 0) {
+    sched_param param;
+    param.sched_priority = config.priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+      rlimit limit;
+      getrlimit(RLIMIT_RTPRIO, &limit);
+      errors << errnoString("pthread_setschedparam(SCHED_FIFO)", err)
+             << " (RLIMIT_RTPRIO=" << limit.rlim_cur << "); ";
+    }
+  }
+
+  std::string stack_error;
+  if (!prefaultStack(config.prefault_stack_kb, stack_error)) {
+    errors << stack_error << "; ";
+  }
+
+  error = errors.str();
+  return error.empty();
+}
+
+bool checkRealtimeConfig(const RealtimeConfig & config, std::string & error)
+{
+  std::ostringstream errors;
+
+  int policy;
+  sched_param param;
+  pthread_getschedparam(pthread_self(), &policy, &param);
+  if (config.priority > 0 && (policy != SCHED_FIFO || param.sched_priority != config.priority)) {
+    errors << "expected SCHED_FIFO priority " << config.priority << "; ";
+  }
+
+  if (!config.cpu_affinity.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    int expected_count = 0;
+    for (const auto cpu : config.cpu_affinity) {
+      if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(static_cast<int>(cpu), &cpu_set)) {
+        errors << "cpu " << cpu << " missing from affinity; ";
+      } else {
+        expected_count++;
+      }
+    }
+    if (CPU_COUNT(&cpu_set) != expected_count) {
+      errors << "thread may run on cpus outside the configured affinity; ";
+    }
+  }
+
+  error = errors.str();
+  return error.empty();
+}
+
+std::string describeCurrentThread()
+{
+  int policy;
+  sched_param param;
+  pthread_getschedparam(pthread_self(), &policy, &param);
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+
+  std::ostringstream ss;
+  ss << "policy=" << (policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR"
+                                                                               : "SCHED_OTHER")
+     << " priority=" << param.sched_priority << " cpus=[";
+  bool first = true;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      ss << (first ? "" : ",") << cpu;
+      first = false;
+    }
+  }
+  ss << "]";
+  return ss.str();
+}
+
+}  // namespace auto_aim_utils
@@ -0,0 +1,73 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/realtime_parameters.hpp"
+
+// STD
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace auto_aim_utils
+{
+RealtimeConfig declareRealtimeParameters(rclcpp::Node * node, const std::string & prefix)
+{
+  RealtimeConfig config;
+
+  rcl_interfaces::msg::ParameterDescriptor param_desc;
+  param_desc.read_only = true;
+
+  param_desc.description = "CPUs the thread is pinned to, empty to keep the default affinity";
+  config.cpu_affinity = node->declare_parameter(
+    prefix + ".cpu_affinity", std::vector<int64_t>{}, param_desc);
+
+  param_desc.description = "SCHED_FIFO priority (1-99), 0 to keep SCHED_OTHER";
+  param_desc.integer_range.resize(1);
+  param_desc.integer_range[0].step = 1;
+  param_desc.integer_range[0].from_value = 0;
+  param_desc.integer_range[0].to_value = 99;
+  config.priority = node->declare_parameter(prefix + ".priority", 0, param_desc);
+  param_desc.integer_range.clear();
+
+  param_desc.description = "Lock all process memory with mlockall";
+  config.lock_memory = node->declare_parameter(prefix + ".lock_memory", false, param_desc);
+
+  param_desc.description =
+    "Stack size in KiB to prefault when the thread starts, at most the thread's stack size";
+  param_desc.integer_range.resize(1);
+  param_desc.integer_range[0].step = 1;
+  param_desc.integer_range[0].from_value = 0;
+  param_desc.integer_range[0].to_value = 65536;
+  config.prefault_stack_kb = node->declare_parameter(prefix + ".prefault_stack_kb", 0, param_desc);
+  param_desc.integer_range.clear();
+
+  param_desc.description = "Fail node startup if the real-time config can not be applied";
+  config.required = node->declare_parameter(prefix + ".required", false, param_desc);
+
+  return config;
+}
+
+void setupRealtimeThread(
+  rclcpp::Node * node, const RealtimeConfig & config, const std::string & thread_name)
+{
+  std::string error;
+  bool ok = applyRealtimeConfig(config, error);
+  if (ok) {
+    ok = checkRealtimeConfig(config, error);
+  }
+
+  if (ok) {
+    RCLCPP_INFO(
+      node->get_logger(), "%s thread: %s", thread_name.c_str(), describeCurrentThread().c_str());
+    return;
+  }
+
+  if (config.required) {
+    throw std::runtime_error(thread_name + " thread real-time setup failed: " + error);
+  }
+  RCLCPP_WARN(
+    node->get_logger(), "%s thread real-time setup failed: %s (running with %s)",
+    thread_name.c_str(), error.c_str(), describeCurrentThread().c_str());
+}
+
+}  // namespace auto_aim_utils
@@ -0,0 +1,41 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/tracing.hpp"
+
+#ifdef AUTO_AIM_TRACING_ENABLED
+
+#include "auto_aim_utils/tp_call.h"
+
+namespace auto_aim_utils
+{
+namespace tracing
+{
+namespace
+{
+int64_t toNanoseconds(const builtin_interfaces::msg::Time & stamp)
+{
+  return static_cast<int64_t>(stamp.sec) * 1000000000 + stamp.nanosec;
+}
+}  // namespace
+
+void stageBegin(const builtin_interfaces::msg::Time & stamp, const char * stage)
+{
+  tracepoint(auto_aim, stage_begin, toNanoseconds(stamp), stage);
+}
+
+void stageEnd(const builtin_interfaces::msg::Time & stamp, const char * stage)
+{
+  tracepoint(auto_aim, stage_end, toNanoseconds(stamp), stage);
+}
+
+void framePublished(
+  const char * topic, const builtin_interfaces::msg::Time & stamp, uint32_t frame_number)
+{
+  tracepoint(auto_aim, frame_published, topic, toNanoseconds(stamp), frame_number);
+}
+
+}  // namespace tracing
+}  // namespace auto_aim_utils
+
+#endif  // AUTO_AIM_TRACING_ENABLED
@@ -0,0 +1,79 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+
+// STD
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "auto_aim_utils/allocation_counter.hpp"
+
+using auto_aim_utils::AllocationScope;
+
+// Not inlined and not static, so that it shows up by name in the reported call stack
+__attribute__((noinline)) std::vector<int> allocateVector(size_t size)
+{
+  return std::vector<int>(size, 1);
+}
+
+// Keep the compiler from eliding an allocation that is freed right away
+void escape(void * ptr) { asm volatile("" : : "g"(ptr) : "memory"); }
+
+TEST(AllocationCounterTest, counts_new_and_malloc)
+{
+  AllocationScope scope;
+  auto value = std::make_unique<int>(1);
+  escape(value.get());
+  void * raw = std::malloc(64);
+  escape(raw);
+  std::free(raw);
+  value.reset();
+  auto stats = scope.stop();
+
+  EXPECT_EQ(stats.allocations, 2u);
+  EXPECT_EQ(stats.frees, 2u);
+  EXPECT_GE(stats.bytes, sizeof(int) + 64);
+}
+
+TEST(AllocationCounterTest, nothing_outside_the_scope)
+{
+  std::vector<int> reused;
+  reused.reserve(100);
+
+  AllocationScope scope;
+  for (int i = 0; i < 100; i++) {
+    reused.push_back(i);
+  }
+  reused.clear();
+  auto stats = scope.stop();
+  EXPECT_EQ(stats.allocations, 0u) << scope.report();
+
+  auto after = std::make_unique<int>(1);
+  escape(after.get());
+  EXPECT_EQ(scope.stop().allocations, 0u);
+}
+
+TEST(AllocationCounterTest, counts_other_threads)
+{
+  AllocationScope scope;
+  std::thread thread([]() {
+    auto text = std::make_unique<std::string>(100, 'a');
+    escape(&(*text)[0]);
+  });
+  thread.join();
+  EXPECT_GE(scope.stop().allocations, 2u);
+}
+
+TEST(AllocationCounterTest, report_shows_the_call_stack)
+{
+  AllocationScope scope;
+  auto data = allocateVector(16);
+  scope.stop();
+
+  auto report = scope.report();
+  EXPECT_NE(report.find("allocateVector"), std::string::npos) << report;
+}
@@ -0,0 +1,215 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+
+// STD
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "auto_aim_utils/async_logger.hpp"
+
+using auto_aim_utils::AsyncLogger;
+using auto_aim_utils::LogSite;
+
+namespace
+{
+// Collects what the drain thread writes out
+class Collector
+{
+public:
+  AsyncLogger::Sink sink()
+  {
+    return [this](const LogSite & site, const char * text) {
+      if (site.logger_name != "test") {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      lines_.emplace_back(text);
+    };
+  }
+
+  std::vector<std::string> lines()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lines_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<std::string> lines_;
+};
+
+// As AUTO_AIM_LOG, with a logger of the test
+#define TEST_LOG(logger, site, ...) \
+  if (site.claim()) {               \
+    logger.log(site, __VA_ARGS__);  \
+  }
+
+// Calls a line of the report stands for, "text" or "text (x37 in the last 1.0s)"
+uint64_t countOf(const std::string & line)
+{
+  auto pos = line.rfind(" (x");
+  return pos == std::string::npos ? 1 : std::strtoull(line.c_str() + pos + 3, nullptr, 10);
+}
+}  // namespace
+
+TEST(AsyncLoggerTest, aggregates_calls_within_period)
+{
+  Collector collector;
+  LogSite site(RCUTILS_LOG_SEVERITY_WARN, "test", __FILE__, __func__, __LINE__, 1000);
+  AsyncLogger logger(collector.sink());
+
+  for (int i = 0; i < 100; i++) {
+    TEST_LOG(logger, site, "PnP failed! %d", i);
+  }
+  logger.flush();
+
+  auto lines = collector.lines();
+  ASSERT_EQ(lines.size(), 2u);
+  EXPECT_EQ(lines[0], "PnP failed! 0");
+  EXPECT_EQ(lines[1].rfind("PnP failed! 0 (x99 in the last ", 0), 0u) << lines[1];
+}
+
+TEST(AsyncLoggerTest, reports_when_period_ends)
+{
+  Collector collector;
+  LogSite site(RCUTILS_LOG_SEVERITY_WARN, "test", __FILE__, __func__, __LINE__, 50);
+  AsyncLogger logger(collector.sink());
+
+  for (int i = 0; i < 10; i++) {
+    TEST_LOG(logger, site, "Error while transforming");
+  }
+  // Written by the drain thread without a flush
+  auto start = std::chrono::steady_clock::now();
+  while (collector.lines().size() < 2 &&
+         std::chrono::steady_clock::now() - start < std::chrono::seconds(2)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  auto lines = collector.lines();
+  ASSERT_EQ(lines.size(), 2u);
+  EXPECT_EQ(lines[0], "Error while transforming");
+  EXPECT_EQ(countOf(lines[1]), 9u);
+
+  // A new window starts with the next call
+  TEST_LOG(logger, site, "Error while transforming again");
+  logger.flush();
+  lines = collector.lines();
+  ASSERT_EQ(lines.size(), 3u);
+  EXPECT_EQ(lines[2], "Error while transforming again");
+}
+
+TEST(AsyncLoggerTest, sites_per_logger)
+{
+  Collector collector;
+  AsyncLogger logger(collector.sink());
+  // As the function-local static of AUTO_AIM_LOG
+  static auto_aim_utils::LogSiteCache cache;
+
+  // More loggers than the cache holds, each keeps its own site and name
+  std::vector<LogSite *> sites;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < auto_aim_utils::LogSiteCache::kSize + 2; i++) {
+      std::string name = "node_" + std::to_string(i);
+      auto & site = cache.get(
+        logger, RCUTILS_LOG_SEVERITY_WARN, name.c_str(), __FILE__, __func__, __LINE__, 1000);
+      EXPECT_EQ(site.logger_name, name);
+      if (pass == 0) {
+        sites.push_back(&site);
+      } else {
+        EXPECT_EQ(&site, sites[i]);
+      }
+    }
+  }
+  EXPECT_NE(sites[0], sites[1]);
+
+  // The site keeps copies, the strings of the statement may go away with its library
+  std::string file = "unloaded.cpp", function = "unloaded";
+  auto & site =
+    logger.site(RCUTILS_LOG_SEVERITY_WARN, "test", file.c_str(), function.c_str(), 1, 1000);
+  file.assign(file.size(), 'x');
+  function.assign(function.size(), 'x');
+  EXPECT_EQ(site.file, "unloaded.cpp");
+  EXPECT_EQ(site.function, "unloaded");
+}
+
+TEST(AsyncLoggerTest, period_zero_writes_every_call)
+{
+  Collector collector;
+  LogSite site(RCUTILS_LOG_SEVERITY_WARN, "test", __FILE__, __func__, __LINE__, 0);
+  AsyncLogger logger(collector.sink());
+
+  for (int i = 0; i < 50; i++) {
+    TEST_LOG(logger, site, "Tracker state: %d", i);
+  }
+  logger.flush();
+
+  uint64_t total = 0;
+  for (const auto & line : collector.lines()) {
+    total += countOf(line);
+  }
+  EXPECT_EQ(total, 50u);
+  EXPECT_EQ(collector.lines().front(), "Tracker state: 0");
+}
+
+TEST(AsyncLoggerTest, counts_every_call_under_contention)
+{
+  // A ring much smaller than the burst, so that most messages are dropped and only counted
+  Collector collector;
+  LogSite site(RCUTILS_LOG_SEVERITY_WARN, "test", __FILE__, __func__, __LINE__, 0);
+  AsyncLogger logger(collector.sink(), 8);
+
+  constexpr int kThreads = 4;
+  constexpr int kCalls = 20000;
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&logger, &site, t]() {
+      for (int i = 0; i < kCalls; i++) {
+        TEST_LOG(logger, site, "thread %d call %d", t, i);
+      }
+    });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  logger.flush();
+
+  uint64_t total = 0;
+  for (const auto & line : collector.lines()) {
+    total += countOf(line);
+  }
+  EXPECT_EQ(total, static_cast<uint64_t>(kThreads * kCalls));
+  std::cout << collector.lines().size() << " lines, " << logger.dropped() << " dropped, "
+            << elapsed.count() / kCalls << "ns per call" << std::endl;
+}
+
+TEST(AsyncLoggerTest, logs_while_statics_are_destroyed)
+{
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_EXIT(
+    {
+      // Created before the process-wide logger, so destroyed after a static logger would be
+      struct LogsAtExit
+      {
+        ~LogsAtExit()
+        {
+          auto & logger = AsyncLogger::instance();
+          auto & site = logger.site(
+            RCUTILS_LOG_SEVERITY_WARN, "test", __FILE__, __func__, __LINE__, 0);
+          TEST_LOG(logger, site, "Destroyed");
+        }
+      };
+      static LogsAtExit logs_at_exit;
+      AsyncLogger::instance();
+      std::exit(0);
+    },
+    testing::ExitedWithCode(0), "");
+}
@@ -0,0 +1,188 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+
+#include <rcl_interfaces/msg/parameter_event.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <std_msgs/msg/header.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+
+// STL
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "auto_aim_utils/callback_group_thread.hpp"
+
+using namespace std::chrono_literals;
+using steady = std::chrono::steady_clock;
+
+namespace
+{
+int64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(steady::now().time_since_epoch())
+    .count();
+}
+
+void busyWait(std::chrono::microseconds duration)
+{
+  auto end = steady::now() + duration;
+  while (steady::now() < end) {
+  }
+}
+
+// Stand-in for a detector/processor: one hot subscription plus housekeeping callbacks that
+// cost as much as a tf lookup or a debug publisher switch
+class BenchNode : public rclcpp::Node
+{
+public:
+  explicit BenchNode(bool dedicated_thread) : Node("bench_node")
+  {
+    hot_group_ = create_callback_group(
+      rclcpp::CallbackGroupType::MutuallyExclusive, !dedicated_thread);
+    rclcpp::SubscriptionOptions options;
+    options.callback_group = hot_group_;
+    hot_sub_ = create_subscription<std_msgs::msg::Header>(
+      "/bench/hot", rclcpp::SensorDataQoS(),
+      [this](std_msgs::msg::Header::ConstSharedPtr msg) {
+        int64_t sent = rclcpp::Time(msg->stamp).nanoseconds();
+        std::lock_guard<std::mutex> lock(mutex_);
+        latencies_us_.push_back((nowNs() - sent) * 1e-3);
+      },
+      options);
+
+    declare_parameter("housekeeping", 0);
+    param_sub_ = std::make_shared<rclcpp::ParameterEventHandler>(this);
+    param_cb_handle_ = param_sub_->add_parameter_callback(
+      "housekeeping", [](const rclcpp::Parameter &) { busyWait(500us); });
+
+    tf_sub_ = create_subscription<tf2_msgs::msg::TFMessage>(
+      "/bench/tf", 100, [](tf2_msgs::msg::TFMessage::ConstSharedPtr) { busyWait(200us); });
+
+    if (dedicated_thread) {
+      hot_thread_ = std::make_unique<auto_aim_utils::CallbackGroupThread>(
+        this, hot_group_, auto_aim_utils::RealtimeConfig(), "bench");
+    }
+  }
+
+  ~BenchNode() override { hot_thread_.reset(); }
+
+  std::vector<double> latencies()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latencies_us_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<double> latencies_us_;
+
+  rclcpp::CallbackGroup::SharedPtr hot_group_;
+  rclcpp::Subscription<std_msgs::msg::Header>::SharedPtr hot_sub_;
+  std::shared_ptr<rclcpp::ParameterEventHandler> param_sub_;
+  std::shared_ptr<rclcpp::ParameterCallbackHandle> param_cb_handle_;
+  rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr tf_sub_;
+  std::unique_ptr<auto_aim_utils::CallbackGroupThread> hot_thread_;
+};
+
+struct LatencyStats
+{
+  size_t count;
+  double p50;
+  double p99;
+  double max;
+};
+
+LatencyStats runBenchmark(bool dedicated_thread)
+{
+  auto bench_node = std::make_shared<BenchNode>(dedicated_thread);
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(bench_node);
+  std::thread spin_thread([&executor]() { executor.spin(); });
+
+  // Synthetic traffic: 200 Hz hot messages, 1 kHz tf and 500 Hz parameter events
+  auto traffic_node = std::make_shared<rclcpp::Node>("bench_traffic");
+  auto hot_pub =
+    traffic_node->create_publisher<std_msgs::msg::Header>("/bench/hot", rclcpp::SensorDataQoS());
+  auto tf_pub = traffic_node->create_publisher<tf2_msgs::msg::TFMessage>("/bench/tf", 100);
+  auto param_pub = traffic_node->create_publisher<rcl_interfaces::msg::ParameterEvent>(
+    "/parameter_events", rclcpp::ParameterEventsQoS());
+
+  tf2_msgs::msg::TFMessage tf_msg;
+  tf_msg.transforms.resize(4);
+  rcl_interfaces::msg::ParameterEvent param_event;
+  param_event.node = bench_node->get_fully_qualified_name();
+  param_event.changed_parameters.resize(1);
+  param_event.changed_parameters[0].name = "housekeeping";
+  param_event.changed_parameters[0].value.type =
+    rcl_interfaces::msg::ParameterType::PARAMETER_INTEGER;
+
+  // Let discovery settle before measuring
+  std::this_thread::sleep_for(500ms);
+
+  const int duration_ms = 3000;
+  std_msgs::msg::Header hot_msg;
+  for (int t = 0; t < duration_ms; t++) {
+    tf_pub->publish(tf_msg);
+    if (t % 2 == 0) {
+      param_event.changed_parameters[0].value.integer_value = t;
+      param_pub->publish(param_event);
+    }
+    if (t % 5 == 0) {
+      hot_msg.stamp = rclcpp::Time(nowNs());
+      hot_pub->publish(hot_msg);
+    }
+    std::this_thread::sleep_for(1ms);
+  }
+  std::this_thread::sleep_for(200ms);
+
+  executor.cancel();
+  spin_thread.join();
+
+  auto latencies = bench_node->latencies();
+  std::sort(latencies.begin(), latencies.end());
+  LatencyStats stats{latencies.size(), 0, 0, 0};
+  if (!latencies.empty()) {
+    stats.p50 = latencies[latencies.size() / 2];
+    stats.p99 = latencies[latencies.size() * 99 / 100];
+    stats.max = latencies.back();
+  }
+  return stats;
+}
+}  // namespace
+
+// Takes several seconds and depends on the machine, so it only runs on request and reports the
+// comparison without judging it
+TEST(CallbackGroupThreadTest, latency_under_housekeeping_traffic)
+{
+  if (std::getenv("AUTO_AIM_BENCHMARKS") == nullptr) {
+    GTEST_SKIP() << "Set AUTO_AIM_BENCHMARKS=1 to compare the hot path latency";
+  }
+
+  auto shared = runBenchmark(false);
+  auto dedicated = runBenchmark(true);
+
+  std::cout << "single executor  n: " << shared.count << " p50: " << shared.p50
+            << "us p99: " << shared.p99 << "us max: " << shared.max << "us" << std::endl;
+  std::cout << "dedicated thread n: " << dedicated.count << " p50: " << dedicated.p50
+            << "us p99: " << dedicated.p99 << "us max: " << dedicated.max << "us" << std::endl;
+
+  ASSERT_GT(shared.count, 0u);
+  ASSERT_GT(dedicated.count, 0u);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  rclcpp::init(argc, argv);
+  auto result = RUN_ALL_TESTS();
+  rclcpp::shutdown();
+  return result;
+}
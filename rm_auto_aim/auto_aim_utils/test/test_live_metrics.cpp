@@ -0,0 +1,170 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "auto_aim_utils/live_metrics.hpp"
+
+using auto_aim_utils::LiveMetrics;
+using auto_aim_utils::LiveMetricsReader;
+using auto_aim_utils::MetricsSnapshot;
+
+namespace
+{
+std::string uniqueName(const std::string & name)
+{
+  return "test_" + name + "_" + std::to_string(getpid());
+}
+
+bool listed(const std::string & segment_name)
+{
+  auto names = LiveMetricsReader::list();
+  return std::find(names.begin(), names.end(), segment_name) != names.end();
+}
+}  // namespace
+
+TEST(LiveMetricsTest, histogram_buckets)
+{
+  using auto_aim_utils::histogramBucket;
+  using auto_aim_utils::histogramBucketMs;
+  // Every bucket starts where the previous one ends, and holds its lower bound
+  for (size_t bucket = 1; bucket < auto_aim_utils::kHistogramBuckets; bucket++) {
+    EXPECT_LT(histogramBucketMs(bucket - 1), histogramBucketMs(bucket));
+    auto lower_ns = static_cast<int64_t>(histogramBucketMs(bucket) * 1e6 + 0.5);
+    EXPECT_EQ(histogramBucket(lower_ns), bucket);
+    EXPECT_EQ(histogramBucket(lower_ns - 1000), bucket - 1);
+  }
+  EXPECT_EQ(histogramBucket(-1), 0u);
+  EXPECT_EQ(histogramBucket(INT64_MAX), auto_aim_utils::kHistogramBuckets - 1);
+}
+
+TEST(LiveMetricsTest, write_and_read)
+{
+  auto name = uniqueName("write_and_read");
+  auto metrics = std::make_unique<LiveMetrics>(
+    name, std::vector<std::string>{"frames", "drops"}, std::vector<std::string>{"state"},
+    std::vector<std::string>{"latency"});
+  metrics->setLabels(0, {"LOST", "DETECTING", "TRACKING"});
+  EXPECT_TRUE(listed(metrics->segmentName()));
+
+  metrics->add(0, 100);
+  metrics->add(1);
+  metrics->set(0, 2);
+  // 1-10ms in 0.01ms steps
+  for (int i = 1; i <= 1000; i++) {
+    metrics->record(0, i * 0.01);
+  }
+
+  LiveMetricsReader reader(metrics->segmentName());
+  MetricsSnapshot snapshot;
+  ASSERT_TRUE(reader.read(snapshot));
+  EXPECT_EQ(snapshot.name, name);
+  EXPECT_EQ(snapshot.pid, getpid());
+  EXPECT_LT(snapshot.idle_s, 1.0);
+  ASSERT_EQ(snapshot.counters.size(), 2u);
+  EXPECT_EQ(snapshot.counters[0].first, "frames");
+  EXPECT_EQ(snapshot.counters[0].second, 100u);
+  EXPECT_EQ(snapshot.counters[1].second, 1u);
+  ASSERT_EQ(snapshot.gauges.size(), 1u);
+  EXPECT_EQ(snapshot.gauges[0].value, 2.0);
+  EXPECT_EQ(snapshot.gauges[0].labels, (std::vector<std::string>{"LOST", "DETECTING", "TRACKING"}));
+  ASSERT_EQ(snapshot.histograms.size(), 1u);
+  const auto & latency = snapshot.histograms[0];
+  EXPECT_EQ(latency.name, "latency");
+  EXPECT_EQ(latency.count, 1000u);
+  EXPECT_NEAR(latency.sum_ms, 5005.0, 0.1);
+  EXPECT_NEAR(latency.max_ms, 10.0, 1e-6);
+  // Within the bucket width of an eighth of the value
+  EXPECT_NEAR(auto_aim_utils::histogramPercentileMs(latency.buckets, 50), 5.0, 5.0 / 8);
+  EXPECT_NEAR(auto_aim_utils::histogramPercentileMs(latency.buckets, 99), 9.9, 9.9 / 8);
+
+  auto segment_name = metrics->segmentName();
+  metrics.reset();
+  EXPECT_FALSE(listed(segment_name));
+  EXPECT_THROW(LiveMetricsReader{segment_name}, std::runtime_error);
+}
+
+TEST(LiveMetricsTest, fully_qualified_name)
+{
+  auto name = uniqueName("fully_qualified_name");
+  LiveMetrics metrics("/ns/" + name, {}, {}, {});
+  EXPECT_EQ(metrics.segmentName(), "/auto_aim_metrics.ns." + name);
+
+  LiveMetricsReader reader(metrics.segmentName());
+  MetricsSnapshot snapshot;
+  ASSERT_TRUE(reader.read(snapshot));
+  EXPECT_EQ(snapshot.name, "/ns/" + name);
+}
+
+TEST(LiveMetricsTest, segment_of_running_process_kept)
+{
+  auto name = uniqueName("running");
+  LiveMetrics metrics(name, {"frames"}, {}, {});
+  metrics.add(0, 7);
+  EXPECT_THROW(LiveMetrics(name, {"frames"}, {}, {}), std::runtime_error);
+
+  LiveMetricsReader reader(metrics.segmentName());
+  MetricsSnapshot snapshot;
+  ASSERT_TRUE(reader.read(snapshot));
+  EXPECT_EQ(snapshot.counters[0].second, 7u);
+}
+
+TEST(LiveMetricsTest, segment_of_exited_process_replaced)
+{
+  auto name = uniqueName("exited");
+  // A child that leaves its segment behind as if it had crashed
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    new LiveMetrics(name, {"frames"}, {}, {});
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+
+  LiveMetrics metrics(name, {"frames"}, {}, {});
+  LiveMetricsReader reader(metrics.segmentName());
+  MetricsSnapshot snapshot;
+  ASSERT_TRUE(reader.read(snapshot));
+  EXPECT_EQ(snapshot.pid, getpid());
+}
+
+TEST(LiveMetricsTest, consistent_under_concurrent_updates)
+{
+  LiveMetrics metrics(uniqueName("concurrent"), {}, {}, {"latency"});
+  LiveMetricsReader reader(metrics.segmentName());
+
+  std::atomic<bool> running{true};
+  std::thread writer([&]() {
+    for (uint64_t i = 0; running; i++) {
+      metrics.record(0, (i % 1000) * 0.01);
+    }
+  });
+
+  int torn = 0;
+  MetricsSnapshot snapshot;
+  for (int i = 0; i < 10000; i++) {
+    if (!reader.read(snapshot)) {
+      continue;
+    }
+    uint64_t total = 0;
+    for (auto count : snapshot.histograms[0].buckets) {
+      total += count;
+    }
+    torn += total != snapshot.histograms[0].count;
+  }
+  running = false;
+  writer.join();
+  EXPECT_EQ(torn, 0);
+}
@@ -0,0 +1,128 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+
+// STD
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "auto_aim_utils/perf_counters.hpp"
+
+using auto_aim_utils::PerfCounters;
+using auto_aim_utils::StageCounters;
+
+namespace
+{
+constexpr int kFrames = 20;
+
+// A sequential sum over a small array, branch-free and cache friendly
+uint64_t sequentialSum(const std::vector<uint32_t> & data)
+{
+  return std::accumulate(data.begin(), data.end(), uint64_t(0));
+}
+
+// A random walk over a large array with an unpredictable branch per step
+uint64_t randomWalk(const std::vector<uint32_t> & next, size_t steps)
+{
+  uint64_t sum = 0;
+  uint32_t i = 0;
+  for (size_t step = 0; step < steps; step++) {
+    i = next[i];
+    if (i & 1) {
+      sum += i;
+    } else {
+      sum ^= i;
+    }
+  }
+  return sum;
+}
+
+bool countersAvailable(std::string & error)
+{
+  PerfCounters counters;
+  return counters.open(error);
+}
+}  // namespace
+
+TEST(StageCountersTest, no_samples_without_frames)
+{
+  StageCounters stage_counters({"a", "b"}, 10);
+  auto summary = stage_counters.summary();
+  ASSERT_EQ(summary.size(), 2u);
+  EXPECT_EQ(summary[0].stage, "a");
+  EXPECT_EQ(summary[0].samples, 0u);
+  EXPECT_EQ(summary[1].ipc, 0.0);
+}
+
+TEST(StageCountersTest, stages_are_told_apart)
+{
+  std::string error;
+  if (!countersAvailable(error)) {
+    GTEST_SKIP() << "Hardware counters not available here: " << error;
+  }
+
+  // 64 MiB random cycle for the memory- and branch-bound stage
+  std::vector<uint32_t> next(16 * 1024 * 1024);
+  std::iota(next.begin(), next.end(), 0);
+  std::mt19937 rng(42);
+  std::shuffle(next.begin() + 1, next.end(), rng);
+  std::vector<uint32_t> cycle(next.size());
+  for (size_t i = 0; i < next.size(); i++) {
+    cycle[next[i]] = next[(i + 1) % next.size()];
+  }
+  std::vector<uint32_t> small(4096, 1);
+
+  StageCounters stage_counters({"sequential", "random"}, kFrames);
+  volatile uint64_t sink = 0;
+  for (int frame = 0; frame < kFrames; frame++) {
+    ASSERT_TRUE(stage_counters.startFrame()) << stage_counters.error();
+    sink = sink + sequentialSum(small);
+    stage_counters.finishStage(0);
+    sink = sink + randomWalk(cycle, 100000);
+    stage_counters.finishStage(1);
+  }
+
+  auto summary = stage_counters.summary();
+  const auto & sequential = summary[0];
+  const auto & random = summary[1];
+  EXPECT_EQ(sequential.samples, static_cast<size_t>(kFrames));
+  EXPECT_EQ(random.samples, static_cast<size_t>(kFrames));
+  EXPECT_GT(random.mean[PerfCounters::INSTRUCTIONS], sequential.mean[PerfCounters::INSTRUCTIONS]);
+  EXPECT_GT(random.cache_mpki, sequential.cache_mpki);
+  EXPECT_GT(random.branch_mpki, sequential.branch_mpki);
+  EXPECT_LT(random.ipc, sequential.ipc);
+
+  for (const auto & stage : summary) {
+    std::cout << stage.stage << ": " << stage.mean[PerfCounters::CYCLES] << " cycles, IPC "
+              << stage.ipc << ", cache MPKI " << stage.cache_mpki << ", branch MPKI "
+              << stage.branch_mpki << std::endl;
+  }
+}
+
+TEST(StageCountersTest, other_threads_are_skipped)
+{
+  std::string error;
+  if (!countersAvailable(error)) {
+    GTEST_SKIP() << "Hardware counters not available here: " << error;
+  }
+
+  StageCounters stage_counters({"stage"}, kFrames);
+  ASSERT_TRUE(stage_counters.startFrame());
+  stage_counters.finishStage(0);
+
+  bool started = true;
+  std::thread other([&]() {
+    started = stage_counters.startFrame();
+    stage_counters.finishStage(0);
+  });
+  other.join();
+  EXPECT_FALSE(started);
+  EXPECT_EQ(stage_counters.summary()[0].samples, 1u);
+}
@@ -0,0 +1,166 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+// STD
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "auto_aim_utils/perf_regression.hpp"
+
+using auto_aim_utils::BenchmarkResult;
+using auto_aim_utils::PerfBaseline;
+
+namespace
+{
+BenchmarkResult makeResult(const std::string & name, double median_us, double spread_us)
+{
+  std::mt19937 rng(0);
+  std::normal_distribution<double> noise(median_us, spread_us);
+  BenchmarkResult result;
+  result.name = name;
+  for (int i = 0; i < 500; i++) {
+    result.samples_us.push_back(noise(rng));
+  }
+  auto_aim_utils::summarizeSamples(result);
+  return result;
+}
+
+std::string tempPath()
+{
+  return "/tmp/test_perf_regression_" + std::to_string(getpid()) + ".txt";
+}
+}  // namespace
+
+TEST(PerfRegressionTest, median_confidence_interval)
+{
+  BenchmarkResult result;
+  for (int i = 1; i <= 101; i++) {
+    result.samples_us.push_back(i);
+  }
+  // Outliers do not move the median
+  result.samples_us.push_back(1e6);
+  result.samples_us.push_back(1e6);
+  auto_aim_utils::summarizeSamples(result);
+  EXPECT_DOUBLE_EQ(result.median_us, 52);
+  // About 1.96 * sqrt(103) / 2 ranks on each side
+  EXPECT_NEAR(result.ci_low_us, 42, 1);
+  EXPECT_NEAR(result.ci_high_us, 62, 1);
+}
+
+TEST(PerfRegressionTest, verdicts)
+{
+  PerfBaseline baseline;
+  baseline.record(
+    "test_machine", {makeResult("same", 100, 5), makeResult("slower", 100, 5),
+                     makeResult("noisy", 100, 5), makeResult("faster", 100, 5)},
+    0.1);
+
+  // 5% slower is within the tolerance, 20% is not
+  auto ok = auto_aim_utils::compareWithBaseline(
+    {makeResult("same", 100, 5), makeResult("slower", 105, 5)}, baseline, "test_machine");
+  EXPECT_FALSE(ok.regressed) << ok.report;
+  EXPECT_FALSE(ok.missing_baseline);
+
+  auto slower = auto_aim_utils::compareWithBaseline(
+    {makeResult("slower", 120, 5), makeResult("faster", 70, 5)}, baseline, "test_machine");
+  EXPECT_TRUE(slower.regressed) << slower.report;
+  EXPECT_NE(slower.report.find("REGRESSED"), std::string::npos);
+  EXPECT_NE(slower.report.find("faster,"), std::string::npos);
+
+  // A median 12% slower but too noisy to tell is not a significant regression
+  auto noisy = auto_aim_utils::compareWithBaseline(
+    {makeResult("noisy", 112, 200)}, baseline, "test_machine");
+  EXPECT_FALSE(noisy.regressed) << noisy.report;
+
+  auto other = auto_aim_utils::compareWithBaseline(
+    {makeResult("same", 1000, 5)}, baseline, "other_machine");
+  EXPECT_FALSE(other.regressed);
+  EXPECT_TRUE(other.missing_baseline);
+  std::cout << slower.report << other.report;
+}
+
+TEST(PerfRegressionTest, save_and_load)
+{
+  PerfBaseline baseline;
+  baseline.record("machine_a", {makeResult("detector", 812.5, 1)}, 0.15);
+  baseline.record("machine_b", {makeResult("detector", 400, 1)});
+  // Recording again keeps the tolerance
+  baseline.record("machine_a", {makeResult("tracker", 3, 0.01)}, 0.5);
+
+  std::string error;
+  auto path = tempPath();
+  ASSERT_TRUE(baseline.save(path, error)) << error;
+  PerfBaseline loaded;
+  ASSERT_TRUE(loaded.load(path, error)) << error;
+  std::remove(path.c_str());
+
+  auto machine = loaded.find("machine_a");
+  ASSERT_NE(machine, nullptr);
+  EXPECT_DOUBLE_EQ(machine->tolerance, 0.15);
+  EXPECT_NEAR(machine->medians_us.at("detector"), 812.5, 0.1);
+  EXPECT_NEAR(machine->medians_us.at("tracker"), 3, 0.1);
+  ASSERT_NE(loaded.find("machine_b"), nullptr);
+  EXPECT_EQ(loaded.find("machine_c"), nullptr);
+}
+
+TEST(PerfRegressionTest, broken_baseline_fails)
+{
+  auto path = tempPath();
+  std::ofstream(path) << "detector 812.5\n";
+  auto comparison = auto_aim_utils::checkBaseline({makeResult("detector", 800, 1)}, path);
+  std::remove(path.c_str());
+  EXPECT_TRUE(comparison.regressed);
+  EXPECT_NE(comparison.report.find(":1:"), std::string::npos) << comparison.report;
+
+  auto missing = auto_aim_utils::checkBaseline({makeResult("detector", 800, 1)}, path);
+  EXPECT_FALSE(missing.regressed);
+  EXPECT_TRUE(missing.missing_baseline);
+}
+
+TEST(PerfRegressionTest, required_baseline_fails)
+{
+  auto path = tempPath();
+  setenv("AUTO_AIM_PERF_REQUIRE_BASELINE", "1", 1);
+  auto missing = auto_aim_utils::checkBaseline({makeResult("detector", 800, 1)}, path);
+  unsetenv("AUTO_AIM_PERF_REQUIRE_BASELINE");
+  EXPECT_TRUE(missing.missing_baseline);
+  EXPECT_TRUE(missing.regressed);
+  EXPECT_NE(missing.report.find("AUTO_AIM_PERF_REQUIRE_BASELINE"), std::string::npos);
+}
+
+TEST(PerfRegressionTest, run_benchmark)
+{
+  volatile double sink = 0;
+  auto result = auto_aim_utils::runBenchmark("loop", [&sink]() {
+    for (int i = 0; i < 1000; i++) {
+      sink = sink + i;
+    }
+  });
+  EXPECT_EQ(result.samples_us.size(), 500u);
+  EXPECT_GE(result.cpu, 0);
+  EXPECT_LE(result.ci_low_us, result.median_us);
+  EXPECT_GE(result.ci_high_us, result.median_us);
+  EXPECT_FALSE(auto_aim_utils::machineClass().empty());
+  std::cout << auto_aim_utils::machineClass() << ": " << result.median_us << "us" << std::endl;
+}
+
+TEST(PerfRegressionTest, run_benchmark_batch)
+{
+  int calls = 0;
+  auto_aim_utils::BenchmarkOptions options;
+  options.warm_up = 10;
+  options.iterations = 20;
+  options.batch = 5;
+  auto result = auto_aim_utils::runBenchmark("batch", [&calls]() { calls++; }, options);
+  EXPECT_EQ(result.samples_us.size(), 20u);
+  EXPECT_EQ(calls, 10 + 20 * 5);
+}
@@ -0,0 +1,158 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+#include <time.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "auto_aim_utils/realtime.hpp"
+
+namespace
+{
+struct JitterResult
+{
+  bool applied;
+  std::string error;
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+// Wake up periodically on an absolute deadline and record how late each wake up is,
+// while other threads keep every CPU busy
+JitterResult measureJitter(const auto_aim_utils::RealtimeConfig & config)
+{
+  const int period_us = 1000;
+  const int loop_num = 2000;
+
+  JitterResult result;
+  std::vector<double> latencies;
+  latencies.reserve(loop_num);
+
+  std::thread worker([&]() {
+    result.applied = auto_aim_utils::applyRealtimeConfig(config, result.error);
+
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < loop_num; i++) {
+      next.tv_nsec += period_us * 1000;
+      if (next.tv_nsec >= 1000000000) {
+        next.tv_nsec -= 1000000000;
+        next.tv_sec++;
+      }
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      latencies.push_back(
+        (now.tv_sec - next.tv_sec) * 1e6 + (now.tv_nsec - next.tv_nsec) * 1e-3);
+    }
+  });
+
+  // Background load competing with the measured thread
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> load;
+  const long cpu_num = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+  for (long i = 0; i < cpu_num; i++) {
+    load.emplace_back([&stop]() {
+      volatile double x = 0;
+      while (!stop) {
+        x = x + 1.0;
+      }
+    });
+  }
+
+  worker.join();
+  stop = true;
+  for (auto & t : load) {
+    t.join();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  result.p50_us = latencies[latencies.size() / 2];
+  result.p99_us = latencies[latencies.size() * 99 / 100];
+  result.max_us = latencies.back();
+  return result;
+}
+}  // namespace
+
+TEST(RealtimeTest, apply_and_check)
+{
+  auto_aim_utils::RealtimeConfig config;
+  config.cpu_affinity = {0};
+  config.prefault_stack_kb = 64;
+
+  std::thread t([&config]() {
+    std::string error;
+    EXPECT_TRUE(auto_aim_utils::applyRealtimeConfig(config, error)) << error;
+    EXPECT_TRUE(auto_aim_utils::checkRealtimeConfig(config, error)) << error;
+    std::cout << auto_aim_utils::describeCurrentThread() << std::endl;
+  });
+  t.join();
+}
+
+TEST(RealtimeTest, invalid_cpu)
+{
+  auto_aim_utils::RealtimeConfig config;
+  config.cpu_affinity = {-1};
+
+  std::thread t([&config]() {
+    std::string error;
+    EXPECT_FALSE(auto_aim_utils::applyRealtimeConfig(config, error));
+    EXPECT_FALSE(error.empty());
+  });
+  t.join();
+}
+
+TEST(RealtimeTest, stack_larger_than_thread)
+{
+  auto_aim_utils::RealtimeConfig config;
+  // Far beyond the default 8 MiB thread stack, prefaulting it all would crash
+  config.prefault_stack_kb = 65536;
+
+  std::thread t([&config]() {
+    std::string error;
+    EXPECT_FALSE(auto_aim_utils::applyRealtimeConfig(config, error));
+    EXPECT_NE(error.find("prefault_stack_kb"), std::string::npos) << error;
+  });
+  t.join();
+}
+
+// Loads every CPU for about 4s and depends on the machine, so it only runs on request and
+// reports the comparison without judging it
+TEST(RealtimeTest, jitter)
+{
+  if (std::getenv("AUTO_AIM_BENCHMARKS") == nullptr) {
+    GTEST_SKIP() << "Set AUTO_AIM_BENCHMARKS=1 to measure the wake up jitter";
+  }
+
+  auto_aim_utils::RealtimeConfig default_config;
+  auto default_result = measureJitter(default_config);
+
+  auto_aim_utils::RealtimeConfig rt_config;
+  rt_config.cpu_affinity = {0};
+  rt_config.priority = 80;
+  // No mlockall, it would lock the memory of the whole test process
+  rt_config.prefault_stack_kb = 256;
+  auto rt_result = measureJitter(rt_config);
+
+  std::cout << "default  p50: " << default_result.p50_us << "us p99: " << default_result.p99_us
+            << "us max: " << default_result.max_us << "us" << std::endl;
+  std::cout << "realtime p50: " << rt_result.p50_us << "us p99: " << rt_result.p99_us
+            << "us max: " << rt_result.max_us << "us" << std::endl;
+
+  if (!rt_result.applied) {
+    GTEST_SKIP() << "Real-time config not permitted here: " << rt_result.error;
+  }
+  // SCHED_FIFO preempts the SCHED_OTHER load, the tail is expected to be shorter
+  std::cout << "realtime p99 is " << (rt_result.p99_us <= default_result.p99_us ? "" : "NOT ")
+            << "better than default" << std::endl;
+}
@@ -0,0 +1,212 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/allocation_counter.hpp"
+
+#include <execinfo.h>
+
+// STD
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+// glibc's own allocator, which the interposed functions forward to
+extern "C" {
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t count, size_t size);
+void * __libc_realloc(void * ptr, size_t size);
+void * __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void * ptr);
+}
+
+namespace
+{
+constexpr int kRecordedStacks = 8;
+constexpr int kStackDepth = 16;
+
+struct RecordedStack
+{
+  size_t size;
+  int depth;
+  void * frames[kStackDepth];
+};
+
+std::atomic<bool> g_counting(false);
+std::atomic<size_t> g_allocations(0);
+std::atomic<size_t> g_frees(0);
+std::atomic<size_t> g_bytes(0);
+RecordedStack g_stacks[kRecordedStacks];
+std::atomic<int> g_recorded(0);
+// Set while recording a stack, backtrace() may allocate itself
+thread_local bool t_in_hook = false;
+
+void countAllocation(size_t size)
+{
+  if (!g_counting.load(std::memory_order_relaxed) || t_in_hook) {
+    return;
+  }
+  t_in_hook = true;
+  size_t index = g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (index < static_cast<size_t>(kRecordedStacks)) {
+    auto & stack = g_stacks[index];
+    stack.size = size;
+    stack.depth = backtrace(stack.frames, kStackDepth);
+    g_recorded.fetch_add(1, std::memory_order_release);
+  }
+  t_in_hook = false;
+}
+
+void countFree(void * ptr)
+{
+  if (ptr != nullptr && g_counting.load(std::memory_order_relaxed) && !t_in_hook) {
+    g_frees.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Load libgcc's unwinder before counting starts, its first use allocates
+struct BacktraceWarmUp
+{
+  BacktraceWarmUp()
+  {
+    void * frames[1];
+    backtrace(frames, 1);
+  }
+} g_backtrace_warm_up;
+}  // namespace
+
+extern "C" {
+void * malloc(size_t size)
+{
+  countAllocation(size);
+  return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size)
+{
+  countAllocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+void * realloc(void * ptr, size_t size)
+{
+  // A moved or shrunk block is one free and one allocation, realloc(ptr, 0) only frees
+  countFree(ptr);
+  if (ptr == nullptr || size != 0) {
+    countAllocation(size);
+  }
+  return __libc_realloc(ptr, size);
+}
+
+void * memalign(size_t alignment, size_t size)
+{
+  countAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+void * aligned_alloc(size_t alignment, size_t size)
+{
+  countAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void ** ptr, size_t alignment, size_t size)
+{
+  countAllocation(size);
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr != nullptr ? 0 : ENOMEM;
+}
+
+void free(void * ptr)
+{
+  countFree(ptr);
+  __libc_free(ptr);
+}
+}
+
+// The global operator new and delete go through the counted malloc and free, independent of
+// how the standard library implements them
+void * operator new(size_t size)
+{
+  void * ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void * operator new[](size_t size) { return operator new(size); }
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return malloc(size == 0 ? 1 : size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void * ptr) noexcept { free(ptr); }
+
+void operator delete[](void * ptr) noexcept { free(ptr); }
+
+void operator delete(void * ptr, size_t) noexcept { free(ptr); }
+
+void operator delete[](void * ptr, size_t) noexcept { free(ptr); }
+
+void operator delete(void * ptr, const std::nothrow_t &) noexcept { free(ptr); }
+
+void operator delete[](void * ptr, const std::nothrow_t &) noexcept { free(ptr); }
+
+namespace auto_aim_utils
+{
+AllocationScope::AllocationScope() : active_(true)
+{
+  g_allocations = 0;
+  g_frees = 0;
+  g_bytes = 0;
+  g_recorded = 0;
+  g_counting = true;
+}
+
+AllocationScope::~AllocationScope() { stop(); }
+
+AllocationStats AllocationScope::stop()
+{
+  if (active_) {
+    g_counting = false;
+    active_ = false;
+    stats_.allocations = g_allocations;
+    stats_.frees = g_frees;
+    stats_.bytes = g_bytes;
+  }
+  return stats_;
+}
+
+std::string AllocationScope::report() const
+{
+  std::ostringstream report;
+  int recorded = g_recorded.load(std::memory_order_acquire);
+  report << stats_.allocations << " allocations (" << stats_.bytes << " bytes) and "
+         << stats_.frees << " frees";
+  if (recorded > 0) {
+    report << ", call stacks of the first " << recorded << ":";
+  }
+  for (int i = 0; i < recorded; i++) {
+    const auto & stack = g_stacks[i];
+    report << "\n#" << i << " " << stack.size << " bytes";
+    char ** symbols = backtrace_symbols(stack.frames, stack.depth);
+    // Skip the interposed allocation function itself
+    for (int frame = 1; frame < stack.depth; frame++) {
+      report << "\n    " << (symbols != nullptr ? symbols[frame] : "?");
+    }
+    free(symbols);
+  }
+  return report.str();
+}
+
+}  // namespace auto_aim_utils
@@ -0,0 +1,342 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "auto_aim_utils/perf_regression.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/utsname.h>
+
+// STD
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "auto_aim_utils/realtime.hpp"
+
+namespace auto_aim_utils
+{
+namespace
+{
+// z of the two-sided 95% interval
+constexpr double kZ95 = 1.96;
+
+int pickCpu(int requested)
+{
+  if (requested >= 0) {
+    return requested;
+  }
+  const char * env = std::getenv("AUTO_AIM_PERF_CPU");
+  if (env != nullptr && *env != '\0') {
+    return std::atoi(env);
+  }
+  // The last allowed CPU, usually the one the system puts the least on
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+    return -1;
+  }
+  for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      return cpu;
+    }
+  }
+  return -1;
+}
+
+std::string sanitize(const std::string & name)
+{
+  std::string result;
+  for (char c : name) {
+    if (std::isalnum(static_cast<unsigned char>(c))) {
+      result += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    } else if (!result.empty() && result.back() != '_') {
+      result += '_';
+    }
+  }
+  while (!result.empty() && result.back() == '_') {
+    result.pop_back();
+  }
+  return result;
+}
+
+std::string cpuModel()
+{
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  // x86 has "model name", ARM boards "Model" or at least "Hardware"
+  for (const char * key : {"model name", "Model", "Hardware"}) {
+    cpuinfo.clear();
+    cpuinfo.seekg(0);
+    while (std::getline(cpuinfo, line)) {
+      auto colon = line.find(':');
+      if (colon != std::string::npos && sanitize(line.substr(0, colon)) == sanitize(key)) {
+        return line.substr(colon + 1);
+      }
+    }
+  }
+  utsname name;
+  return uname(&name) == 0 ? name.machine : "unknown";
+}
+
+std::string formatUs(double us)
+{
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.2f", us);
+  return text;
+}
+}  // namespace
+
+void summarizeSamples(BenchmarkResult & result)
+{
+  auto sorted = result.samples_us;
+  std::sort(sorted.begin(), sorted.end());
+  const int n = static_cast<int>(sorted.size());
+  if (n == 0) {
+    result.median_us = result.ci_low_us = result.ci_high_us = 0;
+    return;
+  }
+  result.median_us = n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+
+  // The number of samples below the median is Binomial(n, 1/2), the ranks n/2 -+ z*sqrt(n)/2
+  // (1-based) bound the median with about 95% probability
+  double half_width = kZ95 * std::sqrt(static_cast<double>(n)) / 2;
+  int low_rank = static_cast<int>(std::floor(n / 2.0 - half_width));
+  int high_rank = static_cast<int>(std::ceil(n / 2.0 + half_width)) + 1;
+  result.ci_low_us = sorted[std::min(std::max(low_rank, 1), n) - 1];
+  result.ci_high_us = sorted[std::min(std::max(high_rank, 1), n) - 1];
+}
+
+BenchmarkResult runBenchmark(
+  const std::string & name, const std::function<void()> & fn, const BenchmarkOptions & options)
+{
+  BenchmarkResult result;
+  result.name = name;
+
+  // Pin for the duration of the benchmark, then give back the previous affinity
+  cpu_set_t previous;
+  bool restore = pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) == 0;
+  int cpu = pickCpu(options.cpu);
+  if (cpu >= 0) {
+    RealtimeConfig config;
+    config.cpu_affinity = {cpu};
+    std::string error;
+    result.cpu = applyRealtimeConfig(config, error) ? cpu : -1;
+  }
+
+  for (int i = 0; i < options.warm_up; i++) {
+    fn();
+  }
+
+  const int batch = std::max(options.batch, 1);
+  result.samples_us.reserve(options.iterations);
+  for (int i = 0; i < options.iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int call = 0; call < batch; call++) {
+      fn();
+    }
+    std::chrono::duration<double, std::micro> cost = std::chrono::steady_clock::now() - start;
+    result.samples_us.push_back(cost.count() / batch);
+  }
+
+  if (restore) {
+    pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+  }
+  summarizeSamples(result);
+  return result;
+}
+
+std::string machineClass()
+{
+  const char * env = std::getenv("AUTO_AIM_MACHINE_CLASS");
+  std::string machine_class = sanitize(env != nullptr && *env != '\0' ? env : cpuModel());
+#ifndef NDEBUG
+  // Unoptimized builds have their own timings
+  machine_class += "_debug";
+#endif
+  return machine_class;
+}
+
+bool PerfBaseline::load(const std::string & path, std::string & error)
+{
+  std::ifstream file(path);
+  if (!file) {
+    error = "cannot read " + path;
+    return false;
+  }
+
+  machines_.clear();
+  Machine * machine = nullptr;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    std::istringstream ss(line);
+    std::string key;
+    if (!(ss >> key) || key[0] == '#') {
+      continue;
+    }
+    if (key == "machine") {
+      std::string name;
+      double tolerance;
+      if (!(ss >> name >> tolerance) || tolerance < 0) {
+        error = path + ":" + std::to_string(line_number) + ": expected machine <class> <tolerance>";
+        return false;
+      }
+      machine = &machines_[name];
+      machine->tolerance = tolerance;
+      continue;
+    }
+    double median_us;
+    if (machine == nullptr || !(ss >> median_us) || median_us <= 0) {
+      error = path + ":" + std::to_string(line_number) + ": expected <benchmark> <median_us>";
+      return false;
+    }
+    machine->medians_us[key] = median_us;
+  }
+  return true;
+}
+
+bool PerfBaseline::save(const std::string & path, std::string & error) const
+{
+  std::ofstream file(path);
+  if (!file) {
+    error = "cannot write " + path;
+    return false;
+  }
+
+  file << "# Medians (us) of the perf regression benchmarks per machine class.\n"
+       << "# Recorded with AUTO_AIM_PERF_RECORD=1, see auto_aim_utils/README.md\n";
+  for (const auto & machine : machines_) {
+    file << "\nmachine " << machine.first << ' ' << machine.second.tolerance << '\n';
+    for (const auto & median : machine.second.medians_us) {
+      file << median.first << ' ' << formatUs(median.second) << '\n';
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+void PerfBaseline::record(
+  const std::string & machine_class, const std::vector<BenchmarkResult> & results,
+  double default_tolerance)
+{
+  auto inserted = machines_.emplace(machine_class, Machine());
+  auto & machine = inserted.first->second;
+  if (inserted.second) {
+    machine.tolerance = default_tolerance;
+  }
+  for (const auto & result : results) {
+    machine.medians_us[result.name] = result.median_us;
+  }
+}
+
+const PerfBaseline::Machine * PerfBaseline::find(const std::string & machine_class) const
+{
+  auto it = machines_.find(machine_class);
+  return it == machines_.end() ? nullptr : &it->second;
+}
+
+PerfComparison compareWithBaseline(
+  const std::vector<BenchmarkResult> & results, const PerfBaseline & baseline,
+  const std::string & machine_class)
+{
+  PerfComparison comparison;
+  const auto * machine = baseline.find(machine_class);
+  comparison.missing_baseline = machine == nullptr;
+
+  std::ostringstream report;
+  report << "Machine class " << machine_class;
+  if (machine != nullptr) {
+    report << ", tolerance " << machine->tolerance * 100 << "%";
+  } else {
+    report << " has no baseline, record one with AUTO_AIM_PERF_RECORD=1";
+  }
+  report << '\n';
+
+  char row[160];
+  std::snprintf(
+    row, sizeof(row), "  %-24s %12s %12s %23s %8s  %s\n", "benchmark", "baseline(us)",
+    "median(us)", "95% CI(us)", "change", "verdict");
+  report << row;
+  for (const auto & result : results) {
+    std::string ci = "[" + formatUs(result.ci_low_us) + ", " + formatUs(result.ci_high_us) + "]";
+    auto it = machine != nullptr ? machine->medians_us.find(result.name)
+                                 : std::map<std::string, double>::const_iterator();
+    if (machine == nullptr || it == machine->medians_us.end()) {
+      std::snprintf(
+        row, sizeof(row), "  %-24s %12s %12.2f %23s %8s  %s\n", result.name.c_str(), "-",
+        result.median_us, ci.c_str(), "-", machine == nullptr ? "new" : "not in baseline");
+      report << row;
+      continue;
+    }
+
+    double base = it->second;
+    double change = (result.median_us - base) / base * 100;
+    // Only significant differences beyond the tolerance count, the whole confidence interval
+    // has to be on one side of the accepted range
+    const char * verdict = "ok";
+    if (result.ci_low_us > base * (1 + machine->tolerance)) {
+      verdict = "REGRESSED";
+      comparison.regressed = true;
+    } else if (result.ci_high_us < base * (1 - machine->tolerance)) {
+      verdict = "faster, consider recording a new baseline";
+    } else if (result.ci_high_us - result.ci_low_us > base * machine->tolerance) {
+      verdict = "ok, noisy";
+    }
+    std::snprintf(
+      row, sizeof(row), "  %-24s %12.2f %12.2f %23s %+7.1f%%  %s\n", result.name.c_str(), base,
+      result.median_us, ci.c_str(), change, verdict);
+    report << row;
+  }
+  comparison.report = report.str();
+  return comparison;
+}
+
+PerfComparison checkBaseline(
+  const std::vector<BenchmarkResult> & results, const std::string & baseline_path)
+{
+  PerfBaseline baseline;
+  std::string error;
+  bool loaded = baseline.load(baseline_path, error);
+  auto machine_class = machineClass();
+  // A missing file is an empty baseline, a broken one must not silently pass
+  if (!loaded && std::ifstream(baseline_path).good()) {
+    PerfComparison comparison;
+    comparison.regressed = true;
+    comparison.report = error + "\n";
+    return comparison;
+  }
+
+  const char * record = std::getenv("AUTO_AIM_PERF_RECORD");
+  if (record != nullptr && std::string(record) == "1") {
+    PerfComparison comparison;
+    baseline.record(machine_class, results);
+    if (baseline.save(baseline_path, error)) {
+      comparison.report = compareWithBaseline(results, baseline, machine_class).report +
+                          "Recorded into " + baseline_path + "\n";
+    } else {
+      comparison.regressed = true;
+      comparison.report = error + "\n";
+    }
+    return comparison;
+  }
+
+  auto comparison = compareWithBaseline(results, baseline, machine_class);
+  // On CI a missing baseline would otherwise pass forever as a skipped test
+  const char * require = std::getenv("AUTO_AIM_PERF_REQUIRE_BASELINE");
+  if (comparison.missing_baseline && require != nullptr && std::string(require) == "1") {
+    comparison.regressed = true;
+    comparison.report += "AUTO_AIM_PERF_REQUIRE_BASELINE=1 and machine class " + machine_class +
+                         " has no baseline in " + baseline_path + "\n";
+  }
+  return comparison;
+}
+
+}  // namespace auto_aim_utils
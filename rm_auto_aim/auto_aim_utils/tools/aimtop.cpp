@@ -0,0 +1,211 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+// Live view of the metrics the auto-aim nodes write into shared memory (see live_metrics.hpp).
+// The segments are mapped read-only, so watching costs the nodes nothing.
+//
+//   ros2 run auto_aim_utils aimtop [-i seconds] [-n refreshes] [node ...]
+
+#include <signal.h>
+#include <unistd.h>
+
+// STD
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "auto_aim_utils/live_metrics.hpp"
+
+using auto_aim_utils::LiveMetricsReader;
+using auto_aim_utils::MetricsSnapshot;
+
+namespace
+{
+struct Options
+{
+  double interval_s = 1.0;
+  // 0 refreshes until interrupted
+  int iterations = 0;
+  // Substrings of the node names to show, all nodes if empty
+  std::vector<std::string> filters;
+};
+
+void usage()
+{
+  std::printf(
+    "usage: aimtop [-i seconds] [-n refreshes] [node ...]\n"
+    "  -i  refresh interval, default 1.0\n"
+    "  -n  exit after this many refreshes, default 0 (until interrupted)\n"
+    "  node  only show nodes whose name contains one of these\n");
+}
+
+bool parseOptions(int argc, char ** argv, Options & options)
+{
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if ((arg == "-i" || arg == "-n") && i + 1 < argc) {
+      char * end;
+      double value = std::strtod(argv[++i], &end);
+      if (*end != '\0' || value <= 0) {
+        return false;
+      }
+      if (arg == "-i") {
+        options.interval_s = value;
+      } else {
+        options.iterations = static_cast<int>(value);
+      }
+    } else if (arg.empty() || arg[0] == '-') {
+      return false;
+    } else {
+      options.filters.push_back(arg);
+    }
+  }
+  return true;
+}
+
+bool selected(const Options & options, const std::string & name)
+{
+  if (options.filters.empty()) {
+    return true;
+  }
+  for (const auto & filter : options.filters) {
+    if (name.find(filter) != std::string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool processAlive(int pid) { return kill(pid, 0) == 0 || errno == EPERM; }
+
+std::string gaugeText(const MetricsSnapshot::Gauge & gauge)
+{
+  double index = std::round(gauge.value);
+  if (
+    !gauge.labels.empty() && index == gauge.value && index >= 0 &&
+    index < static_cast<double>(gauge.labels.size())) {
+    return gauge.labels[static_cast<size_t>(index)];
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.6g", gauge.value);
+  return text;
+}
+
+// Counters and histograms are shown over the last interval when the previous snapshot is of the
+// same run of the node, otherwise over the whole run. The max of a histogram is always over the
+// whole run.
+void printNode(const MetricsSnapshot & now, const MetricsSnapshot * last, double interval_s)
+{
+  bool windowed = last != nullptr && last->id == now.id;
+  if (processAlive(now.pid)) {
+    std::printf("%s  pid %d  updated %.1fs ago\n", now.name.c_str(), now.pid, now.idle_s);
+  } else {
+    std::printf("%s  pid %d  exited\n", now.name.c_str(), now.pid);
+  }
+
+  for (size_t i = 0; i < now.counters.size(); i++) {
+    const auto & counter = now.counters[i];
+    if (windowed) {
+      double rate = (counter.second - last->counters[i].second) / interval_s;
+      std::printf("  %-24s %12" PRIu64 " %10.1f/s\n", counter.first.c_str(), counter.second, rate);
+    } else {
+      std::printf("  %-24s %12" PRIu64 "\n", counter.first.c_str(), counter.second);
+    }
+  }
+  for (const auto & gauge : now.gauges) {
+    std::printf("  %-24s %12s\n", gauge.name.c_str(), gaugeText(gauge).c_str());
+  }
+
+  if (now.histograms.empty()) {
+    return;
+  }
+  std::printf(
+    "  %-24s %8s %8s %8s %8s %8s %8s %8s\n", "latency (ms)", "count", "rate/s", "mean", "p50",
+    "p90", "p99", "run max");
+  for (size_t i = 0; i < now.histograms.size(); i++) {
+    auto histogram = now.histograms[i];
+    if (windowed) {
+      const auto & previous = last->histograms[i];
+      histogram.count -= previous.count;
+      histogram.sum_ms -= previous.sum_ms;
+      for (size_t b = 0; b < histogram.buckets.size(); b++) {
+        histogram.buckets[b] -= previous.buckets[b];
+      }
+    }
+    char rate[16] = "-";
+    if (windowed) {
+      std::snprintf(rate, sizeof(rate), "%.1f", histogram.count / interval_s);
+    }
+    double mean = histogram.count > 0 ? histogram.sum_ms / histogram.count : NAN;
+    // Percentiles are bucket middles, which may lie above the largest sample
+    double max_ms = now.histograms[i].max_ms;
+    auto percentile = [&histogram, max_ms](double p) {
+      return std::min(auto_aim_utils::histogramPercentileMs(histogram.buckets, p), max_ms);
+    };
+    std::printf(
+      "  %-24s %8" PRIu64 " %8s %8.3f %8.3f %8.3f %8.3f %8.3f\n", histogram.name.c_str(),
+      histogram.count, rate, mean, percentile(50), percentile(90), percentile(99), max_ms);
+  }
+}
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+  bool interactive = isatty(STDOUT_FILENO);
+
+  std::map<std::string, MetricsSnapshot> last;
+  for (int refresh = 0; options.iterations == 0 || refresh < options.iterations; refresh++) {
+    if (refresh > 0) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(options.interval_s));
+    }
+
+    std::map<std::string, MetricsSnapshot> current;
+    std::vector<std::string> errors;
+    for (const auto & segment_name : LiveMetricsReader::list()) {
+      try {
+        LiveMetricsReader reader(segment_name);
+        MetricsSnapshot snapshot;
+        if (reader.read(snapshot) && selected(options, snapshot.name)) {
+          current[segment_name] = snapshot;
+        }
+      } catch (const std::runtime_error & e) {
+        errors.push_back(e.what());
+      }
+    }
+
+    if (interactive) {
+      // Clear the screen and move to the top left
+      std::printf("\033[H\033[2J");
+    }
+    if (current.empty()) {
+      std::printf("No auto-aim metrics found in /dev/shm\n");
+    }
+    for (const auto & entry : current) {
+      auto it = last.find(entry.first);
+      printNode(entry.second, it != last.end() ? &it->second : nullptr, options.interval_s);
+      std::printf("\n");
+    }
+    for (const auto & error : errors) {
+      std::printf("%s\n", error.c_str());
+    }
+    std::fflush(stdout);
+    last = std::move(current);
+  }
+  return 0;
+}
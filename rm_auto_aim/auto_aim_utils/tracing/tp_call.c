@@ -0,0 +1,7 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#define TRACEPOINT_CREATE_PROBES
+
+#define TRACEPOINT_DEFINE
+#include "auto_aim_utils/tp_call.h"
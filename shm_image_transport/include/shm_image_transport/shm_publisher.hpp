@@ -0,0 +1,45 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef SHM_IMAGE_TRANSPORT__SHM_PUBLISHER_HPP_
+#define SHM_IMAGE_TRANSPORT__SHM_PUBLISHER_HPP_
+
+#include <image_transport/simple_publisher_plugin.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/image.hpp>
+
+// STD
+#include <memory>
+#include <string>
+
+#include "shm_image_transport/msg/shm_image.hpp"
+#include "shm_image_transport/shm_ring.hpp"
+
+namespace shm_image_transport
+{
+// Copies each image into a shared memory ring and publishes only the slot index
+class ShmPublisher : public image_transport::SimplePublisherPlugin<msg::ShmImage>
+{
+public:
+  std::string getTransportName() const override { return "shm"; }
+
+protected:
+  void advertiseImpl(
+    rclcpp::Node * node, const std::string & base_topic, rmw_qos_profile_t custom_qos) override;
+
+  void publish(const sensor_msgs::msg::Image & message, const PublishFn & publish_fn) const override;
+
+private:
+  rclcpp::Logger logger_ = rclcpp::get_logger("shm_image_transport");
+  mutable rclcpp::Clock steady_clock_{RCL_STEADY_TIME};
+  std::string segment_name_;
+  int slot_count_;
+
+  // Created on the first frame and recreated whenever a frame outgrows the slots
+  mutable std::unique_ptr<ShmRing> ring_;
+  mutable msg::ShmImage shm_msg_;
+};
+
+}  // namespace shm_image_transport
+
+#endif  // SHM_IMAGE_TRANSPORT__SHM_PUBLISHER_HPP_
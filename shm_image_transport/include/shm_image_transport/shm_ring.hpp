@@ -0,0 +1,83 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef SHM_IMAGE_TRANSPORT__SHM_RING_HPP_
+#define SHM_IMAGE_TRANSPORT__SHM_RING_HPP_
+
+// STD
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace shm_image_transport
+{
+struct ShmRingHeader;
+struct ShmSlotHeader;
+
+// A ring of fixed-size frame slots in a POSIX shared memory segment.
+//
+// One process creates the segment and writes frames, any number of processes open it and read
+// frames by (slot, sequence). The writer reuses the slots round robin without waiting for
+// readers. Each slot is a seqlock: a reader checks the slot sequence before and after copying
+// and drops the frame if it changed, so nothing a reader does, or fails to do because it
+// crashed, can hold the writer up.
+class ShmRing
+{
+public:
+  // Subscribers counted by subscriberCount(), more may still read
+  static constexpr uint32_t kMaxSubscribers = 32;
+
+  // Create a segment, replacing one left over by a publisher process that no longer exists.
+  // Throws std::runtime_error if the publisher of the existing segment is still running, or if
+  // slot_count is less than 2.
+  static std::unique_ptr<ShmRing> create(
+    const std::string & name, uint32_t slot_count, uint64_t slot_size);
+
+  // Map an existing segment and take a subscriber lease, the pid of this process in the
+  // segment header. Leases of subscriber processes that have died are reused.
+  // Throws std::runtime_error.
+  static std::unique_ptr<ShmRing> open(const std::string & name);
+
+  ~ShmRing();
+
+  ShmRing(const ShmRing &) = delete;
+  ShmRing & operator=(const ShmRing &) = delete;
+
+  // Copy a frame into the next slot. Returns false if it does not fit a slot.
+  bool write(const uint8_t * data, uint64_t size, uint32_t & slot, uint64_t & sequence);
+
+  // Copy the frame out of the slot. Returns false if it has already been overwritten.
+  bool read(uint32_t slot, uint64_t sequence, std::vector<uint8_t> & data);
+
+  const std::string & name() const { return name_; }
+  uint64_t id() const;
+  uint32_t slotCount() const;
+  uint64_t slotSize() const;
+  // Subscribers whose process is still running
+  uint32_t subscriberCount() const;
+
+private:
+  ShmRing(const std::string & name, void * base, size_t length, bool owner);
+
+  // Index of the subscriber lease taken, -1 if all were taken by running processes
+  int acquireLease();
+
+  ShmSlotHeader * slot(uint32_t index) const;
+  uint8_t * slotData(uint32_t index) const;
+
+  std::string name_;
+  void * base_;
+  size_t length_;
+  bool owner_;
+  ShmRingHeader * header_;
+  uint32_t next_slot_;
+  int lease_;
+};
+
+// POSIX shared memory object name for an image topic, e.g. "/image_raw" -> "/shm_image_raw"
+std::string segmentName(const std::string & topic);
+
+}  // namespace shm_image_transport
+
+#endif  // SHM_IMAGE_TRANSPORT__SHM_RING_HPP_
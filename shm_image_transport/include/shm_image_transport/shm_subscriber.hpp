@@ -0,0 +1,40 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#ifndef SHM_IMAGE_TRANSPORT__SHM_SUBSCRIBER_HPP_
+#define SHM_IMAGE_TRANSPORT__SHM_SUBSCRIBER_HPP_
+
+#include <image_transport/simple_subscriber_plugin.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/image.hpp>
+
+// STD
+#include <memory>
+#include <string>
+
+#include "shm_image_transport/msg/shm_image.hpp"
+#include "shm_image_transport/shm_ring.hpp"
+
+namespace shm_image_transport
+{
+// Maps the publisher's shared memory ring and copies each announced frame out of it
+class ShmSubscriber : public image_transport::SimpleSubscriberPlugin<msg::ShmImage>
+{
+public:
+  std::string getTransportName() const override { return "shm"; }
+
+protected:
+  void internalCallback(
+    const msg::ShmImage::ConstSharedPtr & message, const Callback & user_cb) override;
+
+private:
+  rclcpp::Logger logger_ = rclcpp::get_logger("shm_image_transport");
+  std::unique_ptr<ShmRing> ring_;
+
+  // Reused once the user callback no longer holds on to it
+  std::shared_ptr<sensor_msgs::msg::Image> image_;
+};
+
+}  // namespace shm_image_transport
+
+#endif  // SHM_IMAGE_TRANSPORT__SHM_SUBSCRIBER_HPP_
@@ -0,0 +1,10 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include <pluginlib/class_list_macros.hpp>
+
+#include "shm_image_transport/shm_publisher.hpp"
+#include "shm_image_transport/shm_subscriber.hpp"
+
+PLUGINLIB_EXPORT_CLASS(shm_image_transport::ShmPublisher, image_transport::PublisherPlugin)
+PLUGINLIB_EXPORT_CLASS(shm_image_transport::ShmSubscriber, image_transport::SubscriberPlugin)
@@ -0,0 +1,68 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "shm_image_transport/shm_publisher.hpp"
+
+// STD
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace shm_image_transport
+{
+void ShmPublisher::advertiseImpl(
+  rclcpp::Node * node, const std::string & base_topic, rmw_qos_profile_t custom_qos)
+{
+  logger_ = node->get_logger();
+  segment_name_ = segmentName(base_topic);
+
+  // e.g. "/image_raw" -> "image_raw.shm.slot_count"
+  std::string param_name = base_topic.substr(base_topic.find_first_not_of('/'));
+  for (auto & c : param_name) {
+    c = c == '/' ? '.' : c;
+  }
+  param_name += ".shm.slot_count";
+  slot_count_ = node->has_parameter(param_name)
+                  ? node->get_parameter(param_name).as_int()
+                  : node->declare_parameter(param_name, 4);
+  if (slot_count_ < 2) {
+    RCLCPP_WARN(logger_, "%s must be at least 2, using 2", param_name.c_str());
+    slot_count_ = 2;
+  }
+
+  SimplePublisherPlugin<msg::ShmImage>::advertiseImpl(node, base_topic, custom_qos);
+}
+
+void ShmPublisher::publish(
+  const sensor_msgs::msg::Image & message, const PublishFn & publish_fn) const
+{
+  if (ring_ == nullptr || ring_->slotSize() < message.data.size()) {
+    try {
+      ring_.reset();
+      ring_ = ShmRing::create(segment_name_, slot_count_, message.data.size());
+    } catch (const std::runtime_error & e) {
+      RCLCPP_ERROR_THROTTLE(
+        logger_, steady_clock_, 1000, "Failed to create shared memory ring: %s", e.what());
+      return;
+    }
+    shm_msg_.segment = segment_name_;
+    shm_msg_.segment_id = ring_->id();
+  }
+
+  if (!ring_->write(message.data.data(), message.data.size(), shm_msg_.slot, shm_msg_.sequence)) {
+    RCLCPP_WARN_THROTTLE(
+      logger_, steady_clock_, 1000, "Frame of %zu bytes does not fit the shared memory slots",
+      message.data.size());
+    return;
+  }
+
+  shm_msg_.header = message.header;
+  shm_msg_.height = message.height;
+  shm_msg_.width = message.width;
+  shm_msg_.encoding = message.encoding;
+  shm_msg_.is_bigendian = message.is_bigendian;
+  shm_msg_.step = message.step;
+  publish_fn(shm_msg_);
+}
+
+}  // namespace shm_image_transport
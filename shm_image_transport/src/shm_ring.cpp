@@ -0,0 +1,315 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "shm_image_transport/shm_ring.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace shm_image_transport
+{
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory atomics must be lock free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory atomics must be lock free");
+
+constexpr uint32_t kMagic = 0x53484d49;  // "SHMI"
+constexpr uint32_t kVersion = 2;
+constexpr size_t kAlignment = 64;
+
+struct alignas(kAlignment) ShmRingHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t id;
+  // Process of the publisher, the segment may only be replaced once it is gone
+  int32_t owner_pid;
+  uint32_t slot_count;
+  uint64_t slot_size;
+  uint64_t slot_stride;
+  uint64_t last_sequence;
+  // Subscriber leases, the pid of a subscriber process or 0
+  std::atomic<int32_t> subscribers[ShmRing::kMaxSubscribers];
+};
+
+struct alignas(kAlignment) ShmSlotHeader
+{
+  // Sequence of the frame in this slot, 0 while it is being written
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> size;
+};
+
+namespace
+{
+size_t alignUp(size_t size) { return (size + kAlignment - 1) / kAlignment * kAlignment; }
+
+std::runtime_error shmError(const std::string & what, const std::string & name)
+{
+  return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+}
+
+bool processAlive(int32_t pid)
+{
+  // EPERM: the process exists but belongs to another user
+  return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// Publisher process of an existing segment, 0 if the segment has another layout
+int32_t segmentOwner(const std::string & name)
+{
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  uint32_t magic = 0, version = 0;
+  int32_t pid = 0;
+  bool ok = pread(fd, &magic, sizeof(magic), offsetof(ShmRingHeader, magic)) ==
+              static_cast<ssize_t>(sizeof(magic)) &&
+            pread(fd, &version, sizeof(version), offsetof(ShmRingHeader, version)) ==
+              static_cast<ssize_t>(sizeof(version)) &&
+            pread(fd, &pid, sizeof(pid), offsetof(ShmRingHeader, owner_pid)) ==
+              static_cast<ssize_t>(sizeof(pid));
+  close(fd);
+  return ok && magic == kMagic && version == kVersion ? pid : 0;
+}
+}  // namespace
+
+std::unique_ptr<ShmRing> ShmRing::create(
+  const std::string & name, uint32_t slot_count, uint64_t slot_size)
+{
+  if (slot_count < 2) {
+    throw std::runtime_error(
+      "Shared memory ring " + name + " needs at least 2 slots, got " +
+      std::to_string(slot_count));
+  }
+  const size_t slot_stride = sizeof(ShmSlotHeader) + alignUp(slot_size);
+  if (slot_stride < slot_size || slot_count > (SIZE_MAX - sizeof(ShmRingHeader)) / slot_stride) {
+    throw std::runtime_error("Shared memory ring " + name + " is too large");
+  }
+  const size_t length = sizeof(ShmRingHeader) + slot_count * slot_stride;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    int32_t owner = segmentOwner(name);
+    if (processAlive(owner)) {
+      throw std::runtime_error(
+        "Shared memory segment " + name + " is in use by the publisher in process " +
+        std::to_string(owner));
+    }
+    // Left over by a crashed publisher. Readers still mapping it keep their copy until they
+    // see the new segment id.
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+  if (fd < 0) {
+    throw shmError("shm_open", name);
+  }
+  if (ftruncate(fd, length) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw shmError("ftruncate", name);
+  }
+  void * base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw shmError("mmap", name);
+  }
+
+  auto header = new (base) ShmRingHeader;
+  header->magic = kMagic;
+  header->version = kVersion;
+  std::random_device rd;
+  header->id = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^
+               std::chrono::steady_clock::now().time_since_epoch().count();
+  header->owner_pid = getpid();
+  header->slot_count = slot_count;
+  header->slot_size = slot_size;
+  header->slot_stride = slot_stride;
+  header->last_sequence = 0;
+  for (auto & subscriber : header->subscribers) {
+    subscriber = 0;
+  }
+
+  std::unique_ptr<ShmRing> ring(new ShmRing(name, base, length, true));
+  for (uint32_t i = 0; i < slot_count; i++) {
+    auto slot = new (ring->slot(i)) ShmSlotHeader;
+    slot->sequence = 0;
+    slot->size = 0;
+  }
+  return ring;
+}
+
+std::unique_ptr<ShmRing> ShmRing::open(const std::string & name)
+{
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw shmError("shm_open", name);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+    close(fd);
+    throw std::runtime_error("Invalid shared memory segment " + name);
+  }
+  const size_t length = st.st_size;
+  void * base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    throw shmError("mmap", name);
+  }
+
+  auto header = static_cast<ShmRingHeader *>(base);
+  if (
+    header->magic != kMagic || header->version != kVersion ||
+    sizeof(ShmRingHeader) + header->slot_count * header->slot_stride > length) {
+    munmap(base, length);
+    throw std::runtime_error("Incompatible shared memory segment " + name);
+  }
+
+  std::unique_ptr<ShmRing> ring(new ShmRing(name, base, length, false));
+  ring->lease_ = ring->acquireLease();
+  return ring;
+}
+
+int ShmRing::acquireLease()
+{
+  const int32_t pid = getpid();
+  for (uint32_t i = 0; i < kMaxSubscribers; i++) {
+    int32_t holder = header_->subscribers[i].load();
+    if (
+      (holder == 0 || !processAlive(holder)) &&
+      header_->subscribers[i].compare_exchange_strong(holder, pid)) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+ShmRing::ShmRing(const std::string & name, void * base, size_t length, bool owner)
+: name_(name),
+  base_(base),
+  length_(length),
+  owner_(owner),
+  header_(static_cast<ShmRingHeader *>(base)),
+  next_slot_(0),
+  lease_(-1)
+{
+}
+
+ShmRing::~ShmRing()
+{
+  if (owner_) {
+    // Only unlink our own segment, a newer publisher may have replaced it already
+    int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+    if (fd >= 0) {
+      uint64_t current_id = 0;
+      bool same = pread(fd, &current_id, sizeof(current_id), offsetof(ShmRingHeader, id)) ==
+                    static_cast<ssize_t>(sizeof(current_id)) &&
+                  current_id == header_->id;
+      close(fd);
+      if (same) {
+        shm_unlink(name_.c_str());
+      }
+    }
+  } else if (lease_ >= 0) {
+    header_->subscribers[lease_].store(0);
+  }
+  munmap(base_, length_);
+}
+
+bool ShmRing::write(const uint8_t * data, uint64_t size, uint32_t & slot_index, uint64_t & sequence)
+{
+  if (size > header_->slot_size) {
+    return false;
+  }
+
+  // Invalidate the slot before touching its data, a reader that copied any of it sees the
+  // changed sequence afterwards
+  auto slot = this->slot(next_slot_);
+  slot->sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::memcpy(slotData(next_slot_), data, size);
+  slot->size.store(size, std::memory_order_relaxed);
+  sequence = ++header_->last_sequence;
+  slot->sequence.store(sequence, std::memory_order_release);
+
+  slot_index = next_slot_;
+  next_slot_ = (next_slot_ + 1) % header_->slot_count;
+  return true;
+}
+
+bool ShmRing::read(uint32_t slot_index, uint64_t sequence, std::vector<uint8_t> & data)
+{
+  if (slot_index >= header_->slot_count || sequence == 0) {
+    return false;
+  }
+
+  auto slot = this->slot(slot_index);
+  if (slot->sequence.load(std::memory_order_acquire) != sequence) {
+    return false;
+  }
+  // The size is only trusted once the sequence is confirmed, until then keep it in bounds
+  uint64_t size = std::min(slot->size.load(std::memory_order_relaxed), header_->slot_size);
+  data.resize(size);
+  std::memcpy(data.data(), slotData(slot_index), size);
+
+  // Overwritten while copying if the sequence changed
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot->sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+uint64_t ShmRing::id() const { return header_->id; }
+
+uint32_t ShmRing::slotCount() const { return header_->slot_count; }
+
+uint64_t ShmRing::slotSize() const { return header_->slot_size; }
+
+uint32_t ShmRing::subscriberCount() const
+{
+  uint32_t count = 0;
+  for (const auto & subscriber : header_->subscribers) {
+    count += processAlive(subscriber.load()) ? 1 : 0;
+  }
+  return count;
+}
+
+ShmSlotHeader * ShmRing::slot(uint32_t index) const
+{
+  return reinterpret_cast<ShmSlotHeader *>(
+    static_cast<uint8_t *>(base_) + sizeof(ShmRingHeader) + index * header_->slot_stride);
+}
+
+uint8_t * ShmRing::slotData(uint32_t index) const
+{
+  return reinterpret_cast<uint8_t *>(slot(index)) + sizeof(ShmSlotHeader);
+}
+
+std::string segmentName(const std::string & topic)
+{
+  std::string name = "/shm";
+  for (char c : topic) {
+    name += (c == '/') ? '_' : c;
+  }
+  if (topic.empty() || topic[0] != '/') {
+    name.insert(4, "_");
+  }
+  return name;
+}
+
+}  // namespace shm_image_transport
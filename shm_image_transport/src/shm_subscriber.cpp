@@ -0,0 +1,49 @@
+// Copyright 2022 Chen Jun
+// Licensed under the MIT License.
+
+#include "shm_image_transport/shm_subscriber.hpp"
+
+// STD
+#include <memory>
+#include <stdexcept>
+
+namespace shm_image_transport
+{
+void ShmSubscriber::internalCallback(
+  const msg::ShmImage::ConstSharedPtr & message, const Callback & user_cb)
+{
+  // (Re)map the segment when the publisher started or grew its ring
+  if (ring_ == nullptr || ring_->id() != message->segment_id) {
+    try {
+      ring_.reset();
+      ring_ = ShmRing::open(message->segment);
+    } catch (const std::runtime_error & e) {
+      RCLCPP_ERROR(logger_, "Failed to open shared memory ring: %s", e.what());
+      return;
+    }
+    if (ring_->id() != message->segment_id) {
+      // The message is older than the segment now behind the name
+      ring_.reset();
+      return;
+    }
+  }
+
+  if (image_ == nullptr || image_.use_count() > 1) {
+    image_ = std::make_shared<sensor_msgs::msg::Image>();
+  }
+
+  if (!ring_->read(message->slot, message->sequence, image_->data)) {
+    RCLCPP_DEBUG(logger_, "Frame %lu was overwritten before it was read", message->sequence);
+    return;
+  }
+
+  image_->header = message->header;
+  image_->height = message->height;
+  image_->width = message->width;
+  image_->encoding = message->encoding;
+  image_->is_bigendian = message->is_bigendian;
+  image_->step = message->step;
+  user_cb(image_);
+}
+
+}  // namespace shm_image_transport
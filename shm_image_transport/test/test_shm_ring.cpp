@@ -0,0 +1,204 @@
+// Copyright 2022 Chen Jun
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "shm_image_transport/shm_ring.hpp"
+
+using hrc = std::chrono::high_resolution_clock;
+using shm_image_transport::ShmRing;
+
+namespace
+{
+const std::string kName = "/shm_image_transport_test";
+}
+
+TEST(ShmRingTest, segment_name)
+{
+  EXPECT_EQ(shm_image_transport::segmentName("/image_raw"), "/shm_image_raw");
+  EXPECT_EQ(shm_image_transport::segmentName("image_raw"), "/shm_image_raw");
+  EXPECT_EQ(shm_image_transport::segmentName("/camera/image"), "/shm_camera_image");
+}
+
+TEST(ShmRingTest, write_read)
+{
+  auto writer = ShmRing::create(kName, 3, 1024);
+  auto reader = ShmRing::open(kName);
+  EXPECT_EQ(reader->id(), writer->id());
+  EXPECT_EQ(writer->subscriberCount(), 1u);
+
+  std::vector<uint8_t> frame(1000);
+  std::iota(frame.begin(), frame.end(), 0);
+  uint32_t slot;
+  uint64_t sequence;
+  ASSERT_TRUE(writer->write(frame.data(), frame.size(), slot, sequence));
+
+  std::vector<uint8_t> received;
+  ASSERT_TRUE(reader->read(slot, sequence, received));
+  EXPECT_EQ(received, frame);
+
+  // Too large for a slot
+  std::vector<uint8_t> large(2048);
+  EXPECT_FALSE(writer->write(large.data(), large.size(), slot, sequence));
+
+  reader.reset();
+  EXPECT_EQ(writer->subscriberCount(), 0u);
+}
+
+TEST(ShmRingTest, overwritten_frame_is_dropped)
+{
+  auto writer = ShmRing::create(kName, 2, 16);
+  auto reader = ShmRing::open(kName);
+
+  uint8_t data[16] = {1};
+  uint32_t first_slot, slot;
+  uint64_t first_sequence, sequence;
+  ASSERT_TRUE(writer->write(data, sizeof(data), first_slot, first_sequence));
+  ASSERT_TRUE(writer->write(data, sizeof(data), slot, sequence));
+  ASSERT_TRUE(writer->write(data, sizeof(data), slot, sequence));
+  EXPECT_EQ(slot, first_slot);
+
+  std::vector<uint8_t> received;
+  EXPECT_FALSE(reader->read(first_slot, first_sequence, received));
+  EXPECT_TRUE(reader->read(slot, sequence, received));
+}
+
+TEST(ShmRingTest, too_few_slots)
+{
+  EXPECT_THROW(ShmRing::create(kName, 1, 16), std::runtime_error);
+  EXPECT_THROW(ShmRing::create(kName, 0, 16), std::runtime_error);
+}
+
+TEST(ShmRingTest, stale_segment_is_replaced)
+{
+  // A publisher that crashes leaves its segment behind
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    ShmRing::create(kName, 2, 16).release();
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  auto old_reader = ShmRing::open(kName);
+  auto writer = ShmRing::create(kName, 2, 16);
+  EXPECT_NE(old_reader->id(), writer->id());
+  auto new_reader = ShmRing::open(kName);
+  EXPECT_EQ(new_reader->id(), writer->id());
+}
+
+TEST(ShmRingTest, live_segment_is_not_replaced)
+{
+  auto writer = ShmRing::create(kName, 2, 16);
+  EXPECT_THROW(ShmRing::create(kName, 2, 16), std::runtime_error);
+
+  // The first publisher keeps its segment
+  auto reader = ShmRing::open(kName);
+  EXPECT_EQ(reader->id(), writer->id());
+}
+
+TEST(ShmRingTest, crashed_subscriber_holds_nothing)
+{
+  auto writer = ShmRing::create(kName, 2, 16);
+
+  // A subscriber that dies without closing the ring
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    ShmRing::open(kName).release();
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  EXPECT_EQ(writer->subscriberCount(), 0u);
+
+  // Every slot is still written and read
+  auto reader = ShmRing::open(kName);
+  EXPECT_EQ(writer->subscriberCount(), 1u);
+  uint8_t data[16] = {1};
+  std::vector<uint8_t> received;
+  for (int i = 0; i < 4; i++) {
+    uint32_t slot;
+    uint64_t sequence;
+    ASSERT_TRUE(writer->write(data, sizeof(data), slot, sequence));
+    EXPECT_TRUE(reader->read(slot, sequence, received));
+  }
+}
+
+TEST(ShmRingTest, cross_process_benchmark)
+{
+  // 1440x1080 rgb8, the size of a full camera frame
+  const size_t frame_size = 1440 * 1080 * 3;
+  const int loop_num = 200;
+  auto writer = ShmRing::create(kName, 4, frame_size);
+
+  int to_child[2], to_parent[2];
+  ASSERT_EQ(pipe(to_child), 0);
+  ASSERT_EQ(pipe(to_parent), 0);
+
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // Subscriber process: read every announced frame and check its first byte
+    auto reader = ShmRing::open(kName);
+    std::vector<uint8_t> data;
+    int failures = 0;
+    for (int i = 0; i < loop_num; i++) {
+      uint32_t slot;
+      uint64_t sequence;
+      if (
+        ::read(to_child[0], &slot, sizeof(slot)) != sizeof(slot) ||
+        ::read(to_child[0], &sequence, sizeof(sequence)) != sizeof(sequence)) {
+        _exit(2);
+      }
+      if (!reader->read(slot, sequence, data) || data[0] != static_cast<uint8_t>(i)) {
+        failures++;
+      }
+      char ack = 0;
+      if (::write(to_parent[1], &ack, 1) != 1) {
+        _exit(2);
+      }
+    }
+    _exit(failures == 0 ? 0 : 1);
+  }
+
+  std::vector<uint8_t> frame(frame_size);
+  std::vector<double> times;
+  for (int i = 0; i < loop_num; i++) {
+    frame[0] = static_cast<uint8_t>(i);
+    auto start = hrc::now();
+    uint32_t slot;
+    uint64_t sequence;
+    ASSERT_TRUE(writer->write(frame.data(), frame.size(), slot, sequence));
+    ASSERT_EQ(::write(to_child[1], &slot, sizeof(slot)), static_cast<ssize_t>(sizeof(slot)));
+    ASSERT_EQ(
+      ::write(to_child[1], &sequence, sizeof(sequence)), static_cast<ssize_t>(sizeof(sequence)));
+    char ack;
+    ASSERT_EQ(::read(to_parent[0], &ack, 1), 1);
+    times.push_back(std::chrono::duration<double, std::milli>(hrc::now() - start).count());
+  }
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  std::sort(times.begin(), times.end());
+  std::cout << "write + cross-process read of " << frame_size / 1024 << "KB  "
+            << "median: " << times[times.size() / 2] << "ms max: " << times.back() << "ms"
+            << std::endl;
+}